@@ -0,0 +1,366 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "adpf_manager.h"
+
+#include <android/api-level.h>
+
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "JNIHelper.h"
+#include "common.h"
+#include "scene_manager.h"
+
+namespace {
+// API levels that introduced the PowerManager thermal APIs used by the JNI
+// fallback.
+const int32_t kApiLevelThermalStatus = 29;
+const int32_t kApiLevelThermalHeadroom = 30;
+
+int64_t GetMonotonicNanos() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<int64_t>(t.tv_sec) * 1000000000LL + t.tv_nsec;
+}
+}  // namespace
+
+ADPFManager* ADPFManager::GetInstance() {
+  static ADPFManager instance;
+  return &instance;
+}
+
+ADPFManager::ADPFManager()
+    : app_(nullptr),
+      thermal_manager_(nullptr),
+      power_manager_(nullptr),
+      thermal_status_(ATHERMAL_STATUS_NONE),
+      thermal_headroom_(0.f),
+      running_(false),
+      hint_manager_(nullptr),
+      perf_hint_start_ns_(0),
+      last_work_duration_ns_(0) {
+  for (auto& group : hint_groups_) {
+    group.session_ = nullptr;
+    group.target_work_duration_ns_ = 0;
+  }
+}
+
+ADPFManager::~ADPFManager() { Shutdown(); }
+
+//--------------------------------------------------------------------------------
+// Start monitoring the thermal status.
+//--------------------------------------------------------------------------------
+void ADPFManager::Initialize(android_app* app) {
+  if (running_) {
+    return;
+  }
+  app_ = app;
+
+  // Initialize() runs on the game thread, which owns the hint session.
+  InitializePerformanceHintManager();
+
+  if (!InitializeThermalManager() && !InitializePowerManagerJni()) {
+    ALOGW("ADPFManager: thermal APIs are not available on this device.");
+    return;
+  }
+
+  running_ = true;
+  poll_thread_ = std::thread(&ADPFManager::PollThermalHeadroom, this);
+}
+
+//--------------------------------------------------------------------------------
+// Stop the polling thread and release the thermal APIs.
+//--------------------------------------------------------------------------------
+void ADPFManager::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cv_.notify_all();
+  if (poll_thread_.joinable()) {
+    poll_thread_.join();
+  }
+
+  if (thermal_manager_ != nullptr) {
+    AThermal_unregisterThermalStatusListener(
+        thermal_manager_, ADPFManager::OnThermalStatusChanged, this);
+    AThermal_releaseManager(thermal_manager_);
+    thermal_manager_ = nullptr;
+  }
+
+  if (power_manager_ != nullptr) {
+    ndk_helper::JNIHelper::GetInstance()->DeleteObject(power_manager_);
+    power_manager_ = nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(hint_mutex_);
+  for (auto& group : hint_groups_) {
+    if (group.session_ != nullptr) {
+      APerformanceHint_closeSession(group.session_);
+      group.session_ = nullptr;
+    }
+    group.thread_ids_.clear();
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Acquire the NDK thermal manager and register the status listener.
+//--------------------------------------------------------------------------------
+bool ADPFManager::InitializeThermalManager() {
+  thermal_manager_ = AThermal_acquireManager();
+  if (thermal_manager_ == nullptr) {
+    return false;
+  }
+
+  thermal_status_ = AThermal_getCurrentThermalStatus(thermal_manager_);
+  AThermal_registerThermalStatusListener(
+      thermal_manager_, ADPFManager::OnThermalStatusChanged, this);
+  ALOGI("ADPFManager: using AThermal, initial status %d",
+        thermal_status_.load());
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Fallback path: retrieve android.os.PowerManager through JNI.
+//--------------------------------------------------------------------------------
+bool ADPFManager::InitializePowerManagerJni() {
+  if (app_ == nullptr ||
+      android_get_device_api_level() < kApiLevelThermalStatus) {
+    return false;
+  }
+
+  ndk_helper::JNIHelper* helper = ndk_helper::JNIHelper::GetInstance();
+  JNIEnv* env = helper->AttachCurrentThread();
+  jstring service_name = env->NewStringUTF("power");
+  jobject power_manager = helper->CallObjectMethod(
+      app_->activity->javaGameActivity, "getSystemService",
+      "(Ljava/lang/String;)Ljava/lang/Object;", service_name);
+  env->DeleteLocalRef(service_name);
+  if (power_manager == nullptr) {
+    return false;
+  }
+
+  power_manager_ = env->NewGlobalRef(power_manager);
+  env->DeleteLocalRef(power_manager);
+  ALOGI("ADPFManager: using PowerManager through JNI.");
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Polling thread. Queries the headroom at most once per
+// kThermalHeadroomUpdateIntervalMs until Shutdown() is called.
+//--------------------------------------------------------------------------------
+void ADPFManager::PollThermalHeadroom() {
+  CpuTopology::GetInstance()->PinCurrentThread(THREAD_ROLE_TELEMETRY);
+
+  // The JNI fallback needs this thread to be attached to the VM.
+  JNIEnv* env = nullptr;
+  if (power_manager_ != nullptr) {
+    app_->activity->vm->AttachCurrentThread(&env, nullptr);
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (running_) {
+    lock.unlock();
+    UpdateThermalHeadroom();
+    lock.lock();
+    cv_.wait_for(lock,
+                 std::chrono::milliseconds(kThermalHeadroomUpdateIntervalMs),
+                 [this] { return !running_; });
+  }
+  lock.unlock();
+
+  if (env != nullptr) {
+    app_->activity->vm->DetachCurrentThread();
+  }
+}
+
+void ADPFManager::UpdateThermalHeadroom() {
+  float headroom = NAN;
+  if (thermal_manager_ != nullptr) {
+    headroom = AThermal_getThermalHeadroom(thermal_manager_,
+                                           kThermalHeadroomForecastSeconds);
+  } else if (power_manager_ != nullptr) {
+    // There is no status listener on the JNI path, so poll the status too.
+    ndk_helper::JNIHelper* helper = ndk_helper::JNIHelper::GetInstance();
+    thermal_status_ =
+        helper->CallIntMethod(power_manager_, "getCurrentThermalStatus", "()I");
+    if (android_get_device_api_level() >= kApiLevelThermalHeadroom) {
+      headroom = helper->CallFloatMethod(power_manager_, "getThermalHeadroom",
+                                         "(I)F",
+                                         kThermalHeadroomForecastSeconds);
+    }
+  }
+
+  // NaN is returned when the headroom is not available or was queried too
+  // often; keep the previously cached value in that case.
+  if (!std::isnan(headroom)) {
+    thermal_headroom_ = headroom;
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Thermal status listener, called on a binder thread.
+//--------------------------------------------------------------------------------
+void ADPFManager::OnThermalStatusChanged(void* data, AThermalStatus status) {
+  ADPFManager* manager = reinterpret_cast<ADPFManager*>(data);
+  ALOGI("ADPFManager: thermal status changed %d -> %d",
+        manager->thermal_status_.load(), status);
+  manager->thermal_status_ = status;
+}
+
+//--------------------------------------------------------------------------------
+// Create the performance hint session for the calling (game) thread. The
+// sessions of the other roles are created when their first thread is added.
+//--------------------------------------------------------------------------------
+bool ADPFManager::InitializePerformanceHintManager() {
+  if (hint_manager_ == nullptr) {
+    hint_manager_ = APerformanceHint_getManager();
+  }
+  if (hint_manager_ == nullptr) {
+    ALOGW("ADPFManager: performance hint API is not available.");
+    return false;
+  }
+
+  HintGroup* group = GetHintGroup(THREAD_ROLE_RENDER);
+  group->target_work_duration_ns_ =
+      SceneManager::GetInstance()->GetPreferredSwapInterval();
+  group->thread_ids_.clear();
+  group->thread_ids_.push_back(gettid());
+  CreatePerfHintSession(group);
+  return group->session_ != nullptr;
+}
+
+void ADPFManager::CreatePerfHintSession(HintGroup* group) {
+  if (group->session_ != nullptr) {
+    APerformanceHint_closeSession(group->session_);
+    group->session_ = nullptr;
+  }
+  if (group->thread_ids_.empty()) {
+    return;
+  }
+  // A session needs a target, until its role sets one use the game thread's.
+  int64_t target_ns = group->target_work_duration_ns_;
+  if (target_ns <= 0) {
+    target_ns = GetHintGroup(THREAD_ROLE_RENDER)->target_work_duration_ns_;
+  }
+  group->session_ = APerformanceHint_createSession(
+      hint_manager_, group->thread_ids_.data(), group->thread_ids_.size(),
+      target_ns);
+  ALOGI("ADPFManager: %s hint session %p for %zu thread(s), target %lld ns",
+        CpuTopology::GetClusterTypeName(
+            static_cast<CpuClusterType>(group - hint_groups_)),
+        group->session_, group->thread_ids_.size(),
+        static_cast<long long>(target_ns));
+}
+
+ADPFManager::HintGroup* ADPFManager::GetHintGroup(ThreadRole role) {
+  return &hint_groups_[CpuTopology::GetInstance()->GetPlacement(role)];
+}
+
+bool ADPFManager::DrivesHintGroup(ThreadRole role) {
+  const CpuTopology* topology = CpuTopology::GetInstance();
+  for (auto other = 0; other < role; ++other) {
+    if (topology->GetPlacement(static_cast<ThreadRole>(other)) ==
+        topology->GetPlacement(role)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ADPFManager::AddThreadIdToHintSession(int32_t tid, ThreadRole role) {
+  std::lock_guard<std::mutex> lock(hint_mutex_);
+  HintGroup* group = GetHintGroup(role);
+  if (hint_manager_ == nullptr ||
+      std::find(group->thread_ids_.begin(), group->thread_ids_.end(), tid) !=
+          group->thread_ids_.end()) {
+    return;
+  }
+  group->thread_ids_.push_back(tid);
+  CreatePerfHintSession(group);
+}
+
+void ADPFManager::RemoveThreadIdFromHintSession(int32_t tid,
+                                                ThreadRole role) {
+  std::lock_guard<std::mutex> lock(hint_mutex_);
+  HintGroup* group = GetHintGroup(role);
+  auto it = std::find(group->thread_ids_.begin(), group->thread_ids_.end(),
+                      tid);
+  if (hint_manager_ == nullptr || it == group->thread_ids_.end()) {
+    return;
+  }
+  group->thread_ids_.erase(it);
+  CreatePerfHintSession(group);
+}
+
+bool ADPFManager::HasPerfHintSession() const {
+  std::lock_guard<std::mutex> lock(hint_mutex_);
+  return hint_groups_[CpuTopology::GetInstance()->GetPlacement(
+                          THREAD_ROLE_RENDER)]
+             .session_ != nullptr;
+}
+
+//--------------------------------------------------------------------------------
+// Report the actual duration of the work done between the Begin/End calls.
+//--------------------------------------------------------------------------------
+void ADPFManager::BeginPerfHintSession() {
+  perf_hint_start_ns_ = GetMonotonicNanos();
+}
+
+void ADPFManager::EndPerfHintSession(int64_t parallel_work_ns) {
+  if (perf_hint_start_ns_ == 0) {
+    return;
+  }
+  last_work_duration_ns_ = std::max(
+      GetMonotonicNanos() - perf_hint_start_ns_, parallel_work_ns);
+  perf_hint_start_ns_ = 0;
+  ReportWorkDuration(THREAD_ROLE_RENDER, last_work_duration_ns_);
+}
+
+void ADPFManager::ReportWorkDuration(ThreadRole role, int64_t duration_ns) {
+  if (duration_ns <= 0 || !DrivesHintGroup(role)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(hint_mutex_);
+  HintGroup* group = GetHintGroup(role);
+  if (group->session_ != nullptr) {
+    APerformanceHint_reportActualWorkDuration(group->session_, duration_ns);
+  }
+}
+
+void ADPFManager::SetTargetWorkDuration(int64_t target_duration_ns,
+                                        ThreadRole role) {
+  if (!DrivesHintGroup(role)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(hint_mutex_);
+  HintGroup* group = GetHintGroup(role);
+  if (target_duration_ns <= 0 ||
+      target_duration_ns == group->target_work_duration_ns_) {
+    return;
+  }
+  group->target_work_duration_ns_ = target_duration_ns;
+  if (group->session_ != nullptr) {
+    APerformanceHint_updateTargetWorkDuration(
+        group->session_, group->target_work_duration_ns_);
+  }
+}
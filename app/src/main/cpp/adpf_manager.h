@@ -0,0 +1,169 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ADPF_MANAGER_H_
+#define ADPF_MANAGER_H_
+
+#include <android/performance_hint.h>
+#include <android/thermal.h>
+#include <jni.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cpu_topology.h"
+
+struct android_app;
+
+/*
+ * ADPFManager monitors the device's thermal status using ADPF APIs.
+ *
+ * Thermal status changes are delivered by a status listener, while the
+ * thermal headroom is polled on a dedicated thread on a rate limited schedule.
+ * Both values are cached, so callers on the frame loop never block on a binder
+ * call. When the NDK thermal API is not available, the manager falls back to
+ * android.os.PowerManager through JNI.
+ *
+ * The manager also owns the APerformanceHintSessions, one per cluster of
+ * cores the threads are placed on (see CpuTopology), so the boost of one
+ * cluster follows the work that runs there. The game thread's session gets
+ * each frame's CPU work, bracketed by BeginPerfHintSession() and
+ * EndPerfHintSession(), and its target duration follows the swap interval.
+ * The other roles report their own work with ReportWorkDuration(). Roles
+ * placed on the same cluster share a session, which the first of them in
+ * ThreadRole order drives.
+ */
+class ADPFManager {
+ public:
+  // How far ahead (in seconds) the thermal headroom is forecasted.
+  static constexpr int32_t kThermalHeadroomForecastSeconds = 10;
+
+  // Minimum interval between two headroom polls. The platform may return NaN
+  // when the headroom is queried more often than once per second.
+  static constexpr int32_t kThermalHeadroomUpdateIntervalMs = 1000;
+
+  // Returns the (singleton) instance.
+  static ADPFManager* GetInstance();
+
+  // Start monitoring the thermal status. JNIHelper must be initialized first.
+  void Initialize(android_app* app);
+
+  // Stop monitoring and release the thermal manager.
+  void Shutdown();
+
+  // Returns the last known thermal status (AThermalStatus).
+  int32_t GetThermalStatus() const { return thermal_status_.load(); }
+
+  // Returns the last known thermal headroom, forecasted
+  // kThermalHeadroomForecastSeconds ahead. 1.0 means the device reaches
+  // THERMAL_STATUS_SEVERE. Returns 0 until the first poll completes.
+  float GetThermalHeadroom() const { return thermal_headroom_.load(); }
+
+  // Mark the beginning and the end of the work reported to the performance
+  // hint session. Must be called on the game thread. `parallel_work_ns` is
+  // the work another thread of the session did for the frame meanwhile, the
+  // render thread drawing the previous one: the longer of the two is
+  // reported, it sets the pace.
+  void BeginPerfHintSession();
+  void EndPerfHintSession(int64_t parallel_work_ns = 0);
+
+  // Duration of the last work reported through Begin/EndPerfHintSession(),
+  // in ns, whether or not a hint session is active. Game thread only.
+  int64_t GetLastWorkDuration() const { return last_work_duration_ns_; }
+
+  // Update the target work duration of the session of `role`, typically the
+  // swap interval in ns for the game thread.
+  void SetTargetWorkDuration(int64_t target_duration_ns,
+                             ThreadRole role = THREAD_ROLE_RENDER);
+
+  // Report work done by `role`, e.g. a physics tick. Ignored when the role
+  // shares its session with a role that drives it.
+  void ReportWorkDuration(ThreadRole role, int64_t duration_ns);
+
+  // Add a thread to the performance hint session of the cluster of `role`.
+  // The session is recreated, since the thread list is fixed at creation
+  // time. Unlike the other hint session calls, these two may be called from
+  // any thread.
+  void AddThreadIdToHintSession(int32_t tid, ThreadRole role);
+
+  // Remove a thread (e.g. one about to exit) from its hint session.
+  void RemoveThreadIdFromHintSession(int32_t tid, ThreadRole role);
+
+  // Returns true when the game thread's performance hint session is active.
+  bool HasPerfHintSession() const;
+
+ private:
+  ADPFManager();
+  ~ADPFManager();
+  ADPFManager(const ADPFManager&) = delete;
+  ADPFManager& operator=(const ADPFManager&) = delete;
+
+  // Helpers to set up the thermal API, either through the NDK or JNI.
+  bool InitializeThermalManager();
+  bool InitializePowerManagerJni();
+
+  // Polling thread entry and a single poll of the thermal headroom.
+  void PollThermalHeadroom();
+  void UpdateThermalHeadroom();
+
+  // The threads placed on one cluster type and their session.
+  struct HintGroup {
+    APerformanceHintSession* session_;
+    std::vector<int32_t> thread_ids_;
+    int64_t target_work_duration_ns_;
+  };
+
+  // Helpers to manage the performance hint sessions.
+  bool InitializePerformanceHintManager();
+  void CreatePerfHintSession(HintGroup* group);
+  HintGroup* GetHintGroup(ThreadRole role);
+  // True when no earlier role shares the session of `role`.
+  static bool DrivesHintGroup(ThreadRole role);
+
+  static void OnThermalStatusChanged(void* data, AThermalStatus status);
+
+  android_app* app_;
+
+  // NDK thermal manager, nullptr when the JNI fallback is used.
+  AThermalManager* thermal_manager_;
+
+  // Global ref to android.os.PowerManager for the JNI fallback.
+  jobject power_manager_;
+
+  std::atomic<int32_t> thermal_status_;
+  std::atomic<float> thermal_headroom_;
+
+  // Polling thread state.
+  std::thread poll_thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool running_;
+
+  // Performance hint session state, by CpuClusterType. hint_mutex_ guards
+  // the sessions and the thread lists against concurrent
+  // Add/RemoveThreadIdFromHintSession().
+  mutable std::mutex hint_mutex_;
+  APerformanceHintManager* hint_manager_;
+  HintGroup hint_groups_[CPU_CLUSTER_COUNT];
+  int64_t perf_hint_start_ns_;
+  int64_t last_work_duration_ns_;
+};
+
+#endif  // ADPF_MANAGER_H_
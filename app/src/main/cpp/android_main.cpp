@@ -15,7 +15,13 @@
  */
 
 #include "NDKHelper.h"
+#include "adpf_manager.h"
+#include "game_mode_manager.h"
+#include "memory_tracker.h"
 #include "native_engine.h"
+#include "power_monitor.h"
+#include "replay_log.h"
+#include "soak_test.h"
 
 extern "C" {
 void android_main(struct android_app *app);
@@ -31,6 +37,45 @@ jint JNI_OnLoad(JavaVM *vm, void * /* reserved */) {
   return JNI_VERSION_1_6;
 }
 
+// Called by ADPFSampleActivity.onCreate() when the intent asks for a soak
+// test, before the native activity starts.
+extern "C" JNIEXPORT void JNICALL
+Java_com_android_example_games_ADPFSampleActivity_nativeConfigureSoakTest(
+    JNIEnv *env, jclass /* clazz */, jint duration_seconds, jstring profile) {
+  const char *profile_chars =
+      profile != nullptr ? env->GetStringUTFChars(profile, nullptr) : nullptr;
+  if (!SoakTest::GetInstance()->Configure(static_cast<float>(duration_seconds),
+                                          profile_chars)) {
+    ALOGE("SoakTest: run refused, invalid profile \"%s\"", profile_chars);
+  }
+  if (profile_chars != nullptr) {
+    env->ReleaseStringUTFChars(profile, profile_chars);
+  }
+}
+
+// Called by ADPFSampleActivity.onCreate() when the intent asks to record or
+// replay a run, before the native activity starts.
+extern "C" JNIEXPORT void JNICALL
+Java_com_android_example_games_ADPFSampleActivity_nativeConfigureReplay(
+    JNIEnv *env, jclass /* clazz */, jint record_seconds, jstring replay_file) {
+  if (replay_file != nullptr) {
+    const char *file_chars = env->GetStringUTFChars(replay_file, nullptr);
+    ReplayLog::GetInstance()->ConfigureReplay(file_chars);
+    env->ReleaseStringUTFChars(replay_file, file_chars);
+  } else if (record_seconds > 0) {
+    ReplayLog::GetInstance()->ConfigureRecord(
+        static_cast<float>(record_seconds));
+  }
+}
+
+// Called by ADPFSampleActivity.onTrimMemory(), right before GameActivity
+// posts APP_CMD_LOW_MEMORY to the game loop.
+extern "C" JNIEXPORT void JNICALL
+Java_com_android_example_games_ADPFSampleActivity_nativeOnTrimMemory(
+    JNIEnv * /* env */, jclass /* clazz */, jint level) {
+  MemoryTracker::GetInstance()->SetTrimLevel(level);
+}
+
 /*
     android_main (not main) is our game entry function, it is called from
     the native app glue utility code as part of the onCreate handler.
@@ -41,5 +86,18 @@ void android_main(struct android_app *app) {
 
   ndk_helper::JNIHelper::Init(app);
 
+  // Start monitoring the thermal status of the device.
+  ADPFManager::GetInstance()->Initialize(app);
+
+  // Read the game mode picked in the Game Dashboard.
+  GameModeManager::GetInstance()->Initialize(app);
+
+  // Sample the battery power, to show the energy cost of the frames.
+  PowerMonitor::GetInstance()->Initialize(app);
+
   engine->GameLoop();
+
+  PowerMonitor::GetInstance()->Shutdown();
+  GameModeManager::GetInstance()->Shutdown();
+  ADPFManager::GetInstance()->Shutdown();
 }
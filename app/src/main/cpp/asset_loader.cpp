@@ -0,0 +1,166 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "asset_loader.h"
+
+#include <fstream>
+#include <iterator>
+
+#include "common.h"
+
+AssetBuffer::AssetBuffer(AAsset* asset)
+    : asset_(asset),
+      data_(static_cast<const uint8_t*>(AAsset_getBuffer(asset))),
+      size_(data_ != nullptr ? AAsset_getLength(asset) : 0) {}
+
+AssetBuffer::AssetBuffer(std::vector<uint8_t> contents)
+    : asset_(nullptr),
+      contents_(std::move(contents)),
+      data_(contents_.data()),
+      size_(contents_.size()) {}
+
+AssetBuffer::~AssetBuffer() {
+  if (asset_ != nullptr) {
+    AAsset_close(asset_);
+  }
+}
+
+AssetLoader* AssetLoader::GetInstance() {
+  static AssetLoader instance;
+  return &instance;
+}
+
+AssetLoader::AssetLoader() : asset_manager_(nullptr), running_(false) {}
+
+AssetLoader::~AssetLoader() { Shutdown(); }
+
+void AssetLoader::Initialize(AAssetManager* asset_manager) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  asset_manager_ = asset_manager;
+  if (!running_) {
+    running_ = true;
+    worker_ = std::thread(&AssetLoader::WorkerLoop, this);
+  }
+}
+
+void AssetLoader::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cv_.notify_all();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+void AssetLoader::SetAssetDirectory(const std::string& directory) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  directory_ = directory;
+}
+
+AssetFuture AssetLoader::Load(const char* path) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = loads_.find(path);
+  if (it != loads_.end()) {
+    return it->second;
+  }
+
+  Request request;
+  request.path_ = path;
+  AssetFuture future = request.promise_.get_future().share();
+  loads_[request.path_] = future;
+  if (!running_) {
+    // No worker (yet or anymore): do the IO here.
+    lock.unlock();
+    request.promise_.set_value(Read(request.path_));
+    return future;
+  }
+  requests_.push_back(std::move(request));
+  lock.unlock();
+  cv_.notify_one();
+  return future;
+}
+
+//--------------------------------------------------------------------------------
+// The queue is drained before the thread exits, so no future is left
+// without a value.
+//--------------------------------------------------------------------------------
+void AssetLoader::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] { return !running_ || !requests_.empty(); });
+    if (requests_.empty()) {
+      break;
+    }
+    Request request = std::move(requests_.front());
+    requests_.pop_front();
+    lock.unlock();
+    request.promise_.set_value(Read(request.path_));
+    lock.lock();
+  }
+}
+
+std::shared_ptr<const AssetBuffer> AssetLoader::Read(const std::string& path) {
+  AAssetManager* asset_manager;
+  bool from_directory;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    asset_manager = asset_manager_;
+    from_directory = !directory_.empty();
+  }
+  if (from_directory) {
+    return ReadFile(path);
+  }
+  if (asset_manager == nullptr) {
+    ALOGW("AssetLoader: not initialized, cannot load %s", path.c_str());
+    return nullptr;
+  }
+
+  // AASSET_MODE_BUFFER maps uncompressed assets instead of copying them.
+  AAsset* asset =
+      AAssetManager_open(asset_manager, path.c_str(), AASSET_MODE_BUFFER);
+  if (asset == nullptr) {
+    ALOGW("AssetLoader: cannot open %s", path.c_str());
+    return nullptr;
+  }
+  auto buffer = std::make_shared<const AssetBuffer>(asset);
+  if (buffer->GetData() == nullptr) {
+    ALOGW("AssetLoader: cannot read %s", path.c_str());
+    return nullptr;
+  }
+  ALOGI("AssetLoader: loaded %s (%zu bytes)", path.c_str(), buffer->GetSize());
+  return buffer;
+}
+
+std::shared_ptr<const AssetBuffer> AssetLoader::ReadFile(
+    const std::string& path) {
+  std::string file_path;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    file_path = directory_ + "/" + path;
+  }
+  std::ifstream file(file_path.c_str(), std::ios::binary);
+  if (!file) {
+    ALOGW("AssetLoader: cannot open %s", file_path.c_str());
+    return nullptr;
+  }
+  std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)),
+                                std::istreambuf_iterator<char>());
+  ALOGI("AssetLoader: loaded %s (%zu bytes)", file_path.c_str(),
+        contents.size());
+  return std::make_shared<const AssetBuffer>(std::move(contents));
+}
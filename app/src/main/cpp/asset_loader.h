@@ -0,0 +1,109 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ASSET_LOADER_H_
+#define ASSET_LOADER_H_
+
+#include <android/asset_manager.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Contents of a loaded asset. Uncompressed assets stay memory mapped from the
+ * APK, compressed ones are inflated into memory by the asset manager. Assets
+ * read from a directory are held in memory.
+ */
+class AssetBuffer {
+ public:
+  explicit AssetBuffer(AAsset* asset);
+  explicit AssetBuffer(std::vector<uint8_t> contents);
+  ~AssetBuffer();
+
+  AssetBuffer(const AssetBuffer&) = delete;
+  AssetBuffer& operator=(const AssetBuffer&) = delete;
+
+  const uint8_t* GetData() const { return data_; }
+  size_t GetSize() const { return size_; }
+
+ private:
+  AAsset* asset_;
+  std::vector<uint8_t> contents_;
+  const uint8_t* data_;
+  size_t size_;
+};
+
+// Result of a load, null when the asset could not be read.
+typedef std::shared_future<std::shared_ptr<const AssetBuffer>> AssetFuture;
+
+/*
+ * Reads assets on a worker thread, so that a scene about to be installed
+ * does not stall the frames of the current one on file IO. Only the GL
+ * object creation is left to the render thread.
+ *
+ * Loads are cached by path: requesting an asset again, e.g. to rebuild the
+ * GL objects after a context loss, returns the same buffer without IO.
+ */
+class AssetLoader {
+ public:
+  static AssetLoader* GetInstance();
+
+  // Start the worker thread. Until then, Load() reads on the calling thread.
+  void Initialize(AAssetManager* asset_manager);
+
+  // Read the assets from the files under `directory` rather than from the
+  // APK, for tools running without an activity. Call before any Load().
+  void SetAssetDirectory(const std::string& directory);
+
+  // Finish the queued loads and stop the worker thread.
+  void Shutdown();
+
+  // Queue the load of an asset, or return its pending or completed load.
+  // May be called from any thread.
+  AssetFuture Load(const char* path);
+
+ private:
+  struct Request {
+    std::string path_;
+    std::promise<std::shared_ptr<const AssetBuffer>> promise_;
+  };
+
+  AssetLoader();
+  ~AssetLoader();
+
+  void WorkerLoop();
+  std::shared_ptr<const AssetBuffer> Read(const std::string& path);
+  std::shared_ptr<const AssetBuffer> ReadFile(const std::string& path);
+
+  AAssetManager* asset_manager_;
+  std::string directory_;
+  std::thread worker_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Request> requests_;
+  std::map<std::string, AssetFuture> loads_;
+  bool running_;
+};
+
+#endif  // ASSET_LOADER_H_
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "box_culler.h"
+
+#include <cmath>
+
+#include "VecMath.h"
+
+#if defined(VECMATH_USE_NEON)
+#include <arm_neon.h>
+#elif defined(VECMATH_USE_SSE)
+#include <xmmintrin.h>
+#endif
+
+namespace {
+const int32_t kFloorPlane = BoxCuller::kNumPlanes - 1;
+}  // namespace
+
+BoxCuller::BoxCuller() {
+  // Nothing is culled until the planes are set.
+  for (auto i = 0; i < kNumPlanes; ++i) {
+    SetPlane(i, 0.f, 0.f, 0.f, 1.f);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Gribb & Hartmann: the clip space planes are sums and differences of the last
+// row of the matrix with the other rows.
+//--------------------------------------------------------------------------------
+void BoxCuller::SetViewProjection(const float* m) {
+  // Row i of a column major matrix.
+  auto row = [m](int32_t i, int32_t column) { return m[column * 4 + i]; };
+  for (auto i = 0; i < 3; ++i) {
+    SetPlane(i * 2, row(3, 0) + row(i, 0), row(3, 1) + row(i, 1),
+             row(3, 2) + row(i, 2), row(3, 3) + row(i, 3));
+    SetPlane(i * 2 + 1, row(3, 0) - row(i, 0), row(3, 1) - row(i, 1),
+             row(3, 2) - row(i, 2), row(3, 3) - row(i, 3));
+  }
+}
+
+void BoxCuller::SetFloorHeight(float height) {
+  SetPlane(kFloorPlane, 0.f, 1.f, 0.f, -height);
+}
+
+void BoxCuller::ClearFloorHeight() {
+  SetPlane(kFloorPlane, 0.f, 0.f, 0.f, 1.f);
+}
+
+//--------------------------------------------------------------------------------
+// Normalize the planes, so the plane equation gives the distance to compare
+// with the radius.
+//--------------------------------------------------------------------------------
+void BoxCuller::SetPlane(int32_t index, float a, float b, float c, float d) {
+  float length = sqrtf(a * a + b * b + c * c);
+  float scale = length > 0.f ? 1.f / length : 1.f;
+  a_[index] = a * scale;
+  b_[index] = b * scale;
+  c_[index] = c * scale;
+  d_[index] = d * scale;
+}
+
+int32_t BoxCuller::Cull(const float* x, const float* y, const float* z,
+                        const float* radius, int32_t count,
+                        int32_t* visible) const {
+  int32_t num_visible = 0;
+  int32_t i = 0;
+#if defined(VECMATH_USE_NEON)
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t vx = vld1q_f32(x + i);
+    float32x4_t vy = vld1q_f32(y + i);
+    float32x4_t vz = vld1q_f32(z + i);
+    float32x4_t vr = vld1q_f32(radius + i);
+    uint32x4_t inside = vdupq_n_u32(0xffffffff);
+    for (auto p = 0; p < kNumPlanes; ++p) {
+      float32x4_t distance = vaddq_f32(vdupq_n_f32(d_[p]), vr);
+      distance = vmlaq_n_f32(distance, vx, a_[p]);
+      distance = vmlaq_n_f32(distance, vy, b_[p]);
+      distance = vmlaq_n_f32(distance, vz, c_[p]);
+      inside = vandq_u32(inside, vcgeq_f32(distance, vdupq_n_f32(0.f)));
+    }
+    uint32_t lanes[4];
+    vst1q_u32(lanes, inside);
+    for (auto lane = 0; lane < 4; ++lane) {
+      visible[num_visible] = i + lane;
+      num_visible += lanes[lane] & 1;
+    }
+  }
+#elif defined(VECMATH_USE_SSE)
+  for (; i + 4 <= count; i += 4) {
+    __m128 vx = _mm_loadu_ps(x + i);
+    __m128 vy = _mm_loadu_ps(y + i);
+    __m128 vz = _mm_loadu_ps(z + i);
+    __m128 vr = _mm_loadu_ps(radius + i);
+    __m128 inside = _mm_cmpeq_ps(vr, vr);
+    for (auto p = 0; p < kNumPlanes; ++p) {
+      __m128 distance = _mm_add_ps(_mm_set1_ps(d_[p]), vr);
+      distance = _mm_add_ps(distance, _mm_mul_ps(vx, _mm_set1_ps(a_[p])));
+      distance = _mm_add_ps(distance, _mm_mul_ps(vy, _mm_set1_ps(b_[p])));
+      distance = _mm_add_ps(distance, _mm_mul_ps(vz, _mm_set1_ps(c_[p])));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+    }
+    int mask = _mm_movemask_ps(inside);
+    for (auto lane = 0; lane < 4; ++lane) {
+      visible[num_visible] = i + lane;
+      num_visible += (mask >> lane) & 1;
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    bool inside = true;
+    for (auto p = 0; p < kNumPlanes && inside; ++p) {
+      inside = a_[p] * x[i] + b_[p] * y[i] + c_[p] * z[i] + d_[p] + radius[i] >=
+               0.f;
+    }
+    visible[num_visible] = i;
+    num_visible += inside ? 1 : 0;
+  }
+  return num_visible;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BOX_CULLER_H_
+#define BOX_CULLER_H_
+
+#include <cstdint>
+
+/*
+ * Bounding sphere culling of the boxes against the view frustum, plus an
+ * optional floor plane for the boxes that fell off the ground.
+ *
+ * The spheres are passed as separate arrays of centers and radii, and tested
+ * four at a time with NEON or SSE when available (see VecMath.h).
+ */
+class BoxCuller {
+ public:
+  // The six frustum planes and the floor.
+  static constexpr int32_t kNumPlanes = 7;
+
+  BoxCuller();
+
+  // Extract the frustum planes of a column major view projection matrix.
+  void SetViewProjection(const float* view_projection);
+
+  // Also cull the spheres entirely below `height`.
+  void SetFloorHeight(float height);
+  void ClearFloorHeight();
+
+  // Write the indices of the spheres at least partly inside to `visible`,
+  // in order. Returns how many there are. `visible` must have room for
+  // `count` indices.
+  int32_t Cull(const float* x, const float* y, const float* z,
+               const float* radius, int32_t count, int32_t* visible) const;
+
+ private:
+  void SetPlane(int32_t index, float a, float b, float c, float d);
+
+  // A point is inside all planes where a * x + b * y + c * z + d >= 0.
+  float a_[kNumPlanes];
+  float b_[kNumPlanes];
+  float c_[kNumPlanes];
+  float d_[kNumPlanes];
+};
+
+#endif  // BOX_CULLER_H_
@@ -23,12 +23,46 @@
 //--------------------------------------------------------------------------------
 #include "box_renderer.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "Trace.h"
+#include "gl_state_cache.h"
+#include "memory_tracker.h"
+#include "program_cache.h"
+
 const float CAM_X = -5.f;
 const float CAM_Y = -5.f;
 const float CAM_Z = 170.f;
 const float CAM_NEAR = 5.f;
 const float CAM_FAR = 1000.f;
 
+// Initial # of boxes per instance ring region.
+const int32_t INSTANCE_RING_INITIAL_CAPACITY = 512;
+
+// Max time to wait for the GPU to release an instance ring region.
+const GLuint64 INSTANCE_FENCE_TIMEOUT_NS = 100000000;  // 100 ms
+
+// Shaders of each shading tier, for the per box and the instanced paths.
+const char *SHADING_TIER_NAMES[BOX_SHADING_COUNT] = {"Full", "Vertex Lit",
+                                                     "Flat"};
+const char *SHADING_TIER_VSH[BOX_SHADING_COUNT] = {
+    "Shaders/VS_ShaderPlain.vsh", "Shaders/VS_ShaderVertexLit.vsh",
+    "Shaders/VS_ShaderFlat.vsh"};
+const char *SHADING_TIER_FSH[BOX_SHADING_COUNT] = {
+    "Shaders/ShaderPlain.fsh", "Shaders/ShaderColor.fsh",
+    "Shaders/ShaderColor.fsh"};
+const char *INSTANCED_SHADING_TIER_VSH[BOX_SHADING_COUNT] = {
+    "Shaders/VS_ShaderPlainInstanced.vsh",
+    "Shaders/VS_ShaderVertexLitInstanced.vsh",
+    "Shaders/VS_ShaderFlatInstanced.vsh"};
+const char *INSTANCED_SHADING_TIER_FSH[BOX_SHADING_COUNT] = {
+    "Shaders/ShaderPlainInstanced.fsh", "Shaders/ShaderColorInstanced.fsh",
+    "Shaders/ShaderColorInstanced.fsh"};
+
 //--------------------------------------------------------------------------------
 // Box model data
 //--------------------------------------------------------------------------------
@@ -47,31 +81,81 @@ uint16_t box_indices[6 * 6] = {0,  1,  2,  2,  3,  0,  7,  4,  8,  8,  11, 7,
 //--------------------------------------------------------------------------------
 // Ctor
 //--------------------------------------------------------------------------------
-BoxRenderer::BoxRenderer() : camera_(nullptr) {}
+BoxRenderer::BoxRenderer()
+    : ibo_(0),
+      vbo_(0),
+      vao_(0),
+      shading_tier_(BOX_SHADING_FULL),
+      frame_tier_(BOX_SHADING_FULL),
+      active_shader_param_(nullptr),
+      instanced_(false),
+      instance_vbo_(0),
+      instance_ring_index_(0),
+      instance_capacity_(0),
+      mapped_instances_(nullptr),
+      num_instances_(0),
+      geometry_size_(0),
+      camera_(nullptr) {
+  for (auto tier = 0; tier < BOX_SHADING_COUNT; ++tier) {
+    shader_params_[tier].program_ = 0;
+    instanced_shader_params_[tier].program_ = 0;
+  }
+  for (auto i = 0; i < kInstanceRingSize; ++i) {
+    instance_fences_[i] = 0;
+  }
+}
 
 //--------------------------------------------------------------------------------
 // Dtor
 //--------------------------------------------------------------------------------
 BoxRenderer::~BoxRenderer() { Unload(); }
 
+//--------------------------------------------------------------------------------
+// Queue the sources of every tier of both paths.
+//--------------------------------------------------------------------------------
+std::vector<AssetFuture> BoxRenderer::LoadShaderAssets() {
+  const char *const *sources[] = {SHADING_TIER_VSH, SHADING_TIER_FSH,
+                                  INSTANCED_SHADING_TIER_VSH,
+                                  INSTANCED_SHADING_TIER_FSH};
+  AssetLoader *loader = AssetLoader::GetInstance();
+  std::vector<AssetFuture> assets;
+  for (auto files : sources) {
+    for (auto tier = 0; tier < BOX_SHADING_COUNT; ++tier) {
+      assets.push_back(loader->Load(files[tier]));
+    }
+  }
+  return assets;
+}
+
 //--------------------------------------------------------------------------------
 // Initialize shaders and buffers used to render the cube.
 //--------------------------------------------------------------------------------
 void BoxRenderer::Init() {
+  SAMPLES_TRACE_SCOPE("BoxRenderer::Init");
   // Settings
-  glEnable(GL_DEPTH_TEST);
-
-  // Load shader
-  LoadShaders(&shader_param_, "Shaders/VS_ShaderPlain.vsh",
-              "Shaders/ShaderPlain.fsh");
+  GLStateCache *state = GLStateCache::GetInstance();
+  state->Enable(GL_DEPTH_TEST);
+  // The index buffer must not end up in a vertex array object yet.
+  state->BindVertexArray(0);
+
+  // Load shaders. The cheaper tiers are optional, boxes keep the full
+  // lighting when they fail to build.
+  for (auto tier = 0; tier < BOX_SHADING_COUNT; ++tier) {
+    if (!LoadShaders(&shader_params_[tier], SHADING_TIER_VSH[tier],
+                     SHADING_TIER_FSH[tier])) {
+      LOGW("BoxRenderer: shading tier %s not available",
+           SHADING_TIER_NAMES[tier]);
+      shader_params_[tier].program_ = 0;
+    }
+  }
 
   // Create Index buffer
   num_indices_ = sizeof(box_indices) / sizeof(box_indices[0]);
   glGenBuffers(1, &ibo_);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+  state->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(box_indices), box_indices,
                GL_STATIC_DRAW);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  state->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
   // Create VBO
   const int32_t NUM_FACES = 6;
@@ -95,18 +179,225 @@ void BoxRenderer::Init() {
     }
   }
   glGenBuffers(1, &vbo_);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  state->BindBuffer(GL_ARRAY_BUFFER, vbo_);
   glBufferData(GL_ARRAY_BUFFER, stride * num_vertices_, p, GL_STATIC_DRAW);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  state->BindBuffer(GL_ARRAY_BUFFER, 0);
+  geometry_size_ = sizeof(box_indices) + stride * num_vertices_;
+  MemoryTracker::GetInstance()->Allocate(MEMORY_CATEGORY_GL_BUFFERS,
+                                         geometry_size_);
 
   delete[] p;
 
+  // Record the geometry in a vertex array object, so binding the boxes is a
+  // single call per frame.
+  vao_ = state->CreateVertexArray();
+  if (vao_) {
+    state->BindVertexArray(vao_);
+    BindGeometry();
+    state->BindVertexArray(0);
+  }
+
+  InitInstancing();
+  // A tier picked before a context loss might not have been rebuilt.
+  if (!IsShadingTierAvailable(shading_tier_)) {
+    shading_tier_ = BOX_SHADING_FULL;
+  }
+
   UpdateViewport();
   mat_view_ = ndk_helper::Mat4::LookAt(ndk_helper::Vec3(CAM_X, CAM_Y, CAM_Z),
                                        ndk_helper::Vec3(0.f, 0.f, 0.f),
                                        ndk_helper::Vec3(0.f, 1.f, 0.f));
 }
 
+//--------------------------------------------------------------------------------
+// Set up the instanced rendering path when the context supports OpenGL ES 3.
+//--------------------------------------------------------------------------------
+void BoxRenderer::InitInstancing() {
+  // GL_VERSION is "OpenGL ES <major>.<minor> <vendor specific info>".
+  const char *version =
+      reinterpret_cast<const char *>(glGetString(GL_VERSION));
+  const char *prefix = "OpenGL ES ";
+  instanced_ = version != nullptr &&
+               strncmp(version, prefix, strlen(prefix)) == 0 &&
+               atoi(version + strlen(prefix)) >= 3;
+  if (!instanced_) {
+    LOGI("BoxRenderer: instancing not supported (%s), drawing per box",
+         version ? version : "unknown");
+    return;
+  }
+
+  if (!LoadShaders(&instanced_shader_params_[BOX_SHADING_FULL],
+                   INSTANCED_SHADING_TIER_VSH[BOX_SHADING_FULL],
+                   INSTANCED_SHADING_TIER_FSH[BOX_SHADING_FULL])) {
+    LOGI("BoxRenderer: failed to load instanced shaders, drawing per box");
+    instanced_ = false;
+    return;
+  }
+  for (auto tier = BOX_SHADING_FULL + 1; tier < BOX_SHADING_COUNT; ++tier) {
+    if (!LoadShaders(&instanced_shader_params_[tier],
+                     INSTANCED_SHADING_TIER_VSH[tier],
+                     INSTANCED_SHADING_TIER_FSH[tier])) {
+      LOGW("BoxRenderer: instanced shading tier %s not available",
+           SHADING_TIER_NAMES[tier]);
+      instanced_shader_params_[tier].program_ = 0;
+    }
+  }
+
+  glGenBuffers(1, &instance_vbo_);
+  instance_capacity_ = 0;
+  instance_ring_index_ = 0;
+  num_instances_ = 0;
+  ReserveInstances(INSTANCE_RING_INITIAL_CAPACITY);
+
+  // The instance attributes only need their pointers set per frame, as the
+  // ring region moves. The vertex array object keeps the rest.
+  if (vao_) {
+    GLStateCache *state = GLStateCache::GetInstance();
+    state->BindVertexArray(vao_);
+    SetInstanceAttributesEnabled(true);
+    state->BindVertexArray(0);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Vertex and index buffer of the box, into the current vertex array.
+//--------------------------------------------------------------------------------
+void BoxRenderer::BindGeometry() {
+  GLStateCache *state = GLStateCache::GetInstance();
+  state->BindBuffer(GL_ARRAY_BUFFER, vbo_);
+
+  // Pass the vertex data
+  int32_t iStride = sizeof(BOX_VERTEX);
+  glVertexAttribPointer(ATTRIB_VERTEX, 3, GL_FLOAT, GL_FALSE, iStride,
+                        BUFFER_OFFSET(0));
+  glEnableVertexAttribArray(ATTRIB_VERTEX);
+
+  glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, iStride,
+                        BUFFER_OFFSET(3 * sizeof(GLfloat)));
+  glEnableVertexAttribArray(ATTRIB_NORMAL);
+
+  // Bind the IB
+  state->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+}
+
+void BoxRenderer::SetInstanceAttributesEnabled(bool enabled) {
+  for (int32_t location = ATTRIB_INSTANCE_MODEL;
+       location <= ATTRIB_INSTANCE_COLOR; ++location) {
+    if (enabled) {
+      glEnableVertexAttribArray(location);
+      glVertexAttribDivisor(location, 1);
+    } else {
+      glVertexAttribDivisor(location, 0);
+      glDisableVertexAttribArray(location);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+// (Re)allocate the instance ring so that each region holds `count` boxes.
+//--------------------------------------------------------------------------------
+void BoxRenderer::ReserveInstances(int32_t count) {
+  if (!instanced_ || count <= instance_capacity_) {
+    return;
+  }
+  // Grow geometrically: the box count changes a few boxes at a time.
+  ResizeInstanceRing(count > instance_capacity_ * 2 ? count
+                                                    : instance_capacity_ * 2);
+}
+
+//--------------------------------------------------------------------------------
+// Growing by doubling leaves up to half of the ring unused, and a box count
+// that went down leaves more.
+//--------------------------------------------------------------------------------
+int64_t BoxRenderer::TrimInstanceRing() {
+  if (!instanced_ || mapped_instances_ != nullptr) {
+    return 0;
+  }
+  int32_t capacity = num_instances_ > INSTANCE_RING_INITIAL_CAPACITY
+                         ? num_instances_
+                         : INSTANCE_RING_INITIAL_CAPACITY;
+  if (capacity >= instance_capacity_) {
+    return 0;
+  }
+  int64_t previous_size = GetInstanceRingSize();
+  ResizeInstanceRing(capacity);
+  return previous_size - GetInstanceRingSize();
+}
+
+void BoxRenderer::ResizeInstanceRing(int32_t capacity) {
+  MY_ASSERT(mapped_instances_ == nullptr);
+
+  // The GPU may still read any region of the old storage.
+  for (auto i = 0; i < kInstanceRingSize; ++i) {
+    WaitInstanceFence(i);
+  }
+
+  MemoryTracker *tracker = MemoryTracker::GetInstance();
+  tracker->Free(MEMORY_CATEGORY_GL_BUFFERS, GetInstanceRingSize());
+  instance_capacity_ = capacity;
+  tracker->Allocate(MEMORY_CATEGORY_GL_BUFFERS, GetInstanceRingSize());
+  // Only the instance ring uses GL_COPY_WRITE_BUFFER, it stays bound.
+  GLStateCache::GetInstance()->BindBuffer(GL_COPY_WRITE_BUFFER, instance_vbo_);
+  glBufferData(GL_COPY_WRITE_BUFFER,
+               sizeof(BOX_INSTANCE) * instance_capacity_ * kInstanceRingSize,
+               nullptr, GL_DYNAMIC_DRAW);
+  instance_ring_index_ = 0;
+  LOGI("BoxRenderer: instance ring %d x %d boxes", kInstanceRingSize,
+       instance_capacity_);
+}
+
+//--------------------------------------------------------------------------------
+// Wait until the GPU is done with a ring region and release its fence.
+//--------------------------------------------------------------------------------
+void BoxRenderer::WaitInstanceFence(int32_t index) {
+  GLsync fence = instance_fences_[index];
+  if (fence == 0) {
+    return;
+  }
+  SAMPLES_TRACE_SCOPE("BoxRenderer::WaitInstanceFence");
+  GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                   INSTANCE_FENCE_TIMEOUT_NS);
+  if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED) {
+    LOGW("BoxRenderer: instance fence %d not signaled (0x%x)", index, result);
+  }
+  glDeleteSync(fence);
+  instance_fences_[index] = 0;
+}
+
+//--------------------------------------------------------------------------------
+// Map the current ring region for writing. Since the fence guarantees the
+// GPU is done with it, the mapping is unsynchronized.
+//--------------------------------------------------------------------------------
+bool BoxRenderer::MapInstanceRing() {
+  WaitInstanceFence(instance_ring_index_);
+
+  GLsizeiptr region_size = sizeof(BOX_INSTANCE) * instance_capacity_;
+  GLStateCache::GetInstance()->BindBuffer(GL_COPY_WRITE_BUFFER, instance_vbo_);
+  mapped_instances_ = reinterpret_cast<BOX_INSTANCE *>(glMapBufferRange(
+      GL_COPY_WRITE_BUFFER, region_size * instance_ring_index_, region_size,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+          GL_MAP_UNSYNCHRONIZED_BIT));
+  return mapped_instances_ != nullptr;
+}
+
+void BoxRenderer::ReleaseInstanceRing() {
+  if (mapped_instances_ != nullptr) {
+    GLStateCache::GetInstance()->BindBuffer(GL_COPY_WRITE_BUFFER,
+                                            instance_vbo_);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    mapped_instances_ = nullptr;
+  }
+  for (auto i = 0; i < kInstanceRingSize; ++i) {
+    if (instance_fences_[i] != 0) {
+      glDeleteSync(instance_fences_[i]);
+      instance_fences_[i] = 0;
+    }
+  }
+  MemoryTracker::GetInstance()->Free(MEMORY_CATEGORY_GL_BUFFERS,
+                                     GetInstanceRingSize());
+  instance_capacity_ = 0;
+}
+
 //--------------------------------------------------------------------------------
 // Method to initialize the viewport.
 //--------------------------------------------------------------------------------
@@ -132,20 +423,87 @@ void BoxRenderer::UpdateViewport() {
 // Unload shaders and buffers.
 //--------------------------------------------------------------------------------
 void BoxRenderer::Unload() {
+  GLStateCache *state = GLStateCache::GetInstance();
+  if (vao_) {
+    state->DeleteVertexArray(vao_);
+    vao_ = 0;
+  }
+
   if (vbo_) {
-    glDeleteBuffers(1, &vbo_);
+    state->DeleteBuffer(vbo_);
     vbo_ = 0;
   }
 
   if (ibo_) {
-    glDeleteBuffers(1, &ibo_);
+    state->DeleteBuffer(ibo_);
     ibo_ = 0;
   }
+  MemoryTracker::GetInstance()->Free(MEMORY_CATEGORY_GL_BUFFERS,
+                                     geometry_size_);
+  geometry_size_ = 0;
+
+  for (auto tier = 0; tier < BOX_SHADING_COUNT; ++tier) {
+    if (shader_params_[tier].program_) {
+      state->DeleteProgram(shader_params_[tier].program_);
+      shader_params_[tier].program_ = 0;
+    }
+  }
 
-  if (shader_param_.program_) {
-    glDeleteProgram(shader_param_.program_);
-    shader_param_.program_ = 0;
+  ReleaseInstanceRing();
+  if (instance_vbo_) {
+    state->DeleteBuffer(instance_vbo_);
+    instance_vbo_ = 0;
+  }
+
+  for (auto tier = 0; tier < BOX_SHADING_COUNT; ++tier) {
+    if (instanced_shader_params_[tier].program_) {
+      state->DeleteProgram(instanced_shader_params_[tier].program_);
+      instanced_shader_params_[tier].program_ = 0;
+    }
   }
+  instanced_ = false;
+  active_shader_param_ = nullptr;
+}
+
+//--------------------------------------------------------------------------------
+// Shading tiers.
+//--------------------------------------------------------------------------------
+void BoxRenderer::SetShadingTier(BOX_SHADING_TIER tier) {
+  if (tier < BOX_SHADING_FULL || tier >= BOX_SHADING_COUNT ||
+      !IsShadingTierAvailable(tier)) {
+    return;
+  }
+  if (tier != shading_tier_) {
+    LOGI("BoxRenderer: shading tier %s", SHADING_TIER_NAMES[tier]);
+  }
+  shading_tier_ = tier;
+}
+
+const char *BoxRenderer::GetShadingTierName(BOX_SHADING_TIER tier) {
+  if (tier < BOX_SHADING_FULL || tier >= BOX_SHADING_COUNT) {
+    return "Unknown";
+  }
+  return SHADING_TIER_NAMES[tier];
+}
+
+bool BoxRenderer::DecreaseShadingTier() {
+  for (auto tier = shading_tier_ + 1; tier < BOX_SHADING_COUNT; ++tier) {
+    if (IsShadingTierAvailable(tier)) {
+      SetShadingTier(static_cast<BOX_SHADING_TIER>(tier));
+      return true;
+    }
+  }
+  return false;
+}
+
+bool BoxRenderer::IncreaseShadingTier() {
+  for (auto tier = shading_tier_ - 1; tier >= BOX_SHADING_FULL; --tier) {
+    if (IsShadingTierAvailable(tier)) {
+      SetShadingTier(static_cast<BOX_SHADING_TIER>(tier));
+      return true;
+    }
+  }
+  return false;
 }
 
 //--------------------------------------------------------------------------------
@@ -169,29 +527,43 @@ void BoxRenderer::Update(float fTime) {
 //--------------------------------------------------------------------------------
 // Set up rendering of cubes.
 //--------------------------------------------------------------------------------
-void BoxRenderer::BeginMultipleRender() {
-  glEnable(GL_DEPTH_TEST);
+void BoxRenderer::BeginMultipleRender() { BeginMultipleRender(shading_tier_); }
 
-  // Bind the VBO
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-
-  // Pass the vertex data
-  int32_t iStride = sizeof(BOX_VERTEX);
-  glVertexAttribPointer(ATTRIB_VERTEX, 3, GL_FLOAT, GL_FALSE, iStride,
-                        BUFFER_OFFSET(0));
-  glEnableVertexAttribArray(ATTRIB_VERTEX);
+void BoxRenderer::BeginMultipleRender(BOX_SHADING_TIER tier) {
+  GLStateCache *state = GLStateCache::GetInstance();
+  state->Enable(GL_DEPTH_TEST);
 
-  glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, iStride,
-                        BUFFER_OFFSET(3 * sizeof(GLfloat)));
-  glEnableVertexAttribArray(ATTRIB_NORMAL);
+  if (vao_) {
+    state->BindVertexArray(vao_);
+  } else {
+    BindGeometry();
+  }
 
-  // Bind the IB
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo_);
+  frame_tier_ = tier;
+  if (instanced_) {
+    // Boxes are written by RenderMultiple() into the mapped ring region and
+    // drawn at the end.
+    num_instances_ = 0;
+    if (MapInstanceRing()) {
+      return;
+    }
+    LOGW("BoxRenderer: failed to map the instance ring, drawing per box");
+    ReleaseInstanceRing();
+    if (vao_) {
+      SetInstanceAttributesEnabled(false);
+    }
+    instanced_ = false;
+  }
 
-  glUseProgram(shader_param_.program_);
+  // The per box path may lack the tier picked for the instanced one.
+  if (!IsShadingTierAvailable(frame_tier_)) {
+    frame_tier_ = BOX_SHADING_FULL;
+  }
+  active_shader_param_ = &shader_params_[frame_tier_];
+  state->UseProgram(active_shader_param_->program_);
 
   // Update uniforms
-  glUniform3f(shader_param_.light0_, -5.f, -5.f, -5.f);
+  glUniform3f(active_shader_param_->light0_, -5.f, -5.f, -5.f);
 }
 
 //--------------------------------------------------------------------------------
@@ -200,29 +572,84 @@ void BoxRenderer::BeginMultipleRender() {
 void BoxRenderer::RenderMultiple(const float *const mat, float width,
                                  float height, float depth,
                                  const float *const color) {
-  float diffuse_color[3] = {0.5f * color[0], 0.5f * color[1], 0.5f * color[2]};
+  if (instanced_) {
+    if (num_instances_ >= instance_capacity_) {
+      // ReserveInstances() was not called with the current box count.
+      return;
+    }
+    // This is write-combined GPU memory: only write, never read back.
+    MakeInstance(mat, width, height, depth, color,
+                 &mapped_instances_[num_instances_++]);
+    return;
+  }
+
+  BOX_INSTANCE instance;
+  MakeInstance(mat, width, height, depth, color, &instance);
+  DrawBox(instance);
+}
+
+void BoxRenderer::RenderMultiple(const BOX_INSTANCE *instances,
+                                 int32_t count) {
+  if (instanced_) {
+    // Boxes past what ReserveInstances() made room for are dropped.
+    const int32_t copied = std::min(count, instance_capacity_ - num_instances_);
+    if (copied > 0) {
+      memcpy(mapped_instances_ + num_instances_, instances,
+             sizeof(BOX_INSTANCE) * copied);
+      num_instances_ += copied;
+    }
+    return;
+  }
+
+  for (auto i = 0; i < count; ++i) {
+    DrawBox(instances[i]);
+  }
+}
+
+void BoxRenderer::MakeInstance(const float *const mat, float width,
+                               float height, float depth,
+                               const float *const color,
+                               BOX_INSTANCE *instance) {
+  // Same as model * Mat4::Scale(width, height, depth): scale the first
+  // three columns of the model matrix.
+  for (auto i = 0; i < 4; ++i) {
+    instance->model[i] = mat[i] * width;
+    instance->model[4 + i] = mat[4 + i] * height;
+    instance->model[8 + i] = mat[8 + i] * depth;
+    instance->model[12 + i] = mat[12 + i];
+  }
+  instance->color[0] = 0.5f * color[0];
+  instance->color[1] = 0.5f * color[1];
+  instance->color[2] = 0.5f * color[2];
+  instance->color[3] = 1.f;
+}
+
+//--------------------------------------------------------------------------------
+// Draw a single cube with the per box program.
+//--------------------------------------------------------------------------------
+void BoxRenderer::DrawBox(const BOX_INSTANCE &instance) {
   float specular_color[4] = {0.3f, 0.3f, 0.3f, 10.f};
   float ambient_color[3] = {0.1f, 0.1f, 0.1f};
+  const SHADER_PARAMS &params = *active_shader_param_;
 
   //
   // using glUniform3fv here was troublesome
   //
-  glUniform3f(shader_param_.material_ambient_, ambient_color[0],
-              ambient_color[1], ambient_color[2]);
-  glUniform4f(shader_param_.material_specular_, specular_color[0],
-              specular_color[1], specular_color[2], specular_color[3]);
-  glUniform4f(shader_param_.material_diffuse_, diffuse_color[0],
-              diffuse_color[1], diffuse_color[2], 1.f);
+  glUniform3f(params.material_ambient_, ambient_color[0], ambient_color[1],
+              ambient_color[2]);
+  glUniform4f(params.material_specular_, specular_color[0], specular_color[1],
+              specular_color[2], specular_color[3]);
+  glUniform4f(params.material_diffuse_, instance.color[0], instance.color[1],
+              instance.color[2], instance.color[3]);
 
   //
-  // Feed Projection and Model View matrices to the shaders
-  auto scale = ndk_helper::Mat4::Scale(width, height, depth);
-  auto model = ndk_helper::Mat4(mat);
-  auto mat_vm = mat_view_ * model * scale;
-  auto mat_vp = mat_projection_ * mat_vm;
-  glUniformMatrix4fv(shader_param_.matrix_view_, 1, GL_FALSE, mat_vm.Ptr());
-  glUniformMatrix4fv(shader_param_.matrix_projection_, 1, GL_FALSE,
-                     mat_vp.Ptr());
+  // Feed Projection and Model View matrices to the shaders.
+  float mat_vm[16];
+  float mat_vp[16];
+  ndk_helper::Mat4::Multiply(mat_view_.Ptr(), instance.model, mat_vm);
+  ndk_helper::Mat4::Multiply(mat_projection_.Ptr(), mat_vm, mat_vp);
+  glUniformMatrix4fv(params.matrix_view_, 1, GL_FALSE, mat_vm);
+  glUniformMatrix4fv(params.matrix_projection_, 1, GL_FALSE, mat_vp);
 
   glDrawElements(GL_TRIANGLES, num_indices_, GL_UNSIGNED_SHORT,
                  BUFFER_OFFSET(0));
@@ -232,15 +659,161 @@ void BoxRenderer::RenderMultiple(const float *const mat, float width,
 // Finish multiple rendering of the cubes.
 //--------------------------------------------------------------------------------
 void BoxRenderer::EndMultipleRender() {
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  if (instanced_) {
+    RenderInstances();
+  }
+
+  // Leave the default vertex array to the UI.
+  GLStateCache *state = GLStateCache::GetInstance();
+  if (vao_) {
+    state->BindVertexArray(0);
+  } else {
+    state->BindBuffer(GL_ARRAY_BUFFER, 0);
+    state->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Draw all recorded boxes with a single instanced draw call.
+//--------------------------------------------------------------------------------
+void BoxRenderer::RenderInstances() {
+  SAMPLES_TRACE_SCOPE("BoxRenderer::RenderInstances");
+  // Flush the instances written to the ring region.
+  GLStateCache *state = GLStateCache::GetInstance();
+  state->BindBuffer(GL_COPY_WRITE_BUFFER, instance_vbo_);
+  glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+  mapped_instances_ = nullptr;
+
+  if (num_instances_ == 0) {
+    return;
+  }
+
+  size_t region_offset =
+      sizeof(BOX_INSTANCE) * instance_capacity_ * instance_ring_index_;
+  DrawInstances(instance_vbo_, region_offset, num_instances_);
+
+  // Guard the region until the GPU has consumed it, and move to the next.
+  instance_fences_[instance_ring_index_] =
+      glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  instance_ring_index_ = (instance_ring_index_ + 1) % kInstanceRingSize;
+}
+
+//--------------------------------------------------------------------------------
+// Boxes written by the GPU between BeginMultipleRender() and
+// EndMultipleRender(), e.g. by GpuPhysics.
+//--------------------------------------------------------------------------------
+void BoxRenderer::RenderInstanceBuffer(GLuint buffer, int32_t count) {
+  if (!instanced_ || count == 0) {
+    return;
+  }
+  SAMPLES_TRACE_SCOPE("BoxRenderer::RenderInstanceBuffer");
+  DrawInstances(buffer, 0, count);
+}
+
+//--------------------------------------------------------------------------------
+// One instanced draw call of `count` BOX_INSTANCE from `offset` in `buffer`.
+//--------------------------------------------------------------------------------
+void BoxRenderer::DrawInstances(GLuint buffer, size_t offset, int32_t count) {
+  GLStateCache *state = GLStateCache::GetInstance();
+  const SHADER_PARAMS &params = instanced_shader_params_[frame_tier_];
+  state->UseProgram(params.program_);
+
+  // Material and camera is shared by all the boxes.
+  glUniform3f(params.light0_, -5.f, -5.f, -5.f);
+  glUniform3f(params.material_ambient_, 0.1f, 0.1f, 0.1f);
+  glUniform4f(params.material_specular_, 0.3f, 0.3f, 0.3f, 10.f);
+  glUniformMatrix4fv(params.matrix_view_, 1, GL_FALSE, mat_view_.Ptr());
+  glUniformMatrix4fv(params.matrix_projection_, 1, GL_FALSE,
+                     mat_projection_.Ptr());
+
+  // Source the instances from `buffer`.
+  state->BindBuffer(GL_ARRAY_BUFFER, buffer);
+  int32_t stride = sizeof(BOX_INSTANCE);
+  for (auto column = 0; column < 4; ++column) {
+    GLuint location = ATTRIB_INSTANCE_MODEL + column;
+    glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride,
+                          BUFFER_OFFSET(offset + column * 4 * sizeof(GLfloat)));
+  }
+  glVertexAttribPointer(ATTRIB_INSTANCE_COLOR, 4, GL_FLOAT, GL_FALSE, stride,
+                        BUFFER_OFFSET(offset + offsetof(BOX_INSTANCE, color)));
+  if (!vao_) {
+    SetInstanceAttributesEnabled(true);
+  }
+
+  glDrawElementsInstanced(GL_TRIANGLES, num_indices_, GL_UNSIGNED_SHORT,
+                          BUFFER_OFFSET(0), count);
+
+  // Without a vertex array object, restore the per-vertex state for other
+  // users of the attributes.
+  if (!vao_) {
+    SetInstanceAttributesEnabled(false);
+  }
 }
 
 //--------------------------------------------------------------------------------
-// Helper to load a shader.
+// Helper to load a shader. The linked program comes from the program binary
+// cache when it has it, otherwise it is compiled and added to the cache.
 //--------------------------------------------------------------------------------
 bool BoxRenderer::LoadShaders(SHADER_PARAMS *params, const char *strVsh,
                               const char *strFsh) {
+  // The sources are read even on a cache hit: their hash keys the cache.
+  std::vector<uint8_t> vsh_source;
+  std::vector<uint8_t> fsh_source;
+  if (!ReadShaderSource(strVsh, &vsh_source) ||
+      !ReadShaderSource(strFsh, &fsh_source)) {
+    LOGI("Can not open shaders %s, %s", strVsh, strFsh);
+    return false;
+  }
+  ProgramCache *cache = ProgramCache::GetInstance();
+  uint64_t source_hash = ProgramCache::HashSources(vsh_source, fsh_source);
+
+  GLuint program = cache->LoadProgram(source_hash);
+  if (program) {
+    LOGI("Loaded cached program %d: %s, %s", program, strVsh, strFsh);
+  } else {
+    program = CompileProgram(vsh_source, fsh_source);
+    if (!program) {
+      LOGI("Failed to build program: %s, %s", strVsh, strFsh);
+      return false;
+    }
+    cache->StoreProgram(program, source_hash);
+  }
+
+  // Get uniform locations
+  params->matrix_projection_ = glGetUniformLocation(program, "uPMatrix");
+  params->matrix_view_ = glGetUniformLocation(program, "uMVMatrix");
+
+  params->light0_ = glGetUniformLocation(program, "vLight0");
+  params->material_diffuse_ = glGetUniformLocation(program, "vMaterialDiffuse");
+  params->material_ambient_ = glGetUniformLocation(program, "vMaterialAmbient");
+  params->material_specular_ =
+      glGetUniformLocation(program, "vMaterialSpecular");
+
+  params->program_ = program;
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Take a shader source from the asset loader, normally already loaded by
+// LoadShaderAssets(). Files that are not assets, e.g. overrides put in the
+// external files directory, are read by the JNIHelper.
+//--------------------------------------------------------------------------------
+bool BoxRenderer::ReadShaderSource(const char *file_name,
+                                   std::vector<uint8_t> *source) {
+  std::shared_ptr<const AssetBuffer> asset =
+      AssetLoader::GetInstance()->Load(file_name).get();
+  if (asset == nullptr) {
+    return ndk_helper::JNIHelper::GetInstance()->ReadFile(file_name, source);
+  }
+  source->assign(asset->GetData(), asset->GetData() + asset->GetSize());
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Compile and link a program from its sources. Returns 0 on failure.
+//--------------------------------------------------------------------------------
+GLuint BoxRenderer::CompileProgram(std::vector<uint8_t> &vsh_source,
+                                   std::vector<uint8_t> &fsh_source) {
   GLuint program;
   GLuint vert_shader, frag_shader;
 
@@ -250,22 +823,19 @@ bool BoxRenderer::LoadShaders(SHADER_PARAMS *params, const char *strVsh,
 
   // Create and compile vertex shader
   if (!ndk_helper::shader::CompileShader(&vert_shader, GL_VERTEX_SHADER,
-                                         strVsh)) {
+                                         vsh_source)) {
     LOGI("Failed to compile vertex shader");
     glDeleteProgram(program);
-    return false;
-  } else {
-    LOGI("SUCCESS: %s\n", strVsh);
+    return 0;
   }
 
   // Create and compile fragment shader
   if (!ndk_helper::shader::CompileShader(&frag_shader, GL_FRAGMENT_SHADER,
-                                         strFsh)) {
+                                         fsh_source)) {
     LOGI("Failed to compile fragment shader");
+    glDeleteShader(vert_shader);
     glDeleteProgram(program);
-    return false;
-  } else {
-    LOGI("SUCCESS: %s\n", strFsh);
+    return 0;
   }
 
   // Attach vertex shader to program
@@ -279,42 +849,27 @@ bool BoxRenderer::LoadShaders(SHADER_PARAMS *params, const char *strVsh,
   glBindAttribLocation(program, ATTRIB_VERTEX, "myVertex");
   glBindAttribLocation(program, ATTRIB_NORMAL, "myNormal");
   glBindAttribLocation(program, ATTRIB_UV, "myUV");
+  glBindAttribLocation(program, ATTRIB_INSTANCE_MODEL, "myInstanceModel");
+  glBindAttribLocation(program, ATTRIB_INSTANCE_COLOR, "myInstanceColor");
+
+  // Ask the driver to keep the binary for the program cache.
+  ProgramCache::GetInstance()->PrepareProgram(program);
 
   // Link program
-  if (!ndk_helper::shader::LinkProgram(program)) {
+  bool linked = ndk_helper::shader::LinkProgram(program);
+  if (!linked) {
     LOGI("Failed to link program: %d", program);
-
-    if (vert_shader) {
-      glDeleteShader(vert_shader);
-      vert_shader = 0;
-    }
-    if (frag_shader) {
-      glDeleteShader(frag_shader);
-      frag_shader = 0;
-    }
-    if (program) {
-      glDeleteProgram(program);
-    }
-
-    return false;
   }
 
-  // Get uniform locations
-  params->matrix_projection_ = glGetUniformLocation(program, "uPMatrix");
-  params->matrix_view_ = glGetUniformLocation(program, "uMVMatrix");
-
-  params->light0_ = glGetUniformLocation(program, "vLight0");
-  params->material_diffuse_ = glGetUniformLocation(program, "vMaterialDiffuse");
-  params->material_ambient_ = glGetUniformLocation(program, "vMaterialAmbient");
-  params->material_specular_ =
-      glGetUniformLocation(program, "vMaterialSpecular");
-
   // Release vertex and fragment shaders
   if (vert_shader) glDeleteShader(vert_shader);
   if (frag_shader) glDeleteShader(frag_shader);
 
-  params->program_ = program;
-  return true;
+  if (!linked) {
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
 }
 
 //--------------------------------------------------------------------------------
@@ -42,7 +42,11 @@
 
 #endif
 
+#include <atomic>
+#include <vector>
+
 #include "NDKHelper.h"
+#include "asset_loader.h"
 
 // Decls of shader parameters.
 struct BOX_VERTEX {
@@ -50,10 +54,18 @@ struct BOX_VERTEX {
   float normal[3];
 };
 
+// Per-instance data of the instanced rendering path.
+struct BOX_INSTANCE {
+  float model[16];  // model matrix with the box size applied
+  float color[4];   // diffuse color
+};
+
 enum SHADER_ATTRIBUTES {
   ATTRIB_VERTEX,
   ATTRIB_NORMAL,
   ATTRIB_UV,
+  ATTRIB_INSTANCE_MODEL,  // mat4, uses 4 consecutive locations
+  ATTRIB_INSTANCE_COLOR = ATTRIB_INSTANCE_MODEL + 4,
 };
 
 struct SHADER_PARAMS {
@@ -67,6 +79,15 @@ struct SHADER_PARAMS {
   GLuint matrix_view_;
 };
 
+// Shading cost tiers of the boxes, most expensive first. Every tier is a
+// program compiled in Init(), so switching tiers never compiles a shader.
+enum BOX_SHADING_TIER {
+  BOX_SHADING_FULL,        // per pixel lighting with specular
+  BOX_SHADING_VERTEX_LIT,  // the same lighting, evaluated per vertex
+  BOX_SHADING_FLAT,        // unlit diffuse color
+  BOX_SHADING_COUNT,
+};
+
 // Box renerer implementation.
 class BoxRenderer {
  public:
@@ -76,6 +97,10 @@ class BoxRenderer {
   // Dtor.
   virtual ~BoxRenderer();
 
+  // Start loading the shader sources on the asset loader, so that Init()
+  // does no file IO. Returns the pending loads.
+  static std::vector<AssetFuture> LoadShaderAssets();
+
   // Initialize shaders and buffers used to render the cube.
   void Init();
 
@@ -88,24 +113,123 @@ class BoxRenderer {
   // Unload shaders and buffers.
   void Unload();
 
-  // Rendering API to render multiple cubes.
+  // Returns true when boxes are drawn with a single instanced draw call
+  // (OpenGL ES 3.0). Otherwise each box is drawn separately.
+  bool IsInstanced() const { return instanced_; }
+
+  // Projection * view of the current frame, for culling.
+  ndk_helper::Mat4 GetViewProjection() const {
+    return mat_projection_ * mat_view_;
+  }
+
+  // Make sure the instance ring can hold `count` boxes per frame. Grows the
+  // ring when needed, which waits for the GPU; call it when the box count
+  // changes rather than every frame.
+  void ReserveInstances(int32_t count);
+
+  // Shrink the instance ring to what the last frame drew, on memory
+  // pressure. Waits for the GPU. Returns the # of bytes freed.
+  int64_t TrimInstanceRing();
+
+  // Rendering API to render multiple cubes. With the instanced path,
+  // RenderMultiple() only records the box, and all recorded boxes are drawn
+  // in EndMultipleRender(). The boxes are drawn with `tier`, or the current
+  // shading tier.
   void BeginMultipleRender();
+  void BeginMultipleRender(BOX_SHADING_TIER tier);
   void RenderMultiple(const float *const matrix, float width, float height,
                       float depth, const float *const color);
+  // `count` boxes made with MakeInstance(), e.g. by another thread.
+  void RenderMultiple(const BOX_INSTANCE *instances, int32_t count);
   void EndMultipleRender();
 
+  // What RenderMultiple() draws for a box. Touches no GL state, so it can
+  // run on any thread.
+  static void MakeInstance(const float *const matrix, float width,
+                           float height, float depth,
+                           const float *const color, BOX_INSTANCE *instance);
+
+  // Draw `count` BOX_INSTANCE the GPU wrote to `buffer`, with the instanced
+  // path only. Call between BeginMultipleRender() and EndMultipleRender().
+  void RenderInstanceBuffer(GLuint buffer, int32_t count);
+
+  // Select the shading tier of the next frames. A tier whose program failed
+  // to build is never selected.
+  void SetShadingTier(BOX_SHADING_TIER tier);
+  BOX_SHADING_TIER GetShadingTier() const { return shading_tier_; }
+  static const char *GetShadingTierName(BOX_SHADING_TIER tier);
+
+  // Step to the next cheaper or more expensive available tier. Return false
+  // when there is none.
+  bool DecreaseShadingTier();
+  bool IncreaseShadingTier();
+
  private:
   // Method to initialize the viewport.
   void UpdateViewport();
   // Helper to load shader.
   bool LoadShaders(SHADER_PARAMS *params, const char *strVsh,
                    const char *strFsh);
+  static bool ReadShaderSource(const char *file_name,
+                               std::vector<uint8_t> *source);
+  GLuint CompileProgram(std::vector<uint8_t> &vsh_source,
+                        std::vector<uint8_t> &fsh_source);
+  // Helpers for the instanced rendering path.
+  void InitInstancing();
+  void BindGeometry();
+  void SetInstanceAttributesEnabled(bool enabled);
+  bool MapInstanceRing();
+  void RenderInstances();
+  void DrawInstances(GLuint buffer, size_t offset, int32_t count);
+  // Helper for the per box rendering path.
+  void DrawBox(const BOX_INSTANCE &instance);
+  void WaitInstanceFence(int32_t index);
+  void ReleaseInstanceRing();
+  void ResizeInstanceRing(int32_t capacity);
+  int64_t GetInstanceRingSize() const {
+    return static_cast<int64_t>(sizeof(BOX_INSTANCE)) * instance_capacity_ *
+           kInstanceRingSize;
+  }
+  // Programs of the current rendering path, one per tier.
+  const SHADER_PARAMS *GetShaderParams() const {
+    return instanced_ ? instanced_shader_params_ : shader_params_;
+  }
+  bool IsShadingTierAvailable(int32_t tier) const {
+    return GetShaderParams()[tier].program_ != 0;
+  }
+
   int32_t num_indices_;
   int32_t num_vertices_;
   GLuint ibo_;
   GLuint vbo_;
-
-  SHADER_PARAMS shader_param_;
+  GLuint vao_;  // 0 when vertex array objects are not supported
+
+  SHADER_PARAMS shader_params_[BOX_SHADING_COUNT];
+  BOX_SHADING_TIER shading_tier_;
+  // Tier and per box program of the boxes being rendered, picked in
+  // BeginMultipleRender().
+  BOX_SHADING_TIER frame_tier_;
+  const SHADER_PARAMS *active_shader_param_;
+
+  // Instanced rendering path state. Instances are written straight into a
+  // mapped region of a ring of kInstanceRingSize regions in one buffer.
+  // Each region is guarded by a fence, so a region is only rewritten once
+  // the GPU has consumed it and mapping never implicitly syncs. Falling
+  // back to the per box path happens on the GL thread, while the boxes may
+  // be recorded on another one.
+  static constexpr int32_t kInstanceRingSize = 3;
+  std::atomic<bool> instanced_;
+  SHADER_PARAMS instanced_shader_params_[BOX_SHADING_COUNT];
+  GLuint instance_vbo_;
+  GLsync instance_fences_[kInstanceRingSize];
+  int32_t instance_ring_index_;
+  int32_t instance_capacity_;  // # of boxes per ring region
+  BOX_INSTANCE *mapped_instances_;
+  int32_t num_instances_;
+
+  // Bytes of the vertex and index buffers, accounted to MemoryTracker with
+  // the instance ring.
+  int64_t geometry_size_;
 
   ndk_helper::Mat4 mat_projection_;
   ndk_helper::Mat4 mat_view_;
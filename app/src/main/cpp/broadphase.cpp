@@ -0,0 +1,40 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "broadphase.h"
+
+namespace {
+// Handles of the 32 bit sweep and prune. The demo peaks at 12^3 boxes, the
+// default of 1.5M handles would mostly waste memory.
+const unsigned int kMaxAxisSweepHandles = 16384;
+}  // namespace
+
+const char* const kBroadphaseNames[BROADPHASE_COUNT] = {
+    "Dbvt", "AxisSweep3", "32BitAxisSweep3"};
+
+btBroadphaseInterface* CreateBroadphase(BroadphaseType type,
+                                        const btVector3& world_min,
+                                        const btVector3& world_max) {
+  switch (type) {
+    case BROADPHASE_AXIS_SWEEP:
+      return new btAxisSweep3(world_min, world_max);
+    case BROADPHASE_AXIS_SWEEP_32:
+      return new bt32BitAxisSweep3(world_min, world_max, kMaxAxisSweepHandles);
+    case BROADPHASE_DBVT:
+    default:
+      return new btDbvtBroadphase();
+  }
+}
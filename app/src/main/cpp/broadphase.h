@@ -0,0 +1,46 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BROADPHASE_H_
+#define BROADPHASE_H_
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wextra-semi"
+#include "btBulletDynamicsCommon.h"
+#pragma GCC diagnostic pop
+
+// Broadphase algorithms the physics world can be built with.
+enum BroadphaseType {
+  // Dynamic AABB trees, no bounds. Bullet's default.
+  BROADPHASE_DBVT = 0,
+  // Sweep and prune over the world bounds, 16 bit quantized coordinates.
+  BROADPHASE_AXIS_SWEEP,
+  // Same with 32 bit coordinates and more handles.
+  BROADPHASE_AXIS_SWEEP_32,
+  BROADPHASE_COUNT
+};
+
+// Create a broadphase of `type`. The sweep and prune variants cover the box
+// of `world_min` to `world_max`; objects outside of it still collide, but
+// less efficiently.
+btBroadphaseInterface* CreateBroadphase(BroadphaseType type,
+                                        const btVector3& world_min,
+                                        const btVector3& world_max);
+
+// Display names, indexed by BroadphaseType.
+extern const char* const kBroadphaseNames[BROADPHASE_COUNT];
+
+#endif  // BROADPHASE_H_
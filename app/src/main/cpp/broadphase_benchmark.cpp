@@ -0,0 +1,213 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "broadphase_benchmark.h"
+
+#include <time.h>
+
+#include <cstring>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wextra-semi"
+#include "LinearMath/btQuickprof.h"
+#pragma GCC diagnostic pop
+
+#include "common.h"
+
+namespace {
+const int32_t kNumArraySizes = BroadphaseBenchmark::kMaxArraySize -
+                               BroadphaseBenchmark::kMinArraySize + 1;
+
+// Bullet profile zones timed by the benchmark, see
+// btCollisionWorld::performDiscreteCollisionDetection().
+enum ProfileZone {
+  PROFILE_ZONE_OTHER = 0,
+  PROFILE_ZONE_BROADPHASE,
+  PROFILE_ZONE_NARROWPHASE,
+  PROFILE_ZONE_COUNT
+};
+
+// Deeper zones are still forwarded, but not timed.
+const int32_t kMaxZoneDepth = 32;
+
+struct ZoneStack {
+  int32_t depth_;
+  ProfileZone zones_[kMaxZoneDepth];
+  int64_t starts_[kMaxZoneDepth];
+};
+
+thread_local ZoneStack zone_stack;
+std::atomic<int64_t> zone_time_ns[PROFILE_ZONE_COUNT];
+btEnterProfileZoneFunc* previous_enter_zone = nullptr;
+btLeaveProfileZoneFunc* previous_leave_zone = nullptr;
+
+int64_t GetNanos() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<int64_t>(t.tv_sec) * 1000000000LL + t.tv_nsec;
+}
+
+ProfileZone GetZone(const char* name) {
+  if (!strcmp(name, "updateAabbs") ||
+      !strcmp(name, "calculateOverlappingPairs")) {
+    return PROFILE_ZONE_BROADPHASE;
+  }
+  if (!strcmp(name, "dispatchAllCollisionPairs")) {
+    return PROFILE_ZONE_NARROWPHASE;
+  }
+  return PROFILE_ZONE_OTHER;
+}
+
+void EnterZone(const char* name) {
+  previous_enter_zone(name);
+  ZoneStack& stack = zone_stack;
+  if (stack.depth_ < kMaxZoneDepth) {
+    stack.zones_[stack.depth_] = GetZone(name);
+    stack.starts_[stack.depth_] = GetNanos();
+  }
+  ++stack.depth_;
+}
+
+void LeaveZone() {
+  previous_leave_zone();
+  ZoneStack& stack = zone_stack;
+  // The hooks may be installed while a zone is open.
+  if (stack.depth_ == 0) {
+    return;
+  }
+  --stack.depth_;
+  if (stack.depth_ < kMaxZoneDepth) {
+    ProfileZone zone = stack.zones_[stack.depth_];
+    if (zone != PROFILE_ZONE_OTHER) {
+      zone_time_ns[zone].fetch_add(GetNanos() - stack.starts_[stack.depth_],
+                                   std::memory_order_relaxed);
+    }
+  }
+}
+}  // namespace
+
+BroadphaseBenchmark::BroadphaseBenchmark()
+    : running_(false),
+      run_(0),
+      run_start_(0.f),
+      measuring_(false),
+      ticks_(0),
+      step_ns_(0),
+      broadphase_ns_(0),
+      narrowphase_ns_(0) {}
+
+BroadphaseBenchmark::~BroadphaseBenchmark() { Stop(); }
+
+int32_t BroadphaseBenchmark::GetNumRuns() {
+  return BROADPHASE_COUNT * kNumArraySizes;
+}
+
+BroadphaseType BroadphaseBenchmark::GetBroadphase() const {
+  return static_cast<BroadphaseType>(run_ / kNumArraySizes);
+}
+
+int32_t BroadphaseBenchmark::GetArraySize() const {
+  return kMinArraySize + run_ % kNumArraySizes;
+}
+
+void BroadphaseBenchmark::Start(float now) {
+  if (running_) {
+    Stop();
+  }
+  InstallHooks();
+  run_ = 0;
+  run_start_ = now;
+  measuring_ = false;
+  running_ = true;
+  ALOGI("BroadphaseBenchmark: %d runs of %.1f sec", GetNumRuns(),
+        kSettleTime + kMeasureTime);
+}
+
+void BroadphaseBenchmark::Stop() {
+  if (!running_) {
+    return;
+  }
+  RemoveHooks();
+  running_ = false;
+}
+
+//--------------------------------------------------------------------------------
+// Let the boxes fall and the world settle after a rebuild before measuring,
+// so every run measures the same phase of the simulation.
+//--------------------------------------------------------------------------------
+bool BroadphaseBenchmark::Update(float now, int64_t step_ns) {
+  if (!running_) {
+    return false;
+  }
+
+  if (!measuring_) {
+    if (now - run_start_ < kSettleTime) {
+      return false;
+    }
+    measuring_ = true;
+    ticks_ = 0;
+    step_ns_ = 0;
+    for (auto& time : zone_time_ns) {
+      time = 0;
+    }
+    return false;
+  }
+
+  ++ticks_;
+  step_ns_ += step_ns;
+  if (now - run_start_ < kSettleTime + kMeasureTime) {
+    return false;
+  }
+
+  broadphase_ns_ = zone_time_ns[PROFILE_ZONE_BROADPHASE].load();
+  narrowphase_ns_ = zone_time_ns[PROFILE_ZONE_NARROWPHASE].load();
+  LogRun();
+
+  ++run_;
+  run_start_ = now;
+  measuring_ = false;
+  if (run_ >= GetNumRuns()) {
+    ALOGI("BroadphaseBenchmark: done");
+    Stop();
+  }
+  return true;
+}
+
+void BroadphaseBenchmark::LogRun() const {
+  int32_t size = GetArraySize();
+  float ticks = ticks_ > 0 ? ticks_ : 1;
+  ALOGI("BroadphaseBenchmark: %s, %d boxes, broadphase %.3f ms, "
+        "narrowphase %.3f ms, step %.3f ms per tick (%d ticks)",
+        kBroadphaseNames[GetBroadphase()], size * size * size,
+        broadphase_ns_ / 1e6f / ticks, narrowphase_ns_ / 1e6f / ticks,
+        step_ns_ / 1e6f / ticks, ticks_);
+}
+
+//--------------------------------------------------------------------------------
+// The zones still reach the previous handlers, Bullet's own profiler keeps
+// working.
+//--------------------------------------------------------------------------------
+void BroadphaseBenchmark::InstallHooks() {
+  previous_enter_zone = btGetCurrentEnterProfileZoneFunc();
+  previous_leave_zone = btGetCurrentLeaveProfileZoneFunc();
+  btSetCustomEnterProfileZoneFunc(EnterZone);
+  btSetCustomLeaveProfileZoneFunc(LeaveZone);
+}
+
+void BroadphaseBenchmark::RemoveHooks() {
+  btSetCustomEnterProfileZoneFunc(previous_enter_zone);
+  btSetCustomLeaveProfileZoneFunc(previous_leave_zone);
+}
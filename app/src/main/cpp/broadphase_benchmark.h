@@ -0,0 +1,84 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BROADPHASE_BENCHMARK_H_
+#define BROADPHASE_BENCHMARK_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "broadphase.h"
+
+/*
+ * Benchmark of the collision detection per broadphase algorithm.
+ *
+ * Runs every broadphase at every box count from kMinArraySize^3 to
+ * kMaxArraySize^3. Each run settles for kSettleTime after the world was
+ * rebuilt, then measures for kMeasureTime. The broadphase (AABB update and
+ * pair search) and the narrowphase (pair dispatch) are timed through
+ * Bullet's profile zones, hooked while the benchmark runs. Results are
+ * logged, one line per run.
+ *
+ * Driven by the simulation thread. IsRunning() can be read from any thread.
+ */
+class BroadphaseBenchmark {
+ public:
+  static constexpr int32_t kMinArraySize = 4;
+  static constexpr int32_t kMaxArraySize = 12;
+  static constexpr float kSettleTime = 1.f;
+  static constexpr float kMeasureTime = 3.f;
+
+  BroadphaseBenchmark();
+  ~BroadphaseBenchmark();
+
+  // Start over from the first run. The caller builds the world for
+  // GetBroadphase() and GetArraySize().
+  void Start(float now);
+  void Stop();
+  bool IsRunning() const { return running_; }
+
+  // Configuration of the current run.
+  BroadphaseType GetBroadphase() const;
+  int32_t GetArraySize() const;
+
+  // Current run, and the total # of runs.
+  int32_t GetRun() const { return run_; }
+  static int32_t GetNumRuns();
+
+  // Account a simulation tick whose stepSimulation() calls took `step_ns`
+  // nanoseconds. `now` is in seconds (see Clock()). Returns true when the
+  // run is over: the world must then be rebuilt for the next run, or
+  // restored when IsRunning() turned false.
+  bool Update(float now, int64_t step_ns);
+
+ private:
+  void InstallHooks();
+  void RemoveHooks();
+  void LogRun() const;
+
+  std::atomic<bool> running_;
+  std::atomic<int32_t> run_;
+  float run_start_;
+  bool measuring_;
+
+  // Accumulated while measuring the current run.
+  int32_t ticks_;
+  int64_t step_ns_;
+  int64_t broadphase_ns_;
+  int64_t narrowphase_ns_;
+};
+
+#endif  // BROADPHASE_BENCHMARK_H_
@@ -18,6 +18,7 @@
 
 #include "swappy/swappy_common.h"
 
+#include <atomic>
 #include <cstdint>
 #include <unordered_map>
 #include <mutex>
@@ -38,14 +39,25 @@
 
 namespace samples {
 
+// Even and Odd are only useful for experiments, core numbers say nothing
+// about the core types (see CpuTopology).
 enum class Affinity {
     None,
     Even,
     Odd
 };
 
+// # of cores configured on the device, whether or not they are online.
 int32_t getNumCpus();
 
+// First integer of /sys/devices/system/cpu/cpu<cpu>/<file>, or `fallback`
+// when it can't be read.
+int32_t readCpuValue(int32_t cpu, const char* file, int32_t fallback = 0);
+
+// Relative performance of `cpu`, from the scheduler's cpu_capacity or else
+// the maximum frequency of the core. 0 when neither is readable.
+int32_t getCpuCapacity(int32_t cpu);
+
 void setAffinity(int32_t cpu);
 
 void setAffinity(Affinity affinity);
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <dlfcn.h>
+#include <cstdint>
 #include <memory>
 
 #include <android/log.h>
@@ -29,17 +30,21 @@ public:
     using ATrace_beginSection_type = void (*)(const char *sectionName);
     using ATrace_endSection_type = void (*)();
     using ATrace_isEnabled_type = bool (*)();
+    using ATrace_setCounter_type = void (*)(const char *counterName,
+                                            int64_t counterValue);
 
     Trace() {
         __android_log_print(ANDROID_LOG_INFO, "Trace", "Unable to load NDK tracing APIs");
     }
 
-    Trace(ATrace_beginSection_type beginSection,
-          ATrace_endSection_type endSection,
-          ATrace_isEnabled_type isEnabled)
-        : ATrace_beginSection(beginSection),
-          ATrace_endSection(endSection),
-          ATrace_isEnabled(isEnabled) {}
+    Trace(ATrace_beginSection_type beginSectionFunc,
+          ATrace_endSection_type endSectionFunc,
+          ATrace_isEnabled_type isEnabledFunc,
+          ATrace_setCounter_type setCounterFunc)
+        : ATrace_beginSection(beginSectionFunc),
+          ATrace_endSection(endSectionFunc),
+          ATrace_isEnabled(isEnabledFunc),
+          ATrace_setCounter(setCounterFunc) {}
 
     static std::unique_ptr<Trace> create() {
         void *libandroid = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
@@ -65,7 +70,12 @@ public:
             return std::make_unique<Trace>();
         }
 
-        return std::make_unique<Trace>(beginSection, endSection, isEnabled);
+        // Counters are API 29, sections work without them.
+        auto setCounter = reinterpret_cast<ATrace_setCounter_type>(
+            dlsym(libandroid, "ATrace_setCounter"));
+
+        return std::make_unique<Trace>(beginSection, endSection, isEnabled,
+                                       setCounter);
     }
 
     bool isAvailable() const {
@@ -92,15 +102,24 @@ public:
         ATrace_endSection();
     }
 
+    void setCounter(const char *name, int64_t value) const {
+        if (!ATrace_setCounter || !isEnabled()) {
+            return;
+        }
+
+        ATrace_setCounter(name, value);
+    }
+
     static Trace *getInstance() {
         static std::unique_ptr<Trace> trace = Trace::create();
         return trace.get();
-    };
+    }
 
 private:
     const ATrace_beginSection_type ATrace_beginSection = nullptr;
     const ATrace_endSection_type ATrace_endSection = nullptr;
     const ATrace_isEnabled_type ATrace_isEnabled = nullptr;
+    const ATrace_setCounter_type ATrace_setCounter = nullptr;
 };
 
 struct ScopedTrace {
@@ -132,3 +151,13 @@ private:
 #define PASTE_HELPER_HELPER(a, b) a ## b
 #define PASTE_HELPER(a, b) PASTE_HELPER_HELPER(a, b)
 #define SAMPLES_TRACE_CALL() samples::ScopedTrace PASTE_HELPER(scopedTrace, __LINE__)(__PRETTY_FUNCTION__)
+#define SAMPLES_TRACE_SCOPE(name) samples::ScopedTrace PASTE_HELPER(scopedTrace, __LINE__)(name)
+
+// Counters are compiled out unless SAMPLES_TRACE_COUNTERS is set, see the
+// ADPF_TRACE_COUNTERS build option.
+#if SAMPLES_TRACE_COUNTERS
+#define SAMPLES_TRACE_COUNTER(name, value) \
+    samples::Trace::getInstance()->setCounter(name, static_cast<int64_t>(value))
+#else
+#define SAMPLES_TRACE_COUNTER(name, value) ((void)0)
+#endif
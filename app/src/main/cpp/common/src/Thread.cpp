@@ -17,28 +17,68 @@
 #include "Thread.h"
 
 #include <sched.h>
+#include <stdio.h>
 #include <unistd.h>
 
+#include <vector>
+
 namespace samples {
 
-int32_t getNumCpus() {
-    static int32_t sNumCpus = []() {
-        pid_t pid = gettid();
-        cpu_set_t cpuSet;
-        CPU_ZERO(&cpuSet);
-        sched_getaffinity(pid, sizeof(cpuSet), &cpuSet);
-
-        int32_t numCpus = 0;
-        while (CPU_ISSET(numCpus, &cpuSet)) {
-            ++numCpus;
+namespace {
+
+const std::vector<int32_t>& getCpuCapacities() {
+    static const std::vector<int32_t> sCapacities = []() {
+        std::vector<int32_t> capacities(getNumCpus());
+        for (int32_t cpu = 0; cpu < static_cast<int32_t>(capacities.size());
+             ++cpu) {
+            // cpu_capacity is what the scheduler itself uses, but it is not
+            // exposed on every kernel.
+            int32_t capacity = readCpuValue(cpu, "cpu_capacity");
+            if (capacity <= 0) {
+                capacity = readCpuValue(cpu, "cpufreq/cpuinfo_max_freq");
+            }
+            capacities[cpu] = capacity;
         }
+        return capacities;
+    }();
+    return sCapacities;
+}
+
+}  // namespace
 
-        return numCpus;
+int32_t getNumCpus() {
+    // The affinity mask of the calling thread may be restricted or have holes
+    // (offline or reserved cores), count the cores the kernel knows of.
+    static int32_t sNumCpus = []() {
+        const long numCpus = sysconf(_SC_NPROCESSORS_CONF);
+        return numCpus > 0 ? static_cast<int32_t>(numCpus) : 1;
     }();
 
     return sNumCpus;
 }
 
+int32_t readCpuValue(int32_t cpu, const char* file, int32_t fallback) {
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/%s", cpu, file);
+    FILE* fp = fopen(path, "r");
+    if (fp == nullptr) {
+        return fallback;
+    }
+    int32_t value = fallback;
+    if (fscanf(fp, "%d", &value) != 1) {
+        value = fallback;
+    }
+    fclose(fp);
+    return value;
+}
+
+int32_t getCpuCapacity(int32_t cpu) {
+    if (cpu < 0 || cpu >= getNumCpus()) {
+        return 0;
+    }
+    return getCpuCapacities()[cpu];
+}
+
 void setAffinity(int32_t cpu) {
     cpu_set_t cpuSet;
     CPU_ZERO(&cpuSet);
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cpu_topology.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "Thread.h"
+#include "common.h"
+
+const CpuClusterType CpuTopology::kDefaultPlacement[THREAD_ROLE_COUNT] = {
+    CPU_CLUSTER_BIG,     // THREAD_ROLE_RENDER
+    CPU_CLUSTER_MID,     // THREAD_ROLE_PHYSICS
+    CPU_CLUSTER_LITTLE,  // THREAD_ROLE_TELEMETRY
+};
+
+CpuTopology* CpuTopology::GetInstance() {
+  static CpuTopology instance;
+  return &instance;
+}
+
+//--------------------------------------------------------------------------------
+// Group the cores by cpufreq policy, then sort and merge the groups by
+// capacity.
+//--------------------------------------------------------------------------------
+CpuTopology::CpuTopology() {
+  struct Core {
+    int32_t cpu_;
+    int32_t policy_;
+    int32_t capacity_;
+  };
+  std::vector<Core> cores;
+  const int32_t num_cpus = samples::getNumCpus();
+  for (auto cpu = 0; cpu < num_cpus; ++cpu) {
+    Core core;
+    core.cpu_ = cpu;
+    core.capacity_ = samples::getCpuCapacity(cpu);
+    // The first core of the policy identifies it. Without cpufreq, the cores
+    // of the same capacity are taken as one cluster.
+    core.policy_ = samples::readCpuValue(cpu, "cpufreq/related_cpus", -1);
+    if (core.policy_ < 0) {
+      core.policy_ = -1 - core.capacity_;
+    }
+    cores.push_back(core);
+  }
+  std::stable_sort(cores.begin(), cores.end(),
+                   [](const Core& a, const Core& b) {
+                     return a.capacity_ < b.capacity_;
+                   });
+
+  // Sorting by capacity keeps the cores of a policy together, unless the
+  // policy mixes core types, which the kernel doesn't do.
+  int32_t last_policy = 0;
+  for (auto i = 0; i < static_cast<int32_t>(cores.size()); ++i) {
+    const Core& core = cores[i];
+    const bool same_type =
+        !clusters_.empty() && (core.policy_ == last_policy ||
+                               core.capacity_ == clusters_.back().capacity_);
+    if (!same_type) {
+      clusters_.emplace_back();
+      clusters_.back().capacity_ = 0;
+      clusters_.back().max_freq_khz_ = 0;
+    }
+    Cluster& cluster = clusters_.back();
+    cluster.cpus_.push_back(core.cpu_);
+    cluster.capacity_ = std::max(cluster.capacity_, core.capacity_);
+    cluster.max_freq_khz_ =
+        std::max(cluster.max_freq_khz_,
+                 samples::readCpuValue(core.cpu_, "cpufreq/cpuinfo_max_freq"));
+    last_policy = core.policy_;
+  }
+  if (clusters_.empty()) {
+    clusters_.emplace_back();
+    clusters_.back().cpus_.push_back(0);
+    clusters_.back().capacity_ = 0;
+    clusters_.back().max_freq_khz_ = 0;
+  }
+  for (auto& cluster : clusters_) {
+    std::sort(cluster.cpus_.begin(), cluster.cpus_.end());
+  }
+
+  const int32_t last = GetNumClusters() - 1;
+  cluster_indices_[CPU_CLUSTER_LITTLE] = 0;
+  cluster_indices_[CPU_CLUSTER_MID] = last >= 2 ? last - 1 : last;
+  cluster_indices_[CPU_CLUSTER_BIG] = last;
+
+  for (auto role = 0; role < THREAD_ROLE_COUNT; ++role) {
+    role_cpus_[role] =
+        clusters_[GetClusterIndex(kDefaultPlacement[role])].cpus_;
+  }
+  // With a single prime core, the game and the render threads would only
+  // take turns on it.
+  const int32_t big = GetClusterIndex(CPU_CLUSTER_BIG);
+  const int32_t mid = GetClusterIndex(CPU_CLUSTER_MID);
+  std::vector<int32_t>& render_cpus = role_cpus_[THREAD_ROLE_RENDER];
+  if (static_cast<int32_t>(render_cpus.size()) < kMinRenderCpus &&
+      mid != big) {
+    render_cpus.insert(render_cpus.end(), clusters_[mid].cpus_.begin(),
+                       clusters_[mid].cpus_.end());
+    std::sort(render_cpus.begin(), render_cpus.end());
+    ALOGI("CpuTopology: render on the big and mid cores");
+  }
+
+  for (auto i = 0; i < GetNumClusters(); ++i) {
+    ALOGI("CpuTopology: %s cluster of %zu core(s) from cpu%d, capacity %d, "
+          "%d kHz",
+          GetClusterTypeName(GetClusterType(i)), clusters_[i].cpus_.size(),
+          clusters_[i].cpus_.front(), clusters_[i].capacity_,
+          clusters_[i].max_freq_khz_);
+  }
+}
+
+CpuClusterType CpuTopology::GetClusterType(int32_t index) const {
+  if (index == GetNumClusters() - 1) {
+    return CPU_CLUSTER_BIG;
+  }
+  return index == 0 ? CPU_CLUSTER_LITTLE : CPU_CLUSTER_MID;
+}
+
+bool CpuTopology::PinCurrentThread(ThreadRole role) const {
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (auto cpu : GetCpus(role)) {
+    CPU_SET(cpu, &cpu_set);
+  }
+  if (sched_setaffinity(gettid(), sizeof(cpu_set), &cpu_set) != 0) {
+    ALOGW("CpuTopology: can't pin thread %d to the %s cores", gettid(),
+          GetClusterTypeName(GetPlacement(role)));
+    return false;
+  }
+  return true;
+}
+
+const char* CpuTopology::GetClusterTypeName(CpuClusterType type) {
+  switch (type) {
+    case CPU_CLUSTER_LITTLE:
+      return "little";
+    case CPU_CLUSTER_MID:
+      return "mid";
+    case CPU_CLUSTER_BIG:
+      return "big";
+    default:
+      return "unknown";
+  }
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPU_TOPOLOGY_H_
+#define CPU_TOPOLOGY_H_
+
+#include <cstdint>
+#include <vector>
+
+// Core types, by increasing capacity. A device with fewer than three clusters
+// maps the missing types to the nearest cluster above them (see
+// CpuTopology::GetClusterIndex()).
+enum CpuClusterType {
+  CPU_CLUSTER_LITTLE,
+  CPU_CLUSTER_MID,
+  CPU_CLUSTER_BIG,
+  CPU_CLUSTER_COUNT
+};
+
+// What a thread does, which decides the cores it runs on.
+enum ThreadRole {
+  THREAD_ROLE_RENDER,     // the game and render threads: input, UI and GL
+  THREAD_ROLE_PHYSICS,    // the simulation thread and the JobSystem workers
+  THREAD_ROLE_TELEMETRY,  // background polling, e.g. the thermal headroom
+  THREAD_ROLE_COUNT
+};
+
+/*
+ * The clusters of cores of the device, read once from sysfs.
+ *
+ * Cores sharing a cpufreq policy (cpuN/cpufreq/related_cpus) form a cluster,
+ * or cores of the same capacity when cpufreq is not readable. The capacity of
+ * a core is the scheduler's cpu_capacity, or else its maximum frequency.
+ * Clusters of the same capacity are merged, as they are the same core type.
+ *
+ * Each ThreadRole is placed on one cluster type (kDefaultPlacement): render on
+ * the big cores, physics on the mid cores, telemetry on the little ones.
+ * Render also gets the mid cores when there are fewer than kMinRenderCpus
+ * big ones, so the game and the render threads each have a core.
+ * PinCurrentThread() restricts the calling thread to the cores of its role.
+ */
+class CpuTopology {
+ public:
+  struct Cluster {
+    std::vector<int32_t> cpus_;
+    // The largest capacity and maximum frequency of its cores.
+    int32_t capacity_;
+    int32_t max_freq_khz_;
+  };
+
+  static CpuTopology* GetInstance();
+
+  // Clusters by increasing capacity. There is at least one.
+  int32_t GetNumClusters() const {
+    return static_cast<int32_t>(clusters_.size());
+  }
+  const Cluster& GetCluster(int32_t index) const { return clusters_[index]; }
+
+  // Index of the cluster a core type runs on.
+  int32_t GetClusterIndex(CpuClusterType type) const {
+    return cluster_indices_[type];
+  }
+
+  // The type a cluster stands for, when several types share it: the last
+  // cluster is big, the first one little, the others mid.
+  CpuClusterType GetClusterType(int32_t index) const;
+
+  // Cluster type of the cores a role runs on, after the missing types were
+  // mapped. Roles with the same type share their cores.
+  CpuClusterType GetPlacement(ThreadRole role) const {
+    return GetClusterType(GetClusterIndex(kDefaultPlacement[role]));
+  }
+
+  // Cores of a role: those of its placement, and for render those of the
+  // mid cluster too when the big one is too small.
+  const std::vector<int32_t>& GetCpus(ThreadRole role) const {
+    return role_cpus_[role];
+  }
+
+  // Restrict the calling thread to the cores of `role`. Returns false when
+  // the kernel refused.
+  bool PinCurrentThread(ThreadRole role) const;
+
+  static const char* GetClusterTypeName(CpuClusterType type);
+
+ private:
+  static const CpuClusterType kDefaultPlacement[THREAD_ROLE_COUNT];
+  // The game and the render threads.
+  static constexpr int32_t kMinRenderCpus = 2;
+
+  CpuTopology();
+  CpuTopology(const CpuTopology&) = delete;
+  void operator=(const CpuTopology&) = delete;
+
+  std::vector<Cluster> clusters_;
+  int32_t cluster_indices_[CPU_CLUSTER_COUNT];
+  std::vector<int32_t> role_cpus_[THREAD_ROLE_COUNT];
+};
+
+#endif  // CPU_TOPOLOGY_H_
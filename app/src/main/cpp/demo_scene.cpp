@@ -17,14 +17,39 @@
 #include "demo_scene.h"
 
 #include <time.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cfloat>
+#include <cmath>
 #include <functional>
+#include <string>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wextra-semi"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#pragma GCC diagnostic pop
 
 #include "Log.h"
+#include "Thread.h"
+#include "Trace.h"
+#include "adpf_manager.h"
+#include "cpu_topology.h"
+#include "frame_telemetry.h"
+#include "game_mode_manager.h"
+#include "gl_state_cache.h"
 #include "imgui.h"
 #include "imgui_manager.h"
+#include "input_util.h"
+#include "job_system.h"
 #include "native_engine.h"
+#include "physics_thread.h"
+#include "power_monitor.h"
+#include "render_thread.h"
+#include "soak_test.h"
+#include "swappy_stats_collector.h"
 
 extern "C" {
 #include <GLES2/gl2.h>
@@ -39,17 +64,56 @@ const char* thermal_state_label[] = {
 
 const int32_t kPhysicsResetTime = 10000;  // 10 sec
 
+// Half size of the world bounds of the sweep and prune broadphases. Holds the
+// ground and the spawn grid.
+const float kWorldExtent = 128.f;
+
+// Half size of the ground cube, and the height of its center.
+const btScalar kGroundHalfSize = 50.f;
+const float kGroundCenterHeight = -56.f;
+
+// Boxes below the bottom of the ground fell off it and are not drawn.
+const float kCullFloorHeight = kGroundCenterHeight - kGroundHalfSize;
+
+// Frame deltas above this are clamped (e.g. after a pause), in seconds.
+const float kMaxFrameDelta = 1.0f;
+
+// Time Swappy and the display get to settle on a new frame rate before the
+// frame times are trusted again, in seconds.
+const float kFrameRateTransitionTime = 1.0f;
+
+// The thermal model is saved this often, in seconds, and when the scene goes.
+const float kThermalModelSaveInterval = 60.0f;
+
+// Boxes per side removed on memory pressure.
+const int32_t kMemoryPressureBoxStep = 2;
+
+// Seed of the spawn rotations of the boxes, Bullet and GpuPhysics ones.
+const uint32_t kRandomSeed = 2463534242u;
+
+// Ticks of steps GpuPhysics may catch up with after a long frame.
+const int32_t kGpuPhysicsMaxTicks = 2;
+
 DemoScene* DemoScene::instance_ = NULL;
 
 //--------------------------------------------------------------------------------
 // Ctor
 //--------------------------------------------------------------------------------
-DemoScene::DemoScene() {
+DemoScene::DemoScene()
+    : gpu_physics_clock_(kPhysicsMaxDelta),
+      profile_store_(
+          ndk_helper::JNIHelper::GetInstance()->GetExternalFilesDir() +
+          "/device_profile.bin"),
+      frame_clock_(kMaxFrameDelta) {
   simulated_click_state_ = SIMULATED_CLICK_NONE;
+  replaying_ = false;
+  random_seed_ = kRandomSeed;
   pointer_down_ = false;
   point_x_ = 0.0f;
   pointer_y_ = 0.0f;
   transition_start_ = 0.0f;
+  current_thermal_index_ = 0;
+  thermal_headroom_ = 0.0f;
   target_frame_period_ = SWAPPY_SWAP_60FPS;
   current_frame_period_ = SWAPPY_SWAP_60FPS;
 
@@ -57,11 +121,117 @@ DemoScene::DemoScene() {
 
   // Physics Dynamic adjustments
   current_physics_step_ = kPhysicsStep;
+  solver_tier_ = SOLVER_TIER_HIGH;
+  applied_solver_tier_ = -1;
+  solver_settings_ = GetSolverSettings(SOLVER_TIER_HIGH);
+  best_surface_format_ = kDefaultSurfaceFormat;
   array_size_ = kArraySize;
   box_size_ = kBoxSize;
+  game_mode_ = GAME_MODE_UNSUPPORTED;
+  max_physics_step_ = kPhysicsStepMax;
+  max_array_size_ = kBoxSizeMax;
+
+  // Only worth it when there are cores to spread the islands on.
+  multithreaded_physics_ = samples::getNumCpus() > 1;
+  broadphase_type_ = kDefaultBroadphase;
+
+  // Warm start from the last sustainable configuration, or the recorded
+  // one. The game mode caps still apply on top of it.
+  has_start_profile_ = profile_store_.Load(&start_profile_);
+  StartReplayLog();
+  if (has_start_profile_) {
+    current_physics_step_ =
+        Clamp(start_profile_.physics_step_, kPhysicsStep, kPhysicsStepMax);
+    array_size_ = Clamp(start_profile_.array_size_, kBoxSizeMin, kBoxSizeMax);
+    solver_tier_ = Clamp(start_profile_.solver_tier_,
+                         static_cast<int32_t>(SOLVER_TIER_HIGH),
+                         SOLVER_TIER_COUNT - 1);
+  }
 
-  box_.Init();
-  InitializePhysics();
+  recreate_physics_world_ = false;
+  culling_enabled_ = true;
+  num_visible_boxes_ = 0;
+  gpu_timer_read_backs_ = 0;
+  broadphase_benchmark_requested_ = false;
+  benchmark_saved_broadphase_ = kDefaultBroadphase;
+  physics_backend_ = PHYSICS_BACKEND_BULLET;
+  active_physics_backend_ = PHYSICS_BACKEND_BULLET;
+  gpu_physics_available_ = false;
+  gpu_physics_array_size_ = -1;
+  gpu_physics_reset_time_ = 0.f;
+  gpu_physics_accumulator_ = 0.f;
+  benchmark_saved_array_size_ = kArraySize;
+  recreate_physics_obj_ = false;
+  solver_pool_ = nullptr;
+  ground_body_ = nullptr;
+  box_pool_ = nullptr;
+  physics_running_ = false;
+  physics_paused_ = false;
+  physics_tick_time_ = 0.f;
+  fixed_timestep_ = true;
+  physics_tick_interval_ = kPhysicsTickInterval;
+  physics_accumulator_ = 0.f;
+  physics_restarted_ = true;
+  sleeping_enabled_ = false;
+  reset_cursor_ = -1;
+  respawned_begin_ = respawned_end_ = 0;
+  physics_stats_start_ = 0.f;
+  physics_stats_total_ = 0.f;
+  physics_stats_ticks_ = 0;
+
+  // Register the knobs the governor can move, cheapest to change first.
+  // Shading goes first, so the GPU load is cut before the simulation. Solver
+  // iterations save more CPU than sub-steps, and show less.
+  governor_.AddKnob({"Shading", [this]() { return box_.DecreaseShadingTier(); },
+                     [this]() { return box_.IncreaseShadingTier(); },
+                     GOVERNOR_BOTTLENECK_GPU});
+  governor_.AddKnob({"Solver", [this]() { return ControlSolverTier(false); },
+                     [this]() { return ControlSolverTier(true); },
+                     GOVERNOR_BOTTLENECK_CPU});
+  governor_.AddKnob({"Physics Steps", [this]() { return ControlStep(false); },
+                     [this]() { return ControlStep(true); },
+                     GOVERNOR_BOTTLENECK_CPU});
+  // Moving the simulation rebuilds the world, and only goes off the
+  // resource that throttles: these never move back on headroom alone.
+  governor_.AddKnob(
+      {"Physics on GPU",
+       [this]() { return ControlPhysicsBackend(PHYSICS_BACKEND_GPU); },
+       nullptr, GOVERNOR_BOTTLENECK_CPU});
+  governor_.AddKnob({"Resolution",
+                     [this]() { return dynamic_resolution_.DecreaseScale(); },
+                     [this]() { return dynamic_resolution_.IncreaseScale(); },
+                     GOVERNOR_BOTTLENECK_GPU});
+  governor_.AddKnob({"Surface Format",
+                     [this]() { return ControlSurfaceFormat(false); },
+                     [this]() { return ControlSurfaceFormat(true); },
+                     GOVERNOR_BOTTLENECK_GPU});
+  governor_.AddKnob(
+      {"Physics on CPU",
+       [this]() { return ControlPhysicsBackend(PHYSICS_BACKEND_BULLET); },
+       nullptr, GOVERNOR_BOTTLENECK_GPU});
+  governor_.AddKnob({"Box Count", [this]() { return ControlBoxCount(false); },
+                     [this]() { return ControlBoxCount(true); }});
+
+  // Start from what the previous runs on this device learned.
+  if (thermal_model_.Load(GetThermalModelPath())) {
+    ALOGI("DemoScene: thermal model loaded, %d samples",
+          thermal_model_.GetSampleCount());
+  }
+  thermal_model_save_time_ = 0.0f;
+  PredictivePolicy* policy = new PredictivePolicy(
+      "Predictive", PredictivePolicy::DefaultParams(), &thermal_model_);
+  predictive_policy_ = policy;
+  governor_.SetPolicy(std::unique_ptr<GovernorPolicy>(policy));
+
+  // The scene is installed once the shaders are read, the GL objects are
+  // created in OnStartGraphics().
+  for (const auto& asset : BoxRenderer::LoadShaderAssets()) {
+    AddPendingAsset(asset);
+  }
+  for (const auto& asset : GpuPhysics::LoadShaderAssets()) {
+    AddPendingAsset(asset);
+  }
+  InitializePhysics(array_size_);
 
   instance_ = this;
 }
@@ -70,6 +240,11 @@ DemoScene::DemoScene() {
 // Dtor
 //--------------------------------------------------------------------------------
 DemoScene::~DemoScene() {
+  StopPhysicsThread();
+  thermal_model_.Save(GetThermalModelPath());
+  dynamic_resolution_.Unload();
+  gpu_timer_.Unload();
+  gpu_physics_.Unload();
   box_.Unload();
   CleanupPhysics();
 
@@ -81,9 +256,54 @@ DemoScene::~DemoScene() {
 //--------------------------------------------------------------------------------
 void DemoScene::OnStartGraphics() {
   transition_start_ = Clock();
+  frame_clock_.Reset();
+  governor_.Reset(transition_start_);
+  box_.Init();
+  dynamic_resolution_.Init();
+  dynamic_resolution_.SetEnabled(true);
+  gpu_timer_.Init();
+  // The SSBO it writes is drawn as instance attributes.
+  if (box_.IsInstanced()) {
+    gpu_physics_.Init();
+  }
+  gpu_physics_.SetGround(kGroundCenterHeight + kGroundHalfSize,
+                         kGroundHalfSize);
+  gpu_physics_available_ = gpu_physics_.IsSupported();
+  gpu_physics_array_size_ = -1;
+
+  // After a context loss, keep what the governor picked since.
+  int64_t preferred_period = 0;
+  if (has_start_profile_) {
+    has_start_profile_ = false;
+    box_.SetShadingTier(
+        static_cast<BOX_SHADING_TIER>(start_profile_.shading_tier_));
+    dynamic_resolution_.SetScale(start_profile_.resolution_scale_);
+    preferred_period = start_profile_.frame_period_ns_;
+    const int32_t surface_format = Clamp(
+        start_profile_.surface_format_,
+        static_cast<int32_t>(SURFACE_FORMAT_RGBA8_D24_MSAA),
+        SURFACE_FORMAT_COUNT - 1);
+    best_surface_format_ = Min(best_surface_format_, surface_format);
+    NativeEngine::GetInstance()->RequestSurfaceFormat(
+        static_cast<SurfaceFormat>(surface_format));
+  }
+
+  // The window is set on Swappy by now, so the refresh rates are known.
+  swap_interval_.Initialize(preferred_period);
+  target_frame_period_ = current_frame_period_ =
+      static_cast<int32_t>(swap_interval_.GetFramePeriod());
+  SceneManager::GetInstance()->SetPreferredSwapInterval(target_frame_period_);
+  StartPhysicsThread();
 }
 
 void DemoScene::OnKillGraphics() {
+  // No need to simulate what nobody sees.
+  PausePhysicsThread();
+  thermal_model_.Save(GetThermalModelPath());
+  dynamic_resolution_.Unload();
+  gpu_timer_.Unload();
+  gpu_physics_.Unload();
+  box_.Unload();
 }
 
 void DemoScene::OnInstall() {
@@ -94,26 +314,52 @@ void DemoScene::OnUninstall() {
 
 void DemoScene::OnScreenResized(int width, int height) {}
 
+//--------------------------------------------------------------------------------
+// The context outlives the window, so the simulation is also parked while
+// the app is in the background, not only without graphics.
+//--------------------------------------------------------------------------------
+void DemoScene::OnPause() { PausePhysicsThread(); }
+
+void DemoScene::OnResume() { StartPhysicsThread(); }
+
+//--------------------------------------------------------------------------------
+// Removed boxes are only parked by the pool, and the arena gives its memory
+// back all at once: lowering the box count frees memory once the world is
+// rebuilt with the new count, on the next tick.
+//--------------------------------------------------------------------------------
+void DemoScene::OnTrimMemory(MemoryPressureLevel level) {
+  box_.TrimInstanceRing();
+  if (level >= MEMORY_PRESSURE_REDUCE_CONTENT) {
+    array_size_ = std::max(kBoxSizeMin, array_size_ - kMemoryPressureBoxStep);
+    recreate_physics_world_ = true;
+  }
+}
+
 //--------------------------------------------------------------------------------
 // Control the simulation parameters
 //--------------------------------------------------------------------------------
-void DemoScene::ControlStep(bool step_up) {
+bool DemoScene::ControlStep(bool step_up) {
+  // The simulation thread reads the value, so only store the final one.
+  int32_t previous_step = current_physics_step_;
+  int32_t step = previous_step;
   if (step_up) {
-    current_physics_step_ += kPhysicsStep;
-    if (current_physics_step_ >= kPhysicsStepMax) {
-      current_physics_step_ = kPhysicsStepMax;
+    step += kPhysicsStep;
+    if (step >= max_physics_step_) {
+      step = max_physics_step_;
     }
   } else {
-    current_physics_step_ -= kPhysicsStep;
-    if (current_physics_step_ < kPhysicsStep) {
-      current_physics_step_ = kPhysicsStep;
+    step -= kPhysicsStep;
+    if (step < kPhysicsStep) {
+      step = kPhysicsStep;
     }
   }
+  current_physics_step_ = step;
+  return step != previous_step;
 }
 
-void DemoScene::ControlBoxCount(bool count_up) {
+bool DemoScene::ControlBoxCount(bool count_up) {
   int32_t min_count = kBoxSizeMin;
-  int32_t max_count = kBoxSizeMax;
+  int32_t max_count = max_array_size_;
   bool changed = false;
 
   if (count_up) {
@@ -130,13 +376,102 @@ void DemoScene::ControlBoxCount(bool count_up) {
     }
   }
 
-  if (changed) {
-    recreate_physics_obj_ = true;
+  // The simulation thread grows or shrinks the box pool over the next ticks.
+  return changed;
+}
+
+bool DemoScene::ControlSolverTier(bool tier_up) {
+  // GpuPhysics has no solver to tune.
+  if (active_physics_backend_ == PHYSICS_BACKEND_GPU) {
+    return false;
+  }
+  int32_t tier = solver_tier_;
+  if (tier_up && tier > SOLVER_TIER_HIGH) {
+    solver_tier_ = tier - 1;
+    return true;
+  }
+  if (!tier_up && tier < SOLVER_TIER_COUNT - 1) {
+    solver_tier_ = tier + 1;
+    return true;
+  }
+  return false;
+}
+
+bool DemoScene::ControlSurfaceFormat(bool format_up) {
+  NativeEngine* native_engine = NativeEngine::GetInstance();
+  if (!native_engine->CanChangeSurfaceFormat()) {
+    return false;
+  }
+  int32_t format = native_engine->GetRequestedSurfaceFormat();
+  if (format_up && format > best_surface_format_) {
+    --format;
+  } else if (!format_up && format < SURFACE_FORMAT_COUNT - 1) {
+    ++format;
+  } else {
+    return false;
+  }
+  native_engine->RequestSurfaceFormat(static_cast<SurfaceFormat>(format));
+  return true;
+}
+
+void DemoScene::SetMultithreadedPhysics(bool enabled) {
+  // The multithreaded world isn't reproducible, and the replay sets the
+  // recorded one itself.
+  if (replaying_ || ReplayLog::GetInstance()->IsRecording()) {
+    ALOGW("DemoScene: no multithreaded physics switch while recording or "
+          "replaying");
+    return;
+  }
+  if (enabled != multithreaded_physics_) {
+    multithreaded_physics_ = enabled;
+    recreate_physics_world_ = true;
+  }
+}
+
+void DemoScene::SetBroadphase(BroadphaseType type) {
+  if (type != broadphase_type_) {
+    broadphase_type_ = type;
+    recreate_physics_world_ = true;
+  }
+}
+
+void DemoScene::SetPhysicsBackend(PhysicsBackend backend) {
+  if (backend != physics_backend_) {
+    physics_backend_ = backend;
+    recreate_physics_world_ = true;
+  }
+}
+
+bool DemoScene::ControlPhysicsBackend(PhysicsBackend backend) {
+  const GovernorBottleneck relieved = backend == PHYSICS_BACKEND_GPU
+                                          ? GOVERNOR_BOTTLENECK_CPU
+                                          : GOVERNOR_BOTTLENECK_GPU;
+  if (!gpu_physics_available_ || physics_backend_ == backend ||
+      governor_.GetBottleneck() != relieved) {
+    return false;
+  }
+  SetPhysicsBackend(backend);
+  return true;
+}
+
+int32_t DemoScene::GetBulletBoxCount(int32_t array_size) const {
+  if (active_physics_backend_ == PHYSICS_BACKEND_GPU) {
+    return 0;
+  }
+  return array_size * array_size * array_size;
+}
+
+void DemoScene::StartBroadphaseBenchmark() {
+  if (replaying_ || ReplayLog::GetInstance()->IsRecording()) {
+    ALOGW("DemoScene: no broadphase benchmark while recording or replaying");
+    return;
   }
+  broadphase_benchmark_requested_ = true;
 }
 
 void DemoScene::ControlResetToDefaultSettings() {
   current_physics_step_ = kPhysicsStep;
+  solver_tier_ = SOLVER_TIER_HIGH;
   array_size_ = kArraySize;
 
   recreate_physics_obj_ = true;
@@ -146,27 +481,383 @@ void DemoScene::ControlResetToDefaultSettings() {
 // Process each frame's status updates.
 // - Initiate the OpenGL rendering.
 // - Monitor the device's thermal staus using ADPF API.
-// - Update physics using BulletPhysics.
-// - Render cubes.
+// - Render cubes from the latest BulletPhysics snapshot. The simulation itself
+//   runs on its own thread.
 // - Render UI using ImGUI (Show device's thermal status).
 // - Tell the system of the samples workload using ADPF API.
 //--------------------------------------------------------------------------------
 void DemoScene::DoFrame() {
-  // clear screen
-  glClearColor(0.0f, 0.0f, 0.25f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glDisable(GL_DEPTH_TEST);
+  SAMPLES_TRACE_SCOPE("DemoScene::DoFrame");
+  ReplayFrame frame;
+  ReadFrameInput(&frame);
+  // Results from a few frames ago, the queries don't stall the pipeline.
+  const int32_t gpu_read_backs = gpu_timer_.GetReadBackCount();
+  if (gpu_read_backs != gpu_timer_read_backs_) {
+    gpu_timer_read_backs_ = gpu_read_backs;
+    auto nanos = [](float seconds) {
+      return static_cast<int64_t>(seconds * 1e9f);
+    };
+    FrameTelemetry::GetInstance()->SetGpuQueryTimes(
+        nanos(gpu_timer_.GetFrameTime()),
+        nanos(gpu_timer_.GetSectionTime(GPU_SECTION_BOXES)),
+        nanos(gpu_timer_.GetSectionTime(GPU_SECTION_UI)));
+  }
+  RenderFrame* render_frame = RenderThread::GetInstance()->GetFrame();
+  render_frame->BeginGpuFrame(&gpu_timer_);
 
-  UpdatePhysics();
+  // clear screen
+  render_frame->Clear(0.0f, 0.0f, 0.25f, 1.0f);
+
+  // Pick up the thermal status cached by ADPFManager. This never blocks.
+  ADPFManager* adpf_manager = ADPFManager::GetInstance();
+  int32_t thermal_index = adpf_manager->GetThermalStatus();
+  if (thermal_index != current_thermal_index_) {
+    // Show a thermal status change right away, even on a throttled UI.
+    NativeEngine::GetInstance()->GetImGuiManager()->RequestUpdate();
+  }
+  current_thermal_index_ = thermal_index;
+  thermal_headroom_ = adpf_manager->GetThermalHeadroom();
+  // Counters take integers: fractions are traced in thousandths.
+  SAMPLES_TRACE_COUNTER("ThermalHeadroom(x1000)", thermal_headroom_ * 1000.f);
+  SAMPLES_TRACE_COUNTER("ThermalStatus", current_thermal_index_);
+  UpdateGameMode();
+  UpdateFrameRate();
+  // The benchmark sets the box count itself.
+  if (!broadphase_benchmark_.IsRunning()) {
+    UpdateGovernor(&frame);
+  }
+  UpdateSoakTest();
+  SAMPLES_TRACE_COUNTER("PhysicsSteps", current_physics_step_.load());
+  SAMPLES_TRACE_COUNTER("SolverTier", solver_tier_.load());
+  SAMPLES_TRACE_COUNTER("SurfaceFormat",
+                        NativeEngine::GetInstance()->GetSurfaceFormat());
+  SAMPLES_TRACE_COUNTER("ArraySize", array_size_.load());
+  SAMPLES_TRACE_COUNTER("Power(mW)",
+                        PowerMonitor::GetInstance()->GetPower() * 1000.f);
+
+  {
+    SAMPLES_TRACE_SCOPE("DemoScene::BoxSubmit");
+    TelemetryScope scope(TELEMETRY_PHASE_BOX_SUBMIT);
+    render_frame->BeginGpuSection(&gpu_timer_, GPU_SECTION_BOXES);
+    NativeEngine* native_engine = NativeEngine::GetInstance();
+    const SurfaceFormat surface_format = native_engine->GetSurfaceFormat();
+    const int32_t surface_width = native_engine->GetSurfaceWidth();
+    const int32_t surface_height = native_engine->GetSurfaceHeight();
+    dynamic_resolution_.SetSurfaceFormat(surface_format);
+    UpdateGpuPhysics(&frame);
+    const float scale =
+        dynamic_resolution_.UpdateFrameScale(surface_width, surface_height);
+    const bool scaled = scale < DynamicResolution::kMaxScale;
+    SAMPLES_TRACE_COUNTER("ResolutionScale(x1000)", scale * 1000.f);
+    if (scaled) {
+      render_frame->BeginScaled(&dynamic_resolution_, surface_width,
+                                surface_height, surface_format, scale);
+    }
+    RenderBoxes();
+    if (scaled) {
+      render_frame->EndScaled(&dynamic_resolution_);
+    }
+    render_frame->EndGpuSection(&gpu_timer_);
+  }
 
   // Update UI inputs to ImGui before beginning a new frame
-  UpdateUIInput();
-  ImGuiManager* imguiManager = NativeEngine::GetInstance()->GetImGuiManager();
-  imguiManager->BeginImGuiFrame();
-  RenderUI();
-  imguiManager->EndImGuiFrame();
+  {
+    SAMPLES_TRACE_SCOPE("DemoScene::UI");
+    TelemetryScope scope(TELEMETRY_PHASE_UI);
+    render_frame->BeginGpuSection(&gpu_timer_, GPU_SECTION_UI);
+    UpdateUIInput();
+    ImGuiManager* imguiManager =
+        NativeEngine::GetInstance()->GetImGuiManager();
+    if (imguiManager->BeginImGuiFrame()) {
+      RenderUI();
+    }
+    imguiManager->EndImGuiFrame();
+    render_frame->EndGpuSection(&gpu_timer_);
+  }
+
+  render_frame->EndGpuFrame(&gpu_timer_);
+  // Log what the frame was fed, now that the governor and GpuPhysics ran.
+  ReplayLog::GetInstance()->RecordFrame(frame, Clock());
+}
+
+//--------------------------------------------------------------------------------
+// Let the governor adjust the load based on thermal headroom and frame time.
+//--------------------------------------------------------------------------------
+void DemoScene::UpdateGovernor(ReplayFrame* frame) {
+  const float now = Clock();
+  const ThermalLoad load = GetThermalLoad();
+  thermal_model_.Observe(load, thermal_headroom_, now);
+  if (now - thermal_model_save_time_ >= kThermalModelSaveInterval) {
+    thermal_model_save_time_ = now;
+    if (thermal_model_.IsTrained()) {
+      thermal_model_.Save(GetThermalModelPath());
+    }
+  }
+
+  GovernorInput input;
+  input.thermal_headroom_ = thermal_headroom_;
+  input.thermal_status_ = current_thermal_index_;
+  input.frame_time_ = frame_clock_.ReadDelta();
+  input.target_frame_time_ =
+      SceneManager::GetInstance()->GetPreferredSwapInterval() / 1e9f;
+  input.missed_frame_ratio_ =
+      SwappyStatsCollector::GetInstance()->GetMissedFrameRatio();
+  input.cpu_time_ = GetCpuFrameTime();
+  input.gpu_time_ = gpu_timer_.GetFrameTime();
+  input.load_ = load;
+  const char* action = governor_.Update(input, now);
+  // The governor is disabled during a replay.
+  if (replaying_) {
+    if (frame->knob_ >= 0) {
+      governor_.MoveKnob(frame->knob_,
+                         (frame->flags_ & REPLAY_FRAME_DECREASE) != 0);
+    }
+  } else if (action != nullptr) {
+    frame->knob_ = static_cast<int8_t>(governor_.GetLastKnob());
+    if (governor_.GetPendingRequest() == GOVERNOR_REQUEST_DECREASE) {
+      frame->flags_ |= REPLAY_FRAME_DECREASE;
+    }
+  }
+  UpdateProfile(now);
+}
 
-  glEnable(GL_DEPTH_TEST);
+//--------------------------------------------------------------------------------
+// Record the configuration once it held without thermal pressure. Changes
+// made by hand count too, as long as the device keeps up with them.
+//--------------------------------------------------------------------------------
+void DemoScene::UpdateProfile(float now) {
+  DeviceProfile current;
+  current.physics_step_ = current_physics_step_;
+  current.solver_tier_ = solver_tier_;
+  current.array_size_ = array_size_;
+  current.frame_period_ns_ = current_frame_period_;
+  current.resolution_scale_ =
+      dynamic_resolution_.IsEnabled() ? dynamic_resolution_.GetScale() : 1.f;
+  current.shading_tier_ = box_.GetShadingTier();
+  current.surface_format_ =
+      NativeEngine::GetInstance()->GetRequestedSurfaceFormat();
+  const bool sustainable =
+      governor_.IsEnabled() &&
+      governor_.GetPendingRequest() != GOVERNOR_REQUEST_DECREASE &&
+      current_thermal_index_ < ATHERMAL_STATUS_MODERATE &&
+      current_frame_period_ == target_frame_period_;
+  profile_store_.Update(current, sustainable, now);
+}
+
+//--------------------------------------------------------------------------------
+// The load of the scene, each knob as a fraction of its maximum.
+//--------------------------------------------------------------------------------
+ThermalLoad DemoScene::GetThermalLoad() const {
+  const float scale =
+      dynamic_resolution_.IsEnabled() ? dynamic_resolution_.GetScale() : 1.f;
+  const float boxes = static_cast<float>(array_size_.load()) / kBoxSizeMax;
+  // The solver time grows with the iterations, the rest of the step doesn't
+  // depend on them: a rough fit, the model learns the weight.
+  const SolverSettings solver =
+      GetSolverSettings(static_cast<SolverTier>(solver_tier_.load()));
+  const SolverSettings max_solver = GetSolverSettings(SOLVER_TIER_HIGH);
+  ThermalLoad load;
+  load.physics_ =
+      static_cast<float>(current_physics_step_.load()) / kPhysicsStepMax *
+      solver.num_iterations_ / max_solver.num_iterations_;
+  load.boxes_ = boxes * boxes * boxes;
+  load.pixels_ = scale * scale;
+  return load;
+}
+
+std::string DemoScene::GetThermalModelPath() const {
+  return ndk_helper::JNIHelper::GetInstance()->GetExternalFilesDir() +
+         "/thermal_model.bin";
+}
+
+//--------------------------------------------------------------------------------
+// A scripted soak test overrides the governor for the whole run. The app
+// closes itself when the run is over.
+//--------------------------------------------------------------------------------
+void DemoScene::UpdateSoakTest() {
+  SoakTest* soak_test = SoakTest::GetInstance();
+  if (!soak_test->IsRequested() || soak_test->IsFinished()) {
+    return;
+  }
+  float now = Clock();
+  if (!soak_test->IsRunning()) {
+    std::string directory =
+        ndk_helper::JNIHelper::GetInstance()->GetExternalFilesDir();
+    if (!soak_test->Start(directory, now)) {
+      return;
+    }
+    if (soak_test->IsScripted()) {
+      governor_.SetEnabled(false);
+    }
+  }
+
+  if (soak_test->IsScripted()) {
+    const SoakSegment& segment = soak_test->GetSegment(now);
+    array_size_ = Clamp(segment.array_size_, kBoxSizeMin, kBoxSizeMax);
+    current_physics_step_ = Clamp(segment.physics_step_, 1, kPhysicsStepMax);
+  }
+
+  SoakSample sample;
+  sample.thermal_status_ = current_thermal_index_;
+  sample.thermal_headroom_ = thermal_headroom_;
+  sample.physics_step_ = current_physics_step_;
+  sample.array_size_ = array_size_;
+  sample.frame_period_ns_ = current_frame_period_;
+  sample.resolution_scale_ =
+      dynamic_resolution_.IsEnabled() ? dynamic_resolution_.GetScale() : 1.f;
+  if (!soak_test->Update(sample, now)) {
+    governor_.SetEnabled(true);
+    GameActivity_finish(NativeEngine::GetInstance()->GetAndroidApp()->activity);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// A recording runs the single threaded world, the only one a replay
+// reproduces bit for bit, and SetMultithreadedPhysics() keeps it until the
+// recording is over; the other settings picked in the UI still apply. It
+// starts from the saved profile or the defaults, and records which.
+//--------------------------------------------------------------------------------
+void DemoScene::StartReplayLog() {
+  ReplayLog* replay_log = ReplayLog::GetInstance();
+  if (!replay_log->IsRequested()) {
+    return;
+  }
+  const std::string directory =
+      ndk_helper::JNIHelper::GetInstance()->GetExternalFilesDir();
+  SceneManager* scene_manager = SceneManager::GetInstance();
+  ReplayStart start;
+  if (replay_log->StartReplay(directory, &start, Clock())) {
+    replaying_ = true;
+    random_seed_ = start.random_seed_;
+    broadphase_type_ = start.broadphase_;
+    multithreaded_physics_ = start.multithreaded_ != 0;
+    has_start_profile_ = true;
+    start_profile_ = start.profile_;
+    // The recorded decisions replace the governor's.
+    governor_.SetEnabled(false);
+    if (start.screen_width_ != scene_manager->GetScreenWidth() ||
+        start.screen_height_ != scene_manager->GetScreenHeight()) {
+      ALOGW("DemoScene: replaying a %dx%d run on %dx%d, the touches may "
+            "miss the UI",
+            start.screen_width_, start.screen_height_,
+            scene_manager->GetScreenWidth(), scene_manager->GetScreenHeight());
+    }
+    return;
+  }
+
+  if (!has_start_profile_) {
+    has_start_profile_ = true;
+    start_profile_.physics_step_ = current_physics_step_;
+    start_profile_.solver_tier_ = solver_tier_;
+    start_profile_.array_size_ = array_size_;
+    start_profile_.frame_period_ns_ = 0;
+    start_profile_.resolution_scale_ = dynamic_resolution_.GetScale();
+    start_profile_.shading_tier_ = box_.GetShadingTier();
+    start_profile_.surface_format_ = kDefaultSurfaceFormat;
+  }
+  multithreaded_physics_ = false;
+  start.random_seed_ = random_seed_;
+  start.screen_width_ = scene_manager->GetScreenWidth();
+  start.screen_height_ = scene_manager->GetScreenHeight();
+  start.broadphase_ = broadphase_type_;
+  start.multithreaded_ = 0;
+  start.profile_ = start_profile_;
+  replay_log->StartRecording(directory, start, Clock());
+}
+
+void DemoScene::ReadFrameInput(ReplayFrame* frame) {
+  memset(frame, 0, sizeof(*frame));
+  frame->delta_ = gpu_physics_clock_.ReadDelta();
+  frame->knob_ = -1;
+  frame->array_size_ = static_cast<int8_t>(array_size_.load());
+  frame->physics_step_ = static_cast<int8_t>(current_physics_step_.load());
+  if (!replaying_) {
+    return;
+  }
+
+  ReplayLog* replay_log = ReplayLog::GetInstance();
+  const ReplayEvent* events = nullptr;
+  if (replay_log->NextFrame(frame, &events)) {
+    for (auto i = 0; i < frame->num_events_; ++i) {
+      HandlePointerEvent(events[i]);
+    }
+  } else if (!replay_log->IsFinished()) {
+    // The run is over: report and close, like a soak test.
+    replay_log->Finish(Clock());
+    GameActivity_finish(NativeEngine::GetInstance()->GetAndroidApp()->activity);
+  }
+}
+
+float DemoScene::GetCpuFrameTime() const {
+  float work_time = ADPFManager::GetInstance()->GetLastWorkDuration() / 1e9f;
+  return std::max(work_time, physics_tick_time_.load());
+}
+
+//--------------------------------------------------------------------------------
+// The game mode bounds what the governor and the frame rate controller can
+// pick. Settings above the new caps are lowered right away.
+//--------------------------------------------------------------------------------
+void DemoScene::UpdateGameMode() {
+  int32_t game_mode = GameModeManager::GetInstance()->GetGameMode();
+  if (game_mode == game_mode_) {
+    return;
+  }
+  game_mode_ = game_mode;
+
+  GameModeBudget budget = GameModeManager::GetBudget(game_mode);
+  max_physics_step_ = Clamp(budget.max_physics_step_, kPhysicsStep,
+                            kPhysicsStepMax);
+  max_array_size_ = Clamp(budget.max_array_size_, kBoxSizeMin, kBoxSizeMax);
+  if (current_physics_step_ > max_physics_step_) {
+    current_physics_step_ = max_physics_step_;
+  }
+  if (array_size_ > max_array_size_) {
+    array_size_ = max_array_size_;
+  }
+  swap_interval_.SetFrameRateRange(0, budget.max_frame_rate_);
+  dynamic_resolution_.SetMaxScale(budget.max_resolution_scale_);
+  ALOGI("DemoScene: %s mode, steps <= %d, boxes <= %d, <= %d Hz, scale <= %.2f",
+        GameModeManager::GetGameModeName(game_mode), max_physics_step_,
+        max_array_size_, budget.max_frame_rate_,
+        budget.max_resolution_scale_);
+}
+
+//--------------------------------------------------------------------------------
+// Frame rate changes come first: they save more power than reducing content.
+// While a transition settles, neither loop acts on the stale frame times.
+//--------------------------------------------------------------------------------
+void DemoScene::UpdateFrameRate() {
+  const float now = Clock();
+  if (current_frame_period_ != target_frame_period_) {
+    if (now - transition_start_ < kFrameRateTransitionTime) {
+      return;
+    }
+    current_frame_period_ = target_frame_period_;
+    governor_.Reset(now);
+  }
+
+  GovernorInput input;
+  input.thermal_headroom_ = thermal_headroom_;
+  input.thermal_status_ = current_thermal_index_;
+  // The CPU work of the frame, not the vsync locked frame interval.
+  input.frame_time_ =
+      ADPFManager::GetInstance()->GetLastWorkDuration() / 1e9f;
+  input.target_frame_time_ = current_frame_period_ / 1e9f;
+  input.missed_frame_ratio_ =
+      SwappyStatsCollector::GetInstance()->GetMissedFrameRatio();
+  input.cpu_time_ = GetCpuFrameTime();
+  input.gpu_time_ = gpu_timer_.GetFrameTime();
+  input.load_ = GetThermalLoad();
+
+  int64_t period = swap_interval_.Update(input, now);
+  if (period == 0) {
+    return;
+  }
+  target_frame_period_ = static_cast<int32_t>(period);
+  transition_start_ = now;
+  // Don't publish snapshots faster than they are displayed.
+  physics_tick_interval_ = target_frame_period_ / 1e9f;
+  SceneManager::GetInstance()->SetPreferredSwapInterval(target_frame_period_);
 }
 
 //--------------------------------------------------------------------------------
@@ -181,6 +872,49 @@ void DemoScene::RenderBackground() {
 //--------------------------------------------------------------------------------
 void DemoScene::OnPointerDown(int pointerId,
                               const struct PointerCoords* coords) {
+  OnPointerEvent(COOKED_EVENT_TYPE_POINTER_DOWN, pointerId, coords);
+}
+
+void DemoScene::OnPointerMove(int pointerId,
+                              const struct PointerCoords* coords) {
+  OnPointerEvent(COOKED_EVENT_TYPE_POINTER_MOVE, pointerId, coords);
+}
+
+void DemoScene::OnPointerUp(int pointerId, const struct PointerCoords* coords) {
+  OnPointerEvent(COOKED_EVENT_TYPE_POINTER_UP, pointerId, coords);
+}
+
+void DemoScene::OnPointerEvent(int32_t type, int pointer_id,
+                               const struct PointerCoords* coords) {
+  if (replaying_) {
+    return;
+  }
+  ReplayEvent event;
+  memset(&event, 0, sizeof(event));
+  event.type_ = type;
+  event.pointer_id_ = pointer_id;
+  event.coords_ = *coords;
+  ReplayLog::GetInstance()->RecordEvent(event);
+  HandlePointerEvent(event);
+}
+
+void DemoScene::HandlePointerEvent(const ReplayEvent& event) {
+  switch (event.type_) {
+    case COOKED_EVENT_TYPE_POINTER_DOWN:
+      PointerDown(&event.coords_);
+      break;
+    case COOKED_EVENT_TYPE_POINTER_MOVE:
+      PointerMove(&event.coords_);
+      break;
+    case COOKED_EVENT_TYPE_POINTER_UP:
+      PointerUp(&event.coords_);
+      break;
+    default:
+      break;
+  }
+}
+
+void DemoScene::PointerDown(const struct PointerCoords* coords) {
   // If this event was generated by something that's not associated to the
   // screen, (like a trackpad), ignore it, because our UI is not driven that
   // way.
@@ -211,7 +945,7 @@ void DemoScene::OnPointerDown(int pointerId,
   } else {
     // middle, control recreate/respawn
     if ( upper_touch ) {
-      ResetPhysics(); // respawn boxes
+      recreate_physics_obj_ = true; // respawn boxes
     } else {
       ControlResetToDefaultSettings();
     }
@@ -219,15 +953,14 @@ void DemoScene::OnPointerDown(int pointerId,
   **/
 }
 
-void DemoScene::OnPointerMove(int pointerId,
-                              const struct PointerCoords* coords) {
+void DemoScene::PointerMove(const struct PointerCoords* coords) {
   if (coords->is_screen_ && pointer_down_) {
     point_x_ = coords->x_;
     pointer_y_ = coords->y_;
   }
 }
 
-void DemoScene::OnPointerUp(int pointerId, const struct PointerCoords* coords) {
+void DemoScene::PointerUp(const struct PointerCoords* coords) {
   if (coords->is_screen_) {
     point_x_ = coords->x_;
     pointer_y_ = coords->y_;
@@ -292,16 +1025,248 @@ void DemoScene::RenderPanel() {
   // In this sample, no dynamic performance adjustment based on Thermal State
   // To see dynamic performance adjustment based on Thermal State see the ADPF
   // Sample
-  ImGui::Text("Physics Steps:%d", current_physics_step_);
-  ImGui::Text("Array Size: %d", array_size_);
+  if (current_thermal_index_ >= 0 &&
+      current_thermal_index_ <
+          static_cast<int32_t>(sizeof(thermal_state_label) /
+                               sizeof(thermal_state_label[0]))) {
+    ImGui::Text("Thermal Status: %s",
+                thermal_state_label[current_thermal_index_]);
+  } else {
+    ImGui::Text("Thermal Status: THERMAL_STATUS_ERROR");
+  }
+  ImGui::Text("Thermal Headroom (%ds): %.3f",
+              ADPFManager::kThermalHeadroomForecastSeconds, thermal_headroom_);
+  // Energy of the whole device, per frame drawn and per physics step.
+  PowerMonitor* power_monitor = PowerMonitor::GetInstance();
+  if (power_monitor->IsAvailable()) {
+    const float energy_per_frame = power_monitor->GetEnergyPerFrame();
+    ImGui::Text("Power: %.2f W, %.1f frames/J", power_monitor->GetPower(),
+                energy_per_frame > 0.f ? 1.f / energy_per_frame : 0.f);
+    ImGui::Text("Energy: %.1f mJ/frame, %.2f mJ/step",
+                energy_per_frame * 1000.f,
+                power_monitor->GetEnergyPerPhysicsStep() * 1000.f);
+  } else {
+    ImGui::Text("Power: %s", power_monitor->GetStatusText());
+  }
+  ImGui::Text("Physics Steps:%d", current_physics_step_.load());
+  ImGui::Text("Solver: %s, %d iterations",
+              kSolverTierNames[solver_tier_.load()],
+              GetSolverSettings(static_cast<SolverTier>(solver_tier_.load()))
+                  .num_iterations_);
+  ImGui::Text("Array Size: %d", array_size_.load());
+  ImGui::Text("Physics Tick: %.2f ms", physics_tick_time_.load() * 1000.f);
+
+  ImGui::Checkbox("Frustum Culling", &culling_enabled_);
+  ImGui::SameLine();
+  ImGui::Text("(%d boxes drawn)", num_visible_boxes_);
+
+  const char* shading_names[BOX_SHADING_COUNT];
+  for (auto tier = 0; tier < BOX_SHADING_COUNT; ++tier) {
+    shading_names[tier] =
+        BoxRenderer::GetShadingTierName(static_cast<BOX_SHADING_TIER>(tier));
+  }
+  int32_t shading = box_.GetShadingTier();
+  if (ImGui::Combo("Shading", &shading, shading_names, BOX_SHADING_COUNT)) {
+    box_.SetShadingTier(static_cast<BOX_SHADING_TIER>(shading));
+  }
+
+  bool fixed_timestep = fixed_timestep_;
+  if (ImGui::Checkbox("Fixed Timestep", &fixed_timestep)) {
+    fixed_timestep_ = fixed_timestep;
+  }
+
+  int32_t solver_tier = solver_tier_;
+  if (ImGui::Combo("Solver", &solver_tier, kSolverTierNames,
+                   SOLVER_TIER_COUNT)) {
+    solver_tier_ = solver_tier;
+  }
+
+  if (gpu_physics_available_) {
+    int32_t backend = physics_backend_;
+    if (ImGui::Combo("Physics", &backend, kPhysicsBackendNames,
+                     PHYSICS_BACKEND_COUNT)) {
+      SetPhysicsBackend(static_cast<PhysicsBackend>(backend));
+    }
+  } else {
+    ImGui::Text("Physics: %s (GPU needs OpenGL ES 3.1)",
+                kPhysicsBackendNames[PHYSICS_BACKEND_BULLET]);
+  }
+
+  int32_t broadphase = broadphase_type_;
+  if (ImGui::Combo("Broadphase", &broadphase, kBroadphaseNames,
+                   BROADPHASE_COUNT)) {
+    SetBroadphase(static_cast<BroadphaseType>(broadphase));
+  }
+  if (broadphase_benchmark_.IsRunning()) {
+    ImGui::Text("Broadphase benchmark: run %d of %d",
+                broadphase_benchmark_.GetRun() + 1,
+                BroadphaseBenchmark::GetNumRuns());
+  } else if (ImGui::Button("Benchmark Broadphases")) {
+    StartBroadphaseBenchmark();
+  }
+
+  bool sleeping = sleeping_enabled_;
+  if (ImGui::Checkbox("Allow Sleeping", &sleeping)) {
+    sleeping_enabled_ = sleeping;
+  }
+
+  bool multithreaded = multithreaded_physics_;
+  if (ImGui::Checkbox("Multithreaded Physics", &multithreaded)) {
+    SetMultithreadedPhysics(multithreaded);
+  }
+  if (multithreaded_physics_ && PhysicsTaskScheduler::IsInstalled()) {
+    ImGui::SameLine();
+    ImGui::Text("(%d threads)",
+                PhysicsTaskScheduler::GetInstance()->GetParallelism());
+  }
+
+  ImGuiManager* imgui_manager = NativeEngine::GetInstance()->GetImGuiManager();
+  bool throttled = imgui_manager->IsThrottled();
+  if (ImGui::Checkbox("Throttle UI Updates", &throttled)) {
+    imgui_manager->SetThrottled(throttled);
+  }
+  ImGui::SameLine();
+  ImGui::Text("(%.0f%% of frames)", imgui_manager->GetRebuildRatio() * 100.f);
+
+  ImGui::Text("Frame Rate: %d Hz%s, CPU %.2f ms",
+              swap_interval_.GetFrameRate(),
+              current_frame_period_ != target_frame_period_ ? " (switching)"
+                                                            : "",
+              swap_interval_.GetSmoothedFrameTime() * 1000.f);
+
+  // Show what the governor is doing.
+  const GovernorPolicy* policy = governor_.GetPolicy();
+  const char* last_action = governor_.GetLastAction();
+  ImGui::Text("Governor: %s, frame %.2f ms, last change: %s",
+              policy ? policy->GetName() : "None",
+              governor_.GetSmoothedFrameTime() * 1000.f,
+              last_action ? last_action : "-");
+  if (thermal_model_.IsTrained()) {
+    ImGui::Text("Thermal model: %d samples, error %.4f/s, predicted %.3f",
+                thermal_model_.GetSampleCount(), thermal_model_.GetError(),
+                predictive_policy_->GetPredictedHeadroom());
+  } else {
+    ImGui::Text("Thermal model: learning (%d/%d samples)",
+                thermal_model_.GetSampleCount(), ThermalModel::kMinSamples);
+  }
+
+  bool dynamic_resolution = dynamic_resolution_.IsEnabled();
+  if (dynamic_resolution_.IsSupported() &&
+      ImGui::Checkbox("Dynamic Resolution", &dynamic_resolution)) {
+    dynamic_resolution_.SetEnabled(dynamic_resolution);
+    if (!dynamic_resolution) {
+      dynamic_resolution_.SetScale(DynamicResolution::kMaxScale);
+    }
+  }
+  ImGui::Text("Render size: %d x %d (%.0f%%)",
+              dynamic_resolution_.GetRenderWidth(),
+              dynamic_resolution_.GetRenderHeight(),
+              dynamic_resolution_.GetScale() * 100.f);
+  if (native_engine->CanChangeSurfaceFormat()) {
+    int32_t surface_format = native_engine->GetRequestedSurfaceFormat();
+    if (ImGui::Combo("Surface", &surface_format, kSurfaceFormatNames,
+                     SURFACE_FORMAT_COUNT)) {
+      best_surface_format_ = surface_format;
+      native_engine->RequestSurfaceFormat(
+          static_cast<SurfaceFormat>(surface_format));
+    }
+  }
+  ImGui::Text("Surface format: %s, presentation time %s",
+              kSurfaceFormatNames[native_engine->GetSurfaceFormat()],
+              native_engine->HasPresentationTime() ? "on" : "off");
+  ImGui::Text("Redundant GL state calls skipped: %lld",
+              static_cast<long long>(
+                  GLStateCache::GetInstance()->GetSkippedCount()));
+
+  RenderTelemetry();
 
   // Show the stat changes according to selected Game Mode
+  ImGui::Text("Game Mode: %s", GameModeManager::GetGameModeName(game_mode_));
   ImGui::Text("Surface size: %d x %d", native_engine->GetSurfaceWidth(),
               native_engine->GetSurfaceHeight());
   ImGui::Text("Preferred size: %d x %d", scene_manager->GetPreferredWidth(),
               scene_manager->GetPreferredHeight());
 }
 
+//--------------------------------------------------------------------------------
+// Frame telemetry overlay. The dump goes to the app's internal storage:
+// adb shell run-as <package> cat files/frame_telemetry.csv
+//--------------------------------------------------------------------------------
+void DemoScene::RenderTelemetry() {
+  FrameTelemetry* telemetry = FrameTelemetry::GetInstance();
+  FrameStats stats;
+  telemetry->GetStats(&stats);
+
+  ImGui::Text("Frame ms P50 %.2f P90 %.2f P99 %.2f max %.2f",
+              stats.frame_time_p50_, stats.frame_time_p90_,
+              stats.frame_time_p99_, stats.frame_time_max_);
+  ImGui::Text("Jank: %d of %d (total %lld)", stats.jank_frames_,
+              stats.num_frames_,
+              static_cast<long long>(stats.total_jank_frames_));
+  ImGui::Text("CPU ms physics %.2f ui %.2f boxes %.2f swap %.2f, GPU %.2f",
+              stats.phase_time_average_[TELEMETRY_PHASE_PHYSICS],
+              stats.phase_time_average_[TELEMETRY_PHASE_UI],
+              stats.phase_time_average_[TELEMETRY_PHASE_BOX_SUBMIT],
+              stats.phase_time_average_[TELEMETRY_PHASE_SWAP],
+              stats.gpu_time_average_);
+  if (gpu_timer_.IsSupported()) {
+    const char* bottleneck = "unknown";
+    if (governor_.GetBottleneck() == GOVERNOR_BOTTLENECK_CPU) {
+      bottleneck = "CPU";
+    } else if (governor_.GetBottleneck() == GOVERNOR_BOTTLENECK_GPU) {
+      bottleneck = "GPU";
+    }
+    ImGui::Text("GPU queries ms frame %.2f boxes %.2f ui %.2f, %s bound",
+                stats.gpu_query_time_average_, stats.gpu_boxes_time_average_,
+                stats.gpu_ui_time_average_, bottleneck);
+  }
+  ImGui::Text("Active bodies: %.0f", stats.active_bodies_average_);
+
+  MemoryTracker* memory = MemoryTracker::GetInstance();
+  ImGui::Text("Memory KB: GL buffers %lld, targets %lld, physics %lld, "
+              "fonts %lld",
+              static_cast<long long>(
+                  memory->GetSize(MEMORY_CATEGORY_GL_BUFFERS) / 1024),
+              static_cast<long long>(
+                  memory->GetSize(MEMORY_CATEGORY_GL_RENDERBUFFERS) / 1024),
+              static_cast<long long>(
+                  memory->GetSize(MEMORY_CATEGORY_PHYSICS_ARENA) / 1024),
+              static_cast<long long>(
+                  memory->GetSize(MEMORY_CATEGORY_FONT_ATLAS) / 1024));
+  if (memory->GetLastResponse() != MEMORY_PRESSURE_NONE) {
+    ImGui::Text("Last memory trim: %s, freed %lld KB",
+                MemoryTracker::GetPressureLevelName(memory->GetLastResponse()),
+                static_cast<long long>(memory->GetLastFreedSize() / 1024));
+  }
+
+  // Swappy's presentation histograms over the last second.
+  SwappyStatsCollector* collector = SwappyStatsCollector::GetInstance();
+  if (collector->HasStats()) {
+    const SwappyIntervalStats& swappy = collector->GetStats();
+    ImGui::Text("Swappy: %llu frames, missed %.1f%%, latency %.2f periods",
+                static_cast<unsigned long long>(swappy.total_frames_),
+                swappy.missed_frame_ratio_ * 100.f, swappy.average_latency_);
+    const ImVec2 plot_size(0.f, 40.f);
+    ImGui::PlotHistogram("Idle", swappy.idle_frames_, MAX_FRAME_BUCKETS, 0,
+                         nullptr, 0.f, FLT_MAX, plot_size);
+    ImGui::PlotHistogram("Late", swappy.late_frames_, MAX_FRAME_BUCKETS, 0,
+                         nullptr, 0.f, FLT_MAX, plot_size);
+    ImGui::PlotHistogram("Offset", swappy.offset_from_previous_frame_,
+                         MAX_FRAME_BUCKETS, 0, nullptr, 0.f, FLT_MAX,
+                         plot_size);
+    ImGui::PlotHistogram("Latency", swappy.latency_frames_, MAX_FRAME_BUCKETS,
+                         0, nullptr, 0.f, FLT_MAX, plot_size);
+  }
+
+  if (ImGui::Button("Dump Telemetry")) {
+    android_app* app = NativeEngine::GetInstance()->GetAndroidApp();
+    std::string path = app->activity->internalDataPath;
+    path += "/frame_telemetry.csv";
+    telemetry->DumpToFile(path.c_str());
+    telemetry->LogSummary();
+  }
+}
+
 void DemoScene::OnButtonClicked(int buttonId) {
   // base classes override this to react to button clicks
 }
@@ -309,35 +1274,99 @@ void DemoScene::OnButtonClicked(int buttonId) {
 //--------------------------------------------------------------------------------
 // Initialize BulletPhysics engine.
 //--------------------------------------------------------------------------------
-void DemoScene::InitializePhysics() {
+void DemoScene::InitializePhysics(int32_t array_size) {
   // Initialize physics world.
   collision_configuration_ = new btDefaultCollisionConfiguration();
-  dispatcher_ = new btCollisionDispatcher(collision_configuration_);
-  overlapping_pair_cache_ = new btDbvtBroadphase();
-  solver_ = new btSequentialImpulseConstraintSolver;
-  dynamics_world_ = new btDiscreteDynamicsWorld(
-      dispatcher_, overlapping_pair_cache_, solver_, collision_configuration_);
+  BroadphaseType broadphase =
+      static_cast<BroadphaseType>(broadphase_type_.load());
+  overlapping_pair_cache_ =
+      CreateBroadphase(broadphase, btVector3(-kWorldExtent, -kWorldExtent,
+                                             -kWorldExtent),
+                       btVector3(kWorldExtent, kWorldExtent, kWorldExtent));
+
+  // Let the hint session account for the job system workers too, they run
+  // the physics loops, the pose extraction and the culling.
+  for (auto tid : JobSystem::GetInstance()->GetWorkerThreadIds()) {
+    ADPFManager::GetInstance()->AddThreadIdToHintSession(tid,
+                                                         THREAD_ROLE_PHYSICS);
+  }
+
+  // The game thread installed the scheduler, the Mt classes need it, and a
+  // stepping thread whose index fits their per-thread data.
+  if (multithreaded_physics_ && !PhysicsTaskScheduler::IsInstalled()) {
+    ALOGW("DemoScene: no task scheduler, building a single threaded world");
+    multithreaded_physics_ = false;
+  }
+  const int32_t thread_index =
+      PhysicsThread::GetInstance()->GetBulletThreadIndex();
+  if (multithreaded_physics_ &&
+      (thread_index < 0 ||
+       thread_index >= PhysicsTaskScheduler::GetInstance()->getNumThreads())) {
+    ALOGW("DemoScene: physics thread index %d out of range, building a "
+          "single threaded world",
+          thread_index);
+    multithreaded_physics_ = false;
+  }
+  if (multithreaded_physics_) {
+    int32_t num_threads =
+        kPhysicsThreadCount > 0 ? kPhysicsThreadCount
+                                : JobSystem::GetInstance()->GetNumThreads();
+    PhysicsTaskScheduler* scheduler = PhysicsTaskScheduler::GetInstance();
+    scheduler->setNumThreads(num_threads);
+
+    dispatcher_ = new btCollisionDispatcherMt(collision_configuration_);
+    // A solver per thread that can solve an island at the same time.
+    solver_pool_ = new btConstraintSolverPoolMt(scheduler->getNumThreads());
+    solver_ = new btSequentialImpulseConstraintSolver;
+    dynamics_world_ = new btDiscreteDynamicsWorldMt(
+        dispatcher_, overlapping_pair_cache_, solver_pool_, solver_,
+        collision_configuration_);
+  } else {
+    dispatcher_ = new btCollisionDispatcher(collision_configuration_);
+    solver_ = new btSequentialImpulseConstraintSolver;
+    dynamics_world_ = new btDiscreteDynamicsWorld(
+        dispatcher_, overlapping_pair_cache_, solver_,
+        collision_configuration_);
+  }
   dynamics_world_->setGravity(btVector3(0, -10, 0));
+  // Only moving bodies need their AABB updated on each step. Teleported
+  // bodies are updated by whoever moves them.
+  dynamics_world_->setForceUpdateAllAabbs(false);
+  applied_solver_tier_ = -1;
+  UpdateSolverSettings(solver_tier_);
+  // The first build runs before the graphics exist, so it always uses
+  // Bullet.
+  active_physics_backend_ = physics_backend_ == PHYSICS_BACKEND_GPU &&
+                                    gpu_physics_available_
+                                ? PHYSICS_BACKEND_GPU
+                                : PHYSICS_BACKEND_BULLET;
+  ALOGI("DemoScene: %s physics world, %s broadphase, boxes on %s",
+        multithreaded_physics_ ? "multithreaded" : "single threaded",
+        kBroadphaseNames[broadphase],
+        kPhysicsBackendNames[active_physics_backend_]);
 
   /// create a few basic rigid bodies
-  CreateRigidBodies();
+  CreateRigidBodies(array_size);
 }
 
 //--------------------------------------------------------------------------------
 // Create some RigidBodies (Ground and Boxes)
 //--------------------------------------------------------------------------------
-void DemoScene::CreateRigidBodies() {
+void DemoScene::CreateRigidBodies(int32_t array_size) {
+  // Let the system boost us while the world is built.
+  GameModeManager* game_mode_manager = GameModeManager::GetInstance();
+  game_mode_manager->SetGameState(true);
+
   /// Create Ground
   // the ground is a cube of side 100 at position y = -56.
   // the sphere will hit it at y = -6, with center at -5
-  btCollisionShape* ground_shape =
-      new btBoxShape(btVector3(btScalar(50.), btScalar(50.), btScalar(50.)));
-
-  collision_shapes_.push_back(ground_shape);
+  ShapeCache* shape_cache = ShapeCache::GetInstance();
+  btCollisionShape* ground_shape = shape_cache->GetBox(
+      btVector3(kGroundHalfSize, kGroundHalfSize, kGroundHalfSize));
 
   btTransform groundTransform;
   groundTransform.setIdentity();
-  groundTransform.setOrigin(btVector3(0, -56, 0));
+  groundTransform.setOrigin(btVector3(0, kGroundCenterHeight, 0));
 
   btScalar mass(0.);
   btVector3 local_inertia(0, 0, 0);
@@ -352,56 +1381,31 @@ void DemoScene::CreateRigidBodies() {
 
   // add the body to the dynamics world
   dynamics_world_->addRigidBody(body);
-
-  // create a dynamic rigidbody
-  box_collision_shape_ =
-      new btBoxShape(btVector3(box_size_, box_size_, box_size_));
-  collision_shapes_.push_back(box_collision_shape_);
-
-  /// Create Dynamic Objects
-  int32_t array_size_x = array_size_;
-  int32_t array_size_y = array_size_;
-  int32_t array_size_z = array_size_;
-  for (auto k = 0; k < array_size_y; k++) {
-    for (auto i = 0; i < array_size_x; i++) {
-      for (auto j = 0; j < array_size_z; j++) {
-        // rigidbody is dynamic if and only if mass is non zero, otherwise
-        // static
-        btScalar mass_dynamic(1.f);
-        box_collision_shape_->calculateLocalInertia(mass_dynamic,
-                                                    local_inertia);
-
-        btTransform start_transform;
-        start_transform.setIdentity();
-        start_transform.setOrigin(btVector3(
-            btScalar((-box_size_ * array_size_x / 2) + box_size_ * 2.0 * i),
-            btScalar(10 + box_size_ * k),
-            btScalar((-box_size_ * array_size_z / 2) + box_size_ * 2.0 * j)));
-        float angle = random();
-        btQuaternion qt(btVector3(1, 1, 0), angle);
-        start_transform.setRotation(qt);
-
-        // using motionstate is recommended, it provides interpolation
-        // capabilities, and only synchronizes 'active' objects
-        btDefaultMotionState* motionState_dynamic =
-            new btDefaultMotionState(start_transform);
-        btRigidBody::btRigidBodyConstructionInfo rbInfo_dynamic(
-            mass_dynamic, motionState_dynamic, box_collision_shape_,
-            local_inertia);
-        btRigidBody* body_dynamic = new btRigidBody(rbInfo_dynamic);
-        dynamics_world_->addRigidBody(body_dynamic);
-      }
-    }
-  }
-
-  recreate_physics_obj_ = false;
+  ground_body_ = body;
+
+  /// Create Dynamic Objects, all at once: we are loading anyway.
+  box_pool_ = new RigidBodyPool(
+      dynamics_world_,
+      shape_cache->GetBox(btVector3(box_size_, box_size_, box_size_)));
+  box_pool_->SetRandomSeed(random_seed_);
+  const int32_t count = GetBulletBoxCount(array_size);
+  box_pool_->SetTargetCount(count, array_size);
+  box_pool_->Update(count);
+  SyncBoxProxies();
+
+  game_mode_manager->SetGameState(false);
 }
 
 //--------------------------------------------------------------------------------
 // Delete the RigidBodies (Ground and Boxes)
 //--------------------------------------------------------------------------------
 void DemoScene::DeleteRigidBodies() {
-  // remove the rigidbodies from the dynamics world and delete them
+  // The pool removes and deletes the boxes.
+  box_proxies_.Clear();
+  CleanUp(&box_pool_);
+  ground_body_ = nullptr;
+
+  // remove the remaining rigidbodies from the dynamics world and delete them
   for (auto i = dynamics_world_->getNumCollisionObjects() - 1; i >= 0; i--) {
     btCollisionObject* obj = dynamics_world_->getCollisionObjectArray()[i];
     btRigidBody* body = btRigidBody::upcast(obj);
@@ -412,77 +1416,585 @@ void DemoScene::DeleteRigidBodies() {
     delete obj;
   }
 
-  // delete collision shapes (2 elements: Ground shape & Box shape)
-  for (auto j = 0; j < collision_shapes_.size(); j++) {
-    btCollisionShape* shape = collision_shapes_[j];
-    collision_shapes_[j] = 0;
-    delete shape;
+  // The shapes stay in the ShapeCache for the next rebuild.
+}
+
+//--------------------------------------------------------------------------------
+// Proxy 0 is the ground, proxy i + 1 the pooled box i. The pool parks and
+// reuses boxes from the end, so only the tail of the table ever changes.
+//--------------------------------------------------------------------------------
+void DemoScene::SyncBoxProxies() {
+  const int32_t count = 1 + box_pool_->GetActiveCount();
+  box_proxies_.Truncate(count);
+  while (box_proxies_.GetCount() < count) {
+    const int32_t index = box_proxies_.GetCount();
+    btRigidBody* body =
+        index == 0 ? ground_body_ : box_pool_->GetBody(index - 1);
+    btVector3 size = index == 0 ? btVector3(kGroundHalfSize, kGroundHalfSize,
+                                            kGroundHalfSize)
+                                : box_pool_->GetHalfExtents();
+
+    // Change the box color per index.
+    auto c = ((index + 1) % 7 + 1);
+    float color[3] = {((c & 0x1) != 0) * 1.f, ((c & 0x2) != 0) * 1.f,
+                      ((c & 0x4) != 0) * 1.f};
+    box_proxies_.Add(body, size, color);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Simulation thread management.
+//--------------------------------------------------------------------------------
+void DemoScene::StartPhysicsThread() {
+  if (physics_running_) {
+    {
+      std::lock_guard<std::mutex> lock(physics_mutex_);
+      physics_paused_ = false;
+    }
+    physics_cv_.notify_one();
+    return;
+  }
+  physics_running_ = true;
+  physics_paused_ = false;
+  PhysicsThread* physics_thread = PhysicsThread::GetInstance();
+  if (!physics_thread->Post([this]() { RunPhysicsThread(); })) {
+    ALOGE("DemoScene: the physics thread isn't available");
+    physics_running_ = false;
+    return;
+  }
+
+  // Add the simulation to the hint session of its cores.
+  ADPFManager::GetInstance()->AddThreadIdToHintSession(
+      physics_thread->GetThreadId(), THREAD_ROLE_PHYSICS);
+}
+
+void DemoScene::PausePhysicsThread() {
+  std::lock_guard<std::mutex> lock(physics_mutex_);
+  physics_paused_ = true;
+}
+
+void DemoScene::StopPhysicsThread() {
+  if (!physics_running_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(physics_mutex_);
+    physics_running_ = false;
+  }
+  physics_cv_.notify_one();
+  // The thread stays, for the next scene.
+  PhysicsThread* physics_thread = PhysicsThread::GetInstance();
+  physics_thread->Wait();
+  ADPFManager::GetInstance()->RemoveThreadIdFromHintSession(
+      physics_thread->GetThreadId(), THREAD_ROLE_PHYSICS);
+}
+
+void DemoScene::RunPhysicsThread() {
+  // Tick at a fixed rate. When a tick overruns, the next one starts right
+  // away, and after a long stall the schedule restarts from now instead of
+  // trying to catch up. Each tick is reported to the hint session of the
+  // physics cores, with the tick interval as the target. Timed in ns, most
+  // ticks are shorter than Clock()'s millisecond.
+  ADPFManager* adpf_manager = ADPFManager::GetInstance();
+  int64_t next_tick_ns = FrameTelemetry::GetNanos();
+  DeltaClock physics_clock(kPhysicsMaxDelta);
+  physics_restarted_ = true;
+  while (physics_running_) {
+    if (physics_paused_) {
+      std::unique_lock<std::mutex> lock(physics_mutex_);
+      physics_cv_.wait(
+          lock, [this] { return !physics_paused_ || !physics_running_; });
+      lock.unlock();
+      // Resume from now, as after a long stall.
+      next_tick_ns = FrameTelemetry::GetNanos();
+      physics_clock.Reset();
+      physics_restarted_ = true;
+      continue;
+    }
+    const int64_t tick_start_ns = FrameTelemetry::GetNanos();
+    UpdatePhysics(physics_clock.ReadDelta());
+
+    const float interval =
+        fixed_timestep_ ? physics_tick_interval_.load() : kPhysicsTickInterval;
+    const int64_t interval_ns = static_cast<int64_t>(interval * 1e9f);
+    const int64_t now_ns = FrameTelemetry::GetNanos();
+    adpf_manager->SetTargetWorkDuration(interval_ns, THREAD_ROLE_PHYSICS);
+    adpf_manager->ReportWorkDuration(THREAD_ROLE_PHYSICS,
+                                     now_ns - tick_start_ns);
+
+    next_tick_ns += interval_ns;
+    if (next_tick_ns > now_ns) {
+      usleep(static_cast<useconds_t>((next_tick_ns - now_ns) / 1000));
+    } else if (now_ns - next_tick_ns > interval_ns) {
+      next_tick_ns = now_ns;
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Runs on the simulation thread. The world is rebuilt from the scene's
+// settings, a replay sets them from the tick first.
+//--------------------------------------------------------------------------------
+bool DemoScene::ReadTickInput(float elapsed, ReplayTick* tick) {
+  if (replaying_) {
+    if (!ReplayLog::GetInstance()->NextTick(tick)) {
+      return false;
+    }
+    if ((tick->flags_ & REPLAY_TICK_RECREATE_WORLD) != 0) {
+      broadphase_type_ = tick->broadphase_;
+      multithreaded_physics_ =
+          (tick->flags_ & REPLAY_TICK_MULTITHREADED) != 0;
+      physics_backend_ = tick->physics_backend_;
+    }
+    return true;
+  }
+
+  memset(tick, 0, sizeof(*tick));
+  tick->elapsed_ = elapsed;
+  tick->array_size_ = static_cast<int8_t>(array_size_.load());
+  tick->physics_step_ = static_cast<int8_t>(current_physics_step_.load());
+  tick->solver_tier_ = static_cast<int8_t>(solver_tier_.load());
+  tick->thermal_status_ =
+      static_cast<int8_t>(ADPFManager::GetInstance()->GetThermalStatus());
+  tick->broadphase_ = static_cast<int8_t>(broadphase_type_.load());
+  tick->physics_backend_ = static_cast<int8_t>(physics_backend_.load());
+  uint8_t flags = 0;
+  if (recreate_physics_world_.exchange(false)) {
+    flags |= REPLAY_TICK_RECREATE_WORLD;
+  } else if (recreate_physics_obj_.exchange(false)) {
+    flags |= REPLAY_TICK_RESPAWN;
   }
+  if (multithreaded_physics_) {
+    flags |= REPLAY_TICK_MULTITHREADED;
+  }
+  if (sleeping_enabled_) {
+    flags |= REPLAY_TICK_SLEEPING;
+  }
+  if (fixed_timestep_) {
+    flags |= REPLAY_TICK_FIXED_TIMESTEP;
+  }
+  if (physics_restarted_) {
+    physics_restarted_ = false;
+    flags |= REPLAY_TICK_RESTART;
+  }
+  // Reset a physics each kPhysicsResetTime sec (independent of frame rate)
+  if (currentTimeMillis() - last_physics_reset_tick_ > kPhysicsResetTime) {
+    flags |= REPLAY_TICK_RESET_DUE;
+  }
+  tick->flags_ = flags;
+  return true;
 }
 
 //--------------------------------------------------------------------------------
-// Update phycis world and render boxes.
+// Update physics world and publish the box transforms. Runs on the simulation
+// thread.
 //--------------------------------------------------------------------------------
-void DemoScene::UpdatePhysics() {
-  if (recreate_physics_obj_) {
-    DeleteRigidBodies();
-    CreateRigidBodies();
+void DemoScene::UpdatePhysics(float elapsed) {
+  SAMPLES_TRACE_SCOPE("DemoScene::UpdatePhysics");
+  bool teleported = false;
+  if (broadphase_benchmark_requested_.exchange(false) &&
+      !broadphase_benchmark_.IsRunning()) {
+    benchmark_saved_broadphase_ = broadphase_type_;
+    benchmark_saved_array_size_ = array_size_;
+    broadphase_benchmark_.Start(Clock());
+    broadphase_type_ = broadphase_benchmark_.GetBroadphase();
+    array_size_ = broadphase_benchmark_.GetArraySize();
+    recreate_physics_world_ = true;
+  }
+  ReplayTick tick;
+  if (!ReadTickInput(elapsed, &tick)) {
+    return;
+  }
+  if ((tick.flags_ & REPLAY_TICK_RESTART) != 0) {
+    physics_accumulator_ = 0.f;
+  }
+  if ((tick.flags_ & REPLAY_TICK_RECREATE_WORLD) != 0) {
+    CleanupPhysics();
+    InitializePhysics(tick.array_size_);
     ResetPhysics();
+    teleported = true;
+  } else if ((tick.flags_ & REPLAY_TICK_RESPAWN) != 0) {
+    ResetPhysics();
+    teleported = true;
+  }
+  // A reset due on a tick that already respawned the boxes is dropped, as
+  // ResetPhysics() restarted the period.
+  const bool reset_due =
+      (tick.flags_ & REPLAY_TICK_RESET_DUE) != 0 && !teleported;
+  const bool fixed_timestep = (tick.flags_ & REPLAY_TICK_FIXED_TIMESTEP) != 0;
+
+  box_pool_->SetSleepingEnabled((tick.flags_ & REPLAY_TICK_SLEEPING) != 0);
+  UpdateSolverSettings(tick.solver_tier_);
+
+  // Follow the box count a few bodies per tick instead of rebuilding the
+  // scene, which would stall the simulation for a long time. Batched resets
+  // share the same budget, which is halved under thermal pressure.
+  int32_t budget = RigidBodyPool::kMaxChangesPerUpdate;
+  if (tick.thermal_status_ >= ATHERMAL_STATUS_MODERATE) {
+    budget /= 2;
+  }
+  const int32_t array_size = tick.array_size_;
+  box_pool_->SetTargetCount(GetBulletBoxCount(array_size), array_size);
+  int32_t changes = box_pool_->Update(budget);
+  if (changes > 0) {
+    SyncBoxProxies();
+  }
+  respawned_begin_ = respawned_end_ = 0;
+  if (!teleported) {
+    RespawnBatch(budget - changes);
   }
 
   // In the sample, it's looping physics update here.
   // It's intended to add more CPU load to the system to achieve thermal
   // throttling status easily.
-  // In the future version of the sample, this part will be update to
-  // dynamically adjust the load.
-  auto max_steps = current_physics_step_;
-  for (auto steps = 0; steps < max_steps; ++steps) {
-    dynamics_world_->stepSimulation(1.f / (60.f * max_steps), 10);
+  int32_t max_steps = tick.physics_step_;
+  float step = kPhysicsTickInterval / max_steps;
+  // Clock() is only precise to the millisecond, a tick can be shorter.
+  const int64_t step_start_ns = FrameTelemetry::GetNanos();
+  int32_t num_steps = max_steps;
+  if (fixed_timestep) {
+    num_steps = StepFixedTimestep(tick, step);
+  } else {
+    for (auto steps = 0; steps < max_steps; ++steps) {
+      SAMPLES_TRACE_SCOPE("Physics::SubStep");
+      dynamics_world_->stepSimulation(step, solver_settings_.max_sub_steps_);
+    }
   }
+  const int64_t tick_ns = FrameTelemetry::GetNanos() - step_start_ns;
+  const float tick_time = tick_ns / 1e9f;
+  UpdatePhysicsStats(tick_time, num_steps);
+  PowerMonitor::GetInstance()->RecordPhysicsSteps(num_steps);
+  if (UpdateBroadphaseBenchmark(tick_ns)) {
+    recreate_physics_world_ = true;
+  }
+  FrameTelemetry::GetInstance()->AddPhaseTime(TELEMETRY_PHASE_PHYSICS,
+                                              tick_ns);
 
-  // Update box renderer.
-  box_.BeginMultipleRender();
-
-  // print positions of all objects
-  auto box_color = 1;
-  for (auto j = dynamics_world_->getNumCollisionObjects() - 1; j >= 0; j--) {
-    btCollisionObject* obj = dynamics_world_->getCollisionObjectArray()[j];
-    btRigidBody* body = btRigidBody::upcast(obj);
-    btTransform trans;
-    if (body && body->getMotionState()) {
-      body->getMotionState()->getWorldTransform(trans);
+  if (reset_due && reset_cursor_ < 0) {
+    if (box_pool_->IsSleepingEnabled()) {
+      StartBatchedReset();
     } else {
-      trans = obj->getWorldTransform();
+      ResetPhysics();
+      teleported = true;
     }
-    auto shape = body->getCollisionShape();
-    auto name = shape->getName();
-    if (!strcmp(name, "Box")) {
-      auto p = reinterpret_cast<btBoxShape*>(shape);
-      auto size = p->getHalfExtentsWithoutMargin();
-
-      // Render boxes
-      btScalar m[16];
-      trans.getOpenGLMatrix(m);
-
-      // Change the box color (expecting BulletPhysics's object iteration order
-      // doesn't change).
-      auto c = (box_color % 7 + 1);
-      float color[3] = {((c & 0x1) != 0) * 1.f, ((c & 0x2) != 0) * 1.f,
-                        ((c & 0x4) != 0) * 1.f};
-      box_.RenderMultiple(m, size.getX() * 2, size.getY() * 2, size.getZ() * 2,
-                          color);
-      box_color++;
+  }
+  int32_t awake_bodies = box_pool_->GetAwakeCount();
+  FrameTelemetry::GetInstance()->SetActiveBodies(awake_bodies);
+  SAMPLES_TRACE_COUNTER("ActiveBodies", awake_bodies);
+
+  ReplayLog* replay_log = ReplayLog::GetInstance();
+  if (replaying_) {
+    replay_log->CheckTick(box_pool_->GetStateHash());
+  } else if (replay_log->IsRecording()) {
+    tick.state_hash_ = box_pool_->GetStateHash();
+    replay_log->RecordTick(tick);
+  }
+
+  if (!fixed_timestep) {
+    PublishPhysicsSnapshot(teleported, Clock(), kPhysicsTickInterval);
+  } else if (num_steps > 0 || teleported) {
+    // The simulation is behind the clock by what is left in the accumulator,
+    // the renderer interpolates over it.
+    PublishPhysicsSnapshot(teleported, Clock() - physics_accumulator_,
+                           num_steps > 0 ? num_steps * step : step);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Set the solver tier picked by the UI or the governor on the world. Takes
+// effect on the next step.
+//--------------------------------------------------------------------------------
+void DemoScene::UpdateSolverSettings(int32_t tier) {
+  if (tier == applied_solver_tier_) {
+    return;
+  }
+  applied_solver_tier_ = tier;
+  solver_settings_ = GetSolverSettings(static_cast<SolverTier>(tier));
+  ApplySolverSettings(solver_settings_, dynamics_world_);
+  ALOGI("DemoScene: %s solver, %d iterations", kSolverTierNames[tier],
+        solver_settings_.num_iterations_);
+}
+
+//--------------------------------------------------------------------------------
+// Run the sub-steps the elapsed time adds up to, each one a single Bullet
+// step of exactly `step`, so the simulation speed doesn't depend on the tick
+// rate. Catching up is capped under thermal pressure, so a slow tick doesn't
+// make the next one slower.
+//--------------------------------------------------------------------------------
+int32_t DemoScene::StepFixedTimestep(const ReplayTick& tick, float step) {
+  const int32_t steps_per_tick = tick.physics_step_;
+  int32_t max_steps = steps_per_tick * kPhysicsMaxCatchUpTicks;
+  if (tick.thermal_status_ >= ATHERMAL_STATUS_MODERATE) {
+    max_steps = steps_per_tick;
+  }
+
+  physics_accumulator_ += tick.elapsed_;
+  int32_t num_steps = 0;
+  while (physics_accumulator_ >= step && num_steps < max_steps) {
+    SAMPLES_TRACE_SCOPE("Physics::SubStep");
+    dynamics_world_->stepSimulation(step, 1, step);
+    physics_accumulator_ -= step;
+    ++num_steps;
+  }
+  if (physics_accumulator_ >= step) {
+    physics_accumulator_ = fmodf(physics_accumulator_, step);
+  }
+  return num_steps;
+}
+
+//--------------------------------------------------------------------------------
+// Accumulate the step time and log the average each kPhysicsStatsInterval, so
+// the optimization profiles can be compared from logcat.
+//--------------------------------------------------------------------------------
+void DemoScene::UpdatePhysicsStats(float tick_time, int32_t sub_steps) {
+  float now = Clock();
+  if (physics_stats_ticks_ == 0) {
+    physics_stats_start_ = now;
+  }
+  physics_stats_total_ += tick_time;
+  ++physics_stats_ticks_;
+
+  if (now - physics_stats_start_ >= kPhysicsStatsInterval) {
+    float average = physics_stats_total_ / physics_stats_ticks_;
+    physics_tick_time_ = average;
+    int32_t size = array_size_;
+    ALOGI("PhysicsBenchmark: %d boxes, %d sub-steps, %s, %.3f ms/tick "
+          "(%d ticks)",
+          size * size * size, sub_steps,
+          multithreaded_physics_ ? "multithreaded" : "single threaded",
+          average * 1000.f, physics_stats_ticks_);
+    physics_stats_total_ = 0.f;
+    physics_stats_ticks_ = 0;
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Move to the next run of the benchmark, or back to the user settings after
+// the last one.
+//--------------------------------------------------------------------------------
+bool DemoScene::UpdateBroadphaseBenchmark(int64_t tick_ns) {
+  if (!broadphase_benchmark_.Update(Clock(), tick_ns)) {
+    return false;
+  }
+  if (broadphase_benchmark_.IsRunning()) {
+    broadphase_type_ = broadphase_benchmark_.GetBroadphase();
+    array_size_ = broadphase_benchmark_.GetArraySize();
+  } else {
+    broadphase_type_ = benchmark_saved_broadphase_;
+    array_size_ = benchmark_saved_array_size_;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Copy the box transforms to the snapshot buffer: the ground first, then the
+// pooled boxes, whose indices stay stable while the box count changes. When
+// the boxes were teleported, don't interpolate from their previous pose.
+//--------------------------------------------------------------------------------
+void DemoScene::PublishPhysicsSnapshot(bool teleported, float time,
+                                       float interval) {
+  SAMPLES_TRACE_SCOPE("Physics::PublishSnapshot");
+  PhysicsSnapshot* snapshot = physics_snapshots_.BeginWrite();
+  const int32_t num_boxes = box_proxies_.GetCount();
+  snapshot->boxes_.resize(num_boxes);
+
+  if (teleported) {
+    box_proxies_.ReadAllPoses();
+  } else {
+    box_proxies_.UpdatePoses();
+  }
+  box_proxies_.CopyToSnapshot(snapshot->boxes_.data(), num_boxes);
+
+  // The previous pose is the current pose of the last published snapshot,
+  // which the triple buffer does not give back; keep a copy instead. Boxes
+  // that were just added start without interpolation.
+  int32_t num_known = teleported ? 0 : static_cast<int32_t>(
+                                           last_box_poses_.size());
+  last_box_poses_.resize(num_boxes);
+  for (auto i = num_known; i < num_boxes; ++i) {
+    last_box_poses_[i] = snapshot->boxes_[i].current_;
+  }
+  for (auto i = respawned_begin_; i < std::min(respawned_end_, num_known);
+       ++i) {
+    last_box_poses_[i] = snapshot->boxes_[i].current_;
+  }
+  for (auto i = 0; i < num_boxes; ++i) {
+    BoxSnapshot& box = snapshot->boxes_[i];
+    box.previous_ = last_box_poses_[i];
+    last_box_poses_[i] = box.current_;
+  }
+
+  snapshot->time_ = time;
+  snapshot->interval_ = interval;
+  physics_snapshots_.EndWrite();
+}
+
+//--------------------------------------------------------------------------------
+// Render the boxes of the latest snapshot, interpolated between the last two
+// simulation steps. The instances are computed here, on the game thread, and
+// drawn by the render thread as they are.
+//--------------------------------------------------------------------------------
+void DemoScene::RenderBoxes() {
+  SAMPLES_TRACE_SCOPE("DemoScene::RenderBoxes");
+  const PhysicsSnapshot* snapshot = physics_snapshots_.AcquireLatest();
+  if (snapshot == nullptr) {
+    return;
+  }
+
+  float alpha = 1.f;
+  if (snapshot->interval_ > 0.f) {
+    alpha = Clamp((Clock() - snapshot->time_) / snapshot->interval_, 0.f, 1.f);
+  }
+
+  const int32_t num_boxes = static_cast<int32_t>(snapshot->boxes_.size());
+  cull_x_.resize(num_boxes);
+  cull_y_.resize(num_boxes);
+  cull_z_.resize(num_boxes);
+  cull_radius_.resize(num_boxes);
+  visible_boxes_.resize(num_boxes);
+
+  if (culling_enabled_) {
+    box_culler_.SetViewProjection(box_.GetViewProjection().Ptr());
+    box_culler_.SetFloorHeight(kCullFloorHeight);
+  }
+
+  const int32_t num_blocks = (num_boxes + kCullBlockSize - 1) / kCullBlockSize;
+  cull_block_counts_.resize(num_blocks);
+  {
+    SAMPLES_TRACE_SCOPE("DemoScene::Cull");
+    JobSystem::GetInstance()->ParallelFor(
+        0, num_blocks, 1, [&](int32_t first_block, int32_t last_block) {
+          for (auto block = first_block; block < last_block; ++block) {
+            const int32_t begin = block * kCullBlockSize;
+            const int32_t end = std::min(begin + kCullBlockSize, num_boxes);
+            cull_block_counts_[block] =
+                CullBoxRange(*snapshot, alpha, begin, end);
+          }
+        });
+  }
+
+  // Each block only moves down, to where the previous one ended, so copying
+  // forward in place is safe.
+  num_visible_boxes_ = 0;
+  for (auto block = 0; block < num_blocks; ++block) {
+    const int32_t* first = visible_boxes_.data() + block * kCullBlockSize;
+    std::copy(first, first + cull_block_counts_[block],
+              visible_boxes_.data() + num_visible_boxes_);
+    num_visible_boxes_ += cull_block_counts_[block];
+  }
+
+  // Sized for the worst case, so the ring doesn't regrow as boxes come and
+  // go from the view.
+  GpuPhysics* gpu_boxes = active_physics_backend_ == PHYSICS_BACKEND_GPU
+                              ? &gpu_physics_
+                              : nullptr;
+  BOX_INSTANCE* instances =
+      RenderThread::GetInstance()->GetFrame()->DrawBoxes(
+          &box_, num_visible_boxes_, num_boxes, gpu_boxes);
+  {
+    SAMPLES_TRACE_SCOPE("DemoScene::Interpolate");
+    JobSystem::GetInstance()->ParallelFor(
+        0, num_visible_boxes_, kCullBlockSize, [&](int32_t begin, int32_t end) {
+          for (auto v = begin; v < end; ++v) {
+            const BoxSnapshot& box = snapshot->boxes_[visible_boxes_[v]];
+            float m[16];
+            InterpolateBoxPose(box.previous_, box.current_, alpha, m);
+            BoxRenderer::MakeInstance(
+                m, box.half_extents_[0] * 2, box.half_extents_[1] * 2,
+                box.half_extents_[2] * 2, box.color_, &instances[v]);
+          }
+        });
+  }
+  if (gpu_boxes != nullptr && gpu_physics_array_size_ > 0) {
+    num_visible_boxes_ += gpu_physics_array_size_ * gpu_physics_array_size_ *
+                          gpu_physics_array_size_;
+  }
+}
+
+//--------------------------------------------------------------------------------
+// The same steps as the Bullet world, current_physics_step_ per tick, so the
+// Physics Steps knob moves the GPU load too. The boxes are respawned as
+// often as the Bullet ones, and when the box count changes.
+//--------------------------------------------------------------------------------
+void DemoScene::UpdateGpuPhysics(ReplayFrame* frame) {
+  // A replay steps on the frames the recording did, wherever the simulation
+  // thread is with the switch of backend.
+  const bool active = replaying_
+                          ? (frame->flags_ & REPLAY_FRAME_GPU_PHYSICS) != 0
+                          : active_physics_backend_ == PHYSICS_BACKEND_GPU;
+  if (!active || !gpu_physics_.IsSupported()) {
+    gpu_physics_array_size_ = -1;
+    return;
+  }
+  SAMPLES_TRACE_SCOPE("DemoScene::UpdateGpuPhysics");
+  const float now = Clock();
+  const int32_t array_size = frame->array_size_;
+  bool reset = (frame->flags_ & REPLAY_FRAME_GPU_RESET) != 0;
+  if (!replaying_) {
+    reset = array_size != gpu_physics_array_size_ ||
+            now - gpu_physics_reset_time_ > kPhysicsResetTime * 0.001f;
+    frame->flags_ |= REPLAY_FRAME_GPU_PHYSICS;
+    if (reset) {
+      frame->flags_ |= REPLAY_FRAME_GPU_RESET;
     }
   }
+  RenderFrame* render_frame = RenderThread::GetInstance()->GetFrame();
+  if (reset) {
+    render_frame->ResetGpuPhysics(&gpu_physics_, array_size, box_size_,
+                                  random_seed_);
+    gpu_physics_array_size_ = array_size;
+    gpu_physics_reset_time_ = now;
+    gpu_physics_accumulator_ = 0.f;
+    return;
+  }
 
-  box_.EndMultipleRender();
+  const int32_t steps_per_tick = frame->physics_step_;
+  const float step = kPhysicsTickInterval / steps_per_tick;
+  gpu_physics_accumulator_ += frame->delta_;
+  int32_t num_steps = static_cast<int32_t>(gpu_physics_accumulator_ / step);
+  if (num_steps > steps_per_tick * kGpuPhysicsMaxTicks) {
+    num_steps = steps_per_tick * kGpuPhysicsMaxTicks;
+    gpu_physics_accumulator_ = 0.f;
+  } else {
+    gpu_physics_accumulator_ -= num_steps * step;
+  }
+  render_frame->StepGpuPhysics(&gpu_physics_, step, num_steps);
+}
 
-  // Reset a physics each kPhysicsResetTime sec (independent of frame rate)
-  int32_t currentTime = currentTimeMillis();
-  int32_t elapsedTime = currentTime - last_physics_reset_tick_;
-  if (elapsedTime > kPhysicsResetTime) {
-    ResetPhysics();
+//--------------------------------------------------------------------------------
+// Interpolate the centers only, the rotations are only needed for the visible
+// boxes. Runs on the JobSystem, each call owns its range of the arrays.
+//--------------------------------------------------------------------------------
+int32_t DemoScene::CullBoxRange(const PhysicsSnapshot& snapshot, float alpha,
+                                int32_t begin, int32_t end) {
+  for (auto i = begin; i < end; ++i) {
+    const BoxSnapshot& box = snapshot.boxes_[i];
+    const float* from = box.previous_.position_;
+    const float* to = box.current_.position_;
+    cull_x_[i] = from[0] + (to[0] - from[0]) * alpha;
+    cull_y_[i] = from[1] + (to[1] - from[1]) * alpha;
+    cull_z_[i] = from[2] + (to[2] - from[2]) * alpha;
+    const float* size = box.half_extents_;
+    cull_radius_[i] =
+        sqrtf(size[0] * size[0] + size[1] * size[1] + size[2] * size[2]);
   }
+
+  int32_t* visible = visible_boxes_.data() + begin;
+  if (!culling_enabled_) {
+    for (auto i = begin; i < end; ++i) {
+      *visible++ = i;
+    }
+    return end - begin;
+  }
+
+  const int32_t num_visible =
+      box_culler_.Cull(cull_x_.data() + begin, cull_y_.data() + begin,
+                       cull_z_.data() + begin, cull_radius_.data() + begin,
+                       end - begin, visible);
+  for (auto v = 0; v < num_visible; ++v) {
+    visible[v] += begin;
+  }
+  return num_visible;
 }
 
 int32_t DemoScene::currentTimeMillis() {
@@ -498,53 +2010,35 @@ void DemoScene::ResetPhysics() {
   // keep track of last reset time
   int32_t currentTime = currentTimeMillis();
   last_physics_reset_tick_ = currentTime;
+  reset_cursor_ = -1;
 
-  // Reset physics state.
-  auto k = 0;
-  auto i = 0;
-  auto j = 0;
-  int32_t array_size_x = array_size_;
-  int32_t array_size_y = array_size_;
-  int32_t array_size_z = array_size_;
-  for (auto index = dynamics_world_->getNumCollisionObjects() - 1; index >= 0;
-       index--) {
-    btCollisionObject* obj = dynamics_world_->getCollisionObjectArray()[index];
-    btRigidBody* body = btRigidBody::upcast(obj);
-    if (body) {
-      auto shape = body->getCollisionShape();
-      auto name = shape->getName();
-      if (!strcmp(name, "Box")) {
-        auto p = reinterpret_cast<btBoxShape*>(shape);
-        auto size = p->getHalfExtentsWithoutMargin();
-        auto stage_size_threshold = 30.f;
-        if (size.getX() < stage_size_threshold) {
-          // Reset position.
-          btTransform transform;
-          transform.setIdentity();
-          transform.setOrigin(btVector3(
-              btScalar((-box_size_ * box_size_ / 2) + box_size_ * 2.0 * i),
-              btScalar(10 + box_size_ * k),
-              btScalar((-box_size_ * array_size_z / 2) + box_size_ * 2.0 * j)));
-          float angle = random();
-          btQuaternion qt(btVector3(1, 1, 0), angle);
-          transform.setRotation(qt);
-
-          body->setWorldTransform(transform);
-          body->setActivationState(DISABLE_DEACTIVATION);
-
-          // Update cube's index.
-          j = (j + 1) % array_size_z;
-          if (!j) {
-            i = (i + 1) % array_size_x;
-            if (!i) {
-              k = (k + 1) % array_size_y;
-            }
-          }
-        }
-      }
-    }
+  // The pool moves the broadphase proxies of the boxes it respawns.
+  box_pool_->Respawn(0, box_pool_->GetActiveCount());
+}
+
+void DemoScene::StartBatchedReset() {
+  last_physics_reset_tick_ = currentTimeMillis();
+  reset_cursor_ = 0;
+}
+
+//--------------------------------------------------------------------------------
+// A respawned box wakes up and falls again, so respawning all boxes at once
+// makes every body expensive on the same tick. Respawn them a batch at a
+// time instead, the rest of the pile stays asleep meanwhile.
+//--------------------------------------------------------------------------------
+void DemoScene::RespawnBatch(int32_t budget) {
+  if (reset_cursor_ < 0 || budget <= 0) {
+    return;
+  }
+  int32_t count = box_pool_->Respawn(reset_cursor_, budget);
+
+  // Proxy 0 is the ground.
+  respawned_begin_ = 1 + reset_cursor_;
+  respawned_end_ = respawned_begin_ + count;
+  reset_cursor_ += count;
+  if (reset_cursor_ >= box_pool_->GetActiveCount()) {
+    reset_cursor_ = -1;
   }
-  dynamics_world_->setForceUpdateAllAabbs(true);
 }
 
 //--------------------------------------------------------------------------------
@@ -558,6 +2052,8 @@ void DemoScene::CleanupPhysics() {
 
   // delete solver
   delete solver_;
+  delete solver_pool_;
+  solver_pool_ = nullptr;
 
   // delete broadphase
   delete overlapping_pair_cache_;
@@ -567,7 +2063,8 @@ void DemoScene::CleanupPhysics() {
 
   delete collision_configuration_;
 
-  // next line is optional: it will be cleared by the destructor when the array
-  // goes out of scope
-  collision_shapes_.clear();
+  for (auto tid : JobSystem::GetInstance()->GetWorkerThreadIds()) {
+    ADPFManager::GetInstance()->RemoveThreadIdFromHintSession(
+        tid, THREAD_ROLE_PHYSICS);
+  }
 }
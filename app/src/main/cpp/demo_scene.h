@@ -23,13 +23,33 @@
 #include "btBulletDynamicsCommon.h"
 #pragma GCC diagnostic pop
 
+#include <condition_variable>
+#include <mutex>
+
+#include "box_culler.h"
 #include "box_renderer.h"
+#include "broadphase.h"
+#include "broadphase_benchmark.h"
+#include "device_profile.h"
+#include "dynamic_resolution.h"
 #include "engine.h"
+#include "gpu_physics.h"
+#include "gpu_timer.h"
+#include "physics_snapshot.h"
+#include "physics_task_scheduler.h"
+#include "render_proxy_table.h"
+#include "replay_log.h"
+#include "rigid_body_pool.h"
+#include "shape_cache.h"
+#include "solver_quality.h"
 #include "swappy/swappyGL.h"
 #include "swappy/swappyGL_extra.h"
+#include "swap_interval_controller.h"
+#include "thermal_governor.h"
 #include "util.h"
 
 class GameAssetManager;
+class btConstraintSolverPoolMt;
 
 // Basic scene implementation for our demo UI display.
 // In the scene, it's using BulletPhysics to update bulk cubes dynamically
@@ -67,12 +87,41 @@ class DemoScene : public Scene {
 
   virtual void OnScreenResized(int width, int height);
 
+  virtual void OnPause();
+
+  virtual void OnResume();
+
+  virtual void OnTrimMemory(MemoryPressureLevel level);
+
   static DemoScene* GetInstance();
 
-  void ControlStep(bool step_up);
-  void ControlBoxCount(bool count_up);
+  // Adjust the simulation load. Returns true when the setting changed.
+  bool ControlStep(bool step_up);
+  bool ControlBoxCount(bool count_up);
+  // Up is more accurate, i.e. a lower SolverTier.
+  bool ControlSolverTier(bool tier_up);
+  // Up is a richer SurfaceFormat, up to the one picked in the UI. Only works
+  // when the engine can recreate the surface in another format.
+  bool ControlSurfaceFormat(bool format_up);
   void ControlResetToDefaultSettings();
 
+  // Switch between the single threaded and the multithreaded physics world.
+  // The world is rebuilt on the next frame.
+  void SetMultithreadedPhysics(bool enabled);
+
+  // Switch the broadphase algorithm. The world is rebuilt on the next tick.
+  void SetBroadphase(BroadphaseType type);
+
+  // Simulate the boxes with Bullet or GpuPhysics. Picked when the world is
+  // rebuilt on the next tick, GPU only once OnStartGraphics() found it
+  // supported.
+  void SetPhysicsBackend(PhysicsBackend backend);
+
+  // Benchmark the broadphases at all box counts on the simulation thread.
+  // The user settings are restored once it is done. Not while a run is
+  // recorded or replayed, it depends on the step times.
+  void StartBroadphaseBenchmark();
+
  private:
   // # of cubes managed in bullet physics. Defaulted to 8
   static constexpr int32_t kArraySize = 8;
@@ -87,6 +136,28 @@ class DemoScene : public Scene {
   // Size of the box in the bullet physics.
   static constexpr float kBoxSize = 0.5f;
 
+  // Rate of the simulation thread, in seconds per tick. Each tick runs
+  // current_physics_step_ sub-steps.
+  static constexpr float kPhysicsTickInterval = 1.f / 60.f;
+
+  // Fixed timestep mode: catch up at most this many ticks worth of sub-steps
+  // per update, or a single one under thermal pressure. The time beyond is
+  // dropped and the simulation slows down instead.
+  static constexpr int32_t kPhysicsMaxCatchUpTicks = 3;
+
+  // Longest time between two updates the accumulator picks up, in seconds.
+  static constexpr float kPhysicsMaxDelta = 0.25f;
+
+  // Interval of the step time benchmark log, in seconds.
+  static constexpr float kPhysicsStatsInterval = 5.f;
+
+  // Broadphase the world is built with at startup.
+  static constexpr BroadphaseType kDefaultBroadphase = BROADPHASE_DBVT;
+
+  // Multithreaded physics settings. A thread count of 0 uses all the threads
+  // of the JobSystem.
+  static constexpr int32_t kPhysicsThreadCount = 0;
+
   // must be implemented by subclass
 
   virtual void OnButtonClicked(int buttonId);
@@ -102,14 +173,97 @@ class DemoScene : public Scene {
   void SetupUIWindow();
   bool RenderPreferences();
   void RenderPanel();
+  void RenderTelemetry();
+
+  // Feed the frame's thermal and timing data to the governor. The knob it
+  // moved is logged in `frame`, or the logged one moved during a replay.
+  void UpdateGovernor(ReplayFrame* frame);
+  void UpdateSolverSettings(int32_t tier);
+  void UpdateProfile(float now);
+  ThermalLoad GetThermalLoad() const;
+  std::string GetThermalModelPath() const;
+  // Drive the load and record the run of a requested soak test.
+  void UpdateSoakTest();
+
+  // Start a requested recording or replay, before the world is first built.
+  // A replay starts from the recorded settings and seed.
+  void StartReplayLog();
+  // The inputs of the frame, from the clocks and the settings, or from the
+  // replay along with its touches.
+  void ReadFrameInput(ReplayFrame* frame);
+  // The inputs of the next simulation tick, the same way. Returns false once
+  // the replay ran out of ticks.
+  bool ReadTickInput(float elapsed, ReplayTick* tick);
+  // Touches are recorded with the frame they are delivered in, and ignored
+  // during a replay, which plays the recorded ones.
+  void OnPointerEvent(int32_t type, int pointer_id,
+                      const struct PointerCoords* coords);
+  void HandlePointerEvent(const ReplayEvent& event);
+  void PointerDown(const struct PointerCoords* coords);
+  void PointerMove(const struct PointerCoords* coords);
+  void PointerUp(const struct PointerCoords* coords);
+  // CPU time of the last frame: the game or render thread's work or the
+  // simulation tick, whichever is longer. In seconds.
+  float GetCpuFrameTime() const;
+
+  // Let the swap interval controller pick the frame rate.
+  void UpdateFrameRate();
+
+  // Apply the budget of the current game mode when it changed.
+  void UpdateGameMode();
 
   // Bullet Physics related methods.
-  void InitializePhysics();
-  void CreateRigidBodies();
+  // The world is built with array_size^3 boxes.
+  void InitializePhysics(int32_t array_size);
+  void CreateRigidBodies(int32_t array_size);
   void DeleteRigidBodies();
+
+  // Add or drop the render proxies of the boxes the pool added or parked.
+  void SyncBoxProxies();
   void CleanupPhysics();
-  void UpdatePhysics();
+  // `elapsed` is the time since the previous update, in seconds.
+  void UpdatePhysics(float elapsed);
+  // Respawn all boxes at once.
   void ResetPhysics();
+  // Respawn the boxes over the next ticks, a budget of boxes per tick.
+  void StartBatchedReset();
+  // Respawn the next up to `budget` boxes of a batched reset.
+  void RespawnBatch(int32_t budget);
+
+  // Advance the simulation by whole fixed steps of the accumulated time.
+  // Returns the # of steps run.
+  int32_t StepFixedTimestep(const ReplayTick& tick, float step);
+
+  // Simulation loop, on the PhysicsThread. It owns the physics world while
+  // it runs, and publishes the box transforms through physics_snapshots_.
+  // It is parked while the scene has no graphics, and returns when the
+  // scene goes.
+  void StartPhysicsThread();
+  void PausePhysicsThread();
+  void StopPhysicsThread();
+  void RunPhysicsThread();
+  // `time` is when the published state is current, `interval` how much time
+  // it advanced the simulation by.
+  void PublishPhysicsSnapshot(bool teleported, float time, float interval);
+  void UpdatePhysicsStats(float tick_time, int32_t sub_steps);
+  // Start, advance and finish the broadphase benchmark. Returns true when the
+  // world must be rebuilt.
+  bool UpdateBroadphaseBenchmark(int64_t tick_ns);
+
+  // Draw the boxes from the latest snapshot, and those of GpuPhysics.
+  void RenderBoxes();
+  // Advance GpuPhysics by the frame time when it simulates the boxes. Whether
+  // it did and respawned them is logged in `frame`.
+  void UpdateGpuPhysics(ReplayFrame* frame);
+  // Governor knob: move the simulation to `backend` when the other resource
+  // is the bottleneck.
+  bool ControlPhysicsBackend(PhysicsBackend backend);
+  // # of boxes in the Bullet world: none when GpuPhysics simulates them.
+  int32_t GetBulletBoxCount(int32_t array_size) const;
+  // Interpolate the centers of the boxes [begin, end) and write the visible
+  // ones to visible_boxes_ from `begin` on. Returns how many there are.
+  int32_t CullBoxRange(const PhysicsSnapshot& snapshot, float alpha,
+                       int32_t begin, int32_t end);
 
   int32_t currentTimeMillis();
 
@@ -129,7 +283,69 @@ class DemoScene : public Scene {
   // Did we simulate a click for ImGui?
   SimulatedClickState simulated_click_state_;
 
-  bool recreate_physics_obj_; // need to create obj on next tick
+  // Set for the life of the scene once the replay log is loaded: the
+  // simulation and the frames then only follow the log.
+  bool replaying_;
+
+  // Seed of the spawn rotations of the boxes.
+  uint32_t random_seed_;
+
+  std::atomic<bool> recreate_physics_obj_; // need to respawn obj on next tick
+
+  // Use btDiscreteDynamicsWorldMt, and rebuild the world on next tick.
+  std::atomic<bool> multithreaded_physics_;
+  std::atomic<bool> recreate_physics_world_;
+
+  // BroadphaseType of the world, rebuilt on next tick when it changes.
+  std::atomic<int32_t> broadphase_type_;
+
+  // PhysicsBackend asked for, rebuilt on next tick when it changes, and the
+  // one the world was built with.
+  std::atomic<int32_t> physics_backend_;
+  std::atomic<int32_t> active_physics_backend_;
+  std::atomic<bool> gpu_physics_available_;
+
+  // Broadphase benchmark, and the settings to restore once it is done.
+  BroadphaseBenchmark broadphase_benchmark_;
+  std::atomic<bool> broadphase_benchmark_requested_;
+  int32_t benchmark_saved_broadphase_;
+  int32_t benchmark_saved_array_size_;
+
+  // Simulation thread state.
+  std::atomic<bool> physics_running_;
+  // Guards physics_paused_, on which the parked thread waits.
+  std::mutex physics_mutex_;
+  std::condition_variable physics_cv_;
+  std::atomic<bool> physics_paused_;
+  PhysicsSnapshotBuffer physics_snapshots_;
+  std::vector<BoxPose> last_box_poses_;
+
+  // Step the simulation with the elapsed time instead of a fixed # of
+  // sub-steps per tick. The thread then ticks at the display frame period.
+  std::atomic<bool> fixed_timestep_;
+  std::atomic<float> physics_tick_interval_;
+
+  // Elapsed time not simulated yet, in seconds, restarted on the first tick
+  // after the thread starts or resumes. Simulation thread only.
+  float physics_accumulator_;
+  bool physics_restarted_;
+
+  // Let resting boxes deactivate. Resets are then spread over several ticks.
+  std::atomic<bool> sleeping_enabled_;
+
+  // Next box of a batched reset, -1 when none is in progress, and the range of
+  // proxies respawned this tick, not to be interpolated. Simulation thread
+  // only.
+  int32_t reset_cursor_;
+  int32_t respawned_begin_;
+  int32_t respawned_end_;
+
+  // Step time benchmark: CPU time of the stepSimulation() calls of a tick,
+  // averaged over kPhysicsStatsInterval.
+  std::atomic<float> physics_tick_time_;
+  float physics_stats_start_;
+  float physics_stats_total_;
+  int32_t physics_stats_ticks_;
 
   // Is a touch pointer (a.k.a. finger) down at the moment?
   bool pointer_down_;
@@ -146,18 +362,92 @@ class DemoScene : public Scene {
   // Renderer to render cubes.
   BoxRenderer box_;
 
+  // Scaled render target of the boxes, the UI stays at native resolution.
+  DynamicResolution dynamic_resolution_;
+
+  // Compute shader simulation, GL thread only. The # of boxes per side it
+  // was spawned with, -1 to respawn, and the time of the spawn.
+  GpuPhysics gpu_physics_;
+  DeltaClock gpu_physics_clock_;
+  int32_t gpu_physics_array_size_;
+  float gpu_physics_reset_time_;
+  float gpu_physics_accumulator_;
+
+  // Richest SurfaceFormat the governor goes back up to, MSAA only when it
+  // was picked in the UI.
+  int32_t best_surface_format_;
+
+  // Culls the boxes outside of the view before they are submitted. The
+  // bounding spheres and visible indices are kept between frames. The boxes
+  // are culled in blocks of kCullBlockSize on the JobSystem, then the visible
+  // indices of the blocks are compacted.
+  static constexpr int32_t kCullBlockSize = 256;
+  BoxCuller box_culler_;
+  bool culling_enabled_;
+  std::vector<float> cull_x_;
+  std::vector<float> cull_y_;
+  std::vector<float> cull_z_;
+  std::vector<float> cull_radius_;
+  std::vector<int32_t> visible_boxes_;
+  std::vector<int32_t> cull_block_counts_;
+  int32_t num_visible_boxes_;
+
+  // GPU time of the frame, the box pass and the UI pass.
+  GpuTimer gpu_timer_;
+  // GpuTimer::GetReadBackCount() when the times were last passed on.
+  int32_t gpu_timer_read_backs_;
+
   int32_t current_thermal_index_;
 
-  // Current and target frame rate period.
+  // Thermal headroom forecasted by ADPFManager.
+  float thermal_headroom_;
+
+  // Governor that drives the physics step and box count.
+  ThermalGovernor governor_;
+
+  // Learns how the headroom follows the load, for the governor's policy.
+  // The policy is owned by the governor.
+  ThermalModel thermal_model_;
+  const PredictivePolicy* predictive_policy_;
+  float thermal_model_save_time_;
+
+  // The last configuration this device sustained. The scene starts from it;
+  // the render settings are applied on the first OnStartGraphics().
+  DeviceProfileStore profile_store_;
+  bool has_start_profile_;
+  DeviceProfile start_profile_;
+
+  // Measures the time between two frames.
+  DeltaClock frame_clock_;
+
+  // Game mode the budget below was applied for.
+  int32_t game_mode_;
+
+  // Caps of the physics step and the box count from the game mode budget.
+  int32_t max_physics_step_;
+  int32_t max_array_size_;
+
+  // Picks the frame period from the display's refresh rates.
+  SwapIntervalController swap_interval_;
+
+  // Current and target frame rate period, in ns. They differ while a frame
+  // rate transition started at transition_start_ settles.
   int32_t target_frame_period_;
   int32_t current_frame_period_;
 
   // time of last physics reset
   int32_t last_physics_reset_tick_;
 
-  int32_t current_physics_step_;
+  // Written by the UI and the governor, read by the simulation thread.
+  std::atomic<int32_t> current_physics_step_;
+  std::atomic<int32_t> solver_tier_;
 
-  int32_t array_size_;
+  // The SolverTier set on the world, -1 after it was rebuilt. Owned by the
+  // simulation thread.
+  int32_t applied_solver_tier_;
+  SolverSettings solver_settings_;
+
+  std::atomic<int32_t> array_size_;
 
   float box_size_;
 
@@ -165,10 +455,16 @@ class DemoScene : public Scene {
   btDefaultCollisionConfiguration* collision_configuration_;
   btCollisionDispatcher* dispatcher_;
   btDiscreteDynamicsWorld* dynamics_world_;
-  btAlignedObjectArray<btCollisionShape*> collision_shapes_;
-  btSequentialImpulseConstraintSolver* solver_;
+  btConstraintSolver* solver_;
+  btConstraintSolverPoolMt* solver_pool_;
   btBroadphaseInterface* overlapping_pair_cache_;
-  btCollisionShape* box_collision_shape_;
+  btRigidBody* ground_body_;
+
+  // Dynamic boxes, resized incrementally when the box count changes.
+  RigidBodyPool* box_pool_;
+
+  // The ground, then the pooled boxes, in pool order.
+  RenderProxyTable box_proxies_;
 };
 
 #endif  // DEMO_SCENE_H_
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "device_profile.h"
+
+#include <cstdio>
+
+#include "common.h"
+#include "util.h"
+
+namespace {
+const uint32_t kProfileMagic = 0x31465250;  // "PRF1"
+// Bump when DeviceProfile changes.
+const uint32_t kProfileVersion = 3;
+
+struct ProfileHeader {
+  uint32_t magic_;
+  uint32_t version_;
+  uint64_t device_hash_;
+};
+
+bool IsSameProfile(const DeviceProfile& a, const DeviceProfile& b) {
+  return a.physics_step_ == b.physics_step_ &&
+         a.solver_tier_ == b.solver_tier_ &&
+         a.array_size_ == b.array_size_ &&
+         a.frame_period_ns_ == b.frame_period_ns_ &&
+         a.resolution_scale_ == b.resolution_scale_ &&
+         a.shading_tier_ == b.shading_tier_ &&
+         a.surface_format_ == b.surface_format_;
+}
+}  // namespace
+
+DeviceProfileStore::DeviceProfileStore(const std::string& path)
+    : path_(path),
+      has_profile_(false),
+      profile_(),
+      has_candidate_(false),
+      candidate_(),
+      candidate_since_(0.f) {}
+
+bool DeviceProfileStore::Load(DeviceProfile* profile) {
+  FILE* file = fopen(path_.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  ProfileHeader header;
+  DeviceProfile saved;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            header.magic_ == kProfileMagic &&
+            header.version_ == kProfileVersion &&
+            header.device_hash_ == GetDeviceHash() &&
+            fread(&saved, sizeof(saved), 1, file) == 1;
+  fclose(file);
+  if (!ok) {
+    ALOGI("DeviceProfileStore: ignoring stale %s", path_.c_str());
+    return false;
+  }
+
+  has_profile_ = true;
+  profile_ = saved;
+  *profile = saved;
+  ALOGI("DeviceProfileStore: %d steps, solver %d, %d boxes, %.2f ms, "
+        "scale %.2f, tier %d, surface %d",
+        saved.physics_step_, saved.solver_tier_, saved.array_size_,
+        saved.frame_period_ns_ / 1e6f, saved.resolution_scale_,
+        saved.shading_tier_, saved.surface_format_);
+  return true;
+}
+
+void DeviceProfileStore::Update(const DeviceProfile& current,
+                                bool sustainable, float now) {
+  if (!sustainable) {
+    has_candidate_ = false;
+    return;
+  }
+  if (!has_candidate_ || !IsSameProfile(current, candidate_)) {
+    has_candidate_ = true;
+    candidate_ = current;
+    candidate_since_ = now;
+    return;
+  }
+  if (now - candidate_since_ < kSustainTime ||
+      (has_profile_ && IsSameProfile(candidate_, profile_))) {
+    return;
+  }
+  has_profile_ = true;
+  profile_ = candidate_;
+  Save();
+}
+
+bool DeviceProfileStore::Save() const {
+  ProfileHeader header;
+  header.magic_ = kProfileMagic;
+  header.version_ = kProfileVersion;
+  header.device_hash_ = GetDeviceHash();
+
+  std::string temp_path = path_ + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    ALOGW("DeviceProfileStore: cannot open %s", temp_path.c_str());
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(&profile_, sizeof(profile_), 1, file) == 1;
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(temp_path.c_str(), path_.c_str()) != 0) {
+    ALOGW("DeviceProfileStore: cannot write %s", path_.c_str());
+    remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
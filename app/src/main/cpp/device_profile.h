@@ -0,0 +1,76 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICE_PROFILE_H_
+#define DEVICE_PROFILE_H_
+
+#include <cstdint>
+#include <string>
+
+// A configuration of the demo's quality knobs.
+struct DeviceProfile {
+  int32_t physics_step_;
+  int32_t solver_tier_;
+  int32_t array_size_;
+  int64_t frame_period_ns_;
+  float resolution_scale_;
+  int32_t shading_tier_;
+  int32_t surface_format_;
+};
+
+/*
+ * Remembers the last configuration the device could sustain, so the next
+ * launch starts from it instead of the defaults and skips the throttling and
+ * recovery of the first minute.
+ *
+ * Update() is fed the current configuration every frame. A configuration
+ * becomes the profile once it was kept for kSustainTime without thermal
+ * pressure, and is then saved right away to a small binary file, which also
+ * records the device (GetDeviceHash()) and the file version: a profile copied
+ * from another device or an older build is ignored.
+ */
+class DeviceProfileStore {
+ public:
+  // How long a configuration must be kept to be recorded, in seconds.
+  static constexpr float kSustainTime = 30.f;
+
+  explicit DeviceProfileStore(const std::string& path);
+
+  // Read the saved profile. Returns false when there is none for this
+  // device.
+  bool Load(DeviceProfile* profile);
+
+  // Feed the current configuration, and whether the device keeps up with it
+  // right now. `now` is in seconds (see Clock()).
+  void Update(const DeviceProfile& current, bool sustainable, float now);
+
+  bool HasProfile() const { return has_profile_; }
+  const DeviceProfile& GetProfile() const { return profile_; }
+
+ private:
+  bool Save() const;
+
+  std::string path_;
+  bool has_profile_;
+  DeviceProfile profile_;
+
+  // The configuration being timed, and since when.
+  bool has_candidate_;
+  DeviceProfile candidate_;
+  float candidate_since_;
+};
+
+#endif  // DEVICE_PROFILE_H_
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dynamic_resolution.h"
+
+#include "gl_state_cache.h"
+#include "memory_tracker.h"
+#include "util.h"
+
+DynamicResolution::DynamicResolution()
+    : supported_(false),
+      enabled_(false),
+      multisampled_(false),
+      target_format_(kDefaultSurfaceFormat),
+      bytes_per_pixel_(0),
+      scale_(kMaxScale),
+      max_scale_(kMaxScale),
+      framebuffer_(0),
+      color_buffer_(0),
+      depth_buffer_(0),
+      width_(0),
+      height_(0),
+      render_width_(0),
+      render_height_(0),
+      blit_width_(0),
+      blit_height_(0) {}
+
+DynamicResolution::~DynamicResolution() { Unload(); }
+
+void DynamicResolution::Init() {
+  // GL_VERSION is "OpenGL ES <major>.<minor> <vendor specific info>".
+  const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  const char* prefix = "OpenGL ES ";
+  supported_ = version != nullptr &&
+               strncmp(version, prefix, strlen(prefix)) == 0 &&
+               atoi(version + strlen(prefix)) >= 3;
+  if (!supported_) {
+    ALOGI("DynamicResolution: needs OpenGL ES 3 (%s)",
+          version ? version : "unknown");
+  }
+}
+
+void DynamicResolution::Unload() {
+  if (framebuffer_) {
+    GLStateCache::GetInstance()->DeleteFramebuffer(framebuffer_);
+    framebuffer_ = 0;
+  }
+  if (color_buffer_) {
+    glDeleteRenderbuffers(1, &color_buffer_);
+    color_buffer_ = 0;
+  }
+  if (depth_buffer_) {
+    glDeleteRenderbuffers(1, &depth_buffer_);
+    depth_buffer_ = 0;
+  }
+  MemoryTracker::GetInstance()->Free(
+      MEMORY_CATEGORY_GL_RENDERBUFFERS,
+      static_cast<int64_t>(bytes_per_pixel_) * width_ * height_);
+  width_ = height_ = 0;
+}
+
+void DynamicResolution::SetSurfaceFormat(SurfaceFormat format) {
+  multisampled_ = GetSurfaceFormatSettings(format).samples_ > 0;
+}
+
+void DynamicResolution::SetScale(float scale) {
+  scale_ = Clamp(scale, kMinScale, max_scale_);
+}
+
+void DynamicResolution::SetMaxScale(float max_scale) {
+  max_scale_ = Clamp(max_scale, kMinScale, kMaxScale);
+  SetScale(scale_);
+}
+
+bool DynamicResolution::DecreaseScale() {
+  if (!IsEnabled() || scale_ <= kMinScale) {
+    return false;
+  }
+  SetScale(scale_ - kScaleStep);
+  return true;
+}
+
+bool DynamicResolution::IncreaseScale() {
+  if (!IsEnabled() || scale_ >= max_scale_) {
+    return false;
+  }
+  SetScale(scale_ + kScaleStep);
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Create the target at the surface size. Scaled frames use a part of it.
+//--------------------------------------------------------------------------------
+bool DynamicResolution::Allocate(int32_t width, int32_t height,
+                                 SurfaceFormat format) {
+  Unload();
+
+  const SurfaceFormatSettings settings = GetSurfaceFormatSettings(format);
+  glGenRenderbuffers(1, &color_buffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_buffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, settings.color_format_, width,
+                        height);
+  glGenRenderbuffers(1, &depth_buffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, settings.depth_format_, width,
+                        height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  GLStateCache* state = GLStateCache::GetInstance();
+  glGenFramebuffers(1, &framebuffer_);
+  state->BindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, color_buffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, depth_buffer_);
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  state->BindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    ALOGE("DynamicResolution: framebuffer incomplete (0x%x), disabled",
+          status);
+    Unload();
+    supported_ = false;
+    return false;
+  }
+
+  width_ = width;
+  height_ = height;
+  target_format_ = format;
+  bytes_per_pixel_ = settings.bytes_per_pixel_;
+  MemoryTracker::GetInstance()->Allocate(
+      MEMORY_CATEGORY_GL_RENDERBUFFERS,
+      static_cast<int64_t>(bytes_per_pixel_) * width_ * height_);
+  ALOGI("DynamicResolution: target %d x %d, %s", width_, height_,
+        kSurfaceFormatNames[target_format_]);
+  return true;
+}
+
+float DynamicResolution::UpdateFrameScale(int32_t surface_width,
+                                          int32_t surface_height) {
+  const float scale = IsEnabled() ? scale_ : kMaxScale;
+  render_width_ = surface_width;
+  render_height_ = surface_height;
+  if (scale < kMaxScale) {
+    render_width_ = Max(1, static_cast<int32_t>(surface_width * scale + 0.5f));
+    render_height_ =
+        Max(1, static_cast<int32_t>(surface_height * scale + 0.5f));
+  }
+  return scale;
+}
+
+bool DynamicResolution::BeginFrame(int32_t surface_width,
+                                   int32_t surface_height,
+                                   SurfaceFormat format, float scale) {
+  if (scale >= kMaxScale || !supported_) {
+    return false;
+  }
+  if ((surface_width != width_ || surface_height != height_ ||
+       format != target_format_) &&
+      !Allocate(surface_width, surface_height, format)) {
+    return false;
+  }
+
+  blit_width_ = Max(1, static_cast<int32_t>(surface_width * scale + 0.5f));
+  blit_height_ = Max(1, static_cast<int32_t>(surface_height * scale + 0.5f));
+  GLStateCache* state = GLStateCache::GetInstance();
+  state->BindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  state->Viewport(0, 0, blit_width_, blit_height_);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// The depth is not needed past the scene, so tell the driver not to store it.
+//--------------------------------------------------------------------------------
+void DynamicResolution::EndFrame() {
+  const GLenum depth_attachment = GL_DEPTH_ATTACHMENT;
+  glInvalidateFramebuffer(GL_FRAMEBUFFER, 1, &depth_attachment);
+
+  GLStateCache* state = GLStateCache::GetInstance();
+  state->BindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+  state->BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glBlitFramebuffer(0, 0, blit_width_, blit_height_, 0, 0, width_,
+                    height_, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  state->BindFramebuffer(GL_FRAMEBUFFER, 0);
+  state->Viewport(0, 0, width_, height_);
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DYNAMIC_RESOLUTION_H_
+#define DYNAMIC_RESOLUTION_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "common.h"
+#include "surface_format.h"
+
+/*
+ * Offscreen render target for dynamic resolution. The scene is drawn into the
+ * lower left `scale` part of a surface sized framebuffer, then upscaled to
+ * the surface with a linear blit. Changing the scale only changes the viewport
+ * and the blit rectangle, so it can change every frame without reallocating
+ * anything or reconfiguring the window (unlike
+ * NativeEngine::SwitchToPreferredDisplaySize()).
+ *
+ * Needs OpenGL ES 3 for glBlitFramebuffer(). Everything drawn after
+ * EndFrame(), e.g. the UI, stays at the surface resolution.
+ *
+ * The target follows the color and depth format of the surface. The blit
+ * can't write to a multisampled surface, so the mode is off with MSAA.
+ *
+ * The settings and the scale of each frame belong to the game thread, which
+ * records the frame (UpdateFrameScale()). BeginFrame() and EndFrame() draw it
+ * later on the GL thread (see RenderThread), so they take the scale and
+ * format it was recorded with.
+ */
+class DynamicResolution {
+ public:
+  static constexpr float kMinScale = 0.5f;
+  static constexpr float kMaxScale = 1.f;
+  static constexpr float kScaleStep = 0.125f;
+
+  DynamicResolution();
+  ~DynamicResolution();
+
+  // Check for OpenGL ES 3. Call when the context is (re)created.
+  void Init();
+
+  // Release the GL objects. Call before the context goes away.
+  void Unload();
+
+  bool IsSupported() const { return supported_.load(); }
+
+  void SetEnabled(bool enabled) { enabled_ = enabled; }
+  bool IsEnabled() const { return enabled_ && supported_ && !multisampled_; }
+
+  // Format of the window surface, the mode is off when it is multisampled.
+  void SetSurfaceFormat(SurfaceFormat format);
+
+  void SetScale(float scale);
+  float GetScale() const { return scale_; }
+
+  // Cap the scale, e.g. per game mode. Lowers the current scale if needed.
+  void SetMaxScale(float max_scale);
+
+  // Governor knobs: move the scale by kScaleStep. Return false when the scale
+  // is at its limit or the mode is off.
+  bool DecreaseScale();
+  bool IncreaseScale();
+
+  // Game thread: the scale of the next frame, and the size it is rendered at
+  // (see GetRenderWidth()). kMaxScale when it goes straight to the surface.
+  float UpdateFrameScale(int32_t surface_width, int32_t surface_height);
+
+  // Redirect rendering to the offscreen target, created in `format` if
+  // needed and cleared with the current clear color. Returns false when
+  // rendering goes straight to the surface: the scale is 1, or the target
+  // could not be created.
+  bool BeginFrame(int32_t surface_width, int32_t surface_height,
+                  SurfaceFormat format, float scale);
+
+  // Upscale the target to the surface and restore the surface viewport.
+  // Only call if BeginFrame() returned true.
+  void EndFrame();
+
+  // Size the scene is rendered at in the last UpdateFrameScale() frame.
+  int32_t GetRenderWidth() const { return render_width_; }
+  int32_t GetRenderHeight() const { return render_height_; }
+
+ private:
+  bool Allocate(int32_t width, int32_t height, SurfaceFormat format);
+
+  // Cleared on the GL thread when the target can't be created.
+  std::atomic<bool> supported_;
+  bool enabled_;
+  bool multisampled_;
+  // Format of the allocated target.
+  SurfaceFormat target_format_;
+  int32_t bytes_per_pixel_;
+  float scale_;
+  float max_scale_;
+
+  GLuint framebuffer_;
+  GLuint color_buffer_;
+  GLuint depth_buffer_;
+
+  // Allocated size of the target, the surface size.
+  int32_t width_;
+  int32_t height_;
+
+  int32_t render_width_;
+  int32_t render_height_;
+
+  // Part of the target drawn in the frame between BeginFrame() and
+  // EndFrame().
+  int32_t blit_width_;
+  int32_t blit_height_;
+};
+
+#endif  // DYNAMIC_RESOLUTION_H_
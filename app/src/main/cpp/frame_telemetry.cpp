@@ -0,0 +1,280 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_telemetry.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <cstdio>
+
+#include "common.h"
+#include "swappy/swappyGL_extra.h"
+
+namespace {
+const int64_t kIndexMask = FrameTelemetry::kCapacity - 1;
+
+const char* kPhaseNames[TELEMETRY_PHASE_COUNT] = {"physics", "ui",
+                                                  "box_submit", "swap"};
+
+float NanosToMillis(int64_t ns) { return static_cast<float>(ns) / 1e6f; }
+
+// Value at `percentile` (0..1) of the first `count` values; reorders them.
+float Percentile(float* values, int32_t count, float percentile) {
+  int32_t index = static_cast<int32_t>(percentile * (count - 1) + 0.5f);
+  std::nth_element(values, values + index, values + count);
+  return values[index];
+}
+}  // namespace
+
+FrameTelemetry* FrameTelemetry::GetInstance() {
+  static FrameTelemetry instance;
+  return &instance;
+}
+
+FrameTelemetry::FrameTelemetry()
+    : write_count_(0),
+      total_jank_frames_(0),
+      pending_gpu_ns_(0),
+      active_bodies_(0),
+      last_frame_ns_(0) {
+  for (auto& pending : pending_phase_ns_) {
+    pending = 0;
+  }
+  for (auto& pending : pending_gpu_query_ns_) {
+    pending = 0;
+  }
+}
+
+int64_t FrameTelemetry::GetNanos() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<int64_t>(t.tv_sec) * 1000000000LL + t.tv_nsec;
+}
+
+//--------------------------------------------------------------------------------
+// Swappy reports the GPU time of the previous frame once it waited for it.
+//--------------------------------------------------------------------------------
+void FrameTelemetry::AttachToSwappy() {
+  static SwappyTracer tracer = {};
+  tracer.postWait = FrameTelemetry::OnSwappyPostWait;
+  tracer.userData = this;
+  SwappyGL_injectTracer(&tracer);
+}
+
+void FrameTelemetry::OnSwappyPostWait(void* data, int64_t cpu_time_ns,
+                                      int64_t gpu_time_ns) {
+  FrameTelemetry* telemetry = reinterpret_cast<FrameTelemetry*>(data);
+  telemetry->pending_gpu_ns_ = gpu_time_ns;
+}
+
+void FrameTelemetry::AddPhaseTime(TelemetryPhase phase, int64_t duration_ns) {
+  pending_phase_ns_[phase].fetch_add(duration_ns, std::memory_order_relaxed);
+}
+
+void FrameTelemetry::SetGpuQueryTimes(int64_t frame_ns, int64_t boxes_ns,
+                                      int64_t ui_ns) {
+  pending_gpu_query_ns_[0] = frame_ns;
+  pending_gpu_query_ns_[1] = boxes_ns;
+  pending_gpu_query_ns_[2] = ui_ns;
+}
+
+void FrameTelemetry::SetActiveBodies(int32_t count) {
+  active_bodies_.store(count, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------
+// Commit the frame: write the slot first, then publish it with the counter.
+//--------------------------------------------------------------------------------
+void FrameTelemetry::EndFrame(int32_t thermal_status, float thermal_headroom,
+                              int64_t target_frame_time_ns) {
+  int64_t now = GetNanos();
+  int64_t count = write_count_.load(std::memory_order_relaxed);
+  FrameRecord& record = records_[count & kIndexMask];
+
+  record.timestamp_ns_ = now;
+  record.frame_time_ =
+      last_frame_ns_ != 0 ? NanosToMillis(now - last_frame_ns_) : 0.f;
+  record.target_frame_time_ = NanosToMillis(target_frame_time_ns);
+  for (auto i = 0; i < TELEMETRY_PHASE_COUNT; ++i) {
+    record.phase_time_[i] = NanosToMillis(
+        pending_phase_ns_[i].exchange(0, std::memory_order_relaxed));
+  }
+  record.gpu_time_ = NanosToMillis(pending_gpu_ns_.exchange(0));
+  record.gpu_query_time_ = NanosToMillis(pending_gpu_query_ns_[0]);
+  record.gpu_boxes_time_ = NanosToMillis(pending_gpu_query_ns_[1]);
+  record.gpu_ui_time_ = NanosToMillis(pending_gpu_query_ns_[2]);
+  for (auto& pending : pending_gpu_query_ns_) {
+    pending = 0;
+  }
+  record.thermal_headroom_ = thermal_headroom;
+  record.thermal_status_ = thermal_status;
+  record.active_bodies_ = active_bodies_.load(std::memory_order_relaxed);
+  last_frame_ns_ = now;
+
+  if (record.frame_time_ > record.target_frame_time_ * kJankFactor) {
+    total_jank_frames_.fetch_add(1, std::memory_order_relaxed);
+  }
+  write_count_.store(count + 1, std::memory_order_release);
+}
+
+//--------------------------------------------------------------------------------
+// Lock-free copy of the most recent records.
+//--------------------------------------------------------------------------------
+int32_t FrameTelemetry::GetRecords(FrameRecord* records, int32_t max_records) {
+  int64_t end = write_count_.load(std::memory_order_acquire);
+  int64_t count = std::min<int64_t>(std::min<int64_t>(end, kCapacity),
+                                    max_records);
+  int64_t begin = end - count;
+  for (int64_t i = 0; i < count; ++i) {
+    records[i] = records_[(begin + i) & kIndexMask];
+  }
+
+  // The writer may have lapped us while copying. The slot it is writing now
+  // belongs to index `after - kCapacity`, so everything from the next index
+  // on is intact.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  int64_t after = write_count_.load(std::memory_order_relaxed);
+  int64_t first_valid = std::max(begin, after - kCapacity + 1);
+  if (first_valid >= end) {
+    return 0;
+  }
+  int64_t dropped = first_valid - begin;
+  if (dropped > 0) {
+    std::copy(records + dropped, records + count, records);
+  }
+  return static_cast<int32_t>(count - dropped);
+}
+
+//--------------------------------------------------------------------------------
+// Percentiles of the frame time, phase averages and jank over the buffer.
+//--------------------------------------------------------------------------------
+void FrameTelemetry::GetStats(FrameStats* stats) {
+  *stats = {};
+  int32_t count = GetRecords(stats_records_, kCapacity);
+  stats->total_frames_ = write_count_.load(std::memory_order_relaxed);
+  stats->total_jank_frames_ =
+      total_jank_frames_.load(std::memory_order_relaxed);
+
+  // The very first frame has no frame time.
+  int32_t num_frames = 0;
+  float gpu_total = 0.f;
+  int32_t gpu_frames = 0;
+  int32_t gpu_query_frames = 0;
+  for (auto i = 0; i < count; ++i) {
+    const FrameRecord& record = stats_records_[i];
+    if (record.frame_time_ <= 0.f) {
+      continue;
+    }
+    stats_frame_times_[num_frames++] = record.frame_time_;
+    stats->frame_time_max_ = std::max(stats->frame_time_max_,
+                                      record.frame_time_);
+    for (auto phase = 0; phase < TELEMETRY_PHASE_COUNT; ++phase) {
+      stats->phase_time_average_[phase] += record.phase_time_[phase];
+    }
+    stats->active_bodies_average_ += record.active_bodies_;
+    if (record.gpu_query_time_ > 0.f) {
+      stats->gpu_query_time_average_ += record.gpu_query_time_;
+      stats->gpu_boxes_time_average_ += record.gpu_boxes_time_;
+      stats->gpu_ui_time_average_ += record.gpu_ui_time_;
+      ++gpu_query_frames;
+    }
+    if (record.gpu_time_ > 0.f) {
+      gpu_total += record.gpu_time_;
+      ++gpu_frames;
+    }
+    if (record.frame_time_ > record.target_frame_time_ * kJankFactor) {
+      ++stats->jank_frames_;
+    }
+  }
+
+  stats->num_frames_ = num_frames;
+  if (num_frames == 0) {
+    return;
+  }
+  for (auto phase = 0; phase < TELEMETRY_PHASE_COUNT; ++phase) {
+    stats->phase_time_average_[phase] /= num_frames;
+  }
+  stats->active_bodies_average_ /= num_frames;
+  stats->gpu_time_average_ = gpu_frames ? gpu_total / gpu_frames : 0.f;
+  if (gpu_query_frames > 0) {
+    stats->gpu_query_time_average_ /= gpu_query_frames;
+    stats->gpu_boxes_time_average_ /= gpu_query_frames;
+    stats->gpu_ui_time_average_ /= gpu_query_frames;
+  }
+  stats->frame_time_p50_ = Percentile(stats_frame_times_, num_frames, 0.5f);
+  stats->frame_time_p90_ = Percentile(stats_frame_times_, num_frames, 0.9f);
+  stats->frame_time_p99_ = Percentile(stats_frame_times_, num_frames, 0.99f);
+}
+
+//--------------------------------------------------------------------------------
+// Dump API.
+//--------------------------------------------------------------------------------
+bool FrameTelemetry::DumpToFile(const char* path) {
+  FILE* file = fopen(path, "w");
+  if (file == nullptr) {
+    ALOGE("FrameTelemetry: cannot open %s", path);
+    return false;
+  }
+
+  fprintf(file, "timestamp_ns,frame_ms,target_ms");
+  for (auto phase = 0; phase < TELEMETRY_PHASE_COUNT; ++phase) {
+    fprintf(file, ",%s_ms", kPhaseNames[phase]);
+  }
+  fprintf(file,
+          ",gpu_ms,gpu_query_ms,gpu_boxes_ms,gpu_ui_ms,thermal_status,"
+          "thermal_headroom,active_bodies\n");
+
+  int32_t count = GetRecords(stats_records_, kCapacity);
+  for (auto i = 0; i < count; ++i) {
+    const FrameRecord& record = stats_records_[i];
+    fprintf(file, "%lld,%.3f,%.3f",
+            static_cast<long long>(record.timestamp_ns_), record.frame_time_,
+            record.target_frame_time_);
+    for (auto phase = 0; phase < TELEMETRY_PHASE_COUNT; ++phase) {
+      fprintf(file, ",%.3f", record.phase_time_[phase]);
+    }
+    fprintf(file, ",%.3f,%.3f,%.3f,%.3f,%d,%.3f,%d\n", record.gpu_time_,
+            record.gpu_query_time_, record.gpu_boxes_time_,
+            record.gpu_ui_time_, record.thermal_status_,
+            record.thermal_headroom_, record.active_bodies_);
+  }
+
+  bool ok = ferror(file) == 0;
+  ok = fclose(file) == 0 && ok;
+  ALOGI("FrameTelemetry: dumped %d frames to %s", count, path);
+  return ok;
+}
+
+void FrameTelemetry::LogSummary() {
+  FrameStats stats;
+  GetStats(&stats);
+  ALOGI(
+      "FrameTelemetry: %d frames, P50 %.2f P90 %.2f P99 %.2f max %.2f ms, "
+      "jank %d (total %lld/%lld), physics %.2f ui %.2f boxes %.2f swap %.2f "
+      "gpu %.2f ms (queries %.2f, boxes %.2f, ui %.2f), %.0f active bodies",
+      stats.num_frames_, stats.frame_time_p50_, stats.frame_time_p90_,
+      stats.frame_time_p99_, stats.frame_time_max_, stats.jank_frames_,
+      static_cast<long long>(stats.total_jank_frames_),
+      static_cast<long long>(stats.total_frames_),
+      stats.phase_time_average_[TELEMETRY_PHASE_PHYSICS],
+      stats.phase_time_average_[TELEMETRY_PHASE_UI],
+      stats.phase_time_average_[TELEMETRY_PHASE_BOX_SUBMIT],
+      stats.phase_time_average_[TELEMETRY_PHASE_SWAP],
+      stats.gpu_time_average_, stats.gpu_query_time_average_,
+      stats.gpu_boxes_time_average_, stats.gpu_ui_time_average_,
+      stats.active_bodies_average_);
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FRAME_TELEMETRY_H_
+#define FRAME_TELEMETRY_H_
+
+#include <atomic>
+#include <cstdint>
+
+// CPU phases of a frame tracked by the telemetry.
+enum TelemetryPhase {
+  TELEMETRY_PHASE_PHYSICS = 0,  // simulation thread, summed over the frame
+  TELEMETRY_PHASE_UI,
+  TELEMETRY_PHASE_BOX_SUBMIT,
+  TELEMETRY_PHASE_SWAP,  // render thread, the frame drawn meanwhile
+  TELEMETRY_PHASE_COUNT
+};
+
+// Everything recorded about a single frame. Times are in milliseconds.
+struct FrameRecord {
+  int64_t timestamp_ns_;
+  float frame_time_;
+  float target_frame_time_;
+  float phase_time_[TELEMETRY_PHASE_COUNT];
+  float gpu_time_;  // as reported by Swappy, 0 when unknown
+  // From the GPU timer queries of an earlier frame, 0 when unknown.
+  float gpu_query_time_;
+  float gpu_boxes_time_;
+  float gpu_ui_time_;
+  float thermal_headroom_;
+  int32_t thermal_status_;
+  int32_t active_bodies_;  // awake rigid bodies at the end of the frame
+};
+
+// Rolling statistics over the frames in the telemetry buffer.
+struct FrameStats {
+  int32_t num_frames_;
+  float frame_time_p50_;
+  float frame_time_p90_;
+  float frame_time_p99_;
+  float frame_time_max_;
+  float phase_time_average_[TELEMETRY_PHASE_COUNT];
+  float gpu_time_average_;
+  float gpu_query_time_average_;
+  float gpu_boxes_time_average_;
+  float gpu_ui_time_average_;
+  float active_bodies_average_;
+
+  // Frames over kJankFactor * target frame time, in the window and overall.
+  int32_t jank_frames_;
+  int64_t total_jank_frames_;
+  int64_t total_frames_;
+};
+
+/*
+ * FrameTelemetry records per-frame timing into a fixed size ring buffer.
+ *
+ * The game thread is the only writer: phases are timed with
+ * TelemetryScope (or AddPhaseTime() from other threads, e.g. the simulation
+ * thread), and EndFrame() commits the frame. Readers on any thread take a
+ * consistent copy without locking: a record that was overwritten while it was
+ * copied is detected through the write counter and dropped.
+ */
+class FrameTelemetry {
+ public:
+  // # of frames kept, a power of two. ~8.5 sec at 60 fps.
+  static constexpr int32_t kCapacity = 512;
+
+  // A frame is janky when it takes longer than this many target frames.
+  static constexpr float kJankFactor = 1.5f;
+
+  static FrameTelemetry* GetInstance();
+
+  // Register the Swappy tracer that reports the GPU time of each frame.
+  // Call once after SwappyGL_init().
+  void AttachToSwappy();
+
+  // Add time to a phase of the current frame. Thread safe.
+  void AddPhaseTime(TelemetryPhase phase, int64_t duration_ns);
+
+  // Set the GPU times measured by timer queries, recorded with the current
+  // frame. Game thread only.
+  void SetGpuQueryTimes(int64_t frame_ns, int64_t boxes_ns, int64_t ui_ns);
+
+  // Set the # of awake rigid bodies, recorded with the next frame. Thread
+  // safe.
+  void SetActiveBodies(int32_t count);
+
+  // Commit the current frame. Game thread only.
+  void EndFrame(int32_t thermal_status, float thermal_headroom,
+                int64_t target_frame_time_ns);
+
+  // Compute the statistics over the buffered frames. Uses internal scratch
+  // buffers, so don't call it (or DumpToFile()) from two threads at once.
+  void GetStats(FrameStats* stats);
+
+  // Copy up to `max_records` of the most recent records, oldest first.
+  // Returns the number of records copied.
+  int32_t GetRecords(FrameRecord* records, int32_t max_records);
+
+  // Write the buffered records as CSV. Returns false on I/O errors.
+  bool DumpToFile(const char* path);
+
+  // Log a one line summary of GetStats().
+  void LogSummary();
+
+  static int64_t GetNanos();
+
+ private:
+  FrameTelemetry();
+  FrameTelemetry(const FrameTelemetry&) = delete;
+  FrameTelemetry& operator=(const FrameTelemetry&) = delete;
+
+  static void OnSwappyPostWait(void* data, int64_t cpu_time_ns,
+                               int64_t gpu_time_ns);
+
+  FrameRecord records_[kCapacity];
+  std::atomic<int64_t> write_count_;
+  std::atomic<int64_t> total_jank_frames_;
+
+  // Accumulated for the frame in progress.
+  std::atomic<int64_t> pending_phase_ns_[TELEMETRY_PHASE_COUNT];
+  std::atomic<int64_t> pending_gpu_ns_;
+  int64_t pending_gpu_query_ns_[3];  // frame, boxes, ui
+  std::atomic<int32_t> active_bodies_;
+  int64_t last_frame_ns_;
+
+  // Scratch buffers of GetStats() and DumpToFile().
+  FrameRecord stats_records_[kCapacity];
+  float stats_frame_times_[kCapacity];
+};
+
+// Adds the lifetime of the scope to a telemetry phase.
+class TelemetryScope {
+ public:
+  explicit TelemetryScope(TelemetryPhase phase)
+      : phase_(phase), start_ns_(FrameTelemetry::GetNanos()) {}
+  ~TelemetryScope() {
+    FrameTelemetry::GetInstance()->AddPhaseTime(
+        phase_, FrameTelemetry::GetNanos() - start_ns_);
+  }
+
+ private:
+  TelemetryPhase phase_;
+  int64_t start_ns_;
+};
+
+#endif  // FRAME_TELEMETRY_H_
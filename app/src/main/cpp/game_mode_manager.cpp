@@ -0,0 +1,186 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "game_mode_manager.h"
+
+#include <android/api-level.h>
+
+#include "JNIHelper.h"
+#include "common.h"
+
+namespace {
+// API levels that introduced GameManager.getGameMode() and setGameState().
+const int32_t kApiLevelGameMode = 31;
+const int32_t kApiLevelGameState = 33;
+
+// android.app.GameState.MODE_GAMEPLAY_INTERRUPTIBLE
+const jint kGameStateModeGameplayInterruptible = 2;
+}  // namespace
+
+GameModeManager* GameModeManager::GetInstance() {
+  static GameModeManager instance;
+  return &instance;
+}
+
+GameModeManager::GameModeManager()
+    : app_(nullptr),
+      game_manager_(nullptr),
+      game_mode_(GAME_MODE_UNSUPPORTED) {}
+
+GameModeManager::~GameModeManager() { Shutdown(); }
+
+//--------------------------------------------------------------------------------
+// Retrieve android.app.GameManager through JNI.
+//--------------------------------------------------------------------------------
+void GameModeManager::Initialize(android_app* app) {
+  if (game_manager_ != nullptr) {
+    return;
+  }
+  app_ = app;
+  if (android_get_device_api_level() < kApiLevelGameMode) {
+    ALOGW("GameModeManager: GameManager is not available on this device.");
+    return;
+  }
+
+  ndk_helper::JNIHelper* helper = ndk_helper::JNIHelper::GetInstance();
+  JNIEnv* env = helper->AttachCurrentThread();
+  jstring service_name = env->NewStringUTF("game");
+  jobject game_manager = helper->CallObjectMethod(
+      app_->activity->javaGameActivity, "getSystemService",
+      "(Ljava/lang/String;)Ljava/lang/Object;", service_name);
+  env->DeleteLocalRef(service_name);
+  if (game_manager == nullptr) {
+    ALOGW("GameModeManager: failed to retrieve GameManager.");
+    return;
+  }
+
+  game_manager_ = env->NewGlobalRef(game_manager);
+  env->DeleteLocalRef(game_manager);
+  Refresh();
+}
+
+void GameModeManager::Shutdown() {
+  if (game_manager_ != nullptr) {
+    ndk_helper::JNIHelper::GetInstance()->DeleteObject(game_manager_);
+    game_manager_ = nullptr;
+  }
+}
+
+int32_t GameModeManager::Refresh() {
+  if (game_manager_ == nullptr) {
+    return game_mode_;
+  }
+  int32_t game_mode = ndk_helper::JNIHelper::GetInstance()->CallIntMethod(
+      game_manager_, "getGameMode", "()I");
+  if (game_mode != game_mode_.exchange(game_mode)) {
+    ALOGI("GameModeManager: game mode %s", GetGameModeName(game_mode));
+  }
+  return game_mode;
+}
+
+//--------------------------------------------------------------------------------
+// Performance lifts the frame rate cap, battery trades content and resolution
+// for power. Custom is treated as standard.
+//--------------------------------------------------------------------------------
+GameModeBudget GameModeManager::GetBudget(int32_t game_mode) {
+  GameModeBudget budget;
+  switch (game_mode) {
+    case GAME_MODE_PERFORMANCE:
+      budget.max_physics_step_ = 24;
+      budget.max_array_size_ = 12;
+      budget.max_frame_rate_ = 120;
+      budget.max_resolution_scale_ = 1.f;
+      break;
+    case GAME_MODE_BATTERY:
+      budget.max_physics_step_ = 16;
+      budget.max_array_size_ = 8;
+      budget.max_frame_rate_ = 30;
+      budget.max_resolution_scale_ = 0.75f;
+      break;
+    default:
+      budget.max_physics_step_ = 24;
+      budget.max_array_size_ = 12;
+      budget.max_frame_rate_ = 60;
+      budget.max_resolution_scale_ = 1.f;
+      break;
+  }
+  return budget;
+}
+
+const char* GameModeManager::GetGameModeName(int32_t game_mode) {
+  switch (game_mode) {
+    case GAME_MODE_STANDARD:
+      return "Standard";
+    case GAME_MODE_PERFORMANCE:
+      return "Performance";
+    case GAME_MODE_BATTERY:
+      return "Battery";
+    case GAME_MODE_CUSTOM:
+      return "Custom";
+    default:
+      return "Unsupported";
+  }
+}
+
+//--------------------------------------------------------------------------------
+// GameManager.setGameState(new GameState(is_loading, MODE_GAMEPLAY_...)).
+// Through the JavaVM rather than JNIHelper, which leaves the threads it
+// attaches attached: a thread attached here is detached before returning, as
+// the VM aborts when a thread exits attached.
+//--------------------------------------------------------------------------------
+void GameModeManager::SetGameState(bool is_loading) {
+  if (game_manager_ == nullptr ||
+      android_get_device_api_level() < kApiLevelGameState) {
+    return;
+  }
+
+  JavaVM* vm = app_->activity->vm;
+  JNIEnv* env = nullptr;
+  bool attached = false;
+  if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
+    if (vm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+      ALOGW("GameModeManager: failed to attach to the VM.");
+      return;
+    }
+    attached = true;
+  }
+
+  jclass game_state_class = env->FindClass("android/app/GameState");
+  if (game_state_class != nullptr) {
+    jmethodID constructor =
+        env->GetMethodID(game_state_class, "<init>", "(ZI)V");
+    jobject game_state =
+        env->NewObject(game_state_class, constructor,
+                       static_cast<jboolean>(is_loading),
+                       kGameStateModeGameplayInterruptible);
+    jclass game_manager_class = env->GetObjectClass(game_manager_);
+    jmethodID set_game_state = env->GetMethodID(
+        game_manager_class, "setGameState", "(Landroid/app/GameState;)V");
+    if (set_game_state != nullptr) {
+      env->CallVoidMethod(game_manager_, set_game_state, game_state);
+    }
+    env->DeleteLocalRef(game_manager_class);
+    env->DeleteLocalRef(game_state);
+    env->DeleteLocalRef(game_state_class);
+  }
+  if (env->ExceptionCheck()) {
+    env->ExceptionClear();
+  }
+
+  if (attached) {
+    vm->DetachCurrentThread();
+  }
+}
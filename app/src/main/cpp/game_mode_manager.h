@@ -0,0 +1,94 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GAME_MODE_MANAGER_H_
+#define GAME_MODE_MANAGER_H_
+
+#include <jni.h>
+
+#include <atomic>
+#include <cstdint>
+
+struct android_app;
+
+// Same values as the android.app.GameManager.GAME_MODE_* constants.
+enum GameMode {
+  GAME_MODE_UNSUPPORTED = 0,
+  GAME_MODE_STANDARD = 1,
+  GAME_MODE_PERFORMANCE = 2,
+  GAME_MODE_BATTERY = 3,
+  GAME_MODE_CUSTOM = 4
+};
+
+// Upper bounds of the content load for a game mode. The governor and the
+// frame rate controller move freely below them.
+struct GameModeBudget {
+  int32_t max_physics_step_;
+  int32_t max_array_size_;
+  int32_t max_frame_rate_;
+  float max_resolution_scale_;
+};
+
+/*
+ * GameModeManager reads the game mode the user picked in the Game Dashboard
+ * through android.app.GameManager and maps it to a GameModeBudget. It also
+ * reports loading phases with GameManager.setGameState(), so the system can
+ * boost the CPU while the game loads.
+ *
+ * GameManager has no mode change listener: the mode is re-read with Refresh()
+ * when the game comes back to the foreground, which it does right after the
+ * user changed the mode in the dashboard.
+ */
+class GameModeManager {
+ public:
+  static GameModeManager* GetInstance();
+
+  // Retrieve GameManager. JNIHelper must be initialized first.
+  void Initialize(android_app* app);
+
+  // Release the GameManager reference.
+  void Shutdown();
+
+  // Re-read the game mode. Returns the current mode.
+  int32_t Refresh();
+
+  int32_t GetGameMode() const { return game_mode_.load(); }
+
+  // Budget of the current mode.
+  GameModeBudget GetBudget() const { return GetBudget(GetGameMode()); }
+  static GameModeBudget GetBudget(int32_t game_mode);
+
+  static const char* GetGameModeName(int32_t game_mode);
+
+  // Tell the system whether the game is loading. Can be called from any
+  // thread; a thread that isn't attached to the VM is for the call only.
+  void SetGameState(bool is_loading);
+
+ private:
+  GameModeManager();
+  ~GameModeManager();
+  GameModeManager(const GameModeManager&) = delete;
+  GameModeManager& operator=(const GameModeManager&) = delete;
+
+  android_app* app_;
+
+  // Global ref to android.app.GameManager, nullptr when not available.
+  jobject game_manager_;
+
+  std::atomic<int32_t> game_mode_;
+};
+
+#endif  // GAME_MODE_MANAGER_H_
@@ -0,0 +1,267 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gl_state_cache.h"
+
+#include <cstdlib>
+#include <cstring>
+
+GLStateCache* GLStateCache::GetInstance() {
+  static GLStateCache instance;
+  return &instance;
+}
+
+GLStateCache::GLStateCache()
+    : vertex_array_api_(VAO_API_NONE),
+      gen_vertex_arrays_(nullptr),
+      bind_vertex_array_(nullptr),
+      delete_vertex_arrays_(nullptr),
+      skipped_count_(0) {
+  Invalidate();
+}
+
+//--------------------------------------------------------------------------------
+// An OpenGL ES 3 context has the core entry points, an OpenGL ES 2 one may
+// have the extension.
+//--------------------------------------------------------------------------------
+void GLStateCache::Initialize() {
+  // GL_VERSION is "OpenGL ES <major>.<minor> <vendor specific info>".
+  const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  const char* prefix = "OpenGL ES ";
+  const char* extensions =
+      reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+  vertex_array_api_ = VAO_API_NONE;
+  if (version != nullptr && strncmp(version, prefix, strlen(prefix)) == 0 &&
+      atoi(version + strlen(prefix)) >= 3) {
+    vertex_array_api_ = VAO_API_CORE;
+  } else if (extensions != nullptr &&
+             strstr(extensions, "GL_OES_vertex_array_object") != nullptr) {
+    gen_vertex_arrays_ = reinterpret_cast<PFNGLGENVERTEXARRAYSOESPROC>(
+        eglGetProcAddress("glGenVertexArraysOES"));
+    bind_vertex_array_ = reinterpret_cast<PFNGLBINDVERTEXARRAYOESPROC>(
+        eglGetProcAddress("glBindVertexArrayOES"));
+    delete_vertex_arrays_ = reinterpret_cast<PFNGLDELETEVERTEXARRAYSOESPROC>(
+        eglGetProcAddress("glDeleteVertexArraysOES"));
+    if (gen_vertex_arrays_ != nullptr && bind_vertex_array_ != nullptr &&
+        delete_vertex_arrays_ != nullptr) {
+      vertex_array_api_ = VAO_API_OES;
+    }
+  }
+  if (vertex_array_api_ == VAO_API_NONE) {
+    ALOGI("GLStateCache: vertex array objects not supported");
+  }
+  skipped_count_ = 0;
+  Invalidate();
+}
+
+void GLStateCache::Invalidate() {
+  program_ = kUnknown;
+  array_buffer_ = kUnknown;
+  element_array_buffer_ = kUnknown;
+  copy_write_buffer_ = kUnknown;
+  vertex_array_ = kUnknown;
+  draw_framebuffer_ = kUnknown;
+  read_framebuffer_ = kUnknown;
+  for (auto& state : capabilities_) {
+    state = STATE_UNKNOWN;
+  }
+  viewport_valid_ = false;
+}
+
+void GLStateCache::UseProgram(GLuint program) {
+  if (program == program_) {
+    ++skipped_count_;
+    return;
+  }
+  glUseProgram(program);
+  program_ = program;
+}
+
+GLuint* GLStateCache::GetBufferBinding(GLenum target) {
+  switch (target) {
+    case GL_ARRAY_BUFFER:
+      return &array_buffer_;
+    case GL_ELEMENT_ARRAY_BUFFER:
+      return &element_array_buffer_;
+    case GL_COPY_WRITE_BUFFER:
+      return &copy_write_buffer_;
+    default:
+      return nullptr;
+  }
+}
+
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer) {
+  GLuint* binding = GetBufferBinding(target);
+  bool cached = binding != nullptr &&
+                (target != GL_ELEMENT_ARRAY_BUFFER ||
+                 (vertex_array_ != 0 && vertex_array_ != kUnknown));
+  if (cached && *binding == buffer) {
+    ++skipped_count_;
+    return;
+  }
+  glBindBuffer(target, buffer);
+  if (binding != nullptr) {
+    *binding = buffer;
+  }
+}
+
+void GLStateCache::BindFramebuffer(GLenum target, GLuint framebuffer) {
+  bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+  bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+  if ((!draw || draw_framebuffer_ == framebuffer) &&
+      (!read || read_framebuffer_ == framebuffer)) {
+    ++skipped_count_;
+    return;
+  }
+  glBindFramebuffer(target, framebuffer);
+  if (draw) {
+    draw_framebuffer_ = framebuffer;
+  }
+  if (read) {
+    read_framebuffer_ = framebuffer;
+  }
+}
+
+void GLStateCache::Enable(GLenum capability) {
+  SetCapability(capability, true);
+}
+
+void GLStateCache::Disable(GLenum capability) {
+  SetCapability(capability, false);
+}
+
+void GLStateCache::SetCapability(GLenum capability, bool enabled) {
+  CapabilityState* state = nullptr;
+  switch (capability) {
+    case GL_DEPTH_TEST:
+      state = &capabilities_[CAPABILITY_DEPTH_TEST];
+      break;
+    case GL_BLEND:
+      state = &capabilities_[CAPABILITY_BLEND];
+      break;
+    case GL_CULL_FACE:
+      state = &capabilities_[CAPABILITY_CULL_FACE];
+      break;
+    case GL_SCISSOR_TEST:
+      state = &capabilities_[CAPABILITY_SCISSOR_TEST];
+      break;
+    default:
+      break;
+  }
+  CapabilityState requested = enabled ? STATE_ENABLED : STATE_DISABLED;
+  if (state != nullptr && *state == requested) {
+    ++skipped_count_;
+    return;
+  }
+  if (enabled) {
+    glEnable(capability);
+  } else {
+    glDisable(capability);
+  }
+  if (state != nullptr) {
+    *state = requested;
+  }
+}
+
+void GLStateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+  if (viewport_valid_ && viewport_[0] == x && viewport_[1] == y &&
+      viewport_[2] == width && viewport_[3] == height) {
+    ++skipped_count_;
+    return;
+  }
+  glViewport(x, y, width, height);
+  viewport_[0] = x;
+  viewport_[1] = y;
+  viewport_[2] = width;
+  viewport_[3] = height;
+  viewport_valid_ = true;
+}
+
+GLuint GLStateCache::CreateVertexArray() {
+  GLuint vertex_array = 0;
+  if (vertex_array_api_ == VAO_API_CORE) {
+    glGenVertexArrays(1, &vertex_array);
+  } else if (vertex_array_api_ == VAO_API_OES) {
+    gen_vertex_arrays_(1, &vertex_array);
+  }
+  return vertex_array;
+}
+
+//--------------------------------------------------------------------------------
+// The element array buffer binding is part of the vertex array object.
+//--------------------------------------------------------------------------------
+void GLStateCache::BindVertexArray(GLuint vertex_array) {
+  if (vertex_array_api_ == VAO_API_NONE) {
+    return;
+  }
+  if (vertex_array == vertex_array_) {
+    ++skipped_count_;
+    return;
+  }
+  if (vertex_array_api_ == VAO_API_CORE) {
+    glBindVertexArray(vertex_array);
+  } else {
+    bind_vertex_array_(vertex_array);
+  }
+  vertex_array_ = vertex_array;
+  element_array_buffer_ = kUnknown;
+}
+
+//--------------------------------------------------------------------------------
+// A deleted program stays in use until another one is, but its name may be
+// handed out again right away.
+//--------------------------------------------------------------------------------
+void GLStateCache::DeleteProgram(GLuint program) {
+  glDeleteProgram(program);
+  if (program_ == program) {
+    program_ = kUnknown;
+  }
+}
+
+void GLStateCache::DeleteBuffer(GLuint buffer) {
+  glDeleteBuffers(1, &buffer);
+  GLuint* bindings[] = {&array_buffer_, &element_array_buffer_,
+                        &copy_write_buffer_};
+  for (auto binding : bindings) {
+    if (*binding == buffer) {
+      *binding = 0;
+    }
+  }
+}
+
+void GLStateCache::DeleteVertexArray(GLuint vertex_array) {
+  if (vertex_array_api_ == VAO_API_CORE) {
+    glDeleteVertexArrays(1, &vertex_array);
+  } else if (vertex_array_api_ == VAO_API_OES) {
+    delete_vertex_arrays_(1, &vertex_array);
+  } else {
+    return;
+  }
+  if (vertex_array_ == vertex_array) {
+    vertex_array_ = 0;
+    element_array_buffer_ = kUnknown;
+  }
+}
+
+void GLStateCache::DeleteFramebuffer(GLuint framebuffer) {
+  glDeleteFramebuffers(1, &framebuffer);
+  if (draw_framebuffer_ == framebuffer) {
+    draw_framebuffer_ = 0;
+  }
+  if (read_framebuffer_ == framebuffer) {
+    read_framebuffer_ = 0;
+  }
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GL_STATE_CACHE_H_
+#define GL_STATE_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+
+// After GLES3/gl3.h, for the GL types.
+#include "common.h"
+#include <GLES2/gl2ext.h>
+
+/*
+ * Shadow copy of the GL state the renderers set every frame. Binds, enables
+ * and viewports that go through the cache skip the driver call when the
+ * state already has the requested value.
+ *
+ * The cache must see every change of the state it tracks. Code that sets it
+ * directly has to restore it, as the Dear ImGui backend does, or be followed
+ * by Invalidate(). The element array buffer is only cached while a vertex
+ * array object is bound: on the default one, Dear ImGui binds its own.
+ *
+ * Vertex array objects are core in OpenGL ES 3.0, and are taken from
+ * GL_OES_vertex_array_object on OpenGL ES 2.0 when it is exposed.
+ *
+ * GL thread only, but for GetSkippedCount(), which the UI reads.
+ */
+class GLStateCache {
+ public:
+  static GLStateCache* GetInstance();
+
+  // Call when a context is made current: detects the vertex array object
+  // support and forgets the state.
+  void Initialize();
+
+  // Forget the state, the next call for each of it goes to GL.
+  void Invalidate();
+
+  void UseProgram(GLuint program);
+
+  // GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER and GL_COPY_WRITE_BUFFER are
+  // cached, other targets go straight to GL.
+  void BindBuffer(GLenum target, GLuint buffer);
+
+  // GL_FRAMEBUFFER binds both the draw and the read framebuffer.
+  void BindFramebuffer(GLenum target, GLuint framebuffer);
+
+  // GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE and GL_SCISSOR_TEST are cached,
+  // other capabilities go straight to GL.
+  void Enable(GLenum capability);
+  void Disable(GLenum capability);
+
+  void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+  // Vertex array objects. CreateVertexArray() returns 0 when they are not
+  // supported.
+  bool HasVertexArrays() const { return vertex_array_api_ != VAO_API_NONE; }
+  GLuint CreateVertexArray();
+  void BindVertexArray(GLuint vertex_array);
+
+  // Delete an object, and drop the bindings GL drops with it.
+  void DeleteProgram(GLuint program);
+  void DeleteBuffer(GLuint buffer);
+  void DeleteVertexArray(GLuint vertex_array);
+  void DeleteFramebuffer(GLuint framebuffer);
+
+  // # of calls skipped since Initialize().
+  int64_t GetSkippedCount() const { return skipped_count_.load(); }
+
+ private:
+  enum VertexArrayApi { VAO_API_NONE, VAO_API_CORE, VAO_API_OES };
+  enum Capability {
+    CAPABILITY_DEPTH_TEST,
+    CAPABILITY_BLEND,
+    CAPABILITY_CULL_FACE,
+    CAPABILITY_SCISSOR_TEST,
+    CAPABILITY_COUNT
+  };
+  enum CapabilityState { STATE_UNKNOWN, STATE_DISABLED, STATE_ENABLED };
+
+  // Never a valid GL name.
+  static constexpr GLuint kUnknown = ~0u;
+
+  GLStateCache();
+  void SetCapability(GLenum capability, bool enabled);
+  GLuint* GetBufferBinding(GLenum target);
+
+  VertexArrayApi vertex_array_api_;
+  PFNGLGENVERTEXARRAYSOESPROC gen_vertex_arrays_;
+  PFNGLBINDVERTEXARRAYOESPROC bind_vertex_array_;
+  PFNGLDELETEVERTEXARRAYSOESPROC delete_vertex_arrays_;
+
+  GLuint program_;
+  GLuint array_buffer_;
+  GLuint element_array_buffer_;
+  GLuint copy_write_buffer_;
+  GLuint vertex_array_;
+  GLuint draw_framebuffer_;
+  GLuint read_framebuffer_;
+  CapabilityState capabilities_[CAPABILITY_COUNT];
+  bool viewport_valid_;
+  GLint viewport_[4];
+  std::atomic<int64_t> skipped_count_;
+};
+
+#endif  // GL_STATE_CACHE_H_
@@ -0,0 +1,259 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gpu_physics.h"
+
+#include <GLES3/gl31.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "Shader.h"
+#include "Trace.h"
+#include "box_renderer.h"
+#include "gl_state_cache.h"
+#include "memory_tracker.h"
+#include "program_cache.h"
+
+namespace {
+const char* const kStepShader = "Shaders/CS_BoxStep.csh";
+
+const float kGravity = -10.f;
+
+const float kTwoPi = 2.f * static_cast<float>(M_PI);
+
+// The pass writes BOX_INSTANCE as a mat4 and a vec4.
+static_assert(sizeof(BOX_INSTANCE) == 20 * sizeof(float),
+              "CS_BoxStep.csh writes 80 byte instances");
+}  // namespace
+
+const char* const kPhysicsBackendNames[PHYSICS_BACKEND_COUNT] = {"Bullet",
+                                                                 "GPU"};
+
+GpuPhysics::GpuPhysics()
+    : program_(0),
+      count_location_(-1),
+      step_location_(-1),
+      gravity_location_(-1),
+      ground_height_location_(-1),
+      ground_half_size_location_(-1),
+      body_buffers_{0, 0},
+      current_buffer_(0),
+      instance_buffer_(0),
+      count_(0),
+      ground_height_(0.f),
+      ground_half_size_(0.f) {}
+
+GpuPhysics::~GpuPhysics() { Unload(); }
+
+std::vector<AssetFuture> GpuPhysics::LoadShaderAssets() {
+  return {AssetLoader::GetInstance()->Load(kStepShader)};
+}
+
+void GpuPhysics::Init() {
+  // GL_VERSION is "OpenGL ES <major>.<minor> <vendor specific info>".
+  const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+  const char* prefix = "OpenGL ES ";
+  int major = 0;
+  int minor = 0;
+  if (version == nullptr || strncmp(version, prefix, strlen(prefix)) != 0 ||
+      sscanf(version + strlen(prefix), "%d.%d", &major, &minor) != 2 ||
+      major * 10 + minor < 31) {
+    ALOGI("GpuPhysics: needs OpenGL ES 3.1 (%s)",
+          version ? version : "unknown");
+    return;
+  }
+  if (!LoadProgram()) {
+    ALOGW("GpuPhysics: failed to build %s", kStepShader);
+  }
+}
+
+void GpuPhysics::Unload() {
+  ReleaseBuffers();
+  if (program_) {
+    GLStateCache::GetInstance()->DeleteProgram(program_);
+    program_ = 0;
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Same as BoxRenderer::LoadShaders(), for a compute program: from the program
+// binary cache when it has it.
+//--------------------------------------------------------------------------------
+bool GpuPhysics::LoadProgram() {
+  std::shared_ptr<const AssetBuffer> asset =
+      AssetLoader::GetInstance()->Load(kStepShader).get();
+  if (asset == nullptr) {
+    return false;
+  }
+  std::vector<uint8_t> source(asset->GetData(),
+                              asset->GetData() + asset->GetSize());
+  ProgramCache* cache = ProgramCache::GetInstance();
+  const uint64_t source_hash =
+      ProgramCache::HashSources(source, std::vector<uint8_t>());
+
+  GLuint program = cache->LoadProgram(source_hash);
+  if (!program) {
+    GLuint shader;
+    if (!ndk_helper::shader::CompileShader(&shader, GL_COMPUTE_SHADER,
+                                           source)) {
+      return false;
+    }
+    program = glCreateProgram();
+    glAttachShader(program, shader);
+    cache->PrepareProgram(program);
+    const bool linked = ndk_helper::shader::LinkProgram(program);
+    glDeleteShader(shader);
+    if (!linked) {
+      glDeleteProgram(program);
+      return false;
+    }
+    cache->StoreProgram(program, source_hash);
+  }
+
+  program_ = program;
+  count_location_ = glGetUniformLocation(program, "uCount");
+  step_location_ = glGetUniformLocation(program, "uStep");
+  gravity_location_ = glGetUniformLocation(program, "uGravity");
+  ground_height_location_ = glGetUniformLocation(program, "uGroundHeight");
+  ground_half_size_location_ =
+      glGetUniformLocation(program, "uGroundHalfSize");
+  return true;
+}
+
+void GpuPhysics::SetGround(float height, float half_size) {
+  ground_height_ = height;
+  ground_half_size_ = half_size;
+}
+
+//--------------------------------------------------------------------------------
+// The spawn grid and rotations of RigidBodyPool::GetSpawnTransform(), and the
+// colors of DemoScene::SyncBoxProxies().
+//--------------------------------------------------------------------------------
+void GpuPhysics::Reset(int32_t array_size, float half_size, uint32_t seed) {
+  if (!IsSupported()) {
+    return;
+  }
+  SAMPLES_TRACE_SCOPE("GpuPhysics::Reset");
+  ReleaseBuffers();
+  count_ = array_size * array_size * array_size;
+  if (count_ <= 0) {
+    count_ = 0;
+    return;
+  }
+
+  uint32_t random_state = seed != 0 ? seed : 1;
+  std::vector<Body> bodies(count_);
+  for (auto index = 0; index < count_; ++index) {
+    const int32_t k = index / (array_size * array_size);
+    const int32_t i = (index / array_size) % array_size;
+    const int32_t j = index % array_size;
+    Body& body = bodies[index];
+    body.position_[0] = (-half_size * array_size / 2) + half_size * 2.f * i;
+    body.position_[1] = 10 + half_size * k;
+    body.position_[2] = (-half_size * array_size / 2) + half_size * 2.f * j;
+    body.position_[3] = half_size;
+    body.velocity_[0] = body.velocity_[1] = body.velocity_[2] = 0.f;
+    body.velocity_[3] = 0.f;
+
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    const float angle = static_cast<float>(random_state >> 8) *
+                        (kTwoPi / static_cast<float>(1 << 24));
+    // Around (1, 1, 0) / sqrt(2).
+    const float s = sinf(angle * 0.5f) * static_cast<float>(M_SQRT1_2);
+    body.rotation_[0] = s;
+    body.rotation_[1] = s;
+    body.rotation_[2] = 0.f;
+    body.rotation_[3] = cosf(angle * 0.5f);
+
+    const int32_t c = (index + 2) % 7 + 1;
+    body.color_[0] = ((c & 0x1) != 0) * 1.f;
+    body.color_[1] = ((c & 0x2) != 0) * 1.f;
+    body.color_[2] = ((c & 0x4) != 0) * 1.f;
+    body.color_[3] = 1.f;
+  }
+
+  const GLsizeiptr body_size = sizeof(Body) * count_;
+  glGenBuffers(2, body_buffers_);
+  for (auto buffer : body_buffers_) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, body_size, bodies.data(),
+                 GL_DYNAMIC_COPY);
+  }
+  // Written by the first Step(), drawn as instance attributes.
+  glGenBuffers(1, &instance_buffer_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, instance_buffer_);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(BOX_INSTANCE) * count_,
+               nullptr, GL_DYNAMIC_COPY);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  current_buffer_ = 0;
+  MemoryTracker::GetInstance()->Allocate(MEMORY_CATEGORY_GL_BUFFERS,
+                                         GetBufferSize());
+
+  // Fill the instances before anything is drawn.
+  Step(0.f, 1);
+}
+
+void GpuPhysics::Step(float step, int32_t num_steps) {
+  if (count_ == 0 || num_steps <= 0) {
+    return;
+  }
+  SAMPLES_TRACE_SCOPE("GpuPhysics::Step");
+  GLStateCache::GetInstance()->UseProgram(program_);
+  glUniform1i(count_location_, count_);
+  glUniform1f(step_location_, step);
+  glUniform3f(gravity_location_, 0.f, kGravity, 0.f);
+  glUniform1f(ground_height_location_, ground_height_);
+  glUniform1f(ground_half_size_location_, ground_half_size_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, instance_buffer_);
+
+  const GLuint num_groups = (count_ + kWorkGroupSize - 1) / kWorkGroupSize;
+  for (auto i = 0; i < num_steps; ++i) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0,
+                     body_buffers_[current_buffer_]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1,
+                     body_buffers_[1 - current_buffer_]);
+    glDispatchCompute(num_groups, 1, 1);
+    // The next step reads what this one wrote.
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    current_buffer_ = 1 - current_buffer_;
+  }
+  // The instanced draw sources the instances as vertex attributes.
+  glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void GpuPhysics::ReleaseBuffers() {
+  if (body_buffers_[0] == 0) {
+    return;
+  }
+  MemoryTracker::GetInstance()->Free(MEMORY_CATEGORY_GL_BUFFERS,
+                                     GetBufferSize());
+  GLStateCache* state = GLStateCache::GetInstance();
+  state->DeleteBuffer(body_buffers_[0]);
+  state->DeleteBuffer(body_buffers_[1]);
+  state->DeleteBuffer(instance_buffer_);
+  body_buffers_[0] = body_buffers_[1] = 0;
+  instance_buffer_ = 0;
+  count_ = 0;
+}
+
+int64_t GpuPhysics::GetBufferSize() const {
+  return static_cast<int64_t>(2 * sizeof(Body) + sizeof(BOX_INSTANCE)) *
+         count_;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GPU_PHYSICS_H_
+#define GPU_PHYSICS_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "asset_loader.h"
+#include "common.h"
+
+// Where the boxes are simulated.
+enum PhysicsBackend {
+  // The Bullet world on the simulation thread.
+  PHYSICS_BACKEND_BULLET = 0,
+  // GpuPhysics, on the GL thread.
+  PHYSICS_BACKEND_GPU,
+  PHYSICS_BACKEND_COUNT
+};
+
+// Display names, indexed by PhysicsBackend.
+extern const char* const kPhysicsBackendNames[PHYSICS_BACKEND_COUNT];
+
+/*
+ * Box simulation in OpenGL ES 3.1 compute shaders, for when the CPU is what
+ * throttles and the GPU has headroom.
+ *
+ * Step() dispatches one CS_BoxStep.csh pass per step: gravity, a box-ground
+ * contact and box-box contacts, the boxes colliding as spheres of their half
+ * size. Every box is tested against every other one, in tiles through shared
+ * memory, so the cost grows with the square of the count. The contacts of a
+ * step are taken from the previous one, the body buffers ping-pong.
+ *
+ * The pass also writes the BOX_INSTANCE of each box into the instance buffer,
+ * which BoxRenderer::RenderInstanceBuffer() draws from: the boxes never come
+ * back to the CPU, so they are not culled either.
+ *
+ * GL thread only.
+ */
+class GpuPhysics {
+ public:
+  // Local size of CS_BoxStep.csh.
+  static constexpr int32_t kWorkGroupSize = 64;
+
+  GpuPhysics();
+  ~GpuPhysics();
+
+  // Start loading the shader source on the asset loader, see
+  // BoxRenderer::LoadShaderAssets().
+  static std::vector<AssetFuture> LoadShaderAssets();
+
+  // Check for OpenGL ES 3.1 and build the program. Call when the context is
+  // (re)created.
+  void Init();
+
+  // Release the GL objects. Call before the context goes away.
+  void Unload();
+
+  bool IsSupported() const { return program_ != 0; }
+
+  // Spawn `array_size`^3 boxes of `half_size` at rest, on the spawn grid of
+  // RigidBodyPool, with rotations drawn from `seed`.
+  void Reset(int32_t array_size, float half_size, uint32_t seed);
+
+  // Advance the boxes by `num_steps` steps of `step` seconds.
+  void Step(float step, int32_t num_steps);
+
+  // Top of the ground and its half size on x and z.
+  void SetGround(float height, float half_size);
+
+  int32_t GetCount() const { return count_; }
+  GLuint GetInstanceBuffer() const { return instance_buffer_; }
+
+ private:
+  // Layout of Body in CS_BoxStep.csh (std430).
+  struct Body {
+    float position_[4];  // w: half size
+    float velocity_[4];
+    float rotation_[4];
+    float color_[4];
+  };
+
+  bool LoadProgram();
+  void ReleaseBuffers();
+  int64_t GetBufferSize() const;
+
+  GLuint program_;
+  GLint count_location_;
+  GLint step_location_;
+  GLint gravity_location_;
+  GLint ground_height_location_;
+  GLint ground_half_size_location_;
+
+  // Bodies of the current step, and of the next one.
+  GLuint body_buffers_[2];
+  int32_t current_buffer_;
+  GLuint instance_buffer_;
+  int32_t count_;
+
+  float ground_height_;
+  float ground_half_size_;
+};
+
+#endif  // GPU_PHYSICS_H_
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gpu_timer.h"
+
+#include <cstring>
+
+GpuTimer::GpuTimer()
+    : supported_(false),
+      gen_queries_(nullptr),
+      delete_queries_(nullptr),
+      begin_query_(nullptr),
+      end_query_(nullptr),
+      get_query_objectuiv_(nullptr),
+      get_query_objectui64v_(nullptr),
+      frame_index_(0),
+      query_open_(false),
+      frame_time_(0.f),
+      section_times_(),
+      read_back_count_(0),
+      dropped_frames_(0) {
+  memset(frames_, 0, sizeof(frames_));
+}
+
+GpuTimer::~GpuTimer() { Unload(); }
+
+void GpuTimer::Init() {
+  Unload();
+  const char* extensions =
+      reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+  if (extensions == nullptr ||
+      strstr(extensions, "GL_EXT_disjoint_timer_query") == nullptr) {
+    ALOGI("GpuTimer: GL_EXT_disjoint_timer_query not supported");
+    return;
+  }
+
+  gen_queries_ = reinterpret_cast<PFNGLGENQUERIESEXTPROC>(
+      eglGetProcAddress("glGenQueriesEXT"));
+  delete_queries_ = reinterpret_cast<PFNGLDELETEQUERIESEXTPROC>(
+      eglGetProcAddress("glDeleteQueriesEXT"));
+  begin_query_ = reinterpret_cast<PFNGLBEGINQUERYEXTPROC>(
+      eglGetProcAddress("glBeginQueryEXT"));
+  end_query_ = reinterpret_cast<PFNGLENDQUERYEXTPROC>(
+      eglGetProcAddress("glEndQueryEXT"));
+  get_query_objectuiv_ = reinterpret_cast<PFNGLGETQUERYOBJECTUIVEXTPROC>(
+      eglGetProcAddress("glGetQueryObjectuivEXT"));
+  get_query_objectui64v_ = reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(
+      eglGetProcAddress("glGetQueryObjectui64vEXT"));
+  if (gen_queries_ == nullptr || delete_queries_ == nullptr ||
+      begin_query_ == nullptr || end_query_ == nullptr ||
+      get_query_objectuiv_ == nullptr || get_query_objectui64v_ == nullptr) {
+    ALOGE("GpuTimer: GL_EXT_disjoint_timer_query entry points missing");
+    return;
+  }
+
+  for (auto& frame : frames_) {
+    gen_queries_(kMaxQueriesPerFrame, frame.queries_);
+    frame.count_ = 0;
+    frame.pending_ = false;
+  }
+  // Clear the disjoint flag, it is set when the context is created.
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  frame_index_ = 0;
+  query_open_ = false;
+  supported_ = true;
+}
+
+void GpuTimer::Unload() {
+  if (!supported_) {
+    return;
+  }
+  for (auto& frame : frames_) {
+    delete_queries_(kMaxQueriesPerFrame, frame.queries_);
+    frame.count_ = 0;
+    frame.pending_ = false;
+  }
+  query_open_ = false;
+  supported_ = false;
+}
+
+//--------------------------------------------------------------------------------
+// Read back the frame that used this slot kNumFrames - 1 frames ago, then
+// reuse its queries.
+//--------------------------------------------------------------------------------
+bool GpuTimer::BeginFrame() {
+  if (!supported_) {
+    return false;
+  }
+
+  // A disjoint event (e.g. a GPU frequency change) invalidates all the
+  // queries in flight.
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  if (disjoint) {
+    for (auto& frame : frames_) {
+      if (frame.pending_) {
+        frame.pending_ = false;
+        ++dropped_frames_;
+      }
+    }
+  }
+
+  frame_index_ = (frame_index_ + 1) % kNumFrames;
+  FrameQueries& frame = frames_[frame_index_];
+  bool read = false;
+  if (frame.pending_) {
+    read = ReadBack(frame);
+    if (!read) {
+      ++dropped_frames_;
+    }
+  }
+  frame.count_ = 0;
+  frame.pending_ = false;
+  StartQuery(kNoSection);
+  return read;
+}
+
+void GpuTimer::EndFrame() {
+  if (!supported_) {
+    return;
+  }
+  StopQuery();
+  FrameQueries& frame = frames_[frame_index_];
+  frame.pending_ = frame.count_ > 0;
+}
+
+void GpuTimer::BeginSection(GpuTimerSection section) { StartQuery(section); }
+
+void GpuTimer::EndSection() { StartQuery(kNoSection); }
+
+void GpuTimer::StartQuery(int32_t section) {
+  if (!supported_) {
+    return;
+  }
+  StopQuery();
+  FrameQueries& frame = frames_[frame_index_];
+  if (frame.count_ >= kMaxQueriesPerFrame) {
+    return;
+  }
+  begin_query_(GL_TIME_ELAPSED_EXT, frame.queries_[frame.count_]);
+  frame.sections_[frame.count_] = section;
+  ++frame.count_;
+  query_open_ = true;
+}
+
+void GpuTimer::StopQuery() {
+  if (query_open_) {
+    end_query_(GL_TIME_ELAPSED_EXT);
+    query_open_ = false;
+  }
+}
+
+bool GpuTimer::ReadBack(const FrameQueries& frame) {
+  // Queries complete in order, the last one being available is enough.
+  GLuint available = 0;
+  get_query_objectuiv_(frame.queries_[frame.count_ - 1],
+                       GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+  if (!available) {
+    return false;
+  }
+
+  GLuint64 total = 0;
+  GLuint64 sections[GPU_SECTION_COUNT] = {};
+  for (auto i = 0; i < frame.count_; ++i) {
+    GLuint64 elapsed = 0;
+    get_query_objectui64v_(frame.queries_[i], GL_QUERY_RESULT_EXT, &elapsed);
+    total += elapsed;
+    if (frame.sections_[i] != kNoSection) {
+      sections[frame.sections_[i]] += elapsed;
+    }
+  }
+  frame_time_ = total / 1e9f;
+  for (auto i = 0; i < GPU_SECTION_COUNT; ++i) {
+    section_times_[i] = sections[i] / 1e9f;
+  }
+  ++read_back_count_;
+  return true;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GPU_TIMER_H_
+#define GPU_TIMER_H_
+
+#include <atomic>
+#include <cstdint>
+
+// After GLES3/gl3.h, for the GL types.
+#include "common.h"
+#include <GLES2/gl2ext.h>
+
+// Parts of a frame timed on the GPU.
+enum GpuTimerSection {
+  GPU_SECTION_BOXES = 0,
+  GPU_SECTION_UI,
+  GPU_SECTION_COUNT
+};
+
+/*
+ * GPU frame timing with GL_EXT_disjoint_timer_query.
+ *
+ * Time elapsed queries can't nest, so a frame is covered by consecutive
+ * queries: one per section, and one for each stretch between sections. The
+ * frame time is their sum, it covers the GL work from BeginFrame() to
+ * EndFrame() but not the composition.
+ *
+ * The queries come from a pool allocated once, kNumFrames frames worth. A
+ * frame is read back when its slot comes around again, kNumFrames - 1 frames
+ * later; if the GPU isn't done with it by then, or a disjoint event made the
+ * results unreliable, the frame is dropped instead of waiting.
+ *
+ * GL thread only, but for the results: the game thread reads them while the
+ * render thread times the next frames (see RenderThread).
+ */
+class GpuTimer {
+ public:
+  static constexpr int32_t kNumFrames = 4;
+  static constexpr int32_t kMaxQueriesPerFrame = 8;
+
+  GpuTimer();
+  ~GpuTimer();
+
+  // Look up the extension and allocate the queries. Needs a current context.
+  void Init();
+  void Unload();
+  bool IsSupported() const { return supported_; }
+
+  // Start timing a frame. Returns true when the times of an earlier frame were
+  // read back.
+  bool BeginFrame();
+  void EndFrame();
+
+  // Time the GL calls up to EndSection() as `section`.
+  void BeginSection(GpuTimerSection section);
+  void EndSection();
+
+  // Times of the last frame read back, in seconds.
+  float GetFrameTime() const { return frame_time_.load(); }
+  float GetSectionTime(GpuTimerSection section) const {
+    return section_times_[section].load();
+  }
+
+  // Frames read back so far. Tells the game thread when the times changed.
+  int32_t GetReadBackCount() const { return read_back_count_.load(); }
+
+  // Frames dropped because their results were late or unreliable.
+  int32_t GetDroppedFrames() const { return dropped_frames_.load(); }
+
+ private:
+  // Section of the queries between sections.
+  static constexpr int32_t kNoSection = -1;
+
+  struct FrameQueries {
+    GLuint queries_[kMaxQueriesPerFrame];
+    int32_t sections_[kMaxQueriesPerFrame];
+    int32_t count_;
+    bool pending_;
+  };
+
+  void StartQuery(int32_t section);
+  void StopQuery();
+  bool ReadBack(const FrameQueries& frame);
+
+  bool supported_;
+  PFNGLGENQUERIESEXTPROC gen_queries_;
+  PFNGLDELETEQUERIESEXTPROC delete_queries_;
+  PFNGLBEGINQUERYEXTPROC begin_query_;
+  PFNGLENDQUERYEXTPROC end_query_;
+  PFNGLGETQUERYOBJECTUIVEXTPROC get_query_objectuiv_;
+  PFNGLGETQUERYOBJECTUI64VEXTPROC get_query_objectui64v_;
+
+  FrameQueries frames_[kNumFrames];
+  int32_t frame_index_;
+  bool query_open_;
+
+  std::atomic<float> frame_time_;
+  std::atomic<float> section_times_[GPU_SECTION_COUNT];
+  std::atomic<int32_t> read_back_count_;
+  std::atomic<int32_t> dropped_frames_;
+};
+
+#endif  // GPU_TIMER_H_
@@ -19,19 +19,37 @@ extern "C" {
 #include <GLES2/gl2.h>
 }
 
+#include "Trace.h"
 #include "backends/imgui_impl_opengl3.h"
 #include "imgui.h"
 #include "imgui_manager.h"
+#include "memory_tracker.h"
+#include "render_thread.h"
 
 namespace {
 const float GUI_LOWDPI_FONT_SCALE = 2.0f;
 const float GUI_DEFAULT_FONT_SCALE = 3.0f;
 const float GUI_MINIMUM_FRAME_TIME = (1.0f / 60.0f);
+// Weight of the last frame in the smoothed rebuild ratio.
+const float GUI_REBUILD_RATIO_WEIGHT = 0.05f;
 float currentFontScale = 1.0f;
 bool overrideFontScale = false;
 }  // namespace
 
-ImGuiManager::ImGuiManager() : delta_clock_() {
+ImGuiManager::ImGuiManager()
+    : delta_clock_(),
+      throttled_(true),
+      update_requested_(true),
+      building_(false),
+      has_draw_data_(false),
+      build_count_(0),
+      last_build_time_(0.f),
+      last_input_time_(0.f),
+      last_mouse_x_(0.f),
+      last_mouse_y_(0.f),
+      last_mouse_down_(false),
+      rebuild_ratio_(1.f),
+      font_atlas_size_(0) {
   // Setup Dear ImGui context
   IMGUI_CHECKVERSION();
   ImGui::CreateContext();
@@ -39,11 +57,16 @@ ImGuiManager::ImGuiManager() : delta_clock_() {
   // Setup Dear ImGui style
   ImGui::StyleColorsDark();
 
-  // Setup Platform/Renderer bindings
+  // Setup Platform/Renderer bindings. The font atlas is built here, with
+  // the font texture, rather than by the first frame drawn: the render
+  // thread draws while the game thread builds the next UI.
   ImGui_ImplOpenGL3_Init(NULL);
+  ImGui_ImplOpenGL3_CreateDeviceObjects();
 }
 
 ImGuiManager::~ImGuiManager() {
+  MemoryTracker::GetInstance()->Free(MEMORY_CATEGORY_FONT_ATLAS,
+                                     font_atlas_size_);
   ImGui_ImplOpenGL3_Shutdown();
   ImGui::DestroyContext();
 }
@@ -53,6 +76,9 @@ void ImGuiManager::SetDisplaySize(const int displayWidth,
                                   const int displayDpi) {
   // Make sure the internal display size matches current
   ImGuiIO &io = ImGui::GetIO();
+  if (io.DisplaySize.x != displayWidth || io.DisplaySize.y != displayHeight) {
+    update_requested_ = true;
+  }
   io.DisplaySize = ImVec2((float)displayWidth, (float)displayHeight);
   if (!overrideFontScale) {
     const float displayScale = (displayWidth >= 1920 && displayDpi >= 400)
@@ -63,7 +89,14 @@ void ImGuiManager::SetDisplaySize(const int displayWidth,
   }
 }
 
-void ImGuiManager::BeginImGuiFrame() {
+bool ImGuiManager::BeginImGuiFrame() {
+  building_ = NeedsRebuild();
+  rebuild_ratio_ += GUI_REBUILD_RATIO_WEIGHT *
+                    ((building_ ? 1.f : 0.f) - rebuild_ratio_);
+  if (!building_) {
+    return false;
+  }
+
   // Update the delta time since the last frame
   float deltaTime = delta_clock_.ReadDelta();
   // Don't return a delta time of less than a 60Hz tick
@@ -74,15 +107,89 @@ void ImGuiManager::BeginImGuiFrame() {
   io.DeltaTime = deltaTime;
 
   // Start the Dear ImGui frame
-  ImGui_ImplOpenGL3_NewFrame();
   ImGui::NewFrame();
+  UpdateFontAtlasSize();
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// The backend creates the font texture from the atlas pixels, and rebuilds
+// them first if they were freed, e.g. after a context loss.
+//--------------------------------------------------------------------------------
+int64_t ImGuiManager::TrimMemory() {
+  ImGui::GetIO().Fonts->ClearTexData();
+  int64_t previous_size = font_atlas_size_;
+  UpdateFontAtlasSize();
+  return previous_size - font_atlas_size_;
+}
+
+void ImGuiManager::UpdateFontAtlasSize() {
+  const ImFontAtlas *atlas = ImGui::GetIO().Fonts;
+  const int64_t pixels = static_cast<int64_t>(atlas->TexWidth) *
+                         atlas->TexHeight;
+  int64_t size = 0;
+  if (atlas->TexPixelsAlpha8 != nullptr) {
+    size += pixels;
+  }
+  if (atlas->TexPixelsRGBA32 != nullptr) {
+    size += pixels * 4;
+  }
+  if (size != font_atlas_size_) {
+    MemoryTracker::GetInstance()->Allocate(MEMORY_CATEGORY_FONT_ATLAS,
+                                           size - font_atlas_size_);
+    font_atlas_size_ = size;
+  }
+}
+
+//--------------------------------------------------------------------------------
+// The scene sets the pointer state on the ImGui IO before each frame, so new
+// input shows as a change from the last rebuild.
+//--------------------------------------------------------------------------------
+bool ImGuiManager::NeedsRebuild() {
+  ImGuiIO &io = ImGui::GetIO();
+  float now = Clock();
+  if (io.MousePos.x != last_mouse_x_ || io.MousePos.y != last_mouse_y_ ||
+      io.MouseDown[0] != last_mouse_down_) {
+    last_input_time_ = now;
+  }
+
+  bool rebuild = !throttled_ || !has_draw_data_ || update_requested_ ||
+                 now - last_input_time_ < kInputActiveTime ||
+                 now - last_build_time_ >= kThrottledUpdateInterval;
+  if (rebuild) {
+    update_requested_ = false;
+    last_build_time_ = now;
+    last_mouse_x_ = io.MousePos.x;
+    last_mouse_y_ = io.MousePos.y;
+    last_mouse_down_ = io.MouseDown[0];
+  }
+  return rebuild;
 }
 
 void ImGuiManager::EndImGuiFrame() {
-  ImGui::Render();
+  SAMPLES_TRACE_SCOPE("ImGuiManager::EndImGuiFrame");
+  if (building_) {
+    ImGui::Render();
+    has_draw_data_ = true;
+    building_ = false;
+    ++build_count_;
+  }
+  RenderFrame *frame = RenderThread::GetInstance()->GetFrame();
+  if (frame == nullptr || !has_draw_data_) {
+    return;
+  }
   ImGuiIO &io = ImGui::GetIO();
-  glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
-  ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+  frame->SetViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
+  frame->DrawUi(ImGui::GetDrawData(), build_count_);
+}
+
+void ImGuiManager::RenderDrawData(ImDrawData *draw_data) {
+  SAMPLES_TRACE_SCOPE("ImGuiManager::RenderDrawData");
+  // Only creates the device objects if they are missing.
+  ImGui_ImplOpenGL3_NewFrame();
+  // The backend sets its own state and restores ours when it is done, so the
+  // GLStateCache stays valid.
+  ImGui_ImplOpenGL3_RenderDrawData(draw_data);
 }
 
 float ImGuiManager::GetFontScale() { return currentFontScale; }
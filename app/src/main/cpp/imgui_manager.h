@@ -17,13 +17,33 @@
 #ifndef IMGUI_MANAGER_H_
 #define IMGUI_MANAGER_H_
 
+#include <cstdint>
+
 #include "util.h"
 
+struct ImDrawData;
+
 /*
  * Manages the status and rendering of the ImGui system
+ *
+ * In throttled mode, the UI is only rebuilt when it may have changed: when
+ * input arrives and for a moment after, when RequestUpdate() is called, and
+ * otherwise every kThrottledUpdateInterval so that the values shown stay
+ * fresh. On the other frames the draw data of the last rebuild is drawn
+ * again, it stays valid until the next ImGui::NewFrame().
+ *
+ * The UI is built on the game thread. EndImGuiFrame() records it into the
+ * frame the render thread draws next, which takes a copy of the draw data
+ * when it changed (see RenderFrame::DrawUi()).
  */
 class ImGuiManager {
  public:
+  // Longest time between two rebuilds of a throttled UI.
+  static constexpr float kThrottledUpdateInterval = 0.25f;
+  // How long a throttled UI keeps being rebuilt every frame after input,
+  // for the widgets to react to it.
+  static constexpr float kInputActiveTime = 0.5f;
+
   ImGuiManager();
 
   ~ImGuiManager();
@@ -31,16 +51,54 @@ class ImGuiManager {
   void SetDisplaySize(const int displayWidth, const int displayHeight,
                       const int displayDpi);
 
-  void BeginImGuiFrame();
+  // Returns true when the UI must be built for this frame, between this
+  // call and EndImGuiFrame(). When false, EndImGuiFrame() draws the previous
+  // UI again.
+  bool BeginImGuiFrame();
 
   void EndImGuiFrame();
 
+  // Render thread: draw the UI, as recorded by EndImGuiFrame().
+  static void RenderDrawData(ImDrawData *draw_data);
+
+  // Throttle the UI rebuilds, or rebuild the UI every frame.
+  void SetThrottled(bool throttled) { throttled_ = throttled; }
+  bool IsThrottled() const { return throttled_; }
+
+  // Rebuild the UI on the next frame, e.g. when a value shown changed.
+  void RequestUpdate() { update_requested_ = true; }
+
+  // Share of the recent frames in which the UI was rebuilt.
+  float GetRebuildRatio() const { return rebuild_ratio_; }
+
+  // Free the CPU copy of the font atlas, which is only needed to create the
+  // font texture. Returns the # of bytes freed.
+  int64_t TrimMemory();
+
   float GetFontScale();
 
   void SetFontScale(const float fontScale);
 
  private:
+  bool NeedsRebuild();
+  void UpdateFontAtlasSize();
+
   DeltaClock delta_clock_;
+  bool throttled_;
+  bool update_requested_;
+  bool building_;
+  bool has_draw_data_;
+  // Bumped by every rebuild, so the frames know when to copy the UI again.
+  int64_t build_count_;
+  float last_build_time_;
+  float last_input_time_;
+  // Input seen at the last rebuild.
+  float last_mouse_x_;
+  float last_mouse_y_;
+  bool last_mouse_down_;
+  float rebuild_ratio_;
+  // Accounted to MEMORY_CATEGORY_FONT_ATLAS.
+  int64_t font_atlas_size_;
 };
 
 #endif  // IMGUI_MANAGER_H_
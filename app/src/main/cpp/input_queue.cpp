@@ -0,0 +1,84 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "input_queue.h"
+
+InputQueue* InputQueue::GetInstance() {
+  static InputQueue instance;
+  return &instance;
+}
+
+InputQueue::InputQueue()
+    : head_(0), tail_(0), dropped_count_(0), coalesced_count_(0) {}
+
+bool InputQueue::Push(const CookedEvent& event) {
+  const uint32_t tail = tail_.load(std::memory_order_relaxed);
+  const uint32_t size = tail - head_.load(std::memory_order_acquire);
+  const uint32_t limit = event.type_ == COOKED_EVENT_TYPE_POINTER_MOVE
+                             ? kCapacity - kReservedSlots
+                             : kCapacity;
+  if (size >= limit) {
+    dropped_count_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  events_[tail % kCapacity] = event;
+  tail_.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Walk the events back from the newest first, to find the moves a later move
+// of the same pointer supersedes, before any down or up of that pointer.
+// Only the events the tail published are read.
+//--------------------------------------------------------------------------------
+int32_t InputQueue::Drain(CookedEventCallback callback) {
+  const uint32_t head = head_.load(std::memory_order_relaxed);
+  const uint32_t tail = tail_.load(std::memory_order_acquire);
+  uint64_t moved = 0;
+  for (uint32_t i = tail; i != head;) {
+    --i;
+    const CookedEvent& event = events_[i % kCapacity];
+    const uint64_t bit = GetPointerBit(event);
+    bool superseded = false;
+    if (event.type_ == COOKED_EVENT_TYPE_POINTER_MOVE) {
+      superseded = (moved & bit) != 0;
+      moved |= bit;
+    } else {
+      moved &= ~bit;
+    }
+    superseded_[i % kCapacity] = superseded;
+  }
+
+  int32_t num_delivered = 0;
+  for (uint32_t i = head; i != tail; ++i) {
+    if (superseded_[i % kCapacity]) {
+      coalesced_count_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    callback(&events_[i % kCapacity]);
+    ++num_delivered;
+  }
+  head_.store(tail, std::memory_order_release);
+  return num_delivered;
+}
+
+uint64_t InputQueue::GetPointerBit(const CookedEvent& event) {
+  const int32_t id = event.motion_pointer_id_;
+  if (id < 0 || id >= kMaxCoalescedPointers) {
+    return 0;
+  }
+  return static_cast<uint64_t>(1) << id;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INPUT_QUEUE_H_
+#define INPUT_QUEUE_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "input_util.h"
+
+/*
+ * Single producer, single consumer queue of cooked input events, between the
+ * thread reading the GameActivity input buffers and the scene.
+ *
+ * The producer only writes the tail and the consumer only the head, so
+ * neither side ever waits for the other. The scene drains the queue once per
+ * frame, at a single point (see SceneManager::DoFrame()), instead of being
+ * called back while the input buffers are read.
+ *
+ * The moves of each pointer are coalesced while draining: of the moves a
+ * pointer made between two of its downs or ups, only the last is delivered,
+ * whatever the other pointers did in between. Downs and ups are always kept.
+ *
+ * The producer can't remove queued events, so the last kReservedSlots slots
+ * are kept for downs and ups: once the queue is that full, the new moves are
+ * dropped, and the pointer's next move or up brings its position up to date.
+ * A down or up is only dropped when the queue is completely full.
+ */
+class InputQueue {
+ public:
+  // # of queued events, a power of two.
+  static constexpr int32_t kCapacity = 256;
+  // Slots only downs and ups can use.
+  static constexpr int32_t kReservedSlots = 32;
+  // Pointers whose moves are coalesced, the ids from 0. Moves of the others
+  // are all delivered.
+  static constexpr int32_t kMaxCoalescedPointers = 64;
+
+  static InputQueue* GetInstance();
+
+  // Queue an event. Producer only. Returns false when the queue is full.
+  bool Push(const CookedEvent& event);
+
+  // Deliver the queued events to `callback`, oldest first. Consumer only.
+  // Returns the # of events delivered.
+  int32_t Drain(CookedEventCallback callback);
+
+  // # of events dropped on a full queue and of moves coalesced.
+  int64_t GetDroppedCount() const { return dropped_count_.load(); }
+  int64_t GetCoalescedCount() const { return coalesced_count_.load(); }
+
+ private:
+  InputQueue();
+  InputQueue(const InputQueue&) = delete;
+  InputQueue& operator=(const InputQueue&) = delete;
+
+  // Bit of the pointer of `event` in a coalescing mask, 0 when it has none.
+  static uint64_t GetPointerBit(const CookedEvent& event);
+
+  CookedEvent events_[kCapacity];
+  // Consumer only: the queued moves Drain() skips.
+  bool superseded_[kCapacity];
+  // Head and tail count events since the start, the slot is the count modulo
+  // kCapacity. They sit on their own cache lines.
+  alignas(64) std::atomic<uint32_t> head_;
+  alignas(64) std::atomic<uint32_t> tail_;
+  std::atomic<int64_t> dropped_count_;
+  std::atomic<int64_t> coalesced_count_;
+};
+
+#endif  // INPUT_QUEUE_H_
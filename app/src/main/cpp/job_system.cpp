@@ -0,0 +1,224 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "job_system.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "common.h"
+#include "cpu_topology.h"
+
+namespace {
+// # of attempts to find a job before a worker goes to sleep.
+const int32_t kSpinCount = 64;
+// Queue of the calling thread in the JobSystem, kNoQueue when all the
+// external queues are taken.
+const int32_t kUnassigned = -1;
+const int32_t kNoQueue = -2;
+thread_local int32_t tls_queue_index = kUnassigned;
+}  // namespace
+
+JobSystem* JobSystem::GetInstance() {
+  static JobSystem instance;
+  return &instance;
+}
+
+JobSystem::JobSystem()
+    : num_external_queues_(0),
+      queued_jobs_(0),
+      started_workers_(0),
+      stop_(false),
+      steal_count_(0) {
+  const int32_t num_cores = static_cast<int32_t>(
+      CpuTopology::GetInstance()->GetCpus(THREAD_ROLE_PHYSICS).size());
+  const int32_t num_workers = std::max(num_cores - 1, 0);
+  for (auto i = 0; i < num_workers + kMaxExternalQueues; ++i) {
+    queues_.emplace_back(new WorkQueue);
+  }
+  worker_tids_.assign(num_workers, 0);
+  for (auto i = 0; i < num_workers; ++i) {
+    workers_.emplace_back(&JobSystem::WorkerLoop, this, i);
+  }
+
+  // Wait until every worker published its tid.
+  std::unique_lock<std::mutex> lock(sleep_mutex_);
+  started_cv_.wait(lock, [this, num_workers] {
+    return started_workers_ == num_workers;
+  });
+  ALOGI("JobSystem: %d worker(s) on the %s cores", num_workers,
+        CpuTopology::GetClusterTypeName(
+            CpuTopology::GetInstance()->GetPlacement(THREAD_ROLE_PHYSICS)));
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  wake_cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Split the range in even chunks. The calling thread queues all chunks but
+// the first one, runs that one, then helps with its own queue until every
+// chunk is done.
+//--------------------------------------------------------------------------------
+void JobSystem::ParallelFor(int32_t begin, int32_t end, int32_t grain_size,
+                            int32_t max_threads, RangeFunc func,
+                            void* context) {
+  const int32_t count = end - begin;
+  if (count <= 0) {
+    return;
+  }
+  grain_size = std::max(grain_size, 1);
+  const int32_t num_threads = std::min(max_threads, GetNumThreads());
+  const int32_t num_chunks = std::min((count + grain_size - 1) / grain_size,
+                                      num_threads * kChunksPerThread);
+  if (num_threads <= 1 || num_chunks <= 1) {
+    func(context, begin, end);
+    return;
+  }
+  const int32_t queue = GetQueueIndex();
+  if (queue < 0) {
+    func(context, begin, end);
+    return;
+  }
+
+  auto chunk_begin = [=](int32_t chunk) {
+    return begin + static_cast<int32_t>(static_cast<int64_t>(count) * chunk /
+                                        num_chunks);
+  };
+  std::atomic<int32_t> pending(num_chunks - 1);
+  {
+    WorkQueue& work_queue = *queues_[queue];
+    std::lock_guard<std::mutex> lock(work_queue.mutex_);
+    for (auto chunk = 1; chunk < num_chunks; ++chunk) {
+      work_queue.jobs_.push_back(Job{func, context, chunk_begin(chunk),
+                                     chunk_begin(chunk + 1), &pending});
+    }
+  }
+  queued_jobs_.fetch_add(num_chunks - 1, std::memory_order_release);
+  {
+    // Pairs with the predicate check of the sleeping workers.
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+  }
+  wake_cv_.notify_all();
+
+  func(context, begin, chunk_begin(1));
+
+  const bool is_worker = queue < static_cast<int32_t>(workers_.size());
+  while (pending.load(std::memory_order_acquire) > 0) {
+    if (!RunOneJob(queue, is_worker)) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Workers.
+//--------------------------------------------------------------------------------
+void JobSystem::WorkerLoop(int32_t index) {
+  tls_queue_index = index;
+  CpuTopology::GetInstance()->PinCurrentThread(THREAD_ROLE_PHYSICS);
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    worker_tids_[index] = gettid();
+    ++started_workers_;
+  }
+  started_cv_.notify_all();
+
+  while (true) {
+    bool ran = false;
+    for (auto spin = 0; spin < kSpinCount && !ran; ++spin) {
+      ran = RunOneJob(index, true);
+      if (!ran) {
+        std::this_thread::yield();
+      }
+    }
+    if (ran) {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    wake_cv_.wait(lock, [this] {
+      return stop_ || queued_jobs_.load(std::memory_order_acquire) > 0;
+    });
+    if (stop_) {
+      return;
+    }
+  }
+}
+
+int32_t JobSystem::GetQueueIndex() {
+  if (tls_queue_index == kUnassigned) {
+    const int32_t external = num_external_queues_.fetch_add(1);
+    if (external < kMaxExternalQueues) {
+      tls_queue_index = static_cast<int32_t>(workers_.size()) + external;
+    } else {
+      ALOGW("JobSystem: more than %d threads submit work, running inline",
+            kMaxExternalQueues);
+      tls_queue_index = kNoQueue;
+    }
+  }
+  return tls_queue_index >= 0 ? tls_queue_index : -1;
+}
+
+bool JobSystem::PopJob(int32_t index, bool steal, Job* job) {
+  WorkQueue& work_queue = *queues_[index];
+  std::lock_guard<std::mutex> lock(work_queue.mutex_);
+  if (work_queue.jobs_.empty()) {
+    return false;
+  }
+  if (steal) {
+    *job = work_queue.jobs_.front();
+    work_queue.jobs_.pop_front();
+  } else {
+    *job = work_queue.jobs_.back();
+    work_queue.jobs_.pop_back();
+  }
+  queued_jobs_.fetch_sub(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool JobSystem::RunOneJob(int32_t index, bool can_steal) {
+  Job job;
+  if (PopJob(index, false, &job)) {
+    RunJob(job);
+    return true;
+  }
+  if (!can_steal || queued_jobs_.load(std::memory_order_acquire) == 0) {
+    return false;
+  }
+  const int32_t num_queues = static_cast<int32_t>(queues_.size());
+  for (auto i = 1; i < num_queues; ++i) {
+    if (PopJob((index + i) % num_queues, true, &job)) {
+      steal_count_.fetch_add(1, std::memory_order_relaxed);
+      RunJob(job);
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::RunJob(const Job& job) {
+  job.func_(job.context_, job.begin_, job.end_);
+  job.pending_->fetch_sub(1, std::memory_order_release);
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef JOB_SYSTEM_H_
+#define JOB_SYSTEM_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Work-stealing pool of worker threads, shared by the physics (through
+ * PhysicsTaskScheduler) and the per-frame loops of the game thread.
+ *
+ * Every worker owns a deque of jobs. It runs its own jobs from the back and,
+ * when it has none left, steals from the front of the other deques. Threads
+ * outside of the pool get a deque of their own the first time they submit
+ * work; the workers steal from it, but the submitting thread only ever runs
+ * its own jobs while it waits. That keeps code that indexes per-thread data
+ * by btGetCurrentThreadIndex() on the physics thread and the workers.
+ *
+ * The workers run on the cores of THREAD_ROLE_PHYSICS (see CpuTopology), one
+ * less than there are, as the simulation thread runs there too and takes
+ * part in its loops.
+ */
+class JobSystem {
+ public:
+  // The body of a parallel loop, called on the range [begin, end).
+  typedef void (*RangeFunc)(void* context, int32_t begin, int32_t end);
+
+  // Most threads outside of the pool that can submit work.
+  static constexpr int32_t kMaxExternalQueues = 4;
+  // A parallel loop is split into up to this many chunks per thread, so the
+  // threads that finish early can steal from the others.
+  static constexpr int32_t kChunksPerThread = 4;
+
+  static JobSystem* GetInstance();
+
+  ~JobSystem();
+
+  // # of threads that can run a parallel loop, the calling thread included.
+  int32_t GetNumThreads() const {
+    return static_cast<int32_t>(workers_.size()) + 1;
+  }
+
+  // Kernel thread ids of the workers, e.g. to add them to a hint session.
+  const std::vector<int32_t>& GetWorkerThreadIds() const {
+    return worker_tids_;
+  }
+
+  // # of jobs that ran on another thread than the one they were queued on.
+  uint64_t GetStealCount() const {
+    return steal_count_.load(std::memory_order_relaxed);
+  }
+
+  // Run `func` on chunks of at least `grain_size` indices of [begin, end),
+  // split for `max_threads` threads. Returns once all chunks are done.
+  void ParallelFor(int32_t begin, int32_t end, int32_t grain_size,
+                   int32_t max_threads, RangeFunc func, void* context);
+
+  // Same with a callable taking (begin, end), on all the threads.
+  template <typename Body>
+  void ParallelFor(int32_t begin, int32_t end, int32_t grain_size,
+                   const Body& body) {
+    ParallelFor(
+        begin, end, grain_size, GetNumThreads(),
+        [](void* context, int32_t range_begin, int32_t range_end) {
+          (*static_cast<const Body*>(context))(range_begin, range_end);
+        },
+        const_cast<Body*>(&body));
+  }
+
+ private:
+  struct Job {
+    RangeFunc func_;
+    void* context_;
+    int32_t begin_;
+    int32_t end_;
+    std::atomic<int32_t>* pending_;
+  };
+
+  // On its own cache line, the queues are locked by different threads.
+  struct alignas(64) WorkQueue {
+    std::mutex mutex_;
+    std::deque<Job> jobs_;
+  };
+
+  JobSystem();
+  JobSystem(const JobSystem&) = delete;
+  void operator=(const JobSystem&) = delete;
+
+  void WorkerLoop(int32_t index);
+
+  // The queue of the calling thread, or -1 when there is none left.
+  int32_t GetQueueIndex();
+
+  // Take a job from queue `index` if `steal`, from the front, or else from
+  // the back.
+  bool PopJob(int32_t index, bool steal, Job* job);
+
+  // Run one job of the own queue of `index`, or one stolen from another if
+  // `can_steal`. Returns false when there was nothing to run.
+  bool RunOneJob(int32_t index, bool can_steal);
+
+  static void RunJob(const Job& job);
+
+  std::vector<std::thread> workers_;
+  std::vector<int32_t> worker_tids_;
+  // The queues of the workers, then the ones of the external threads.
+  std::vector<std::unique_ptr<WorkQueue>> queues_;
+  std::atomic<int32_t> num_external_queues_;
+
+  // Sleeping workers wait for queued_jobs_ to become non zero.
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_cv_;
+  std::condition_variable started_cv_;
+  std::atomic<int32_t> queued_jobs_;
+  int32_t started_workers_;
+  bool stop_;
+
+  std::atomic<uint64_t> steal_count_;
+};
+
+#endif  // JOB_SYSTEM_H_
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "memory_tracker.h"
+
+namespace {
+const char* const kCategoryNames[MEMORY_CATEGORY_COUNT] = {
+    "GL buffers", "GL renderbuffers", "Physics arena", "Font atlas"};
+const char* const kPressureLevelNames[] = {"None", "Trim caches",
+                                           "Reduce content",
+                                           "Release graphics"};
+}  // namespace
+
+MemoryTracker* MemoryTracker::GetInstance() {
+  static MemoryTracker instance;
+  return &instance;
+}
+
+MemoryTracker::MemoryTracker()
+    : trim_level_(TRIM_MEMORY_NONE),
+      last_response_(MEMORY_PRESSURE_NONE),
+      last_freed_size_(0) {
+  for (auto& size : sizes_) {
+    size = 0;
+  }
+}
+
+int64_t MemoryTracker::GetTotalSize() const {
+  int64_t total = 0;
+  for (const auto& size : sizes_) {
+    total += size.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+const char* MemoryTracker::GetCategoryName(MemoryCategory category) {
+  return category >= 0 && category < MEMORY_CATEGORY_COUNT
+             ? kCategoryNames[category]
+             : "Unknown";
+}
+
+int32_t MemoryTracker::TakeTrimLevel() {
+  int32_t level = trim_level_.exchange(TRIM_MEMORY_NONE);
+  return level != TRIM_MEMORY_NONE ? level : TRIM_MEMORY_COMPLETE;
+}
+
+//--------------------------------------------------------------------------------
+// The RUNNING_* levels come while the app is in the foreground, and grow
+// with the pressure on the whole system. The others come once the UI is
+// hidden, and grow as the process gets closer to being killed: by then the
+// GL objects are not shown and rebuilding them is the app's problem only.
+//--------------------------------------------------------------------------------
+MemoryPressureLevel MemoryTracker::GetPressureLevel(int32_t trim_level,
+                                                    bool has_window) {
+  MemoryPressureLevel level = MEMORY_PRESSURE_NONE;
+  if (trim_level >= TRIM_MEMORY_COMPLETE) {
+    level = MEMORY_PRESSURE_RELEASE_GRAPHICS;
+  } else if (trim_level >= TRIM_MEMORY_MODERATE) {
+    level = MEMORY_PRESSURE_REDUCE_CONTENT;
+  } else if (trim_level >= TRIM_MEMORY_UI_HIDDEN) {
+    level = MEMORY_PRESSURE_TRIM_CACHES;
+  } else if (trim_level >= TRIM_MEMORY_RUNNING_LOW) {
+    level = MEMORY_PRESSURE_REDUCE_CONTENT;
+  } else if (trim_level >= TRIM_MEMORY_RUNNING_MODERATE) {
+    level = MEMORY_PRESSURE_TRIM_CACHES;
+  }
+  if (level == MEMORY_PRESSURE_RELEASE_GRAPHICS && has_window) {
+    level = MEMORY_PRESSURE_REDUCE_CONTENT;
+  }
+  return level;
+}
+
+const char* MemoryTracker::GetPressureLevelName(MemoryPressureLevel level) {
+  return level >= MEMORY_PRESSURE_NONE &&
+                 level <= MEMORY_PRESSURE_RELEASE_GRAPHICS
+             ? kPressureLevelNames[level]
+             : "Unknown";
+}
+
+void MemoryTracker::SetLastResponse(MemoryPressureLevel level,
+                                    int64_t freed_bytes) {
+  last_response_ = level;
+  last_freed_size_ = freed_bytes;
+}
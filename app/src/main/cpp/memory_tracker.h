@@ -0,0 +1,118 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEMORY_TRACKER_H_
+#define MEMORY_TRACKER_H_
+
+#include <atomic>
+#include <cstdint>
+
+// What the tracked memory is used for.
+enum MemoryCategory {
+  // Vertex, index and instance buffers.
+  MEMORY_CATEGORY_GL_BUFFERS = 0,
+  // The offscreen color and depth buffers of the dynamic resolution.
+  MEMORY_CATEGORY_GL_RENDERBUFFERS,
+  // Blocks of the arenas holding the rigid bodies.
+  MEMORY_CATEGORY_PHYSICS_ARENA,
+  // CPU copy of the ImGui font atlas, kept after it is uploaded.
+  MEMORY_CATEGORY_FONT_ATLAS,
+  MEMORY_CATEGORY_COUNT
+};
+
+// Same values as the android.content.ComponentCallbacks2.TRIM_MEMORY_*
+// constants.
+enum TrimMemoryLevel {
+  TRIM_MEMORY_NONE = 0,
+  TRIM_MEMORY_RUNNING_MODERATE = 5,
+  TRIM_MEMORY_RUNNING_LOW = 10,
+  TRIM_MEMORY_RUNNING_CRITICAL = 15,
+  TRIM_MEMORY_UI_HIDDEN = 20,
+  TRIM_MEMORY_BACKGROUND = 40,
+  TRIM_MEMORY_MODERATE = 60,
+  TRIM_MEMORY_COMPLETE = 80
+};
+
+// Graded responses to memory pressure, each one also does the ones before.
+enum MemoryPressureLevel {
+  MEMORY_PRESSURE_NONE = 0,
+  // Free what is rebuilt cheaply: the slack of the instance ring, the CPU
+  // copy of the font atlas.
+  MEMORY_PRESSURE_TRIM_CACHES,
+  // Lower the box count, and rebuild the physics world to give the memory
+  // of the parked bodies back.
+  MEMORY_PRESSURE_REDUCE_CONTENT,
+  // Drop all GL objects, they are recreated with the next frame. Only done
+  // while there is no window.
+  MEMORY_PRESSURE_RELEASE_GRAPHICS
+};
+
+/*
+ * Accounts for the larger allocations of the app by category, so the memory
+ * a pressure level frees can be seen, and passes the trim level reported to
+ * the activity on to the game loop.
+ *
+ * GameActivity turns onTrimMemory() and onLowMemory() into the same
+ * APP_CMD_LOW_MEMORY command, without the level: ADPFSampleActivity stores
+ * it here first with SetTrimLevel().
+ *
+ * Thread safe.
+ */
+class MemoryTracker {
+ public:
+  static MemoryTracker* GetInstance();
+
+  // Account for `bytes` more or less of a category.
+  void Allocate(MemoryCategory category, int64_t bytes) {
+    sizes_[category].fetch_add(bytes, std::memory_order_relaxed);
+  }
+  void Free(MemoryCategory category, int64_t bytes) {
+    sizes_[category].fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+  int64_t GetSize(MemoryCategory category) const {
+    return sizes_[category].load(std::memory_order_relaxed);
+  }
+  int64_t GetTotalSize() const;
+
+  static const char* GetCategoryName(MemoryCategory category);
+
+  // The level of the last onTrimMemory(), and take it. Without one, e.g.
+  // after onLowMemory(), TakeTrimLevel() returns TRIM_MEMORY_COMPLETE.
+  void SetTrimLevel(int32_t level) { trim_level_ = level; }
+  int32_t TakeTrimLevel();
+
+  // The response to a trim level. Graphics are only released while they
+  // are not shown.
+  static MemoryPressureLevel GetPressureLevel(int32_t trim_level,
+                                              bool has_window);
+  static const char* GetPressureLevelName(MemoryPressureLevel level);
+
+  // What the last response freed, for the UI.
+  void SetLastResponse(MemoryPressureLevel level, int64_t freed_bytes);
+  MemoryPressureLevel GetLastResponse() const { return last_response_; }
+  int64_t GetLastFreedSize() const { return last_freed_size_; }
+
+ private:
+  MemoryTracker();
+
+  std::atomic<int64_t> sizes_[MEMORY_CATEGORY_COUNT];
+  std::atomic<int32_t> trim_level_;
+  std::atomic<MemoryPressureLevel> last_response_;
+  std::atomic<int64_t> last_freed_size_;
+};
+
+#endif  // MEMORY_TRACKER_H_
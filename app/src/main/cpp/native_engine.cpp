@@ -15,13 +15,28 @@
  */
 #include "native_engine.h"
 
+#include <EGL/eglext.h>
 #include <android/window.h>
 
+#include "Trace.h"
+#include "adpf_manager.h"
+#include "asset_loader.h"
 #include "common.h"
+#include "cpu_topology.h"
 #include "demo_scene.h"
+#include "frame_telemetry.h"
+#include "game_mode_manager.h"
+#include "gl_state_cache.h"
 #include "imgui_manager.h"
+#include "input_queue.h"
 #include "input_util.h"
+#include "memory_tracker.h"
+#include "physics_task_scheduler.h"
+#include "physics_thread.h"
+#include "power_monitor.h"
+#include "render_thread.h"
 #include "scene_manager.h"
+#include "swappy_stats_collector.h"
 #include "welcome_scene.h"
 
 // verbose debug logs on?
@@ -36,6 +51,9 @@
 // max # of GL errors to print before giving up
 #define MAX_GL_ERRORS 200
 
+// the first frame after the window comes back should be shown within this
+static const float kResumeFrameBudgetMs = 100.0f;
+
 static bool all_motion_filter(const GameActivityMotionEvent *event) {
   // Process all motion events
   return true;
@@ -55,6 +73,13 @@ NativeEngine::NativeEngine(struct android_app *app) {
   mEglSurface = EGL_NO_SURFACE;
   mEglContext = EGL_NO_CONTEXT;
   mEglConfig = 0;
+  mHasSurfacelessContext = false;
+  mHasNoConfigContext = false;
+  mHasPresentationTime = false;
+  mSurfaceFormat = mRequestedSurfaceFormat = mConfigSurfaceFormat =
+      kDefaultSurfaceFormat;
+  mResumeStartTime = -1.0f;
+  mResumeKeptContext = false;
   mSurfWidth = mSurfHeight = 0;
   mSurfNativeWidth = mSurfNativeHeight = 0;
   mGameMode = 0;
@@ -65,6 +90,8 @@ NativeEngine::NativeEngine(struct android_app *app) {
   mImGuiManager = NULL;
   memset(&mState, 0, sizeof(mState));
   mIsFirstFrame = true;
+  mSwapError = EGL_SUCCESS;
+  mDrawDuration = 0;
 
   app->motionEventFilter = all_motion_filter;
 
@@ -81,6 +108,11 @@ NativeEngine::NativeEngine(struct android_app *app) {
   ALOGI("Calling SwappyGL_init");
   SwappyGL_init(GetJniEnv(), mApp->activity->javaGameActivity);
   SwappyGL_setSwapIntervalNS(SWAPPY_SWAP_60FPS);
+  FrameTelemetry::GetInstance()->AttachToSwappy();
+  SwappyStatsCollector::GetInstance()->Initialize();
+
+  // Scenes read their assets on the loader thread.
+  AssetLoader::GetInstance()->Initialize(mApp->activity->assetManager);
 
   VLOGD("NativeEngine: querying API level.");
   ALOGI("NativeEngine: API version %d.", mApiVersion);
@@ -93,14 +125,23 @@ NativeEngine *NativeEngine::GetInstance() {
 }
 
 NativeEngine::~NativeEngine() {
+  VLOGD("NativeEngine: destructor running");
+  // The context is current on the render thread, release it there once the
+  // frames in flight are drawn.
+  RenderThread *render_thread = RenderThread::GetInstance();
+  render_thread->Run([this]() {
+    KillContext();
+    if (mImGuiManager != NULL) {
+      delete mImGuiManager;
+      mImGuiManager = NULL;
+    }
+  });
+  render_thread->Stop();
+
   // Destroy Swappy instance.
   SwappyGL_destroy();
+  AssetLoader::GetInstance()->Shutdown();
 
-  VLOGD("NativeEngine: destructor running");
-  KillContext();
-  if (mImGuiManager != NULL) {
-    delete mImGuiManager;
-  }
   if (mJniEnv) {
     ALOGI("Detaching current thread from JNI.");
     mApp->activity->vm->DetachCurrentThread();
@@ -119,31 +160,14 @@ bool NativeEngine::IsAnimating() {
   return mHasFocus && mIsVisible && mHasWindow;
 }
 
+// The scene picks the events up at the start of its next frame, see
+// SceneManager::DoFrame().
 static bool _cooked_event_callback(struct CookedEvent *event) {
-  SceneManager *mgr = SceneManager::GetInstance();
-  PointerCoords coords;
-  memset(&coords, 0, sizeof(coords));
-  coords.x_ = event->motion_x_;
-  coords.y_ = event->motion_y_;
-  coords.min_x_ = event->motion_min_x_;
-  coords.max_x_ = event->motion_max_x_;
-  coords.min_y_ = event->motion_min_y_;
-  coords.max_y_ = event->motion_max_y_;
-  coords.is_screen_ = event->motion_is_on_screen_;
-
-  switch (event->type_) {
-    case COOKED_EVENT_TYPE_POINTER_DOWN:
-      mgr->OnPointerDown(event->motion_pointer_id_, &coords);
-      return true;
-    case COOKED_EVENT_TYPE_POINTER_UP:
-      mgr->OnPointerUp(event->motion_pointer_id_, &coords);
-      return true;
-    case COOKED_EVENT_TYPE_POINTER_MOVE:
-      mgr->OnPointerMove(event->motion_pointer_id_, &coords);
-      return true;
-    default:
-      return false;
+  if (!InputQueue::GetInstance()->Push(*event)) {
+    VLOGD("NativeEngine: input queue full, event dropped.");
+    return false;
   }
+  return true;
 }
 
 // This is here and not in input_util.cpp due to being specific to the
@@ -193,6 +217,15 @@ static bool _cook_game_activity_motion_event(
 }
 
 void NativeEngine::GameLoop() {
+  CpuTopology::GetInstance()->PinCurrentThread(THREAD_ROLE_RENDER);
+  // Before a scene builds a physics world, on another thread. The
+  // simulation thread is started once per process, after it.
+  PhysicsTaskScheduler::Install();
+  PhysicsThread::GetInstance()->Start();
+  // After the ADPFManager is initialized, to join the game thread's hint
+  // session.
+  RenderThread::GetInstance()->Start(
+      mApp->activity->vm, [this](RenderFrame *frame) { DrawFrame(frame); });
   mApp->userData = this;
   mApp->onAppCmd = _handle_cmd_proxy;
   // mApp->onInputEvent = _handle_input_proxy;
@@ -210,20 +243,26 @@ void NativeEngine::GameLoop() {
     struct android_poll_source *source;
 
     // If not animating, block until we get an event; if animating, don't block.
-    while ((ALooper_pollAll(IsAnimating() ? 0 : -1, NULL, &events,
-                            (void **)&source)) >= 0) {
-      // process event
-      if (source != NULL) {
-        source->process(mApp, source);
-      }
+    {
+      SAMPLES_TRACE_SCOPE("GameLoop::Poll");
+      while ((ALooper_pollAll(IsAnimating() ? 0 : -1, NULL, &events,
+                              (void **)&source)) >= 0) {
+        // process event
+        if (source != NULL) {
+          source->process(mApp, source);
+        }
 
-      // are we exiting?
-      if (mApp->destroyRequested) {
-        return;
+        // are we exiting?
+        if (mApp->destroyRequested) {
+          return;
+        }
       }
     }
 
-    HandleGameActivityInput();
+    {
+      SAMPLES_TRACE_SCOPE("GameLoop::Input");
+      HandleGameActivityInput();
+    }
 
     if (IsAnimating()) {
       DoFrame();
@@ -277,6 +316,10 @@ void NativeEngine::HandleCommand(int32_t cmd) {
       VLOGD("NativeEngine: APP_CMD_INIT_WINDOW");
       if (mApp->window != NULL) {
         mHasWindow = true;
+        if (!mIsFirstFrame) {
+          mResumeStartTime = Clock();
+          mResumeKeptContext = mEglContext != EGL_NO_CONTEXT && mHasGLObjects;
+        }
 
         // Set the window to Swappy instance.
         SwappyGL_setWindow(mApp->window);
@@ -297,13 +340,16 @@ void NativeEngine::HandleCommand(int32_t cmd) {
     case APP_CMD_TERM_WINDOW:
       // The window is going away -- kill the surface
       VLOGD("NativeEngine: APP_CMD_TERM_WINDOW");
-      KillSurface();
+      RenderThread::GetInstance()->Run([this]() { KillSurface(); });
       mHasWindow = false;
       break;
     case APP_CMD_GAINED_FOCUS:
       VLOGD("NativeEngine: APP_CMD_GAINED_FOCUS");
       mHasFocus = true;
       mState.mHasFocus = appState.mHasFocus = mHasFocus;
+      // Focus comes back when the Game Dashboard closes, the game mode may
+      // have changed.
+      mGameMode = GameModeManager::GetInstance()->Refresh();
       break;
     case APP_CMD_LOST_FOCUS:
       VLOGD("NativeEngine: APP_CMD_LOST_FOCUS");
@@ -317,6 +363,7 @@ void NativeEngine::HandleCommand(int32_t cmd) {
       break;
     case APP_CMD_RESUME:
       VLOGD("NativeEngine: APP_CMD_RESUME");
+      mGameMode = GameModeManager::GetInstance()->Refresh();
       mgr->OnResume();
       break;
     case APP_CMD_STOP:
@@ -339,11 +386,10 @@ void NativeEngine::HandleCommand(int32_t cmd) {
       break;
     case APP_CMD_LOW_MEMORY:
       VLOGD("NativeEngine: APP_CMD_LOW_MEMORY");
-      // system told us we have low memory. So if we are not visible, let's
-      // cooperate by deallocating all of our graphic resources.
-      if (!mHasWindow) {
-        VLOGD("NativeEngine: trimming memory footprint (deleting GL objects).");
-        KillGLObjects();
+      {
+        const int32_t level = MemoryTracker::GetInstance()->TakeTrimLevel();
+        RenderThread::GetInstance()->Run(
+            [this, level]() { HandleMemoryPressure(level); });
       }
       break;
     case APP_CMD_WINDOW_INSETS_CHANGED:
@@ -391,6 +437,10 @@ void NativeEngine::HandleGameActivityInput() {
   }
 }
 
+static bool _has_egl_extension(const char *extensions, const char *name) {
+  return extensions != nullptr && strstr(extensions, name) != nullptr;
+}
+
 bool NativeEngine::InitDisplay() {
   if (mEglDisplay != EGL_NO_DISPLAY) {
     // nothing to do
@@ -405,6 +455,21 @@ bool NativeEngine::InitDisplay() {
     return false;
   }
 
+  const char *extensions = eglQueryString(mEglDisplay, EGL_EXTENSIONS);
+  mHasSurfacelessContext =
+      _has_egl_extension(extensions, "EGL_KHR_surfaceless_context");
+  mHasNoConfigContext =
+      _has_egl_extension(extensions, "EGL_KHR_no_config_context");
+  // Swappy sets the presentation time of each frame through it, so frames
+  // are queued for the vsync they are paced to rather than the next one.
+  mHasPresentationTime =
+      _has_egl_extension(extensions, "EGL_ANDROID_presentation_time");
+  ALOGI("NativeEngine: surfaceless context %s, no config context %s, "
+        "presentation time %s.",
+        mHasSurfacelessContext ? "supported" : "not supported",
+        mHasNoConfigContext ? "supported" : "not supported",
+        mHasPresentationTime ? "supported" : "not supported");
+
   return true;
 }
 
@@ -420,25 +485,15 @@ bool NativeEngine::InitSurface() {
 
   ALOGI("NativeEngine: initializing surface.");
 
-  EGLint numConfigs;
-
-  const EGLint attribs[] = {EGL_RENDERABLE_TYPE,
-                            EGL_OPENGL_ES2_BIT,  // request OpenGL ES 2.0
-                            EGL_SURFACE_TYPE,
-                            EGL_WINDOW_BIT,
-                            EGL_BLUE_SIZE,
-                            8,
-                            EGL_GREEN_SIZE,
-                            8,
-                            EGL_RED_SIZE,
-                            8,
-                            EGL_DEPTH_SIZE,
-                            16,
-                            EGL_NONE};
-
-  // since this is a simple sample, we have a trivial selection process. We pick
-  // the first EGLConfig that matches:
-  eglChooseConfig(mEglDisplay, attribs, &mEglConfig, 1, &numConfigs);
+  // A kept context only works with surfaces of the config it was created
+  // with, unless it was created without one.
+  if (mEglConfig == 0 || (CanChangeSurfaceFormat() &&
+                          mRequestedSurfaceFormat != mConfigSurfaceFormat)) {
+    if (!ChooseConfig()) {
+      ALOGE("NativeEngine: no EGL config, EGL error %d", eglGetError());
+      return false;
+    }
+  }
 
   // create EGL surface
   mEglSurface =
@@ -458,13 +513,36 @@ bool NativeEngine::InitSurface() {
   return true;
 }
 
+//--------------------------------------------------------------------------------
+// Prefer OpenGL ES 3.0, which enables instanced box rendering, and fall back
+// to OpenGL ES 2.0. A format the display lacks falls back to a cheaper one.
+//--------------------------------------------------------------------------------
+bool NativeEngine::ChooseConfig() {
+  mConfigSurfaceFormat = mRequestedSurfaceFormat;
+  const EGLint renderableTypes[] = {EGL_OPENGL_ES3_BIT, EGL_OPENGL_ES2_BIT};
+  for (EGLint renderableType : renderableTypes) {
+    for (auto format = static_cast<int32_t>(mRequestedSurfaceFormat);
+         format < SURFACE_FORMAT_COUNT; ++format) {
+      if (ChooseSurfaceConfig(mEglDisplay, static_cast<SurfaceFormat>(format),
+                              renderableType, &mEglConfig)) {
+        mSurfaceFormat = static_cast<SurfaceFormat>(format);
+        ALOGI("NativeEngine: surface format %s.",
+              kSurfaceFormatNames[mSurfaceFormat]);
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool NativeEngine::CanChangeSurfaceFormat() {
+  return mEglContext == EGL_NO_CONTEXT || mHasNoConfigContext;
+}
+
 bool NativeEngine::InitContext() {
   // need a display
   MY_ASSERT(mEglDisplay != EGL_NO_DISPLAY);
 
-  EGLint attribList[] = {EGL_CONTEXT_CLIENT_VERSION, 2,
-                         EGL_NONE};  // OpenGL ES 2.0
-
   if (mEglContext != EGL_NO_CONTEXT) {
     // nothing to do
     ALOGI("NativeEngine: no need to init context (already had one).");
@@ -473,25 +551,60 @@ bool NativeEngine::InitContext() {
 
   ALOGI("NativeEngine: initializing context.");
 
-  // create EGL context
-  mEglContext = eglCreateContext(mEglDisplay, mEglConfig, NULL, attribList);
+  // create an OpenGL ES 3.0 context when the config supports it, otherwise
+  // an OpenGL ES 2.0 context
+  EGLint renderableType = 0;
+  eglGetConfigAttrib(mEglDisplay, mEglConfig, EGL_RENDERABLE_TYPE,
+                     &renderableType);
+  EGLint clientVersion = (renderableType & EGL_OPENGL_ES3_BIT) ? 3 : 2;
+  EGLint attribList[] = {EGL_CONTEXT_CLIENT_VERSION, clientVersion, EGL_NONE};
+
+  // create EGL context. Without a config, it can be bound to surfaces of any
+  // format.
+  EGLConfig config = mHasNoConfigContext ? EGL_NO_CONFIG_KHR : mEglConfig;
+  mEglContext = eglCreateContext(mEglDisplay, config, NULL, attribList);
+  if (mEglContext == EGL_NO_CONTEXT && clientVersion == 3) {
+    ALOGW("NativeEngine: failed to create ES 3.0 context, trying ES 2.0.");
+    attribList[1] = 2;
+    mEglContext = eglCreateContext(mEglDisplay, config, NULL, attribList);
+  }
   if (mEglContext == EGL_NO_CONTEXT) {
     ALOGE("Failed to create EGL context, EGL error %d", eglGetError());
     return false;
   }
 
-  ALOGI("NativeEngine: successfully initialized context.");
+  ALOGI("NativeEngine: successfully initialized context (ES %d.0).",
+        attribList[1]);
 
   return true;
 }
 
 void NativeEngine::ConfigureOpenGL() {
+  GLStateCache* state = GLStateCache::GetInstance();
+  state->Initialize();
   glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-  glEnable(GL_DEPTH_TEST);
+  state->Enable(GL_DEPTH_TEST);
   glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 }
 
+bool NativeEngine::IsReadyToRender() {
+  return mEglDisplay != EGL_NO_DISPLAY && mEglSurface != EGL_NO_SURFACE &&
+         mEglContext != EGL_NO_CONTEXT && mHasGLObjects &&
+         mImGuiManager != NULL &&
+         (mRequestedSurfaceFormat == mConfigSurfaceFormat ||
+          !CanChangeSurfaceFormat());
+}
+
 bool NativeEngine::PrepareToRender() {
+  // A new format only needs a new surface, the context and GL objects are
+  // kept.
+  if (mEglSurface != EGL_NO_SURFACE &&
+      mRequestedSurfaceFormat != mConfigSurfaceFormat &&
+      CanChangeSurfaceFormat()) {
+    ALOGI("NativeEngine: recreating surface as %s.",
+          kSurfaceFormatNames[mRequestedSurfaceFormat]);
+    KillSurface();
+  }
   if (mEglDisplay == EGL_NO_DISPLAY || mEglSurface == EGL_NO_SURFACE ||
       mEglContext == EGL_NO_CONTEXT) {
     // create display if needed
@@ -506,7 +619,8 @@ bool NativeEngine::PrepareToRender() {
       return false;
     }
 
-    // create context if needed
+    // create context if needed. A kept context still has its GL state.
+    const bool new_context = mEglContext == EGL_NO_CONTEXT;
     if (!InitContext()) {
       ALOGE("NativeEngine: failed to create context.");
       return false;
@@ -525,7 +639,9 @@ bool NativeEngine::PrepareToRender() {
     }
 
     // configure our global OpenGL settings
-    ConfigureOpenGL();
+    if (new_context) {
+      ConfigureOpenGL();
+    }
 
     if (mImGuiManager == NULL) {
       mImGuiManager = new ImGuiManager();
@@ -539,9 +655,6 @@ bool NativeEngine::PrepareToRender() {
     }
   }
 
-  // Keep the ImGui display size up to date
-  mImGuiManager->SetDisplaySize(mSurfWidth, mSurfHeight, mScreenDensity);
-
   // ready to render
   return true;
 }
@@ -554,9 +667,50 @@ void NativeEngine::KillGLObjects() {
   }
 }
 
+//--------------------------------------------------------------------------------
+// Recreating the GL objects compiles shaders again and stalls the next frame,
+// so lighter levels free caches and content first. The GL objects are only
+// dropped on the last level, when the app is not visible.
+//--------------------------------------------------------------------------------
+void NativeEngine::HandleMemoryPressure(int32_t trim_level) {
+  MemoryTracker *tracker = MemoryTracker::GetInstance();
+  MemoryPressureLevel level =
+      MemoryTracker::GetPressureLevel(trim_level, mHasWindow);
+  if (level == MEMORY_PRESSURE_NONE) {
+    return;
+  }
+  const int64_t previous_size = tracker->GetTotalSize();
+  if (mImGuiManager != NULL) {
+    mImGuiManager->TrimMemory();
+  }
+  if (mHasGLObjects && IsContextCurrent()) {
+    SceneManager::GetInstance()->TrimMemory(level);
+  }
+  if (level == MEMORY_PRESSURE_RELEASE_GRAPHICS) {
+    // Without a current context the GL objects can't be deleted, destroying
+    // the context frees them instead.
+    if (IsContextCurrent()) {
+      KillGLObjects();
+    } else {
+      KillContext();
+    }
+  }
+  const int64_t freed_size = previous_size - tracker->GetTotalSize();
+  tracker->SetLastResponse(level, freed_size);
+  ALOGI("NativeEngine: trim level %d, %s, freed %lld KB", trim_level,
+        MemoryTracker::GetPressureLevelName(level),
+        static_cast<long long>(freed_size / 1024));
+}
+
+//--------------------------------------------------------------------------------
+// The context is kept, and stays current without a surface when the driver
+// allows it: a new window only needs a new surface, the buffers, programs and
+// scene survive.
+//--------------------------------------------------------------------------------
 void NativeEngine::KillSurface() {
   ALOGI("NativeEngine: killing surface.");
-  eglMakeCurrent(mEglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  EGLContext context = mHasSurfacelessContext ? mEglContext : EGL_NO_CONTEXT;
+  eglMakeCurrent(mEglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
   if (mEglSurface != EGL_NO_SURFACE) {
     eglDestroySurface(mEglDisplay, mEglSurface);
     mEglSurface = EGL_NO_SURFACE;
@@ -589,10 +743,21 @@ void NativeEngine::KillDisplay() {
     ALOGI("NativeEngine: terminating display now.");
     eglTerminate(mEglDisplay);
     mEglDisplay = EGL_NO_DISPLAY;
+    mEglConfig = 0;
+    mHasSurfacelessContext = false;
+    mHasNoConfigContext = false;
+    mHasPresentationTime = false;
   }
   ALOGI("NativeEngine: display killed successfully.");
 }
 
+bool NativeEngine::IsContextCurrent() {
+  if (mEglContext == EGL_NO_CONTEXT) {
+    return false;
+  }
+  return mEglSurface != EGL_NO_SURFACE || mHasSurfacelessContext;
+}
+
 bool NativeEngine::HandleEglError(EGLint error) {
   switch (error) {
     case EGL_SUCCESS:
@@ -687,18 +852,34 @@ void NativeEngine::SwitchToPreferredDisplaySize() {
     mSurfWidth = width;
     mSurfHeight = height;
     mgr->SetScreenSize(mSurfWidth, mSurfHeight);
-    glViewport(0, 0, mSurfWidth, mSurfHeight);
   }
 }
 
 void NativeEngine::DoFrame() {
-  // prepare to render (create context, surfaces, etc, if needed)
-  if (!PrepareToRender()) {
-    // not ready
-    VLOGD("NativeEngine: preparation to render failed.");
-    return;
+  SAMPLES_TRACE_SCOPE("NativeEngine::DoFrame");
+  RenderThread *render_thread = RenderThread::GetInstance();
+
+  // a swap failed on the render thread since the last frame
+  const EGLint swap_error = mSwapError.exchange(EGL_SUCCESS);
+  if (swap_error != EGL_SUCCESS) {
+    render_thread->Run([this, swap_error]() { HandleEglError(swap_error); });
+  }
+
+  // prepare to render (create context, surfaces, etc, if needed), on the
+  // render thread, which the context is current on
+  if (!IsReadyToRender()) {
+    bool ready = false;
+    render_thread->Run([this, &ready]() { ready = PrepareToRender(); });
+    if (!ready) {
+      // not ready
+      VLOGD("NativeEngine: preparation to render failed.");
+      return;
+    }
   }
 
+  // Keep the ImGui display size up to date
+  mImGuiManager->SetDisplaySize(mSurfWidth, mSurfHeight, mScreenDensity);
+
   SceneManager *mgr = SceneManager::GetInstance();
   //  ImGuiManager *guiManager = NativeEngine::GetInstance()->GetImGuiManager();
 
@@ -711,17 +892,60 @@ void NativeEngine::DoFrame() {
     mgr->RequestNewScene(new WelcomeScene());
   }
 
-  // render!
+  // record the frame while the render thread draws the previous one. The
+  // CPU work of the frame is reported to the hint session: the longer of
+  // the two threads' work sets the pace.
+  RenderFrame *frame = render_thread->BeginFrame();
+  frame->SetViewport(0, 0, mSurfWidth, mSurfHeight);
+  ADPFManager* adpf_manager = ADPFManager::GetInstance();
+  adpf_manager->BeginPerfHintSession();
   mgr->DoFrame();
+  adpf_manager->EndPerfHintSession(mDrawDuration);
 
   if (mImGuiManager != NULL) {
     mImGuiManager->EndImGuiFrame();
   }
+  render_thread->SubmitFrame();
+
+  FrameTelemetry::GetInstance()->EndFrame(
+      adpf_manager->GetThermalStatus(), adpf_manager->GetThermalHeadroom(),
+      mgr->GetPreferredSwapInterval());
+  SwappyStatsCollector::GetInstance()->Update();
+  PowerMonitor::GetInstance()->RecordFrame();
+
+  if (mResumeStartTime >= 0.0f) {
+    const float resume_ms = (Clock() - mResumeStartTime) * 1000.0f;
+    ALOGI("NativeEngine: first frame %.1f ms after resume, context %s.",
+          resume_ms, mResumeKeptContext ? "kept" : "recreated");
+    if (resume_ms > kResumeFrameBudgetMs) {
+      ALOGW("NativeEngine: resume took longer than %.0f ms.",
+            kResumeFrameBudgetMs);
+    }
+    mResumeStartTime = -1.0f;
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Runs on the render thread. A failed swap is left to the game thread, which
+// recreates what was lost through RenderThread::Run() before its next frame.
+//--------------------------------------------------------------------------------
+void NativeEngine::DrawFrame(RenderFrame *frame) {
+  SAMPLES_TRACE_SCOPE("NativeEngine::DrawFrame");
+  SwappyStatsCollector::GetInstance()->RecordFrameStart(mEglDisplay,
+                                                        mEglSurface);
+  const int64_t draw_start_ns = FrameTelemetry::GetNanos();
+  frame->Execute();
+  mDrawDuration = FrameTelemetry::GetNanos() - draw_start_ns;
 
   // swap buffers
-  if (!SwappyGL_swap(mEglDisplay, mEglSurface)) {  // failed to swap buffers...
-    ALOGW("NativeEngine: SwappyGL_swap failed, EGL error %d", eglGetError());
-    HandleEglError(eglGetError());
+  {
+    SAMPLES_TRACE_SCOPE("NativeEngine::Swap");
+    TelemetryScope scope(TELEMETRY_PHASE_SWAP);
+    if (!SwappyGL_swap(mEglDisplay, mEglSurface)) {  // failed to swap...
+      const EGLint error = eglGetError();
+      ALOGW("NativeEngine: SwappyGL_swap failed, EGL error %d", error);
+      mSwapError = error;
+    }
   }
 
   // print out GL errors, if any
@@ -17,10 +17,14 @@
 #ifndef NATIVE_ENGINE_H_
 #define NATIVE_ENGINE_H_
 
+#include <atomic>
+
 #include "common.h"
+#include "surface_format.h"
 #include "swappy/swappyGL.h"
 
 class ImGuiManager;
+class RenderFrame;
 
 struct NativeEngineSavedState {
   bool mHasFocus;
@@ -60,6 +64,20 @@ class NativeEngine {
   // Return the current system bar offset
   int GetSystemBarOffset() { return mSystemBarOffset; }
 
+  // Framebuffer format of the window surface. A new format is applied at the
+  // start of the next frame by recreating the surface, which needs
+  // EGL_KHR_no_config_context once the context exists. Formats the display
+  // lacks fall back to cheaper ones.
+  bool CanChangeSurfaceFormat();
+  void RequestSurfaceFormat(SurfaceFormat format) {
+    mRequestedSurfaceFormat = format;
+  }
+  SurfaceFormat GetRequestedSurfaceFormat() { return mRequestedSurfaceFormat; }
+  SurfaceFormat GetSurfaceFormat() { return mSurfaceFormat; }
+
+  // Does Swappy queue the frames with EGL_ANDROID_presentation_time?
+  bool HasPresentationTime() { return mHasPresentationTime; }
+
  private:
   // variables to track Android lifecycle:
   bool mHasFocus, mIsVisible, mHasWindow;
@@ -79,6 +97,28 @@ class NativeEngine {
   EGLContext mEglContext;
   EGLConfig mEglConfig;
 
+  // EGL_KHR_surfaceless_context: the context stays current while there is no
+  // window, so it outlives the surface.
+  bool mHasSurfacelessContext;
+
+  // EGL_KHR_no_config_context: the context is bound to surfaces of any
+  // format, so changing the format only recreates the surface.
+  bool mHasNoConfigContext;
+
+  bool mHasPresentationTime;
+
+  // format of mEglConfig, the one asked for, and the request mEglConfig was
+  // chosen for (which may have fallen back to a cheaper format)
+  SurfaceFormat mSurfaceFormat;
+  SurfaceFormat mRequestedSurfaceFormat;
+  SurfaceFormat mConfigSurfaceFormat;
+
+  // Clock() time the window came back, -1 when not resuming.
+  float mResumeStartTime;
+
+  // did the context and GL objects survive while the window was away?
+  bool mResumeKeptContext;
+
   // known surface size
   int mSurfWidth, mSurfHeight;
 
@@ -111,12 +151,21 @@ class NativeEngine {
   // is this the first frame we're drawing?
   bool mIsFirstFrame;
 
+  // set by the render thread: EGL error of the last failed swap (handled by
+  // the game thread before its next frame), and how long the GL calls of
+  // the last frame drawn took, in ns
+  std::atomic<EGLint> mSwapError;
+  std::atomic<int64_t> mDrawDuration;
+
   // initialize the display
   bool InitDisplay();
 
   // initialize surface. Requires display to have been initialized first.
   bool InitSurface();
 
+  // pick mEglConfig for mRequestedSurfaceFormat
+  bool ChooseConfig();
+
   // initialize context. Requires display to have been initialized first.
   bool InitContext();
 
@@ -127,18 +176,31 @@ class NativeEngine {
 
   void KillDisplay();  // also causes context and surface to get killed
 
+  // is there a current context to issue GL calls to, with or without a
+  // surface?
+  bool IsContextCurrent();
+
   bool HandleEglError(EGLint error);
 
   bool InitGLObjects();
 
   void KillGLObjects();
 
+  // Respond to an onTrimMemory() level, freeing more the higher it is.
+  void HandleMemoryPressure(int32_t trim_level);
+
   void ConfigureOpenGL();
 
+  // does PrepareToRender() have nothing to create?
+  bool IsReadyToRender();
+
   bool PrepareToRender();
 
   void DoFrame();
 
+  // draw and present a frame the game thread recorded, on the render thread
+  void DrawFrame(RenderFrame *frame);
+
   void SwitchToPreferredDisplaySize();
 
   bool IsAnimating();
@@ -48,7 +48,9 @@ namespace ndk_helper {
     //---------------------------------------------------------------------------
     // Ctor
     //---------------------------------------------------------------------------
-    JNIHelper::JNIHelper() : app_(nullptr) {}
+    JNIHelper::JNIHelper() : app_(nullptr) {
+      pthread_key_create(&detach_key_, DetachCurrentThreadDtor);
+    }
 
     //---------------------------------------------------------------------------
     // Dtor
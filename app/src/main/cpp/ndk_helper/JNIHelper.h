@@ -66,6 +66,8 @@ namespace ndk_helper {
       std::string app_name_;
 
       android_app* app_;
+      // Detaches the threads AttachCurrentThread() attached when they exit.
+      pthread_key_t detach_key_;
       jobject jni_helper_java_ref_;
       jclass jni_helper_java_class_;
 
@@ -94,10 +96,14 @@ namespace ndk_helper {
        * Unregister this thread from the VM
        */
       static void DetachCurrentThreadDtor(void* p) {
-        LOGI("detached current thread");
         android_app* app = static_cast<android_app*>(p);
         JavaVM *vm = app->activity->vm;
-        vm->DetachCurrentThread();
+        // The thread may have detached itself already.
+        JNIEnv* env;
+        if (vm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_OK) {
+          LOGI("detached current thread");
+          vm->DetachCurrentThread();
+        }
       }
 
      public:
@@ -220,8 +226,8 @@ namespace ndk_helper {
 
       /*
        * Attach current thread
-       * In Android, the thread doesn't have to be 'Detach' current thread
-       * as application process is only killed and VM does not shut down
+       * The thread is detached when it exits: the VM aborts when a thread
+       * exits attached.
        */
       JNIEnv* AttachCurrentThread() {
         JNIEnv* env;
@@ -229,7 +235,7 @@ namespace ndk_helper {
         if (vm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_OK)
           return env;
         vm->AttachCurrentThread(&env, NULL);
-        pthread_key_create((int32_t*)app_, DetachCurrentThreadDtor);
+        pthread_setspecific(detach_key_, app_);
         return env;
       }
 
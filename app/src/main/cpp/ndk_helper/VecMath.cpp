@@ -19,8 +19,108 @@
 //--------------------------------------------------------------------------------
 #include "VecMath.h"
 
+#if defined(VECMATH_USE_NEON)
+#include <arm_neon.h>
+#elif defined(VECMATH_USE_SSE)
+#include <xmmintrin.h>
+#endif
+
 namespace ndk_helper {
 
+//--------------------------------------------------------------------------------
+// Mat4 kernels
+// A column major product is a linear combination of the columns of the left
+// matrix: column j of a * b is sum_k(a.column[k] * b[4 * j + k]). Each
+// implementation keeps the columns of `a` in registers and reads `b` one
+// column at a time, so `out` may alias either input.
+//--------------------------------------------------------------------------------
+    namespace {
+#if defined(VECMATH_USE_NEON)
+        struct Mat4Columns {
+            float32x4_t c0, c1, c2, c3;
+        };
+
+        inline Mat4Columns LoadColumns(const float *m) {
+            Mat4Columns c;
+            c.c0 = vld1q_f32(m);
+            c.c1 = vld1q_f32(m + 4);
+            c.c2 = vld1q_f32(m + 8);
+            c.c3 = vld1q_f32(m + 12);
+            return c;
+        }
+
+        inline void TransformColumn(const Mat4Columns &a, const float *v,
+                                    float *out) {
+            float32x4_t b = vld1q_f32(v);
+#if defined(__aarch64__)
+            float32x4_t r = vmulq_laneq_f32(a.c0, b, 0);
+            r = vfmaq_laneq_f32(r, a.c1, b, 1);
+            r = vfmaq_laneq_f32(r, a.c2, b, 2);
+            r = vfmaq_laneq_f32(r, a.c3, b, 3);
+#else
+            float32x4_t r = vmulq_lane_f32(a.c0, vget_low_f32(b), 0);
+            r = vmlaq_lane_f32(r, a.c1, vget_low_f32(b), 1);
+            r = vmlaq_lane_f32(r, a.c2, vget_high_f32(b), 0);
+            r = vmlaq_lane_f32(r, a.c3, vget_high_f32(b), 1);
+#endif
+            vst1q_f32(out, r);
+        }
+#elif defined(VECMATH_USE_SSE)
+        struct Mat4Columns {
+            __m128 c0, c1, c2, c3;
+        };
+
+        inline Mat4Columns LoadColumns(const float *m) {
+            Mat4Columns c;
+            c.c0 = _mm_loadu_ps(m);
+            c.c1 = _mm_loadu_ps(m + 4);
+            c.c2 = _mm_loadu_ps(m + 8);
+            c.c3 = _mm_loadu_ps(m + 12);
+            return c;
+        }
+
+        inline void TransformColumn(const Mat4Columns &a, const float *v,
+                                    float *out) {
+            __m128 r = _mm_mul_ps(a.c0, _mm_set1_ps(v[0]));
+            r = _mm_add_ps(r, _mm_mul_ps(a.c1, _mm_set1_ps(v[1])));
+            r = _mm_add_ps(r, _mm_mul_ps(a.c2, _mm_set1_ps(v[2])));
+            r = _mm_add_ps(r, _mm_mul_ps(a.c3, _mm_set1_ps(v[3])));
+            _mm_storeu_ps(out, r);
+        }
+#else
+        struct Mat4Columns {
+            float f[16];
+        };
+
+        inline Mat4Columns LoadColumns(const float *m) {
+            Mat4Columns c;
+            for (int32_t i = 0; i < 16; ++i) c.f[i] = m[i];
+            return c;
+        }
+
+        inline void TransformColumn(const Mat4Columns &a, const float *v,
+                                    float *out) {
+            const float x = v[0], y = v[1], z = v[2], w = v[3];
+            for (int32_t i = 0; i < 4; ++i) {
+                out[i] = a.f[i] * x + a.f[4 + i] * y + a.f[8 + i] * z +
+                         a.f[12 + i] * w;
+            }
+        }
+#endif
+
+        inline void MultiplyColumns(const Mat4Columns &a, const float *b,
+                                    float *out) {
+            TransformColumn(a, b, out);
+            TransformColumn(a, b + 4, out + 4);
+            TransformColumn(a, b + 8, out + 8);
+            TransformColumn(a, b + 12, out + 12);
+        }
+    }  // namespace
+
+    void Mat4::Multiply(const float *a, const float *b, float *out) {
+        MultiplyColumns(LoadColumns(a), b, out);
+    }
+
 //--------------------------------------------------------------------------------
 // vec3
 //--------------------------------------------------------------------------------
@@ -58,52 +158,15 @@ namespace ndk_helper {
 
     Mat4 Mat4::operator*(const Mat4 &rhs) const {
         Mat4 ret;
-        ret.f_[0] = f_[0] * rhs.f_[0] + f_[4] * rhs.f_[1] + f_[8] * rhs.f_[2] +
-                    f_[12] * rhs.f_[3];
-        ret.f_[1] = f_[1] * rhs.f_[0] + f_[5] * rhs.f_[1] + f_[9] * rhs.f_[2] +
-                    f_[13] * rhs.f_[3];
-        ret.f_[2] = f_[2] * rhs.f_[0] + f_[6] * rhs.f_[1] + f_[10] * rhs.f_[2] +
-                    f_[14] * rhs.f_[3];
-        ret.f_[3] = f_[3] * rhs.f_[0] + f_[7] * rhs.f_[1] + f_[11] * rhs.f_[2] +
-                    f_[15] * rhs.f_[3];
-
-        ret.f_[4] = f_[0] * rhs.f_[4] + f_[4] * rhs.f_[5] + f_[8] * rhs.f_[6] +
-                    f_[12] * rhs.f_[7];
-        ret.f_[5] = f_[1] * rhs.f_[4] + f_[5] * rhs.f_[5] + f_[9] * rhs.f_[6] +
-                    f_[13] * rhs.f_[7];
-        ret.f_[6] = f_[2] * rhs.f_[4] + f_[6] * rhs.f_[5] + f_[10] * rhs.f_[6] +
-                    f_[14] * rhs.f_[7];
-        ret.f_[7] = f_[3] * rhs.f_[4] + f_[7] * rhs.f_[5] + f_[11] * rhs.f_[6] +
-                    f_[15] * rhs.f_[7];
-
-        ret.f_[8] = f_[0] * rhs.f_[8] + f_[4] * rhs.f_[9] + f_[8] * rhs.f_[10] +
-                    f_[12] * rhs.f_[11];
-        ret.f_[9] = f_[1] * rhs.f_[8] + f_[5] * rhs.f_[9] + f_[9] * rhs.f_[10] +
-                    f_[13] * rhs.f_[11];
-        ret.f_[10] = f_[2] * rhs.f_[8] + f_[6] * rhs.f_[9] + f_[10] * rhs.f_[10] +
-                     f_[14] * rhs.f_[11];
-        ret.f_[11] = f_[3] * rhs.f_[8] + f_[7] * rhs.f_[9] + f_[11] * rhs.f_[10] +
-                     f_[15] * rhs.f_[11];
-
-        ret.f_[12] = f_[0] * rhs.f_[12] + f_[4] * rhs.f_[13] + f_[8] * rhs.f_[14] +
-                     f_[12] * rhs.f_[15];
-        ret.f_[13] = f_[1] * rhs.f_[12] + f_[5] * rhs.f_[13] + f_[9] * rhs.f_[14] +
-                     f_[13] * rhs.f_[15];
-        ret.f_[14] = f_[2] * rhs.f_[12] + f_[6] * rhs.f_[13] + f_[10] * rhs.f_[14] +
-                     f_[14] * rhs.f_[15];
-        ret.f_[15] = f_[3] * rhs.f_[12] + f_[7] * rhs.f_[13] + f_[11] * rhs.f_[14] +
-                     f_[15] * rhs.f_[15];
-
+        Multiply(f_, rhs.f_, ret.f_);
         return ret;
     }
 
     Vec4 Mat4::operator*(const Vec4 &rhs) const {
-        Vec4 ret;
-        ret.x_ = rhs.x_ * f_[0] + rhs.y_ * f_[4] + rhs.z_ * f_[8] + rhs.w_ * f_[12];
-        ret.y_ = rhs.x_ * f_[1] + rhs.y_ * f_[5] + rhs.z_ * f_[9] + rhs.w_ * f_[13];
-        ret.z_ = rhs.x_ * f_[2] + rhs.y_ * f_[6] + rhs.z_ * f_[10] + rhs.w_ * f_[14];
-        ret.w_ = rhs.x_ * f_[3] + rhs.y_ * f_[7] + rhs.z_ * f_[11] + rhs.w_ * f_[15];
-        return ret;
+        const float v[4] = {rhs.x_, rhs.y_, rhs.z_, rhs.w_};
+        float r[4];
+        TransformColumn(LoadColumns(f_), v, r);
+        return Vec4(r[0], r[1], r[2], r[3]);
     }
 
     Mat4 Mat4::Inverse() {
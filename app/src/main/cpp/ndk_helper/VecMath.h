@@ -28,11 +28,20 @@
 #include <cmath>
 #include "JNIHelper.h"
 
+// SIMD implementation of the Mat4 kernels, selected at compile time. Define
+// VECMATH_NO_SIMD to force the scalar fallback.
+#if !defined(VECMATH_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define VECMATH_USE_NEON 1
+#elif !defined(VECMATH_NO_SIMD) && (defined(__SSE__) || defined(__x86_64__))
+#define VECMATH_USE_SSE 1
+#endif
+
 namespace ndk_helper {
 
 /******************************************************************
  * Helper class for vector math operations
- * Currently all implementations are in pure C++.
+ * Mat4 products use NEON or SSE when available (see VecMath.cpp), everything
+ * else is in pure C++.
  * Each class is an opaque class so caller does not have a direct access
  * to each element. This is for an ease of future optimization to use vector
  *operations.
@@ -691,44 +700,7 @@ namespace ndk_helper {
         }
 
         Mat4 &operator*=(const Mat4 &rhs) {
-            Mat4 ret;
-            ret.f_[0] = f_[0] * rhs.f_[0] + f_[4] * rhs.f_[1] + f_[8] * rhs.f_[2] +
-                        f_[12] * rhs.f_[3];
-            ret.f_[1] = f_[1] * rhs.f_[0] + f_[5] * rhs.f_[1] + f_[9] * rhs.f_[2] +
-                        f_[13] * rhs.f_[3];
-            ret.f_[2] = f_[2] * rhs.f_[0] + f_[6] * rhs.f_[1] + f_[10] * rhs.f_[2] +
-                        f_[14] * rhs.f_[3];
-            ret.f_[3] = f_[3] * rhs.f_[0] + f_[7] * rhs.f_[1] + f_[11] * rhs.f_[2] +
-                        f_[15] * rhs.f_[3];
-
-            ret.f_[4] = f_[0] * rhs.f_[4] + f_[4] * rhs.f_[5] + f_[8] * rhs.f_[6] +
-                        f_[12] * rhs.f_[7];
-            ret.f_[5] = f_[1] * rhs.f_[4] + f_[5] * rhs.f_[5] + f_[9] * rhs.f_[6] +
-                        f_[13] * rhs.f_[7];
-            ret.f_[6] = f_[2] * rhs.f_[4] + f_[6] * rhs.f_[5] + f_[10] * rhs.f_[6] +
-                        f_[14] * rhs.f_[7];
-            ret.f_[7] = f_[3] * rhs.f_[4] + f_[7] * rhs.f_[5] + f_[11] * rhs.f_[6] +
-                        f_[15] * rhs.f_[7];
-
-            ret.f_[8] = f_[0] * rhs.f_[8] + f_[4] * rhs.f_[9] + f_[8] * rhs.f_[10] +
-                        f_[12] * rhs.f_[11];
-            ret.f_[9] = f_[1] * rhs.f_[8] + f_[5] * rhs.f_[9] + f_[9] * rhs.f_[10] +
-                        f_[13] * rhs.f_[11];
-            ret.f_[10] = f_[2] * rhs.f_[8] + f_[6] * rhs.f_[9] + f_[10] * rhs.f_[10] +
-                         f_[14] * rhs.f_[11];
-            ret.f_[11] = f_[3] * rhs.f_[8] + f_[7] * rhs.f_[9] + f_[11] * rhs.f_[10] +
-                         f_[15] * rhs.f_[11];
-
-            ret.f_[12] = f_[0] * rhs.f_[12] + f_[4] * rhs.f_[13] + f_[8] * rhs.f_[14] +
-                         f_[12] * rhs.f_[15];
-            ret.f_[13] = f_[1] * rhs.f_[12] + f_[5] * rhs.f_[13] + f_[9] * rhs.f_[14] +
-                         f_[13] * rhs.f_[15];
-            ret.f_[14] = f_[2] * rhs.f_[12] + f_[6] * rhs.f_[13] + f_[10] * rhs.f_[14] +
-                         f_[14] * rhs.f_[15];
-            ret.f_[15] = f_[3] * rhs.f_[12] + f_[7] * rhs.f_[13] + f_[11] * rhs.f_[14] +
-                         f_[15] * rhs.f_[15];
-
-            *this = ret;
+            Multiply(f_, rhs.f_, f_);
             return *this;
         }
 
@@ -788,6 +760,11 @@ namespace ndk_helper {
 
         float *Ptr() { return f_; }
 
+        const float *Ptr() const { return f_; }
+
+        // out = a * b on raw column major matrices. `out` may alias either.
+        static void Multiply(const float *a, const float *b, float *out);
+
         //--------------------------------------------------------------------------------
         // Misc
         //--------------------------------------------------------------------------------
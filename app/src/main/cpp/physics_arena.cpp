@@ -0,0 +1,70 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "physics_arena.h"
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wextra-semi"
+#include "LinearMath/btAlignedAllocator.h"
+#pragma GCC diagnostic pop
+
+#include "memory_tracker.h"
+
+namespace {
+// Blocks are allocated with this alignment, the largest Allocate() supports.
+const int32_t kBlockAlignment = 64;
+}  // namespace
+
+PhysicsArena::PhysicsArena()
+    : cursor_(nullptr), end_(nullptr), allocated_size_(0), reserved_size_(0) {}
+
+PhysicsArena::~PhysicsArena() { Release(); }
+
+//--------------------------------------------------------------------------------
+// Bump the cursor, starting a new block when the current one is full. The
+// blocks come from Bullet's allocator, like the rest of Bullet's memory.
+//--------------------------------------------------------------------------------
+void* PhysicsArena::Allocate(size_t size, size_t alignment) {
+  uintptr_t address = reinterpret_cast<uintptr_t>(cursor_);
+  uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+  if (cursor_ == nullptr ||
+      aligned + size > reinterpret_cast<uintptr_t>(end_)) {
+    size_t block_size = size > kBlockSize ? size : kBlockSize;
+    void* block = btAlignedAlloc(block_size, kBlockAlignment);
+    blocks_.push_back(block);
+    reserved_size_ += block_size;
+    MemoryTracker::GetInstance()->Allocate(MEMORY_CATEGORY_PHYSICS_ARENA,
+                                           block_size);
+    cursor_ = static_cast<uint8_t*>(block);
+    end_ = cursor_ + block_size;
+    aligned = reinterpret_cast<uintptr_t>(cursor_);
+  }
+  cursor_ = reinterpret_cast<uint8_t*>(aligned + size);
+  allocated_size_ += size;
+  return reinterpret_cast<void*>(aligned);
+}
+
+void PhysicsArena::Release() {
+  for (auto block : blocks_) {
+    btAlignedFree(block);
+  }
+  blocks_.clear();
+  MemoryTracker::GetInstance()->Free(MEMORY_CATEGORY_PHYSICS_ARENA,
+                                     reserved_size_);
+  cursor_ = end_ = nullptr;
+  allocated_size_ = 0;
+  reserved_size_ = 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHYSICS_ARENA_H_
+#define PHYSICS_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+ * Bump allocator for long lived physics objects (rigid bodies and their
+ * motion states). Objects are carved out of large blocks in allocation order,
+ * so objects created together sit next to each other in memory, and the whole
+ * arena is released at once by freeing its few blocks.
+ *
+ * There is no per-object free. New() only runs the constructor: the owner
+ * runs the destructors it needs before Release(). Not thread safe.
+ */
+class PhysicsArena {
+ public:
+  // Size of a block, enough for ~250 bodies plus their motion states.
+  static constexpr size_t kBlockSize = 256 * 1024;
+
+  PhysicsArena();
+  ~PhysicsArena();
+
+  // Returns `size` bytes aligned to `alignment` (a power of two, <= 64).
+  void* Allocate(size_t size, size_t alignment);
+
+  // Construct an object in the arena.
+  template <typename T, typename... Args>
+  T* New(Args&&... args) {
+    void* memory = Allocate(sizeof(T), Alignment<T>());
+    return new (memory) T(std::forward<Args>(args)...);
+  }
+
+  // Free all the blocks. Everything allocated so far becomes invalid.
+  void Release();
+
+  size_t GetAllocatedSize() const { return allocated_size_; }
+  // Size of the blocks, accounted as MEMORY_CATEGORY_PHYSICS_ARENA.
+  size_t GetReservedSize() const { return reserved_size_; }
+
+ private:
+  PhysicsArena(const PhysicsArena&) = delete;
+  PhysicsArena& operator=(const PhysicsArena&) = delete;
+
+  // Bullet's math types expect 16 byte alignment, whatever alignof() says.
+  template <typename T>
+  static constexpr size_t Alignment() {
+    return alignof(T) > 16 ? alignof(T) : 16;
+  }
+
+  std::vector<void*> blocks_;
+  uint8_t* cursor_;
+  uint8_t* end_;
+  size_t allocated_size_;
+  size_t reserved_size_;
+};
+
+#endif  // PHYSICS_ARENA_H_
@@ -0,0 +1,606 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Headless benchmark of the demo workload: the Bullet world of DemoScene
+ * and, optionally, the BoxRenderer drawing it into an EGL pbuffer.
+ *
+ * The world is built like DemoScene::InitializePhysics() and stepped like
+ * DemoScene::UpdatePhysics(), `--steps` sub-steps per tick, with a fixed
+ * seed for the spawn rotations, so two runs of the same options simulate
+ * the same thing. Per tick timings are written as JSON.
+ *
+ * The solver starts from a SolverTier, and each of its settings can be
+ * overridden, so the CPU time of a setting can be weighed against its
+ * stability: each tick also records the mean speed of the boxes (resting
+ * stacks that jitter keep moving) and the deepest contact penetration.
+ *
+ * Build it with -DADPF_BUILD_BENCHMARK=ON (-PnativeBenchmark=true from
+ * Gradle), then run it through adb, see the README.
+ */
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <string>
+#include <vector>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wextra-semi"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#pragma GCC diagnostic pop
+
+#include "asset_loader.h"
+#include "box_renderer.h"
+#include "broadphase.h"
+#include "gl_state_cache.h"
+#include "job_system.h"
+#include "physics_task_scheduler.h"
+#include "rigid_body_pool.h"
+#include "shape_cache.h"
+#include "solver_quality.h"
+
+namespace {
+// The workload of DemoScene.
+const float kPhysicsTickInterval = 1.f / 60.f;
+const float kWorldExtent = 128.f;
+const btScalar kGroundHalfSize = 50.f;
+const float kBoxSize = 0.5f;
+
+struct Options {
+  int32_t array_size_ = 8;
+  int32_t steps_ = 8;
+  int32_t ticks_ = 600;
+  int32_t warmup_ticks_ = 60;
+  BroadphaseType broadphase_ = BROADPHASE_DBVT;
+  bool multithreaded_ = false;
+  int32_t threads_ = 0;  // 0 uses all the job system threads
+  uint32_t seed_ = 1;
+  bool sleeping_ = false;
+  SolverTier solver_tier_ = SOLVER_TIER_HIGH;
+  SolverSettings solver_ = GetSolverSettings(SOLVER_TIER_HIGH);
+  bool render_ = false;
+  int32_t width_ = 1920;
+  int32_t height_ = 1080;
+  std::string assets_;
+  std::string output_;
+};
+
+// Timings of one measured tick.
+struct TickSample {
+  int64_t physics_ns_;
+  int64_t render_ns_;
+  int32_t awake_bodies_;
+  float mean_speed_;
+  float max_penetration_;
+};
+
+int64_t NowNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void PrintUsage(const char* name) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "  --array-size N   boxes per side of the spawn cube (8)\n"
+          "  --steps N        physics sub-steps per tick (8)\n"
+          "  --ticks N        measured ticks (600)\n"
+          "  --warmup N       ticks run before measuring (60)\n"
+          "  --broadphase B   Dbvt, AxisSweep3 or 32BitAxisSweep3 (Dbvt)\n"
+          "  --mt             use the multithreaded world\n"
+          "  --threads N      threads of the multithreaded world (all)\n"
+          "  --seed N         seed of the spawn rotations (1)\n"
+          "  --sleeping       let resting boxes deactivate\n"
+          "  --solver T       High, Medium, Low or Minimum solver tier (High)\n"
+          "  --iterations N   solver iterations (from the tier)\n"
+          "  --max-sub-steps N\n"
+          "                   maxSubSteps of stepSimulation (from the tier)\n"
+          "  --simd / --no-simd, --warm-starting / --no-warm-starting,\n"
+          "  --split-impulse / --no-split-impulse\n"
+          "                   override a solver setting of the tier\n"
+          "  --render         also draw the boxes into an EGL pbuffer\n"
+          "  --size WxH       pbuffer size (1920x1080)\n"
+          "  --assets DIR     directory holding the Shaders/ of the APK\n"
+          "  --output FILE    write the JSON there instead of stdout\n",
+          name);
+}
+
+// Looks up a name of `names`, case insensitive. Returns `count` if missing.
+int32_t FindName(const char* value, const char* const* names, int32_t count) {
+  auto index = 0;
+  while (index < count && strcasecmp(value, names[index]) != 0) {
+    ++index;
+  }
+  return index;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  // The tier sets the defaults of the solver settings, whatever the order of
+  // the arguments.
+  for (auto i = 1; i + 1 < argc; ++i) {
+    if (strcmp(argv[i], "--solver") == 0) {
+      auto tier = FindName(argv[i + 1], kSolverTierNames, SOLVER_TIER_COUNT);
+      if (tier == SOLVER_TIER_COUNT) {
+        fprintf(stderr, "Unknown solver tier %s\n", argv[i + 1]);
+        return false;
+      }
+      options->solver_tier_ = static_cast<SolverTier>(tier);
+      options->solver_ = GetSolverSettings(options->solver_tier_);
+    }
+  }
+  SolverSettings& solver = options->solver_;
+  for (auto i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    bool has_value = true;
+    if (strcmp(arg, "--array-size") == 0 && value) {
+      options->array_size_ = atoi(value);
+    } else if (strcmp(arg, "--steps") == 0 && value) {
+      options->steps_ = atoi(value);
+    } else if (strcmp(arg, "--ticks") == 0 && value) {
+      options->ticks_ = atoi(value);
+    } else if (strcmp(arg, "--warmup") == 0 && value) {
+      options->warmup_ticks_ = atoi(value);
+    } else if (strcmp(arg, "--broadphase") == 0 && value) {
+      auto type = FindName(value, kBroadphaseNames, BROADPHASE_COUNT);
+      if (type == BROADPHASE_COUNT) {
+        fprintf(stderr, "Unknown broadphase %s\n", value);
+        return false;
+      }
+      options->broadphase_ = static_cast<BroadphaseType>(type);
+    } else if (strcmp(arg, "--solver") == 0 && value) {
+      // Read above.
+    } else if (strcmp(arg, "--iterations") == 0 && value) {
+      solver.num_iterations_ = atoi(value);
+    } else if (strcmp(arg, "--max-sub-steps") == 0 && value) {
+      solver.max_sub_steps_ = atoi(value);
+    } else if (strcmp(arg, "--threads") == 0 && value) {
+      options->threads_ = atoi(value);
+    } else if (strcmp(arg, "--seed") == 0 && value) {
+      options->seed_ = static_cast<uint32_t>(strtoul(value, nullptr, 0));
+    } else if (strcmp(arg, "--size") == 0 && value) {
+      if (sscanf(value, "%dx%d", &options->width_, &options->height_) != 2) {
+        return false;
+      }
+    } else if (strcmp(arg, "--assets") == 0 && value) {
+      options->assets_ = value;
+    } else if (strcmp(arg, "--output") == 0 && value) {
+      options->output_ = value;
+    } else {
+      has_value = false;
+      if (strcmp(arg, "--mt") == 0) {
+        options->multithreaded_ = true;
+      } else if (strcmp(arg, "--sleeping") == 0) {
+        options->sleeping_ = true;
+      } else if (strcmp(arg, "--render") == 0) {
+        options->render_ = true;
+      } else if (strcmp(arg, "--simd") == 0 ||
+                 strcmp(arg, "--no-simd") == 0) {
+        solver.simd_ = arg[2] != 'n';
+      } else if (strcmp(arg, "--warm-starting") == 0 ||
+                 strcmp(arg, "--no-warm-starting") == 0) {
+        solver.warm_starting_ = arg[2] != 'n';
+      } else if (strcmp(arg, "--split-impulse") == 0 ||
+                 strcmp(arg, "--no-split-impulse") == 0) {
+        solver.split_impulse_ = arg[2] != 'n';
+      } else {
+        return false;
+      }
+    }
+    if (has_value) {
+      ++i;
+    }
+  }
+  if (options->render_ && options->assets_.empty()) {
+    fprintf(stderr, "--render needs --assets\n");
+    return false;
+  }
+  return options->array_size_ > 0 && options->steps_ > 0 &&
+         options->ticks_ > 0 && options->warmup_ticks_ >= 0 &&
+         solver.num_iterations_ > 0 && solver.max_sub_steps_ > 0 &&
+         options->width_ > 0 && options->height_ > 0;
+}
+
+/*
+ * The physics world of DemoScene: the ground and the pool of boxes.
+ */
+class BenchmarkWorld {
+ public:
+  explicit BenchmarkWorld(const Options& options);
+  ~BenchmarkWorld();
+
+  // One tick of the simulation thread, in `steps` sub-steps.
+  void Tick(int32_t steps);
+
+  // Mean linear speed of the boxes, and the deepest penetration of all the
+  // contacts of the last step.
+  float GetMeanSpeed() const;
+  float GetMaxPenetration() const;
+
+  const RigidBodyPool& GetPool() const { return *box_pool_; }
+  int32_t GetThreadCount() const {
+    return task_scheduler_ ? task_scheduler_->GetParallelism() : 1;
+  }
+
+ private:
+  PhysicsTaskScheduler* task_scheduler_;
+  btDefaultCollisionConfiguration* collision_configuration_;
+  btCollisionDispatcher* dispatcher_;
+  btBroadphaseInterface* broadphase_;
+  btConstraintSolverPoolMt* solver_pool_;
+  btSequentialImpulseConstraintSolver* solver_;
+  btDiscreteDynamicsWorld* dynamics_world_;
+  btRigidBody* ground_body_;
+  RigidBodyPool* box_pool_;
+  int32_t max_sub_steps_;
+};
+
+BenchmarkWorld::BenchmarkWorld(const Options& options)
+    : task_scheduler_(nullptr),
+      solver_pool_(nullptr),
+      max_sub_steps_(options.solver_.max_sub_steps_) {
+  collision_configuration_ = new btDefaultCollisionConfiguration();
+  broadphase_ = CreateBroadphase(
+      options.broadphase_,
+      btVector3(-kWorldExtent, -kWorldExtent, -kWorldExtent),
+      btVector3(kWorldExtent, kWorldExtent, kWorldExtent));
+  solver_ = new btSequentialImpulseConstraintSolver;
+  if (options.multithreaded_) {
+    // The scheduler must be installed before the Mt classes are created.
+    int32_t num_threads = options.threads_ > 0
+                              ? options.threads_
+                              : JobSystem::GetInstance()->GetNumThreads();
+    task_scheduler_ = new PhysicsTaskScheduler(num_threads);
+    btSetTaskScheduler(task_scheduler_);
+    dispatcher_ = new btCollisionDispatcherMt(collision_configuration_);
+    solver_pool_ =
+        new btConstraintSolverPoolMt(task_scheduler_->getNumThreads());
+    dynamics_world_ = new btDiscreteDynamicsWorldMt(
+        dispatcher_, broadphase_, solver_pool_, solver_,
+        collision_configuration_);
+  } else {
+    dispatcher_ = new btCollisionDispatcher(collision_configuration_);
+    dynamics_world_ = new btDiscreteDynamicsWorld(
+        dispatcher_, broadphase_, solver_, collision_configuration_);
+  }
+  dynamics_world_->setGravity(btVector3(0, -10, 0));
+  dynamics_world_->setForceUpdateAllAabbs(false);
+  ApplySolverSettings(options.solver_, dynamics_world_);
+
+  ShapeCache* shape_cache = ShapeCache::GetInstance();
+  btTransform ground_transform;
+  ground_transform.setIdentity();
+  ground_transform.setOrigin(btVector3(0, -56, 0));
+  btRigidBody::btRigidBodyConstructionInfo info(
+      0.f, new btDefaultMotionState(ground_transform),
+      shape_cache->GetBox(
+          btVector3(kGroundHalfSize, kGroundHalfSize, kGroundHalfSize)));
+  ground_body_ = new btRigidBody(info);
+  dynamics_world_->addRigidBody(ground_body_);
+
+  const int32_t count =
+      options.array_size_ * options.array_size_ * options.array_size_;
+  box_pool_ = new RigidBodyPool(
+      dynamics_world_,
+      shape_cache->GetBox(btVector3(kBoxSize, kBoxSize, kBoxSize)));
+  box_pool_->SetRandomSeed(options.seed_);
+  box_pool_->SetSleepingEnabled(options.sleeping_);
+  box_pool_->SetTargetCount(count, options.array_size_);
+  box_pool_->Update(count);
+}
+
+BenchmarkWorld::~BenchmarkWorld() {
+  delete box_pool_;
+  dynamics_world_->removeRigidBody(ground_body_);
+  delete ground_body_->getMotionState();
+  delete ground_body_;
+  delete dynamics_world_;
+  delete solver_;
+  delete solver_pool_;
+  delete broadphase_;
+  delete dispatcher_;
+  delete collision_configuration_;
+  // Bullet keeps using the scheduler until it is replaced.
+  if (task_scheduler_ != nullptr) {
+    btSetTaskScheduler(btGetSequentialTaskScheduler());
+    delete task_scheduler_;
+  }
+}
+
+void BenchmarkWorld::Tick(int32_t steps) {
+  const float step = kPhysicsTickInterval / steps;
+  for (auto i = 0; i < steps; ++i) {
+    dynamics_world_->stepSimulation(step, max_sub_steps_);
+  }
+}
+
+float BenchmarkWorld::GetMeanSpeed() const {
+  const int32_t count = box_pool_->GetActiveCount();
+  if (count == 0) {
+    return 0.f;
+  }
+  float sum = 0.f;
+  for (auto i = 0; i < count; ++i) {
+    sum += box_pool_->GetBody(i)->getLinearVelocity().length();
+  }
+  return sum / count;
+}
+
+float BenchmarkWorld::GetMaxPenetration() const {
+  float penetration = 0.f;
+  const int32_t num_manifolds = dispatcher_->getNumManifolds();
+  for (auto i = 0; i < num_manifolds; ++i) {
+    const btPersistentManifold* manifold =
+        dispatcher_->getManifoldByIndexInternal(i);
+    for (auto j = 0; j < manifold->getNumContacts(); ++j) {
+      penetration = std::max(
+          penetration, -manifold->getContactPoint(j).getDistance());
+    }
+  }
+  return penetration;
+}
+
+/*
+ * An OpenGL ES 3 context current on a pbuffer, no window needed.
+ */
+class PbufferContext {
+ public:
+  PbufferContext()
+      : display_(EGL_NO_DISPLAY),
+        surface_(EGL_NO_SURFACE),
+        context_(EGL_NO_CONTEXT) {}
+  ~PbufferContext();
+
+  bool Init(int32_t width, int32_t height);
+
+ private:
+  EGLDisplay display_;
+  EGLSurface surface_;
+  EGLContext context_;
+};
+
+bool PbufferContext::Init(int32_t width, int32_t height) {
+  display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display_ == EGL_NO_DISPLAY ||
+      !eglInitialize(display_, nullptr, nullptr)) {
+    return false;
+  }
+  const EGLint config_attribs[] = {EGL_SURFACE_TYPE,
+                                   EGL_PBUFFER_BIT,
+                                   EGL_RENDERABLE_TYPE,
+                                   EGL_OPENGL_ES3_BIT,
+                                   EGL_RED_SIZE,
+                                   8,
+                                   EGL_GREEN_SIZE,
+                                   8,
+                                   EGL_BLUE_SIZE,
+                                   8,
+                                   EGL_DEPTH_SIZE,
+                                   24,
+                                   EGL_NONE};
+  EGLConfig config;
+  EGLint num_configs = 0;
+  if (!eglChooseConfig(display_, config_attribs, &config, 1, &num_configs) ||
+      num_configs == 0) {
+    return false;
+  }
+  const EGLint surface_attribs[] = {EGL_WIDTH, width, EGL_HEIGHT, height,
+                                    EGL_NONE};
+  surface_ = eglCreatePbufferSurface(display_, config, surface_attribs);
+  const EGLint context_attribs[] = {EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE};
+  context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT,
+                              context_attribs);
+  if (surface_ == EGL_NO_SURFACE || context_ == EGL_NO_CONTEXT) {
+    return false;
+  }
+  return eglMakeCurrent(display_, surface_, surface_, context_) == EGL_TRUE;
+}
+
+PbufferContext::~PbufferContext() {
+  if (display_ == EGL_NO_DISPLAY) {
+    return;
+  }
+  eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (context_ != EGL_NO_CONTEXT) {
+    eglDestroyContext(display_, context_);
+  }
+  if (surface_ != EGL_NO_SURFACE) {
+    eglDestroySurface(display_, surface_);
+  }
+  eglTerminate(display_);
+}
+
+//--------------------------------------------------------------------------------
+// Draw every box, like DemoScene::RenderBoxes() with culling off. Waits for
+// the GPU, so the time includes the draw.
+//--------------------------------------------------------------------------------
+void RenderBoxes(BoxRenderer* renderer, const RigidBodyPool& pool) {
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  const int32_t count = pool.GetActiveCount();
+  const btVector3& half_extents = pool.GetHalfExtents();
+  renderer->ReserveInstances(count);
+  renderer->Update(0.f);
+  renderer->BeginMultipleRender();
+  for (auto i = 0; i < count; ++i) {
+    btTransform transform;
+    pool.GetBody(i)->getMotionState()->getWorldTransform(transform);
+    float matrix[16];
+    transform.getOpenGLMatrix(matrix);
+    auto c = ((i + 2) % 7 + 1);
+    float color[3] = {((c & 0x1) != 0) * 1.f, ((c & 0x2) != 0) * 1.f,
+                      ((c & 0x4) != 0) * 1.f};
+    renderer->RenderMultiple(matrix, half_extents.x() * 2,
+                             half_extents.y() * 2, half_extents.z() * 2,
+                             color);
+  }
+  renderer->EndMultipleRender();
+  glFinish();
+}
+
+// Mean and percentiles of a series of durations, in milliseconds.
+void WriteSummary(FILE* file, const char* name, std::vector<int64_t> values) {
+  std::sort(values.begin(), values.end());
+  double sum = 0;
+  for (auto value : values) {
+    sum += value;
+  }
+  auto percentile = [&values](double p) {
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[index] / 1e6;
+  };
+  fprintf(file,
+          "    \"%s\": {\"mean_ms\": %.4f, \"p50_ms\": %.4f, "
+          "\"p90_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f}",
+          name, sum / values.size() / 1e6, percentile(0.5), percentile(0.9),
+          percentile(0.99), values.back() / 1e6);
+}
+
+void WriteJson(FILE* file, const Options& options, int32_t num_threads,
+               int32_t num_boxes, const std::vector<TickSample>& samples) {
+  fprintf(file, "{\n  \"config\": {\n");
+  fprintf(file, "    \"array_size\": %d,\n", options.array_size_);
+  fprintf(file, "    \"boxes\": %d,\n", num_boxes);
+  fprintf(file, "    \"steps\": %d,\n", options.steps_);
+  fprintf(file, "    \"tick_interval_s\": %.6f,\n", kPhysicsTickInterval);
+  fprintf(file, "    \"broadphase\": \"%s\",\n",
+          kBroadphaseNames[options.broadphase_]);
+  fprintf(file, "    \"multithreaded\": %s,\n",
+          options.multithreaded_ ? "true" : "false");
+  fprintf(file, "    \"threads\": %d,\n", num_threads);
+  fprintf(file, "    \"seed\": %u,\n", options.seed_);
+  fprintf(file, "    \"sleeping\": %s,\n",
+          options.sleeping_ ? "true" : "false");
+  const SolverSettings& solver = options.solver_;
+  fprintf(file,
+          "    \"solver\": {\"tier\": \"%s\", \"iterations\": %d, "
+          "\"simd\": %s, \"warm_starting\": %s, \"split_impulse\": %s, "
+          "\"max_sub_steps\": %d},\n",
+          kSolverTierNames[options.solver_tier_], solver.num_iterations_,
+          solver.simd_ ? "true" : "false",
+          solver.warm_starting_ ? "true" : "false",
+          solver.split_impulse_ ? "true" : "false", solver.max_sub_steps_);
+  fprintf(file, "    \"render\": %s,\n", options.render_ ? "true" : "false");
+  fprintf(file, "    \"width\": %d,\n", options.width_);
+  fprintf(file, "    \"height\": %d,\n", options.height_);
+  fprintf(file, "    \"warmup_ticks\": %d\n  },\n", options.warmup_ticks_);
+
+  std::vector<int64_t> physics;
+  std::vector<int64_t> render;
+  double speed_sum = 0;
+  float max_penetration = 0.f;
+  for (const auto& sample : samples) {
+    physics.push_back(sample.physics_ns_);
+    render.push_back(sample.render_ns_);
+    speed_sum += sample.mean_speed_;
+    max_penetration = std::max(max_penetration, sample.max_penetration_);
+  }
+  fprintf(file, "  \"summary\": {\n");
+  WriteSummary(file, "physics", physics);
+  if (options.render_) {
+    fprintf(file, ",\n");
+    WriteSummary(file, "render", render);
+  }
+  fprintf(file,
+          ",\n    \"stability\": {\"mean_speed\": %.5f, "
+          "\"max_penetration\": %.5f}",
+          speed_sum / samples.size(), max_penetration);
+  fprintf(file, "\n  },\n  \"ticks\": [\n");
+  for (size_t i = 0; i < samples.size(); ++i) {
+    const TickSample& sample = samples[i];
+    fprintf(file,
+            "    {\"physics_ms\": %.4f, \"render_ms\": %.4f, "
+            "\"awake\": %d, \"speed\": %.5f, \"penetration\": %.5f}%s\n",
+            sample.physics_ns_ / 1e6, sample.render_ns_ / 1e6,
+            sample.awake_bodies_, sample.mean_speed_,
+            sample.max_penetration_, i + 1 < samples.size() ? "," : "");
+  }
+  fprintf(file, "  ]\n}\n");
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage(argv[0]);
+    return 2;
+  }
+
+  PbufferContext context;
+  BoxRenderer* renderer = nullptr;
+  if (options.render_) {
+    if (!context.Init(options.width_, options.height_)) {
+      fprintf(stderr, "Cannot create an OpenGL ES 3 pbuffer context\n");
+      return 1;
+    }
+    AssetLoader::GetInstance()->SetAssetDirectory(options.assets_);
+    GLStateCache::GetInstance()->Initialize();
+    GLStateCache::GetInstance()->Viewport(0, 0, options.width_,
+                                          options.height_);
+    renderer = new BoxRenderer();
+    renderer->Init();
+  }
+
+  BenchmarkWorld world(options);
+  for (auto tick = 0; tick < options.warmup_ticks_; ++tick) {
+    world.Tick(options.steps_);
+  }
+
+  std::vector<TickSample> samples(options.ticks_);
+  for (auto& sample : samples) {
+    int64_t start = NowNanos();
+    world.Tick(options.steps_);
+    int64_t physics_end = NowNanos();
+    sample.physics_ns_ = physics_end - start;
+    sample.render_ns_ = 0;
+    if (renderer != nullptr) {
+      RenderBoxes(renderer, world.GetPool());
+      sample.render_ns_ = NowNanos() - physics_end;
+    }
+    sample.awake_bodies_ = world.GetPool().GetAwakeCount();
+    sample.mean_speed_ = world.GetMeanSpeed();
+    sample.max_penetration_ = world.GetMaxPenetration();
+  }
+
+  FILE* file = stdout;
+  if (!options.output_.empty()) {
+    file = fopen(options.output_.c_str(), "w");
+    if (file == nullptr) {
+      fprintf(stderr, "Cannot write %s\n", options.output_.c_str());
+      return 1;
+    }
+  }
+  WriteJson(file, options, world.GetThreadCount(),
+            world.GetPool().GetActiveCount(), samples);
+  if (file != stdout) {
+    fclose(file);
+  }
+
+  if (renderer != nullptr) {
+    renderer->Unload();
+    delete renderer;
+  }
+  return 0;
+}
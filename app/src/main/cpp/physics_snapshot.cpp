@@ -0,0 +1,94 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "physics_snapshot.h"
+
+#include <cmath>
+
+//--------------------------------------------------------------------------------
+// Interpolate the position linearly and the rotation with a normalized lerp,
+// which is close enough to a slerp for the small rotation of a single step.
+//--------------------------------------------------------------------------------
+void InterpolateBoxPose(const BoxPose& from, const BoxPose& to, float alpha,
+                        float* matrix) {
+  float p[3];
+  for (auto i = 0; i < 3; ++i) {
+    p[i] = from.position_[i] + (to.position_[i] - from.position_[i]) * alpha;
+  }
+
+  // Take the shortest path between the two orientations.
+  float dot = 0.f;
+  for (auto i = 0; i < 4; ++i) {
+    dot += from.rotation_[i] * to.rotation_[i];
+  }
+  const float sign = dot < 0.f ? -1.f : 1.f;
+  float q[4];
+  float length = 0.f;
+  for (auto i = 0; i < 4; ++i) {
+    q[i] = from.rotation_[i] +
+           (to.rotation_[i] * sign - from.rotation_[i]) * alpha;
+    length += q[i] * q[i];
+  }
+  const float inv_length = length > 0.f ? 1.f / sqrtf(length) : 0.f;
+  const float x = q[0] * inv_length;
+  const float y = q[1] * inv_length;
+  const float z = q[2] * inv_length;
+  const float w = q[3] * inv_length;
+
+  // Same layout as btTransform::getOpenGLMatrix().
+  matrix[0] = 1.f - 2.f * (y * y + z * z);
+  matrix[1] = 2.f * (x * y + w * z);
+  matrix[2] = 2.f * (x * z - w * y);
+  matrix[3] = 0.f;
+  matrix[4] = 2.f * (x * y - w * z);
+  matrix[5] = 1.f - 2.f * (x * x + z * z);
+  matrix[6] = 2.f * (y * z + w * x);
+  matrix[7] = 0.f;
+  matrix[8] = 2.f * (x * z + w * y);
+  matrix[9] = 2.f * (y * z - w * x);
+  matrix[10] = 1.f - 2.f * (x * x + y * y);
+  matrix[11] = 0.f;
+  matrix[12] = p[0];
+  matrix[13] = p[1];
+  matrix[14] = p[2];
+  matrix[15] = 1.f;
+}
+
+//--------------------------------------------------------------------------------
+// PhysicsSnapshotBuffer
+//--------------------------------------------------------------------------------
+PhysicsSnapshotBuffer::PhysicsSnapshotBuffer()
+    : ready_(1), write_index_(0), read_index_(2), has_published_(false) {
+  for (auto& snapshot : snapshots_) {
+    snapshot.time_ = 0.f;
+    snapshot.interval_ = 0.f;
+  }
+}
+
+void PhysicsSnapshotBuffer::EndWrite() {
+  uint32_t previous =
+      ready_.exchange(write_index_ | kFreshBit, std::memory_order_acq_rel);
+  write_index_ = previous & kIndexMask;
+}
+
+const PhysicsSnapshot* PhysicsSnapshotBuffer::AcquireLatest() {
+  if (ready_.load(std::memory_order_relaxed) & kFreshBit) {
+    uint32_t previous = ready_.exchange(read_index_, std::memory_order_acq_rel);
+    read_index_ = previous & kIndexMask;
+    has_published_ = true;
+  }
+  return has_published_ ? &snapshots_[read_index_] : nullptr;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHYSICS_SNAPSHOT_H_
+#define PHYSICS_SNAPSHOT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Position and orientation (quaternion x, y, z, w) of a box.
+struct BoxPose {
+  float position_[3];
+  float rotation_[4];
+};
+
+// A box as published by the simulation: its pose before and after the step.
+struct BoxSnapshot {
+  BoxPose previous_;
+  BoxPose current_;
+  float half_extents_[3];
+  float color_[3];
+};
+
+// State of all boxes after one simulation step.
+struct PhysicsSnapshot {
+  std::vector<BoxSnapshot> boxes_;
+
+  // Clock() time the step was published, and the step interval, in seconds.
+  float time_;
+  float interval_;
+};
+
+// Build the column-major model matrix of a pose interpolated between
+// `from` and `to` by `alpha` (0 = from, 1 = to).
+void InterpolateBoxPose(const BoxPose& from, const BoxPose& to, float alpha,
+                        float* matrix);
+
+/*
+ * Lock-free triple buffer of physics snapshots between the simulation thread
+ * (single producer) and the game thread (single consumer).
+ *
+ * The producer always owns one buffer and the consumer another; the third
+ * holds the latest published snapshot. Publishing and acquiring swap buffer
+ * indices atomically, so neither side ever waits for the other, and the
+ * consumer always sees the newest complete snapshot.
+ */
+class PhysicsSnapshotBuffer {
+ public:
+  PhysicsSnapshotBuffer();
+
+  // Producer: the buffer to fill, then publish it with EndWrite().
+  PhysicsSnapshot* BeginWrite() { return &snapshots_[write_index_]; }
+  void EndWrite();
+
+  // Consumer: returns the latest published snapshot. The snapshot stays valid
+  // until the next call. Returns nullptr until something was published.
+  const PhysicsSnapshot* AcquireLatest();
+
+ private:
+  static constexpr uint32_t kIndexMask = 0x3;
+  static constexpr uint32_t kFreshBit = 0x4;
+
+  PhysicsSnapshot snapshots_[3];
+
+  // Index of the latest published buffer, with kFreshBit when the consumer
+  // has not picked it up yet.
+  std::atomic<uint32_t> ready_;
+  uint32_t write_index_;
+  uint32_t read_index_;
+  bool has_published_;
+};
+
+#endif  // PHYSICS_SNAPSHOT_H_
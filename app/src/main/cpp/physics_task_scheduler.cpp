@@ -0,0 +1,130 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "physics_task_scheduler.h"
+
+#include <algorithm>
+
+#include "common.h"
+#include "job_system.h"
+
+PhysicsTaskScheduler::PhysicsTaskScheduler(int32_t num_threads)
+    : btITaskScheduler("PhysicsTaskScheduler"), num_threads_(1) {
+  setNumThreads(num_threads);
+}
+
+PhysicsTaskScheduler* PhysicsTaskScheduler::GetInstance() {
+  static PhysicsTaskScheduler instance(
+      JobSystem::GetInstance()->GetNumThreads());
+  return &instance;
+}
+
+bool PhysicsTaskScheduler::Install() {
+  if (IsInstalled()) {
+    return true;
+  }
+  // Also makes the calling thread Bullet's main thread, if none asked first.
+  if (!btIsMainThread()) {
+    ALOGW("PhysicsTaskScheduler: thread %u is not Bullet's main thread",
+          btGetCurrentThreadIndex());
+    return false;
+  }
+  btSetTaskScheduler(GetInstance());
+  return true;
+}
+
+bool PhysicsTaskScheduler::IsInstalled() {
+  return btGetTaskScheduler() == GetInstance();
+}
+
+//--------------------------------------------------------------------------------
+// The pool and the stepping thread, plus the game thread, Bullet's main
+// thread, which never steps.
+//--------------------------------------------------------------------------------
+int PhysicsTaskScheduler::getMaxNumThreads() const {
+  return std::min(JobSystem::GetInstance()->GetNumThreads() + 1,
+                  static_cast<int32_t>(BT_MAX_THREAD_COUNT));
+}
+
+int PhysicsTaskScheduler::getNumThreads() const { return getMaxNumThreads(); }
+
+void PhysicsTaskScheduler::setNumThreads(int num_threads) {
+  const int32_t max_threads = JobSystem::GetInstance()->GetNumThreads();
+  num_threads_ = std::max(1, std::min(num_threads, max_threads));
+  ALOGI("PhysicsTaskScheduler: %d of %d thread(s)", num_threads_.load(),
+        max_threads);
+}
+
+const std::vector<int32_t>& PhysicsTaskScheduler::GetWorkerThreadIds() const {
+  return JobSystem::GetInstance()->GetWorkerThreadIds();
+}
+
+void PhysicsTaskScheduler::parallelFor(int begin, int end, int grain_size,
+                                       const btIParallelForBody& body) {
+  // Not worth waking the workers up for a single chunk.
+  const int32_t num_threads = num_threads_;
+  if (num_threads <= 1 || end - begin <= grain_size) {
+    body.forLoop(begin, end);
+    return;
+  }
+  JobSystem::GetInstance()->ParallelFor(
+      begin, end, grain_size, num_threads,
+      [](void* context, int32_t range_begin, int32_t range_end) {
+        static_cast<const btIParallelForBody*>(context)->forLoop(range_begin,
+                                                                 range_end);
+      },
+      const_cast<btIParallelForBody*>(&body));
+}
+
+//--------------------------------------------------------------------------------
+// Each chunk writes its own partial sum, added up in order afterwards. The
+// result doesn't depend on which thread ran which chunk.
+//--------------------------------------------------------------------------------
+btScalar PhysicsTaskScheduler::parallelSum(int begin, int end, int grain_size,
+                                           const btIParallelSumBody& body) {
+  const int32_t num_threads = num_threads_;
+  if (num_threads <= 1 || end - begin <= grain_size) {
+    return body.sumLoop(begin, end);
+  }
+  grain_size = std::max(grain_size, 1);
+  const int32_t count = end - begin;
+  const int32_t num_chunks =
+      std::min((count + grain_size - 1) / grain_size, kMaxSumChunks);
+  btScalar sums[kMaxSumChunks];
+  auto sum_chunks = [&](int32_t first, int32_t last) {
+    for (auto chunk = first; chunk < last; ++chunk) {
+      const int32_t chunk_begin =
+          begin + static_cast<int32_t>(static_cast<int64_t>(count) * chunk /
+                                       num_chunks);
+      const int32_t chunk_end =
+          begin + static_cast<int32_t>(static_cast<int64_t>(count) *
+                                       (chunk + 1) / num_chunks);
+      sums[chunk] = body.sumLoop(chunk_begin, chunk_end);
+    }
+  };
+  JobSystem::GetInstance()->ParallelFor(
+      0, num_chunks, 1, num_threads,
+      [](void* context, int32_t first, int32_t last) {
+        (*static_cast<decltype(sum_chunks)*>(context))(first, last);
+      },
+      &sum_chunks);
+
+  btScalar sum = 0;
+  for (auto chunk = 0; chunk < num_chunks; ++chunk) {
+    sum += sums[chunk];
+  }
+  return sum;
+}
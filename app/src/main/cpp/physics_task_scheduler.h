@@ -0,0 +1,87 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHYSICS_TASK_SCHEDULER_H_
+#define PHYSICS_TASK_SCHEDULER_H_
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wextra-semi"
+#include "LinearMath/btThreads.h"
+#pragma GCC diagnostic pop
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Bullet task scheduler running the parallel loops of the physics on the
+ * shared JobSystem pool.
+ *
+ * Bullet only lets its main thread, the first one that asked for a thread
+ * index, install a scheduler. The game's is installed once by the game
+ * thread with Install(), before any world is built, and stays installed as
+ * long as the process: the worlds are rebuilt on other threads, which can't
+ * put it back.
+ *
+ * The thread calling stepSimulation() takes part in every parallelFor().
+ * Bullet indexes its per-thread data with btGetCurrentThreadIndex(), which
+ * gives each new thread the next index and never reuses one. The indices in
+ * use are the game thread's, 0, the pool workers' and the PhysicsThread's,
+ * all kept as long as the process: the scenes run their simulation on the
+ * PhysicsThread rather than starting another. getNumThreads() counts them
+ * all, as Bullet sizes its per-thread data with it; setNumThreads() only
+ * limits how many threads a loop is split for.
+ */
+class PhysicsTaskScheduler : public btITaskScheduler {
+ public:
+  // Most chunks of a parallelSum(), each has its own partial sum.
+  static constexpr int32_t kMaxSumChunks = 64;
+
+  // `num_threads` includes the calling thread. It is clamped to
+  // [1, JobSystem::GetNumThreads()].
+  explicit PhysicsTaskScheduler(int32_t num_threads);
+  virtual ~PhysicsTaskScheduler() {}
+
+  // The scheduler of the game's worlds, on all the pool threads.
+  static PhysicsTaskScheduler* GetInstance();
+
+  // Install GetInstance() as Bullet's scheduler. Call on the game thread,
+  // before any other thread uses Bullet. Returns false when Bullet refused
+  // it, the multithreaded worlds can't be built then.
+  static bool Install();
+  static bool IsInstalled();
+
+  virtual int getMaxNumThreads() const;
+  virtual int getNumThreads() const;
+  virtual void setNumThreads(int num_threads);
+  virtual void parallelFor(int begin, int end, int grain_size,
+                           const btIParallelForBody& body);
+  virtual btScalar parallelSum(int begin, int end, int grain_size,
+                               const btIParallelSumBody& body);
+
+  // # of threads the loops are split for.
+  int32_t GetParallelism() const { return num_threads_; }
+
+  // Kernel thread ids of the pool workers, e.g. to add them to a hint
+  // session.
+  const std::vector<int32_t>& GetWorkerThreadIds() const;
+
+ private:
+  // Set by the thread building a world, read by the stepping one.
+  std::atomic<int32_t> num_threads_;
+};
+
+#endif  // PHYSICS_TASK_SCHEDULER_H_
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "physics_thread.h"
+
+#include <unistd.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wextra-semi"
+#include "LinearMath/btThreads.h"
+#pragma GCC diagnostic pop
+
+#include "common.h"
+#include "cpu_topology.h"
+
+PhysicsThread* PhysicsThread::GetInstance() {
+  static PhysicsThread instance;
+  return &instance;
+}
+
+PhysicsThread::PhysicsThread()
+    : thread_tid_(0),
+      bullet_thread_index_(-1),
+      busy_(false),
+      started_(false),
+      stopping_(false) {}
+
+PhysicsThread::~PhysicsThread() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_cv_.notify_one();
+  thread_.join();
+}
+
+void PhysicsThread::Start() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (thread_.joinable()) {
+    return;
+  }
+  thread_ = std::thread(&PhysicsThread::RunPhysicsThread, this);
+
+  // Its Bullet thread index is taken once it reported in.
+  done_cv_.wait(lock, [this] { return started_; });
+  ALOGI("PhysicsThread: started, Bullet thread index %d",
+        bullet_thread_index_.load());
+}
+
+bool PhysicsThread::Post(Task task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!started_ || busy_) {
+      return false;
+    }
+    task_ = std::move(task);
+    busy_ = true;
+  }
+  work_cv_.notify_one();
+  return true;
+}
+
+void PhysicsThread::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this] { return !busy_; });
+}
+
+void PhysicsThread::RunPhysicsThread() {
+  CpuTopology::GetInstance()->PinCurrentThread(THREAD_ROLE_PHYSICS);
+  std::unique_lock<std::mutex> lock(mutex_);
+  thread_tid_ = gettid();
+  bullet_thread_index_ = static_cast<int32_t>(btGetCurrentThreadIndex());
+  started_ = true;
+  done_cv_.notify_all();
+
+  while (true) {
+    work_cv_.wait(lock, [this] { return busy_ || stopping_; });
+    if (!busy_) {
+      break;
+    }
+    Task task = std::move(task_);
+    task_ = nullptr;
+    lock.unlock();
+    task();
+    lock.lock();
+    busy_ = false;
+    done_cv_.notify_all();
+  }
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PHYSICS_THREAD_H_
+#define PHYSICS_THREAD_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/*
+ * The simulation thread, which steps the physics worlds. It lives as long
+ * as the process, like the JobSystem pool: Bullet gives each new thread the
+ * next thread index and never reuses one, and the per-thread data of the
+ * multithreaded worlds is only sized for the threads of
+ * PhysicsTaskScheduler::getNumThreads(). A scene hands its loop over with
+ * Post() and gets the thread back once the loop returned, so a scene
+ * rebuilt with the activity runs on the same thread and index.
+ *
+ * The thread runs on the cores of THREAD_ROLE_PHYSICS.
+ */
+class PhysicsThread {
+ public:
+  typedef std::function<void()> Task;
+
+  static PhysicsThread* GetInstance();
+
+  ~PhysicsThread();
+
+  // Start the thread, if it isn't yet. Call on the game thread after
+  // PhysicsTaskScheduler::Install().
+  void Start();
+
+  // Run `task` on the thread. One task at a time: returns false when the
+  // thread isn't started or still runs a task.
+  bool Post(Task task);
+
+  // Wait until the task posted returned.
+  void Wait();
+
+  // Kernel thread id, 0 until the thread is started.
+  int32_t GetThreadId() const { return thread_tid_; }
+
+  // Bullet's btGetCurrentThreadIndex() on the thread, -1 until the thread
+  // is started.
+  int32_t GetBulletThreadIndex() const { return bullet_thread_index_; }
+
+ private:
+  PhysicsThread();
+  PhysicsThread(const PhysicsThread&) = delete;
+  PhysicsThread& operator=(const PhysicsThread&) = delete;
+
+  void RunPhysicsThread();
+
+  std::thread thread_;
+  std::atomic<int32_t> thread_tid_;
+  std::atomic<int32_t> bullet_thread_index_;
+
+  // Guards the task, which wakes up the thread (work_cv_) and the threads
+  // waiting for it to return (done_cv_).
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  Task task_;
+  bool busy_;
+  bool started_;
+  bool stopping_;
+};
+
+#endif  // PHYSICS_THREAD_H_
@@ -0,0 +1,319 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "power_monitor.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+#include "JNIHelper.h"
+#include "common.h"
+#include "cpu_topology.h"
+
+namespace {
+const char kBatterySysfsDir[] = "/sys/class/power_supply/battery";
+
+// BatteryManager.BATTERY_PROPERTY_CURRENT_NOW, in microamperes.
+const int32_t kBatteryPropertyCurrentNow = 2;
+
+bool ReadSysfsString(const char* name, char* value, size_t size) {
+  char path[96];
+  snprintf(path, sizeof(path), "%s/%s", kBatterySysfsDir, name);
+  FILE* fp = fopen(path, "r");
+  if (fp == nullptr) {
+    return false;
+  }
+  const bool read = fgets(value, static_cast<int>(size), fp) != nullptr;
+  fclose(fp);
+  return read;
+}
+
+bool ReadSysfsValue(const char* name, int64_t* value) {
+  char text[32];
+  if (!ReadSysfsString(name, text, sizeof(text))) {
+    return false;
+  }
+  *value = strtoll(text, nullptr, 10);
+  return true;
+}
+
+double GetSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+}  // namespace
+
+PowerMonitor* PowerMonitor::GetInstance() {
+  static PowerMonitor instance;
+  return &instance;
+}
+
+PowerMonitor::PowerMonitor()
+    : app_(nullptr),
+      source_(SOURCE_NONE),
+      battery_manager_(nullptr),
+      voltage_mv_(0),
+      frames_(0),
+      physics_steps_(0),
+      running_(false),
+      num_samples_(0),
+      energy_(0),
+      last_time_(0),
+      last_power_(0.f),
+      available_(false),
+      plugged_(false),
+      power_(0.f),
+      energy_per_frame_(0.f),
+      energy_per_step_(0.f) {}
+
+PowerMonitor::~PowerMonitor() { Shutdown(); }
+
+//--------------------------------------------------------------------------------
+// Pick the source of the readings and start sampling.
+//--------------------------------------------------------------------------------
+void PowerMonitor::Initialize(android_app* app) {
+  if (running_) {
+    return;
+  }
+  app_ = app;
+
+  int64_t value = 0;
+  if (ReadSysfsValue("current_now", &value) &&
+      ReadSysfsValue("voltage_now", &value)) {
+    source_ = SOURCE_SYSFS;
+  } else if (InitializeBatteryManagerJni()) {
+    source_ = SOURCE_BATTERY_MANAGER;
+  } else {
+    ALOGW("PowerMonitor: the battery current is not readable.");
+    return;
+  }
+  ALOGI("PowerMonitor: reading the battery from %s",
+        source_ == SOURCE_SYSFS ? kBatterySysfsDir : "BatteryManager");
+
+  running_ = true;
+  poll_thread_ = std::thread(&PowerMonitor::PollPower, this);
+}
+
+void PowerMonitor::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  cv_.notify_all();
+  if (poll_thread_.joinable()) {
+    poll_thread_.join();
+  }
+
+  if (battery_manager_ != nullptr) {
+    ndk_helper::JNIHelper::GetInstance()->DeleteObject(battery_manager_);
+    battery_manager_ = nullptr;
+  }
+  source_ = SOURCE_NONE;
+  available_ = false;
+}
+
+const char* PowerMonitor::GetStatusText() const {
+  if (source_ == SOURCE_NONE) {
+    return "not available";
+  }
+  if (plugged_) {
+    return "plugged in";
+  }
+  if (!available_) {
+    return "measuring";
+  }
+  return source_ == SOURCE_SYSFS ? "sysfs" : "BatteryManager";
+}
+
+bool PowerMonitor::InitializeBatteryManagerJni() {
+  if (app_ == nullptr) {
+    return false;
+  }
+
+  ndk_helper::JNIHelper* helper = ndk_helper::JNIHelper::GetInstance();
+  JNIEnv* env = helper->AttachCurrentThread();
+  jstring service_name = env->NewStringUTF("batterymanager");
+  jobject battery_manager = helper->CallObjectMethod(
+      app_->activity->javaGameActivity, "getSystemService",
+      "(Ljava/lang/String;)Ljava/lang/Object;", service_name);
+  env->DeleteLocalRef(service_name);
+  if (battery_manager == nullptr) {
+    return false;
+  }
+
+  battery_manager_ = env->NewGlobalRef(battery_manager);
+  env->DeleteLocalRef(battery_manager);
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Sampling thread. Samples every kSampleIntervalMs until Shutdown() is called.
+//--------------------------------------------------------------------------------
+void PowerMonitor::PollPower() {
+  CpuTopology::GetInstance()->PinCurrentThread(THREAD_ROLE_TELEMETRY);
+
+  // The JNI source needs this thread to be attached to the VM.
+  JNIEnv* env = nullptr;
+  if (source_ == SOURCE_BATTERY_MANAGER) {
+    app_->activity->vm->AttachCurrentThread(&env, nullptr);
+  }
+
+  int32_t sample = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (running_) {
+    lock.unlock();
+    UpdatePower(sample++, GetSeconds());
+    lock.lock();
+    cv_.wait_for(lock, std::chrono::milliseconds(kSampleIntervalMs),
+                 [this] { return !running_; });
+  }
+  lock.unlock();
+
+  if (env != nullptr) {
+    app_->activity->vm->DetachCurrentThread();
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Integrate the power into energy, and compare the counters with the oldest
+// sample of the window.
+//--------------------------------------------------------------------------------
+void PowerMonitor::UpdatePower(int32_t sample, double time) {
+  float power = 0.f;
+  const bool read =
+      source_ == SOURCE_SYSFS
+          ? ReadSysfsPower(&power)
+          : ReadBatteryManagerPower(sample % kVoltageIntervalSamples == 0,
+                                    &power);
+  if (!read) {
+    // Start over once the readings are back.
+    num_samples_ = 0;
+    available_ = false;
+    return;
+  }
+
+  if (num_samples_ > 0) {
+    energy_ += 0.5 * (power + last_power_) * (time - last_time_);
+  }
+  last_time_ = time;
+  last_power_ = power;
+
+  Sample current;
+  current.time_ = time;
+  current.energy_ = energy_;
+  current.frames_ = frames_.load(std::memory_order_relaxed);
+  current.physics_steps_ = physics_steps_.load(std::memory_order_relaxed);
+
+  Sample& slot = window_[num_samples_ % kWindowSamples];
+  if (num_samples_ >= kWindowSamples) {
+    const Sample& oldest = slot;
+    const double energy = current.energy_ - oldest.energy_;
+    const int64_t frames = current.frames_ - oldest.frames_;
+    const int64_t steps = current.physics_steps_ - oldest.physics_steps_;
+    power_ = static_cast<float>(energy / (current.time_ - oldest.time_));
+    energy_per_frame_ = frames > 0 ? static_cast<float>(energy / frames) : 0.f;
+    energy_per_step_ = steps > 0 ? static_cast<float>(energy / steps) : 0.f;
+    available_ = true;
+  }
+  slot = current;
+  ++num_samples_;
+}
+
+bool PowerMonitor::ReadSysfsPower(float* power) {
+  char status[32];
+  if (ReadSysfsString("status", status, sizeof(status))) {
+    plugged_ = strncmp(status, "Discharging", 11) != 0;
+  }
+  int64_t current_ua = 0;
+  int64_t voltage_uv = 0;
+  if (plugged_ || !ReadSysfsValue("current_now", &current_ua) ||
+      !ReadSysfsValue("voltage_now", &voltage_uv) || current_ua == 0) {
+    return false;
+  }
+  // The sign of the current depends on the device.
+  *power = static_cast<float>(std::llabs(current_ua) * 1e-6 *
+                              static_cast<double>(voltage_uv) * 1e-6);
+  return true;
+}
+
+bool PowerMonitor::ReadBatteryManagerPower(bool read_voltage, float* power) {
+  if ((read_voltage || voltage_mv_ <= 0) && !ReadBatteryIntent()) {
+    return false;
+  }
+  if (plugged_ || voltage_mv_ <= 0) {
+    return false;
+  }
+  ndk_helper::JNIHelper* helper = ndk_helper::JNIHelper::GetInstance();
+  const int32_t current_ua = helper->CallIntMethod(
+      battery_manager_, "getIntProperty", "(I)I", kBatteryPropertyCurrentNow);
+  // Integer.MIN_VALUE when the property is not supported.
+  if (current_ua == 0 || current_ua == INT_MIN) {
+    return false;
+  }
+  *power = static_cast<float>(std::abs(current_ua) * 1e-6 * voltage_mv_ * 1e-3);
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// ACTION_BATTERY_CHANGED is sticky: registering a null receiver returns the
+// last intent without subscribing to the next ones.
+//--------------------------------------------------------------------------------
+bool PowerMonitor::ReadBatteryIntent() {
+  ndk_helper::JNIHelper* helper = ndk_helper::JNIHelper::GetInstance();
+  JNIEnv* env = helper->AttachCurrentThread();
+
+  jclass filter_class = env->FindClass("android/content/IntentFilter");
+  jmethodID constructor =
+      env->GetMethodID(filter_class, "<init>", "(Ljava/lang/String;)V");
+  jstring action = env->NewStringUTF("android.intent.action.BATTERY_CHANGED");
+  jobject filter = env->NewObject(filter_class, constructor, action);
+  jobject intent = helper->CallObjectMethod(
+      app_->activity->javaGameActivity, "registerReceiver",
+      "(Landroid/content/BroadcastReceiver;Landroid/content/IntentFilter;)"
+      "Landroid/content/Intent;",
+      nullptr, filter);
+  if (env->ExceptionCheck()) {
+    env->ExceptionClear();
+    intent = nullptr;
+  }
+
+  bool read = false;
+  if (intent != nullptr) {
+    jstring voltage_key = env->NewStringUTF("voltage");
+    jstring plugged_key = env->NewStringUTF("plugged");
+    voltage_mv_ = helper->CallIntMethod(intent, "getIntExtra",
+                                        "(Ljava/lang/String;I)I", voltage_key,
+                                        0);
+    plugged_ = helper->CallIntMethod(intent, "getIntExtra",
+                                     "(Ljava/lang/String;I)I", plugged_key,
+                                     0) != 0;
+    env->DeleteLocalRef(voltage_key);
+    env->DeleteLocalRef(plugged_key);
+    env->DeleteLocalRef(intent);
+    read = true;
+  }
+  // This thread stays attached, don't let the local refs pile up.
+  env->DeleteLocalRef(filter);
+  env->DeleteLocalRef(action);
+  env->DeleteLocalRef(filter_class);
+  return read;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef POWER_MONITOR_H_
+#define POWER_MONITOR_H_
+
+#include <jni.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+struct android_app;
+
+/*
+ * Samples the power drawn from the battery, to put the frame rate and the
+ * physics load against the energy they cost.
+ *
+ * The battery current and voltage come from /sys/class/power_supply/battery
+ * when the app can read it, or else from android.os.BatteryManager and the
+ * sticky ACTION_BATTERY_CHANGED intent through JNI. Either way this is the
+ * whole device, not only the app. Nothing is reported while the device is
+ * plugged in, as the battery current then says nothing about the load.
+ *
+ * The power is sampled every kSampleIntervalMs on a telemetry thread and
+ * integrated into energy. The frames and physics steps are counted by the
+ * threads that run them, and the energy per frame and per step are averaged
+ * over the last kWindowSamples samples.
+ */
+class PowerMonitor {
+ public:
+  static constexpr int32_t kSampleIntervalMs = 250;
+  // The rolling window, 5 seconds.
+  static constexpr int32_t kWindowSamples = 20;
+  // The voltage changes slowly and the intent is heavier to read, so it is
+  // only read every 10 seconds.
+  static constexpr int32_t kVoltageIntervalSamples = 40;
+
+  static PowerMonitor* GetInstance();
+
+  // Start sampling. JNIHelper must be initialized first.
+  void Initialize(android_app* app);
+
+  // Stop sampling and release the JNI objects.
+  void Shutdown();
+
+  // Count work done since the last sample. May be called from any thread.
+  void RecordFrame() { frames_.fetch_add(1, std::memory_order_relaxed); }
+  void RecordPhysicsSteps(int32_t steps) {
+    physics_steps_.fetch_add(steps, std::memory_order_relaxed);
+  }
+
+  // True once a full window was measured on battery.
+  bool IsAvailable() const { return available_.load(); }
+  // Why IsAvailable() is false, or where the readings come from.
+  const char* GetStatusText() const;
+
+  // Averages over the window, in W and J.
+  float GetPower() const { return power_.load(); }
+  float GetEnergyPerFrame() const { return energy_per_frame_.load(); }
+  float GetEnergyPerPhysicsStep() const { return energy_per_step_.load(); }
+
+ private:
+  enum Source { SOURCE_NONE, SOURCE_SYSFS, SOURCE_BATTERY_MANAGER };
+
+  // The counters at the time of a sample.
+  struct Sample {
+    double time_;
+    double energy_;
+    int64_t frames_;
+    int64_t physics_steps_;
+  };
+
+  PowerMonitor();
+  ~PowerMonitor();
+  PowerMonitor(const PowerMonitor&) = delete;
+  PowerMonitor& operator=(const PowerMonitor&) = delete;
+
+  bool InitializeBatteryManagerJni();
+
+  // Sampling thread entry and a single sample.
+  void PollPower();
+  void UpdatePower(int32_t sample, double time);
+
+  // Read the current power in W, false when it is not available or the
+  // device is plugged in.
+  bool ReadSysfsPower(float* power);
+  bool ReadBatteryManagerPower(bool read_voltage, float* power);
+  // Read the voltage and the plugged state from ACTION_BATTERY_CHANGED.
+  bool ReadBatteryIntent();
+
+  android_app* app_;
+  Source source_;
+
+  // Global ref to android.os.BatteryManager for the JNI source.
+  jobject battery_manager_;
+  int32_t voltage_mv_;
+
+  std::atomic<int64_t> frames_;
+  std::atomic<int64_t> physics_steps_;
+
+  // Sampling thread state. The window is only used by that thread.
+  std::thread poll_thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool running_;
+  Sample window_[kWindowSamples];
+  int32_t num_samples_;
+  double energy_;
+  double last_time_;
+  float last_power_;
+
+  std::atomic<bool> available_;
+  std::atomic<bool> plugged_;
+  std::atomic<float> power_;
+  std::atomic<float> energy_per_frame_;
+  std::atomic<float> energy_per_step_;
+};
+
+#endif  // POWER_MONITOR_H_
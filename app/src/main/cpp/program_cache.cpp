@@ -0,0 +1,219 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "program_cache.h"
+
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "JNIHelper.h"
+
+namespace {
+// Bump when the entry layout, or what the programs depend on besides their
+// sources (e.g. the attribute bindings), changes.
+const uint32_t kCacheMagic = 0x31435050;  // "PPC1"
+const uint32_t kCacheVersion = 1;
+
+const uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ull;
+const uint64_t kFnvPrime = 0x100000001b3ull;
+
+struct EntryHeader {
+  uint32_t magic_;
+  uint32_t version_;
+  uint64_t driver_hash_;
+  uint64_t source_hash_;
+  uint32_t format_;
+  uint32_t size_;
+};
+
+// FNV-1a, continuing from `hash`.
+uint64_t Hash(const void* data, size_t size, uint64_t hash) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * kFnvPrime;
+  }
+  return hash;
+}
+
+uint64_t HashGLString(GLenum name, uint64_t hash) {
+  const char* str = reinterpret_cast<const char*>(glGetString(name));
+  if (str == nullptr) {
+    return hash;
+  }
+  // Include the terminator, so "ab" + "c" and "a" + "bc" differ.
+  return Hash(str, strlen(str) + 1, hash);
+}
+}  // namespace
+
+ProgramCache* ProgramCache::GetInstance() {
+  static ProgramCache instance;
+  return &instance;
+}
+
+ProgramCache::ProgramCache()
+    : initialized_(false), supported_(false), driver_hash_(0) {}
+
+uint64_t ProgramCache::HashSources(
+    const std::vector<uint8_t>& vertex_source,
+    const std::vector<uint8_t>& fragment_source) {
+  uint64_t size = vertex_source.size();
+  uint64_t hash = Hash(&size, sizeof(size), kFnvOffsetBasis);
+  hash = Hash(vertex_source.data(), vertex_source.size(), hash);
+  return Hash(fragment_source.data(), fragment_source.size(), hash);
+}
+
+bool ProgramCache::IsSupported() {
+  if (!initialized_) {
+    Initialize();
+  }
+  return supported_;
+}
+
+//--------------------------------------------------------------------------------
+// Program binaries are core in OpenGL ES 3.0, but a driver may support no
+// binary format at all.
+//--------------------------------------------------------------------------------
+void ProgramCache::Initialize() {
+  initialized_ = true;
+
+  GLint num_formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+  if (glGetError() != GL_NO_ERROR || num_formats <= 0) {
+    ALOGI("ProgramCache: no program binary format, caching disabled");
+    return;
+  }
+
+  std::string files_dir = ndk_helper::JNIHelper::GetInstance()
+                              ->GetExternalFilesDir();
+  if (files_dir.empty()) {
+    ALOGW("ProgramCache: no files directory, caching disabled");
+    return;
+  }
+  directory_ = files_dir + "/program_cache";
+  if (mkdir(directory_.c_str(), 0700) != 0 && errno != EEXIST) {
+    ALOGW("ProgramCache: cannot create %s (%d), caching disabled",
+          directory_.c_str(), errno);
+    return;
+  }
+
+  driver_hash_ = HashGLString(GL_VENDOR, kFnvOffsetBasis);
+  driver_hash_ = HashGLString(GL_RENDERER, driver_hash_);
+  driver_hash_ = HashGLString(GL_VERSION, driver_hash_);
+  supported_ = true;
+  ALOGI("ProgramCache: caching programs in %s", directory_.c_str());
+}
+
+std::string ProgramCache::GetPath(uint64_t source_hash) const {
+  char name[32];
+  snprintf(name, sizeof(name), "/%016llx.bin",
+           static_cast<unsigned long long>(source_hash));
+  return directory_ + name;
+}
+
+//--------------------------------------------------------------------------------
+// Load a program binary. Any mismatch is a miss: the caller compiles.
+//--------------------------------------------------------------------------------
+GLuint ProgramCache::LoadProgram(uint64_t source_hash) {
+  if (!IsSupported()) {
+    return 0;
+  }
+
+  std::string path = GetPath(source_hash);
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return 0;
+  }
+  EntryHeader header;
+  std::vector<uint8_t> binary;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            header.magic_ == kCacheMagic && header.version_ == kCacheVersion &&
+            header.driver_hash_ == driver_hash_ &&
+            header.source_hash_ == source_hash && header.size_ > 0;
+  if (ok) {
+    binary.resize(header.size_);
+    ok = fread(binary.data(), binary.size(), 1, file) == 1;
+  }
+  fclose(file);
+  if (!ok) {
+    ALOGI("ProgramCache: stale entry %s", path.c_str());
+    return 0;
+  }
+
+  // The driver may still reject the binary.
+  GLuint program = glCreateProgram();
+  glProgramBinary(program, header.format_, binary.data(),
+                  static_cast<GLsizei>(binary.size()));
+  GLint status = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (status == 0) {
+    ALOGI("ProgramCache: entry %s rejected by the driver", path.c_str());
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+void ProgramCache::PrepareProgram(GLuint program) {
+  if (IsSupported()) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Write the entry next to its final path and rename it over, so a crash
+// midway never leaves a truncated entry behind.
+//--------------------------------------------------------------------------------
+void ProgramCache::StoreProgram(GLuint program, uint64_t source_hash) {
+  if (!IsSupported()) {
+    return;
+  }
+
+  GLint size = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+  if (size <= 0) {
+    return;
+  }
+  std::vector<uint8_t> binary(size);
+  GLenum format = 0;
+  GLsizei length = 0;
+  glGetProgramBinary(program, size, &length, &format, binary.data());
+  if (length <= 0) {
+    ALOGW("ProgramCache: cannot retrieve the binary of program %d", program);
+    return;
+  }
+
+  EntryHeader header = {kCacheMagic, kCacheVersion, driver_hash_,
+                        source_hash, format, static_cast<uint32_t>(length)};
+  std::string path = GetPath(source_hash);
+  std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    ALOGW("ProgramCache: cannot open %s", temp_path.c_str());
+    return;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(binary.data(), length, 1, file) == 1;
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+    ALOGW("ProgramCache: cannot write %s", path.c_str());
+    remove(temp_path.c_str());
+    return;
+  }
+  ALOGI("ProgramCache: stored %s (%d bytes)", path.c_str(), length);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROGRAM_CACHE_H_
+#define PROGRAM_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+/*
+ * Disk cache of linked shader programs, so a program is compiled from source
+ * once per driver rather than on every scene construction and context loss.
+ *
+ * Programs are saved with glGetProgramBinary() under the external files
+ * directory, one file per program, named after the hash of its sources. A
+ * file also records the GL vendor, renderer and version it was built by:
+ * when any of them differs (e.g. after a driver update), or the driver
+ * rejects the binary, LoadProgram() fails and the caller compiles from
+ * source, then overwrites the entry with StoreProgram().
+ *
+ * Must be used on the thread the GL context is current on.
+ */
+class ProgramCache {
+ public:
+  static ProgramCache* GetInstance();
+
+  // Hash of the sources of a program, what the entries are named after.
+  static uint64_t HashSources(const std::vector<uint8_t>& vertex_source,
+                              const std::vector<uint8_t>& fragment_source);
+
+  // Create a program from its cached binary. Returns 0 when there is no
+  // usable entry.
+  GLuint LoadProgram(uint64_t source_hash);
+
+  // Call on a program compiled from source, before linking it, so the
+  // driver keeps its binary around.
+  void PrepareProgram(GLuint program);
+
+  // Save the binary of a linked program.
+  void StoreProgram(GLuint program, uint64_t source_hash);
+
+  bool IsSupported();
+
+ private:
+  ProgramCache();
+  // On the first use: check the context can save binaries, and where to.
+  void Initialize();
+  std::string GetPath(uint64_t source_hash) const;
+
+  bool initialized_;
+  bool supported_;
+  std::string directory_;
+  // Hash of the GL vendor, renderer and version strings.
+  uint64_t driver_hash_;
+};
+
+#endif  // PROGRAM_CACHE_H_
@@ -0,0 +1,249 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render_frame.h"
+
+#include <cstring>
+
+#include "Trace.h"
+#include "dynamic_resolution.h"
+#include "gl_state_cache.h"
+#include "gpu_physics.h"
+#include "imgui.h"
+#include "imgui_manager.h"
+
+namespace {
+// ImVector's assignment frees and reallocates, resize() keeps the capacity.
+template <typename T>
+void CopyImVector(const ImVector<T>& from, ImVector<T>* to) {
+  to->resize(from.Size);
+  if (from.Size > 0) {
+    memcpy(to->Data, from.Data, sizeof(T) * from.Size);
+  }
+}
+}  // namespace
+
+RenderFrame::RenderFrame()
+    : num_instances_(0), ui_data_(new ImDrawData()), ui_version_(-1) {}
+
+RenderFrame::~RenderFrame() {}
+
+void RenderFrame::Reset() {
+  commands_.clear();
+  num_instances_ = 0;
+}
+
+RenderCommand* RenderFrame::AddCommand(RenderCommandType type) {
+  commands_.emplace_back();
+  RenderCommand* command = &commands_.back();
+  command->type_ = type;
+  return command;
+}
+
+void RenderFrame::Clear(float red, float green, float blue, float alpha) {
+  RenderCommand* command = AddCommand(RENDER_COMMAND_CLEAR);
+  command->clear_color_[0] = red;
+  command->clear_color_[1] = green;
+  command->clear_color_[2] = blue;
+  command->clear_color_[3] = alpha;
+}
+
+void RenderFrame::SetViewport(int32_t x, int32_t y, int32_t width,
+                              int32_t height) {
+  RenderCommand* command = AddCommand(RENDER_COMMAND_VIEWPORT);
+  command->viewport_[0] = x;
+  command->viewport_[1] = y;
+  command->viewport_[2] = width;
+  command->viewport_[3] = height;
+}
+
+void RenderFrame::BeginGpuFrame(GpuTimer* timer) {
+  AddCommand(RENDER_COMMAND_BEGIN_GPU_FRAME)->gpu_timer_.timer_ = timer;
+}
+
+void RenderFrame::EndGpuFrame(GpuTimer* timer) {
+  AddCommand(RENDER_COMMAND_END_GPU_FRAME)->gpu_timer_.timer_ = timer;
+}
+
+void RenderFrame::BeginGpuSection(GpuTimer* timer, GpuTimerSection section) {
+  RenderCommand* command = AddCommand(RENDER_COMMAND_BEGIN_GPU_SECTION);
+  command->gpu_timer_.timer_ = timer;
+  command->gpu_timer_.section_ = section;
+}
+
+void RenderFrame::EndGpuSection(GpuTimer* timer) {
+  AddCommand(RENDER_COMMAND_END_GPU_SECTION)->gpu_timer_.timer_ = timer;
+}
+
+void RenderFrame::ResetGpuPhysics(GpuPhysics* physics, int32_t array_size,
+                                  float half_size, uint32_t seed) {
+  RenderCommand* command = AddCommand(RENDER_COMMAND_RESET_GPU_PHYSICS);
+  command->reset_physics_.physics_ = physics;
+  command->reset_physics_.array_size_ = array_size;
+  command->reset_physics_.half_size_ = half_size;
+  command->reset_physics_.seed_ = seed;
+}
+
+void RenderFrame::StepGpuPhysics(GpuPhysics* physics, float step,
+                                 int32_t num_steps) {
+  RenderCommand* command = AddCommand(RENDER_COMMAND_STEP_GPU_PHYSICS);
+  command->step_physics_.physics_ = physics;
+  command->step_physics_.step_ = step;
+  command->step_physics_.num_steps_ = num_steps;
+}
+
+void RenderFrame::BeginScaled(DynamicResolution* target,
+                              int32_t surface_width, int32_t surface_height,
+                              SurfaceFormat format, float scale) {
+  RenderCommand* command = AddCommand(RENDER_COMMAND_BEGIN_SCALED);
+  command->scaled_.target_ = target;
+  command->scaled_.surface_width_ = surface_width;
+  command->scaled_.surface_height_ = surface_height;
+  command->scaled_.format_ = format;
+  command->scaled_.scale_ = scale;
+}
+
+void RenderFrame::EndScaled(DynamicResolution* target) {
+  AddCommand(RENDER_COMMAND_END_SCALED)->scaled_.target_ = target;
+}
+
+BOX_INSTANCE* RenderFrame::DrawBoxes(BoxRenderer* renderer, int32_t count,
+                                     int32_t reserve, GpuPhysics* gpu_boxes) {
+  RenderCommand* command = AddCommand(RENDER_COMMAND_DRAW_BOXES);
+  command->boxes_.renderer_ = renderer;
+  command->boxes_.first_ = num_instances_;
+  command->boxes_.count_ = count;
+  command->boxes_.reserve_ = reserve;
+  command->boxes_.tier_ = renderer->GetShadingTier();
+  command->boxes_.gpu_boxes_ = gpu_boxes;
+  num_instances_ += count;
+  if (instances_.size() < static_cast<size_t>(num_instances_)) {
+    instances_.resize(num_instances_);
+  }
+  return instances_.data() + command->boxes_.first_;
+}
+
+void RenderFrame::DrawUi(const ImDrawData* draw_data, int64_t version) {
+  if (draw_data == nullptr) {
+    return;
+  }
+  if (version != ui_version_) {
+    CopyUi(draw_data);
+    ui_version_ = version;
+  }
+  AddCommand(RENDER_COMMAND_DRAW_UI);
+}
+
+//--------------------------------------------------------------------------------
+// The lists are copied into ones the frame owns, which keep their buffers
+// from one copy to the next.
+//--------------------------------------------------------------------------------
+void RenderFrame::CopyUi(const ImDrawData* draw_data) {
+  SAMPLES_TRACE_SCOPE("RenderFrame::CopyUi");
+  const int32_t count = draw_data->CmdListsCount;
+  while (static_cast<int32_t>(ui_lists_.size()) < count) {
+    ui_lists_.emplace_back(new ImDrawList(nullptr));
+  }
+  ui_list_pointers_.resize(count);
+  for (auto i = 0; i < count; ++i) {
+    const ImDrawList* from = draw_data->CmdLists[i];
+    ImDrawList* to = ui_lists_[i].get();
+    CopyImVector(from->CmdBuffer, &to->CmdBuffer);
+    CopyImVector(from->IdxBuffer, &to->IdxBuffer);
+    CopyImVector(from->VtxBuffer, &to->VtxBuffer);
+    to->Flags = from->Flags;
+    ui_list_pointers_[i] = to;
+  }
+
+  ImDrawData* ui = ui_data_.get();
+  ui->Valid = draw_data->Valid;
+  ui->CmdLists = ui_list_pointers_.data();
+  ui->CmdListsCount = count;
+  ui->TotalIdxCount = draw_data->TotalIdxCount;
+  ui->TotalVtxCount = draw_data->TotalVtxCount;
+  ui->DisplayPos = draw_data->DisplayPos;
+  ui->DisplaySize = draw_data->DisplaySize;
+  ui->FramebufferScale = draw_data->FramebufferScale;
+}
+
+void RenderFrame::Execute() {
+  SAMPLES_TRACE_SCOPE("RenderFrame::Execute");
+  GLStateCache* state = GLStateCache::GetInstance();
+  // BeginScaled() falls back to the surface when the target can't be used.
+  bool scaled = false;
+  for (const RenderCommand& command : commands_) {
+    switch (command.type_) {
+      case RENDER_COMMAND_CLEAR:
+        glClearColor(command.clear_color_[0], command.clear_color_[1],
+                     command.clear_color_[2], command.clear_color_[3]);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        break;
+      case RENDER_COMMAND_VIEWPORT:
+        state->Viewport(command.viewport_[0], command.viewport_[1],
+                        command.viewport_[2], command.viewport_[3]);
+        break;
+      case RENDER_COMMAND_BEGIN_GPU_FRAME:
+        command.gpu_timer_.timer_->BeginFrame();
+        break;
+      case RENDER_COMMAND_END_GPU_FRAME:
+        command.gpu_timer_.timer_->EndFrame();
+        break;
+      case RENDER_COMMAND_BEGIN_GPU_SECTION:
+        command.gpu_timer_.timer_->BeginSection(command.gpu_timer_.section_);
+        break;
+      case RENDER_COMMAND_END_GPU_SECTION:
+        command.gpu_timer_.timer_->EndSection();
+        break;
+      case RENDER_COMMAND_RESET_GPU_PHYSICS:
+        command.reset_physics_.physics_->Reset(
+            command.reset_physics_.array_size_,
+            command.reset_physics_.half_size_, command.reset_physics_.seed_);
+        break;
+      case RENDER_COMMAND_STEP_GPU_PHYSICS:
+        command.step_physics_.physics_->Step(command.step_physics_.step_,
+                                             command.step_physics_.num_steps_);
+        break;
+      case RENDER_COMMAND_BEGIN_SCALED:
+        scaled = command.scaled_.target_->BeginFrame(
+            command.scaled_.surface_width_, command.scaled_.surface_height_,
+            command.scaled_.format_, command.scaled_.scale_);
+        break;
+      case RENDER_COMMAND_END_SCALED:
+        if (scaled) {
+          command.scaled_.target_->EndFrame();
+          scaled = false;
+        }
+        break;
+      case RENDER_COMMAND_DRAW_BOXES: {
+        BoxRenderer* renderer = command.boxes_.renderer_;
+        GpuPhysics* gpu_boxes = command.boxes_.gpu_boxes_;
+        renderer->ReserveInstances(command.boxes_.reserve_);
+        renderer->BeginMultipleRender(command.boxes_.tier_);
+        renderer->RenderMultiple(instances_.data() + command.boxes_.first_,
+                                 command.boxes_.count_);
+        if (gpu_boxes != nullptr) {
+          renderer->RenderInstanceBuffer(gpu_boxes->GetInstanceBuffer(),
+                                         gpu_boxes->GetCount());
+        }
+        renderer->EndMultipleRender();
+        break;
+      }
+      case RENDER_COMMAND_DRAW_UI:
+        ImGuiManager::RenderDrawData(ui_data_.get());
+        break;
+    }
+  }
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_FRAME_H_
+#define RENDER_FRAME_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "box_renderer.h"
+#include "gpu_timer.h"
+#include "surface_format.h"
+
+class DynamicResolution;
+class GpuPhysics;
+struct ImDrawData;
+struct ImDrawList;
+
+enum RenderCommandType {
+  RENDER_COMMAND_CLEAR = 0,
+  RENDER_COMMAND_VIEWPORT,
+  RENDER_COMMAND_BEGIN_GPU_FRAME,
+  RENDER_COMMAND_END_GPU_FRAME,
+  RENDER_COMMAND_BEGIN_GPU_SECTION,
+  RENDER_COMMAND_END_GPU_SECTION,
+  RENDER_COMMAND_RESET_GPU_PHYSICS,
+  RENDER_COMMAND_STEP_GPU_PHYSICS,
+  RENDER_COMMAND_BEGIN_SCALED,
+  RENDER_COMMAND_END_SCALED,
+  RENDER_COMMAND_DRAW_BOXES,
+  RENDER_COMMAND_DRAW_UI
+};
+
+// A recorded GL operation. The objects it points to outlive the frame: they
+// are only deleted on the render thread, once it drew the frames recorded
+// before (see RenderThread::Run()).
+struct RenderCommand {
+  RenderCommandType type_;
+  union {
+    float clear_color_[4];
+    int32_t viewport_[4];
+    struct {
+      GpuTimer* timer_;
+      GpuTimerSection section_;
+    } gpu_timer_;
+    struct {
+      GpuPhysics* physics_;
+      int32_t array_size_;
+      float half_size_;
+      uint32_t seed_;
+    } reset_physics_;
+    struct {
+      GpuPhysics* physics_;
+      float step_;
+      int32_t num_steps_;
+    } step_physics_;
+    struct {
+      DynamicResolution* target_;
+      int32_t surface_width_;
+      int32_t surface_height_;
+      SurfaceFormat format_;
+      float scale_;
+    } scaled_;
+    struct {
+      BoxRenderer* renderer_;
+      // The frame's instances from first_, and the GpuPhysics boxes.
+      int32_t first_;
+      int32_t count_;
+      int32_t reserve_;
+      BOX_SHADING_TIER tier_;
+      GpuPhysics* gpu_boxes_;
+    } boxes_;
+  };
+};
+
+/*
+ * The GL work of a frame, recorded on the game thread and replayed with
+ * Execute() on the render thread, a frame later (see RenderThread).
+ *
+ * A frame is a list of commands, plus the data they draw: the box instances,
+ * already transformed, and a copy of the Dear ImGui draw lists, which only
+ * stay valid until the next ImGui::NewFrame(). The frames of the ring are
+ * reused, so once they have grown to the scene recording allocates nothing.
+ * A throttled UI that wasn't rebuilt isn't copied again either.
+ */
+class RenderFrame {
+ public:
+  RenderFrame();
+  ~RenderFrame();
+
+  // Forget the commands of the frame that used the slot. Keeps the memory.
+  void Reset();
+
+  void Clear(float red, float green, float blue, float alpha);
+  void SetViewport(int32_t x, int32_t y, int32_t width, int32_t height);
+
+  void BeginGpuFrame(GpuTimer* timer);
+  void EndGpuFrame(GpuTimer* timer);
+  void BeginGpuSection(GpuTimer* timer, GpuTimerSection section);
+  void EndGpuSection(GpuTimer* timer);
+
+  void ResetGpuPhysics(GpuPhysics* physics, int32_t array_size,
+                       float half_size, uint32_t seed);
+  void StepGpuPhysics(GpuPhysics* physics, float step, int32_t num_steps);
+
+  // Draw the commands up to EndScaled() to `target` at `scale`, see
+  // DynamicResolution::BeginFrame().
+  void BeginScaled(DynamicResolution* target, int32_t surface_width,
+                   int32_t surface_height, SurfaceFormat format, float scale);
+  void EndScaled(DynamicResolution* target);
+
+  // Draw `count` boxes in a single batch with the current shading tier of
+  // `renderer`, and the boxes `gpu_boxes` simulated unless nullptr. Returns
+  // the instances to fill with BoxRenderer::MakeInstance() before the frame
+  // is submitted, valid until the next call. `reserve` is passed to
+  // BoxRenderer::ReserveInstances().
+  BOX_INSTANCE* DrawBoxes(BoxRenderer* renderer, int32_t count,
+                          int32_t reserve, GpuPhysics* gpu_boxes);
+
+  // Draw the Dear ImGui draw data. `version` changes whenever the UI was
+  // rebuilt since the last call, so an unchanged UI isn't copied again.
+  void DrawUi(const ImDrawData* draw_data, int64_t version);
+
+  // Render thread: issue the recorded commands.
+  void Execute();
+
+ private:
+  RenderFrame(const RenderFrame&) = delete;
+  RenderFrame& operator=(const RenderFrame&) = delete;
+
+  RenderCommand* AddCommand(RenderCommandType type);
+  void CopyUi(const ImDrawData* draw_data);
+
+  std::vector<RenderCommand> commands_;
+
+  // Only grows: the instances of a frame are overwritten, not cleared.
+  std::vector<BOX_INSTANCE> instances_;
+  int32_t num_instances_;
+
+  // Copy of the UI, kept across frames.
+  std::unique_ptr<ImDrawData> ui_data_;
+  std::vector<std::unique_ptr<ImDrawList>> ui_lists_;
+  std::vector<ImDrawList*> ui_list_pointers_;
+  int64_t ui_version_;
+};
+
+#endif  // RENDER_FRAME_H_
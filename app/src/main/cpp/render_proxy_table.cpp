@@ -0,0 +1,105 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render_proxy_table.h"
+
+#include <atomic>
+
+#include "job_system.h"
+
+int32_t RenderProxyTable::Add(btRigidBody* body, const btVector3& half_extents,
+                              const float* color) {
+  int32_t index = GetCount();
+  bodies_.push_back(body);
+  poses_.emplace_back();
+  ReadPose(body, &poses_.back());
+  half_extents_[0].push_back(half_extents.x());
+  half_extents_[1].push_back(half_extents.y());
+  half_extents_[2].push_back(half_extents.z());
+  for (auto axis = 0; axis < 3; ++axis) {
+    colors_[axis].push_back(color[axis]);
+  }
+  return index;
+}
+
+void RenderProxyTable::Truncate(int32_t count) {
+  if (count >= GetCount()) {
+    return;
+  }
+  bodies_.resize(count);
+  poses_.resize(count);
+  for (auto axis = 0; axis < 3; ++axis) {
+    half_extents_[axis].resize(count);
+    colors_[axis].resize(count);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Sleeping and static bodies don't move: skip their motion state and the
+// matrix to quaternion conversion.
+//--------------------------------------------------------------------------------
+int32_t RenderProxyTable::UpdatePoses() {
+  std::atomic<int32_t> num_updated(0);
+  JobSystem::GetInstance()->ParallelFor(
+      0, GetCount(), kPoseGrainSize, [&](int32_t begin, int32_t end) {
+        int32_t chunk_updated = 0;
+        for (auto i = begin; i < end; ++i) {
+          btRigidBody* body = bodies_[i];
+          if (!body->isActive()) {
+            continue;
+          }
+          ReadPose(body, &poses_[i]);
+          ++chunk_updated;
+        }
+        num_updated.fetch_add(chunk_updated, std::memory_order_relaxed);
+      });
+  return num_updated.load(std::memory_order_relaxed);
+}
+
+void RenderProxyTable::ReadAllPoses() {
+  JobSystem::GetInstance()->ParallelFor(
+      0, GetCount(), kPoseGrainSize, [this](int32_t begin, int32_t end) {
+        for (auto i = begin; i < end; ++i) {
+          ReadPose(bodies_[i], &poses_[i]);
+        }
+      });
+}
+
+void RenderProxyTable::CopyToSnapshot(BoxSnapshot* boxes,
+                                      int32_t count) const {
+  for (auto i = 0; i < count; ++i) {
+    BoxSnapshot& box = boxes[i];
+    box.current_ = poses_[i];
+    for (auto axis = 0; axis < 3; ++axis) {
+      box.half_extents_[axis] = half_extents_[axis][i];
+      box.color_[axis] = colors_[axis][i];
+    }
+  }
+}
+
+void RenderProxyTable::ReadPose(btRigidBody* body, BoxPose* pose) {
+  btTransform trans;
+  body->getMotionState()->getWorldTransform(trans);
+  const btVector3& origin = trans.getOrigin();
+  btQuaternion rotation = trans.getRotation();
+  pose->position_[0] = origin.x();
+  pose->position_[1] = origin.y();
+  pose->position_[2] = origin.z();
+  pose->rotation_[0] = rotation.x();
+  pose->rotation_[1] = rotation.y();
+  pose->rotation_[2] = rotation.z();
+  pose->rotation_[3] = rotation.w();
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_PROXY_TABLE_H_
+#define RENDER_PROXY_TABLE_H_
+
+#include <cstdint>
+#include <vector>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wextra-semi"
+#include "btBulletDynamicsCommon.h"
+#pragma GCC diagnostic pop
+
+#include "physics_snapshot.h"
+
+/*
+ * What the renderer needs to know about each box, cached when the body is
+ * added instead of being looked up on the body every tick (shape type, half
+ * extents, color). Each attribute is its own array, indexed by the proxy.
+ *
+ * UpdatePoses() only reads back the transforms of the bodies that are awake;
+ * a sleeping body keeps the pose it had when it fell asleep. The poses are
+ * read in chunks of kPoseGrainSize on the JobSystem.
+ *
+ * Owned by the simulation thread.
+ */
+class RenderProxyTable {
+ public:
+  static constexpr int32_t kPoseGrainSize = 256;
+
+  // Append a proxy for `body`. Its pose is read right away. Returns its index.
+  int32_t Add(btRigidBody* body, const btVector3& half_extents,
+              const float* color);
+
+  // Drop the proxies from `count` on.
+  void Truncate(int32_t count);
+
+  void Clear() { Truncate(0); }
+
+  int32_t GetCount() const { return static_cast<int32_t>(bodies_.size()); }
+
+  // Read back the transforms of the awake bodies. Returns how many changed.
+  int32_t UpdatePoses();
+
+  // Re-read every pose, e.g. after the bodies were teleported.
+  void ReadAllPoses();
+
+  // Fill the current pose, extents and color of `count` snapshot boxes.
+  void CopyToSnapshot(BoxSnapshot* boxes, int32_t count) const;
+
+ private:
+  static void ReadPose(btRigidBody* body, BoxPose* pose);
+
+  std::vector<btRigidBody*> bodies_;
+  std::vector<BoxPose> poses_;
+  std::vector<float> half_extents_[3];
+  std::vector<float> colors_[3];
+};
+
+#endif  // RENDER_PROXY_TABLE_H_
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render_thread.h"
+
+#include <unistd.h>
+
+#include <thread>
+
+#include "Thread.h"
+#include "Trace.h"
+#include "adpf_manager.h"
+#include "common.h"
+#include "cpu_topology.h"
+
+RenderThread* RenderThread::GetInstance() {
+  static RenderThread instance;
+  return &instance;
+}
+
+RenderThread::RenderThread()
+    : vm_(nullptr),
+      thread_id_(0),
+      thread_tid_(0),
+      running_(false),
+      recording_(nullptr),
+      num_submitted_(0),
+      num_drawn_(0),
+      task_(nullptr),
+      stopping_(false) {}
+
+void RenderThread::Start(JavaVM* vm, DrawFunction draw) {
+  if (running_) {
+    return;
+  }
+  vm_ = vm;
+  draw_ = draw;
+  stopping_ = false;
+  thread_tid_ = 0;
+  if (samples::ThreadManager::Instance().Start(
+          &thread_id_, RenderThread::RenderThreadMain, this) != 0) {
+    ALOGE("RenderThread: failed to start, rendering on the game thread");
+    return;
+  }
+  running_ = true;
+
+  // Same cores and hint session as the game thread, once the thread
+  // reported its tid.
+  while (thread_tid_ == 0) {
+    std::this_thread::yield();
+  }
+  ADPFManager::GetInstance()->AddThreadIdToHintSession(thread_tid_,
+                                                       THREAD_ROLE_RENDER);
+  ALOGI("RenderThread: started, %d frames in flight", kNumFrames);
+}
+
+void RenderThread::Stop() {
+  if (!running_) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_cv_.notify_one();
+  samples::ThreadManager::Instance().Join(thread_id_);
+  running_ = false;
+  ADPFManager::GetInstance()->RemoveThreadIdFromHintSession(
+      thread_tid_, THREAD_ROLE_RENDER);
+  thread_tid_ = 0;
+  ALOGI("RenderThread: stopped");
+}
+
+void RenderThread::Run(const std::function<void()>& task) {
+  if (!running_ || gettid() == thread_tid_) {
+    task();
+    return;
+  }
+  SAMPLES_TRACE_SCOPE("RenderThread::Run");
+  std::unique_lock<std::mutex> lock(mutex_);
+  task_ = &task;
+  work_cv_.notify_one();
+  done_cv_.wait(lock, [this] { return task_ == nullptr; });
+}
+
+RenderFrame* RenderThread::BeginFrame() {
+  {
+    SAMPLES_TRACE_SCOPE("RenderThread::WaitForFrame");
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] {
+      return num_submitted_ - num_drawn_ < kNumFrames;
+    });
+  }
+  recording_ = &frames_[num_submitted_ % kNumFrames];
+  recording_->Reset();
+  return recording_;
+}
+
+void RenderThread::SubmitFrame() {
+  RenderFrame* frame = recording_;
+  recording_ = nullptr;
+  if (frame == nullptr) {
+    return;
+  }
+  if (!running_) {
+    draw_(frame);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++num_submitted_;
+  }
+  work_cv_.notify_one();
+}
+
+void* RenderThread::RenderThreadMain(void* data) {
+  reinterpret_cast<RenderThread*>(data)->RunRenderThread();
+  return nullptr;
+}
+
+//--------------------------------------------------------------------------------
+// Frames are drawn in the order they were submitted, and before a task, so a
+// task never deletes what a pending frame uses.
+//--------------------------------------------------------------------------------
+void RenderThread::RunRenderThread() {
+  CpuTopology::GetInstance()->PinCurrentThread(THREAD_ROLE_RENDER);
+  // Attached like the game thread, for Swappy calls that go through JNI.
+  JNIEnv* env = nullptr;
+  if (vm_->AttachCurrentThread(&env, nullptr) != 0) {
+    ALOGW("RenderThread: failed to attach to the VM");
+  }
+  thread_tid_ = gettid();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_cv_.wait(lock, [this] {
+      return num_drawn_ < num_submitted_ || task_ != nullptr || stopping_;
+    });
+    if (num_drawn_ < num_submitted_) {
+      RenderFrame* frame = &frames_[num_drawn_ % kNumFrames];
+      lock.unlock();
+      draw_(frame);
+      lock.lock();
+      ++num_drawn_;
+      done_cv_.notify_all();
+    } else if (task_ != nullptr) {
+      const std::function<void()>* task = task_;
+      lock.unlock();
+      (*task)();
+      lock.lock();
+      task_ = nullptr;
+      done_cv_.notify_all();
+    } else {
+      break;
+    }
+  }
+  lock.unlock();
+
+  if (env != nullptr) {
+    vm_->DetachCurrentThread();
+  }
+}
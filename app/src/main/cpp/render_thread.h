@@ -0,0 +1,111 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_THREAD_H_
+#define RENDER_THREAD_H_
+
+#include <jni.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#include "render_frame.h"
+#include "swappy/swappy_common.h"
+
+/*
+ * The thread the EGL context is current on: it issues all the GL calls and
+ * the swaps, so the game thread's frame time is the CPU work of the scene
+ * and the UI, not the driver's.
+ *
+ * The game thread records each frame into a RenderFrame of a ring of
+ * kNumFrames, between BeginFrame() and SubmitFrame(), while the render
+ * thread draws the previous one. The game thread is at most one frame ahead:
+ * BeginFrame() waits until a slot is drawn.
+ *
+ * The EGL and GL object lifecycle (surfaces, contexts, the scene's GL
+ * objects) goes through Run(), which executes on the render thread once the
+ * frames submitted so far were drawn, while the game thread waits. Nothing
+ * the recorded frames point to is deleted before they are drawn.
+ *
+ * The thread is placed on the cores of the game thread and joins its hint
+ * session (THREAD_ROLE_RENDER). Without it, e.g. when it failed to start,
+ * everything runs on the game thread.
+ *
+ * Game thread only.
+ */
+class RenderThread {
+ public:
+  static constexpr int32_t kNumFrames = 2;
+
+  // Draws and presents a frame, on the render thread.
+  typedef std::function<void(RenderFrame*)> DrawFunction;
+
+  static RenderThread* GetInstance();
+
+  // `vm` to attach the thread to. Call once the ADPFManager is initialized.
+  void Start(JavaVM* vm, DrawFunction draw);
+
+  // Draw the frames submitted and stop the thread.
+  void Stop();
+
+  bool IsRunning() const { return running_; }
+
+  // Run `task` on the render thread once the frames submitted were drawn,
+  // and wait for it. Runs it right away on the render thread itself.
+  void Run(const std::function<void()>& task);
+
+  // Start recording a frame. Waits while all the slots are being drawn.
+  RenderFrame* BeginFrame();
+
+  // The frame being recorded, nullptr outside of BeginFrame() and
+  // SubmitFrame().
+  RenderFrame* GetFrame() { return recording_; }
+
+  // Hand the frame recorded over to the render thread.
+  void SubmitFrame();
+
+ private:
+  RenderThread();
+  RenderThread(const RenderThread&) = delete;
+  RenderThread& operator=(const RenderThread&) = delete;
+
+  static void* RenderThreadMain(void* data);
+  void RunRenderThread();
+
+  DrawFunction draw_;
+  JavaVM* vm_;
+  SwappyThreadId thread_id_;
+  std::atomic<int32_t> thread_tid_;
+  bool running_;
+
+  RenderFrame frames_[kNumFrames];
+  RenderFrame* recording_;
+
+  // Guards the counters and the task, which wake up the render thread
+  // (work_cv_) and the game thread (done_cv_).
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  int64_t num_submitted_;
+  int64_t num_drawn_;
+  const std::function<void()>* task_;
+  bool stopping_;
+};
+
+#endif  // RENDER_THREAD_H_
@@ -0,0 +1,298 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "replay_log.h"
+
+#include <algorithm>
+#include <ctime>
+
+#include "common.h"
+#include "util.h"
+
+namespace {
+const uint32_t kReplayMagic = 0x314c5052;  // "RPL1"
+// Bump when a record or ReplayStart changes.
+const uint32_t kReplayVersion = 1;
+
+struct ReplayHeader {
+  uint32_t magic_;
+  uint32_t version_;
+  uint64_t device_hash_;
+  ReplayStart start_;
+};
+
+// Each record starts with its tag.
+enum ReplayRecordTag : uint8_t {
+  REPLAY_RECORD_TICK = 1,
+  REPLAY_RECORD_FRAME
+};
+}  // namespace
+
+ReplayLog* ReplayLog::GetInstance() {
+  static ReplayLog instance;
+  return &instance;
+}
+
+ReplayLog::ReplayLog()
+    : mode_(REPLAY_MODE_OFF),
+      duration_(0.f),
+      recording_(false),
+      replaying_(false),
+      finished_(false),
+      start_time_(0.f),
+      file_(nullptr),
+      num_recorded_frames_(0),
+      num_recorded_ticks_(0),
+      next_frame_(0),
+      next_event_(0),
+      next_tick_(0),
+      num_checked_ticks_(0),
+      num_diverged_ticks_(0),
+      first_diverged_tick_(-1) {}
+
+ReplayLog::~ReplayLog() {
+  if (recording_) {
+    Finish(Clock());
+  }
+}
+
+void ReplayLog::ConfigureRecord(float duration) {
+  mode_ = REPLAY_MODE_RECORD;
+  duration_ = duration;
+  ALOGI("ReplayLog: recording %.0f sec", duration_);
+}
+
+void ReplayLog::ConfigureReplay(const char* path) {
+  mode_ = REPLAY_MODE_REPLAY;
+  replay_path_ = path;
+  ALOGI("ReplayLog: replaying %s", path);
+}
+
+bool ReplayLog::StartRecording(const std::string& directory,
+                               const ReplayStart& start, float now) {
+  if (mode_ != REPLAY_MODE_RECORD || recording_ || finished_) {
+    return false;
+  }
+  char name[64];
+  time_t wall_time = time(nullptr);
+  strftime(name, sizeof(name), "/replay_%Y%m%d_%H%M%S.bin",
+           localtime(&wall_time));
+  path_ = directory + name;
+  file_ = fopen(path_.c_str(), "wb");
+  if (file_ == nullptr) {
+    ALOGW("ReplayLog: cannot create %s", path_.c_str());
+    finished_ = true;
+    return false;
+  }
+  ReplayHeader header;
+  header.magic_ = kReplayMagic;
+  header.version_ = kReplayVersion;
+  header.device_hash_ = GetDeviceHash();
+  header.start_ = start;
+  if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+    ALOGW("ReplayLog: cannot write %s", path_.c_str());
+    fclose(file_);
+    file_ = nullptr;
+    finished_ = true;
+    return false;
+  }
+  start_time_ = now;
+  num_recorded_frames_ = 0;
+  num_recorded_ticks_ = 0;
+  recording_ = true;
+  ALOGI("ReplayLog: recording to %s, seed %u", path_.c_str(),
+        start.random_seed_);
+  return true;
+}
+
+bool ReplayLog::StartReplay(const std::string& directory, ReplayStart* start,
+                            float now) {
+  if (mode_ != REPLAY_MODE_REPLAY || replaying_ || finished_) {
+    return false;
+  }
+  path_ = !replay_path_.empty() && replay_path_[0] == '/'
+              ? replay_path_
+              : directory + "/" + replay_path_;
+  FILE* file = fopen(path_.c_str(), "rb");
+  if (file == nullptr) {
+    ALOGW("ReplayLog: cannot open %s", path_.c_str());
+    finished_ = true;
+    return false;
+  }
+  ReplayHeader header;
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            header.magic_ == kReplayMagic &&
+            header.version_ == kReplayVersion && Load(file);
+  fclose(file);
+  if (!ok) {
+    ALOGW("ReplayLog: %s is not a replay log of this version",
+          path_.c_str());
+    finished_ = true;
+    return false;
+  }
+  if (header.device_hash_ != GetDeviceHash()) {
+    // Still worth running: the state hashes tell whether it diverged.
+    ALOGW("ReplayLog: %s was recorded on another device", path_.c_str());
+  }
+
+  *start = header.start_;
+  start_time_ = now;
+  next_frame_ = next_event_ = next_tick_ = 0;
+  num_checked_ticks_ = num_diverged_ticks_ = 0;
+  first_diverged_tick_ = -1;
+  replaying_ = true;
+  ALOGI("ReplayLog: %zu frames, %zu ticks, seed %u", frames_.size(),
+        ticks_.size(), start->random_seed_);
+  return true;
+}
+
+//--------------------------------------------------------------------------------
+// Split the records by thread, each one then walks its own array. A record
+// cut short, e.g. by the app being killed while recording, ends the log.
+//--------------------------------------------------------------------------------
+bool ReplayLog::Load(FILE* file) {
+  frames_.clear();
+  events_.clear();
+  ticks_.clear();
+  uint8_t tag;
+  while (fread(&tag, sizeof(tag), 1, file) == 1) {
+    if (tag == REPLAY_RECORD_TICK) {
+      ReplayTick tick;
+      if (fread(&tick, sizeof(tick), 1, file) != 1) {
+        break;
+      }
+      ticks_.push_back(tick);
+    } else if (tag == REPLAY_RECORD_FRAME) {
+      ReplayFrame frame;
+      if (fread(&frame, sizeof(frame), 1, file) != 1) {
+        break;
+      }
+      const size_t first = events_.size();
+      events_.resize(first + frame.num_events_);
+      if (frame.num_events_ > 0 &&
+          fread(&events_[first], sizeof(ReplayEvent), frame.num_events_,
+                file) != frame.num_events_) {
+        events_.resize(first);
+        break;
+      }
+      frames_.push_back(frame);
+    } else {
+      ALOGW("ReplayLog: unknown record %u", tag);
+      return false;
+    }
+  }
+  return !frames_.empty() && !ticks_.empty();
+}
+
+void ReplayLog::RecordEvent(const ReplayEvent& event) {
+  if (recording_) {
+    pending_events_.push_back(event);
+  }
+}
+
+bool ReplayLog::RecordFrame(const ReplayFrame& frame, float now) {
+  if (!recording_) {
+    return false;
+  }
+  ReplayFrame record = frame;
+  record.num_events_ = static_cast<uint16_t>(
+      std::min<size_t>(pending_events_.size(), UINT16_MAX));
+  record.reserved_ = 0;
+  Write(REPLAY_RECORD_FRAME, &record, sizeof(record), pending_events_.data(),
+        record.num_events_ * sizeof(ReplayEvent));
+  pending_events_.clear();
+  ++num_recorded_frames_;
+  if (now - start_time_ >= duration_) {
+    Finish(now);
+    return false;
+  }
+  return true;
+}
+
+void ReplayLog::RecordTick(const ReplayTick& tick) {
+  if (recording_ && Write(REPLAY_RECORD_TICK, &tick, sizeof(tick))) {
+    ++num_recorded_ticks_;
+  }
+}
+
+bool ReplayLog::Write(uint8_t tag, const void* data, size_t size,
+                      const void* extra, size_t extra_size) {
+  std::lock_guard<std::mutex> lock(file_mutex_);
+  if (file_ == nullptr) {
+    return false;
+  }
+  return fwrite(&tag, sizeof(tag), 1, file_) == 1 &&
+         fwrite(data, size, 1, file_) == 1 &&
+         (extra_size == 0 || fwrite(extra, extra_size, 1, file_) == 1);
+}
+
+bool ReplayLog::NextFrame(ReplayFrame* frame, const ReplayEvent** events) {
+  if (!replaying_ || next_frame_ >= frames_.size()) {
+    return false;
+  }
+  *frame = frames_[next_frame_++];
+  *events = events_.data() + next_event_;
+  next_event_ += frame->num_events_;
+  return true;
+}
+
+bool ReplayLog::NextTick(ReplayTick* tick) {
+  if (!replaying_ || next_tick_ >= ticks_.size()) {
+    return false;
+  }
+  *tick = ticks_[next_tick_++];
+  return true;
+}
+
+void ReplayLog::CheckTick(uint32_t state_hash) {
+  if (next_tick_ == 0) {
+    return;
+  }
+  const int32_t index = static_cast<int32_t>(next_tick_ - 1);
+  ++num_checked_ticks_;
+  if (state_hash != ticks_[index].state_hash_) {
+    if (num_diverged_ticks_++ == 0) {
+      first_diverged_tick_ = index;
+      ALOGW("ReplayLog: the simulation diverged at tick %d", index);
+    }
+  }
+}
+
+void ReplayLog::Finish(float now) {
+  if (recording_) {
+    recording_ = false;
+    std::lock_guard<std::mutex> lock(file_mutex_);
+    fclose(file_);
+    file_ = nullptr;
+    ALOGI("ReplayLog: done, %d frames and %d ticks in %s",
+          num_recorded_frames_, num_recorded_ticks_.load(), path_.c_str());
+  } else if (replaying_) {
+    replaying_ = false;
+    const float duration = now - start_time_;
+    ALOGI("ReplayLog: done, %zu frames in %.1f sec, %.2f ms per frame",
+          next_frame_, duration,
+          next_frame_ > 0 ? duration * 1000.f / next_frame_ : 0.f);
+    if (num_diverged_ticks_ > 0) {
+      ALOGW("ReplayLog: %d of %d ticks diverged, the first at tick %d",
+            num_diverged_ticks_.load(), num_checked_ticks_.load(),
+            first_diverged_tick_.load());
+    } else {
+      ALOGI("ReplayLog: all %d ticks matched the recording",
+            num_checked_ticks_.load());
+    }
+  }
+  finished_ = true;
+}
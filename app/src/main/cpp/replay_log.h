@@ -0,0 +1,202 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REPLAY_LOG_H_
+#define REPLAY_LOG_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "device_profile.h"
+#include "scene_manager.h"
+
+enum ReplayMode {
+  REPLAY_MODE_OFF = 0,
+  REPLAY_MODE_RECORD,
+  REPLAY_MODE_REPLAY
+};
+
+// Flags of a ReplayTick.
+enum ReplayTickFlags {
+  REPLAY_TICK_RECREATE_WORLD = 1 << 0,
+  REPLAY_TICK_RESPAWN = 1 << 1,
+  REPLAY_TICK_MULTITHREADED = 1 << 2,
+  REPLAY_TICK_SLEEPING = 1 << 3,
+  REPLAY_TICK_FIXED_TIMESTEP = 1 << 4,
+  // The periodic reset is due.
+  REPLAY_TICK_RESET_DUE = 1 << 5,
+  // First tick since the simulation thread started or resumed.
+  REPLAY_TICK_RESTART = 1 << 6
+};
+
+// Flags of a ReplayFrame.
+enum ReplayFrameFlags {
+  // The governor decreased knob_, rather than increased it.
+  REPLAY_FRAME_DECREASE = 1 << 0,
+  // GpuPhysics simulated the boxes, and respawned them instead of stepping.
+  REPLAY_FRAME_GPU_PHYSICS = 1 << 1,
+  REPLAY_FRAME_GPU_RESET = 1 << 2
+};
+
+// Everything a simulation tick reads from outside of the physics world, and
+// a hash of the world once it ran (RigidBodyPool::GetStateHash()).
+struct ReplayTick {
+  float elapsed_;
+  int8_t array_size_;
+  int8_t physics_step_;
+  int8_t solver_tier_;
+  int8_t thermal_status_;
+  int8_t broadphase_;
+  int8_t physics_backend_;
+  uint8_t flags_;  // ReplayTickFlags
+  uint8_t reserved_;
+  uint32_t state_hash_;
+};
+
+// What the game thread fed the scene in a frame: the time GpuPhysics
+// advanced by and its load, and the knob the governor moved, -1 for none.
+// The frame's input events follow it in the log.
+struct ReplayFrame {
+  float delta_;
+  int8_t knob_;
+  uint8_t flags_;  // ReplayFrameFlags
+  int8_t array_size_;
+  int8_t physics_step_;
+  uint16_t num_events_;
+  uint16_t reserved_;
+};
+
+// A cooked pointer event, as delivered to the scene (see InputQueue).
+struct ReplayEvent {
+  int32_t type_;  // COOKED_EVENT_TYPE_POINTER_*
+  int32_t pointer_id_;
+  PointerCoords coords_;
+};
+
+// The state the scene starts from, before the first tick and frame.
+struct ReplayStart {
+  uint32_t random_seed_;
+  int32_t screen_width_;
+  int32_t screen_height_;
+  int32_t broadphase_;
+  int32_t multithreaded_;
+  DeviceProfile profile_;
+};
+
+/*
+ * Deterministic record and replay of the demo scene, requested by the
+ * activity from the intent extras (see ADPFSampleActivity), so two builds can
+ * be compared on the same workload, frame for frame.
+ *
+ * A recording is a small binary file: a header with the ReplayStart, then
+ * one record per simulation tick and per frame, in the order they ran. The
+ * simulation thread logs the inputs of each tick, the game thread the frame
+ * delta, the governor decision and the cooked input events of each frame.
+ *
+ * A replay reads the whole log first. The scene then takes the inputs of each
+ * tick and frame from it instead of the clocks, the governor, the thermal
+ * status and the touches, so it simulates the same boxes however long the
+ * ticks and frames take. The state hash of each tick is checked against the
+ * recorded one; a mismatch means the simulation diverged. Only the single
+ * threaded world is bit for bit reproducible: the multithreaded dispatcher
+ * gathers the contact manifolds in the order its threads finish.
+ *
+ * The game thread owns the frames, the simulation thread the ticks.
+ */
+class ReplayLog {
+ public:
+  static ReplayLog* GetInstance();
+
+  // Record `duration` seconds of the demo scene, or replay the log at
+  // `path`, relative to the external files directory unless absolute. Call
+  // before the native activity starts.
+  void ConfigureRecord(float duration);
+  void ConfigureReplay(const char* path);
+
+  bool IsRequested() const { return mode_ != REPLAY_MODE_OFF; }
+  bool IsRecording() const { return recording_; }
+  bool IsReplaying() const { return replaying_; }
+  bool IsFinished() const { return finished_; }
+
+  // Create the recording in `directory` and write `start`. `now` is in
+  // seconds (see Clock()).
+  bool StartRecording(const std::string& directory, const ReplayStart& start,
+                      float now);
+
+  // Read the log, and the state to start from in `start`.
+  bool StartReplay(const std::string& directory, ReplayStart* start,
+                   float now);
+
+  // Recording. An event is logged with the next frame. RecordFrame() returns
+  // false once the recording is over and closed.
+  void RecordEvent(const ReplayEvent& event);
+  bool RecordFrame(const ReplayFrame& frame, float now);
+  void RecordTick(const ReplayTick& tick);
+
+  // Replay. Return false once the log has no more frames or ticks. The
+  // events of the frame are valid until the next call.
+  bool NextFrame(ReplayFrame* frame, const ReplayEvent** events);
+  bool NextTick(ReplayTick* tick);
+  // Check the state the last tick from NextTick() left the world in.
+  void CheckTick(uint32_t state_hash);
+
+  // Close the recording, or log the outcome of the replay.
+  void Finish(float now);
+
+ private:
+  ReplayLog();
+  ~ReplayLog();
+  ReplayLog(const ReplayLog&) = delete;
+  ReplayLog& operator=(const ReplayLog&) = delete;
+
+  // Append a record. `size` bytes of `data`, then `extra_size` of `extra`.
+  bool Write(uint8_t tag, const void* data, size_t size,
+             const void* extra = nullptr, size_t extra_size = 0);
+  bool Load(FILE* file);
+
+  ReplayMode mode_;
+  float duration_;
+  std::string replay_path_;
+  std::string path_;
+  std::atomic<bool> recording_;
+  std::atomic<bool> replaying_;
+  std::atomic<bool> finished_;
+  float start_time_;
+
+  // Recording: both threads append to the file.
+  std::mutex file_mutex_;
+  FILE* file_;
+  std::vector<ReplayEvent> pending_events_;
+  int32_t num_recorded_frames_;
+  std::atomic<int32_t> num_recorded_ticks_;
+
+  // Replay: the log, read once, and where each thread is in it.
+  std::vector<ReplayFrame> frames_;
+  std::vector<ReplayEvent> events_;
+  std::vector<ReplayTick> ticks_;
+  size_t next_frame_;
+  size_t next_event_;
+  size_t next_tick_;
+  std::atomic<int32_t> num_checked_ticks_;
+  std::atomic<int32_t> num_diverged_ticks_;
+  std::atomic<int32_t> first_diverged_tick_;
+};
+
+#endif  // REPLAY_LOG_H_
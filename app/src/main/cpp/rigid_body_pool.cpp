@@ -0,0 +1,203 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "rigid_body_pool.h"
+
+#include <algorithm>
+
+namespace {
+const btScalar kBoxMass = 1.f;
+const uint32_t kRandomSeed = 2463534242u;
+
+uint32_t HashBytes(uint32_t hash, const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+}  // namespace
+
+RigidBodyPool::RigidBodyPool(btDiscreteDynamicsWorld* world,
+                             btBoxShape* shape)
+    : world_(world),
+      shape_(shape),
+      local_inertia_(0, 0, 0),
+      half_extents_(shape->getHalfExtentsWithoutMargin()),
+      half_size_(half_extents_.x()),
+      num_active_(0),
+      target_count_(0),
+      array_size_(1),
+      sleeping_enabled_(false),
+      random_state_(kRandomSeed) {
+  shape_->calculateLocalInertia(kBoxMass, local_inertia_);
+}
+
+RigidBodyPool::~RigidBodyPool() {
+  for (auto i = 0; i < static_cast<int32_t>(bodies_.size()); ++i) {
+    btRigidBody* body = bodies_[i];
+    if (i < num_active_) {
+      world_->removeRigidBody(body);
+    }
+    // The arena only gives the memory back, run the destructors here.
+    body->getMotionState()->~btMotionState();
+    body->~btRigidBody();
+  }
+  arena_.Release();
+}
+
+void RigidBodyPool::SetTargetCount(int32_t count, int32_t array_size) {
+  target_count_ = count;
+  array_size_ = array_size > 0 ? array_size : 1;
+}
+
+int32_t RigidBodyPool::Update(int32_t max_changes) {
+  int32_t changes = 0;
+  while (num_active_ < target_count_ && changes < max_changes) {
+    btRigidBody* body;
+    if (num_active_ < static_cast<int32_t>(bodies_.size())) {
+      body = bodies_[num_active_];
+    } else {
+      body = CreateBody();
+      bodies_.push_back(body);
+    }
+    Spawn(body, num_active_);
+    world_->addRigidBody(body);
+    ++num_active_;
+    ++changes;
+  }
+
+  // Park from the end, so the remaining bodies keep their index.
+  while (num_active_ > target_count_ && changes < max_changes) {
+    --num_active_;
+    world_->removeRigidBody(bodies_[num_active_]);
+    ++changes;
+  }
+  return changes;
+}
+
+int32_t RigidBodyPool::Respawn(int32_t first, int32_t count) {
+  int32_t end = std::min(first + count, num_active_);
+  btTransform transforms[kRespawnBlockSize];
+  for (auto block = first; block < end; block += kRespawnBlockSize) {
+    const int32_t block_end = std::min(block + kRespawnBlockSize, end);
+    for (auto i = block; i < block_end; ++i) {
+      GetSpawnTransform(i, &transforms[i - block]);
+    }
+    for (auto i = block; i < block_end; ++i) {
+      btRigidBody* body = bodies_[i];
+      Place(body, transforms[i - block]);
+      world_->updateSingleAabb(body);
+    }
+  }
+  return std::max(end - first, 0);
+}
+
+void RigidBodyPool::SetSleepingEnabled(bool enabled) {
+  if (enabled == sleeping_enabled_) {
+    return;
+  }
+  sleeping_enabled_ = enabled;
+  for (auto i = 0; i < num_active_; ++i) {
+    bodies_[i]->forceActivationState(enabled ? ACTIVE_TAG
+                                             : DISABLE_DEACTIVATION);
+  }
+}
+
+int32_t RigidBodyPool::GetAwakeCount() const {
+  int32_t count = 0;
+  for (auto i = 0; i < num_active_; ++i) {
+    count += bodies_[i]->isActive() ? 1 : 0;
+  }
+  return count;
+}
+
+//--------------------------------------------------------------------------------
+// The bits of the floats, not their values: a replay must match exactly.
+//--------------------------------------------------------------------------------
+uint32_t RigidBodyPool::GetStateHash() const {
+  uint32_t hash = 2166136261u;
+  for (auto i = 0; i < num_active_; ++i) {
+    const btRigidBody* body = bodies_[i];
+    const btTransform& transform = body->getWorldTransform();
+    const btVector3& origin = transform.getOrigin();
+    const btQuaternion rotation = transform.getRotation();
+    const btVector3& velocity = body->getLinearVelocity();
+    const btVector3& spin = body->getAngularVelocity();
+    const float state[13] = {
+        origin.x(),   origin.y(),   origin.z(),   rotation.x(), rotation.y(),
+        rotation.z(), rotation.w(), velocity.x(), velocity.y(), velocity.z(),
+        spin.x(),     spin.y(),     spin.z()};
+    hash = HashBytes(hash, state, sizeof(state));
+  }
+  return hash;
+}
+
+btRigidBody* RigidBodyPool::CreateBody() {
+  // using motionstate is recommended, it provides interpolation
+  // capabilities, and only synchronizes 'active' objects
+  btDefaultMotionState* motion_state = arena_.New<btDefaultMotionState>();
+  btRigidBody::btRigidBodyConstructionInfo info(kBoxMass, motion_state, shape_,
+                                                local_inertia_);
+  return arena_.New<btRigidBody>(info);
+}
+
+void RigidBodyPool::Spawn(btRigidBody* body, int32_t index) {
+  btTransform transform;
+  GetSpawnTransform(index, &transform);
+  Place(body, transform);
+}
+
+//--------------------------------------------------------------------------------
+// Slot `index` of the spawn grid, with a random rotation around (1, 1, 0).
+//--------------------------------------------------------------------------------
+void RigidBodyPool::GetSpawnTransform(int32_t index, btTransform* transform) {
+  const int32_t k = index / (array_size_ * array_size_);
+  const int32_t i = (index / array_size_) % array_size_;
+  const int32_t j = index % array_size_;
+
+  transform->setOrigin(btVector3(
+      btScalar((-half_size_ * array_size_ / 2) + half_size_ * 2.0 * i),
+      btScalar(10 + half_size_ * k),
+      btScalar((-half_size_ * array_size_ / 2) + half_size_ * 2.0 * j)));
+  const btScalar half_angle = NextRandomAngle() * btScalar(0.5);
+  // The normalized axis is (1, 1, 0) / sqrt(2).
+  const btScalar s = btSin(half_angle) * SIMDSQRT12;
+  transform->setRotation(btQuaternion(s, s, 0.f, btCos(half_angle)));
+}
+
+//--------------------------------------------------------------------------------
+// Move a body to `transform`, at rest.
+//--------------------------------------------------------------------------------
+void RigidBodyPool::Place(btRigidBody* body, const btTransform& transform) {
+  body->setWorldTransform(transform);
+  body->getMotionState()->setWorldTransform(transform);
+  body->setLinearVelocity(btVector3(0, 0, 0));
+  body->setAngularVelocity(btVector3(0, 0, 0));
+  body->clearForces();
+  body->forceActivationState(sleeping_enabled_ ? ACTIVE_TAG
+                                              : DISABLE_DEACTIVATION);
+  body->setDeactivationTime(0.f);
+}
+
+float RigidBodyPool::NextRandomAngle() {
+  random_state_ ^= random_state_ << 13;
+  random_state_ ^= random_state_ >> 17;
+  random_state_ ^= random_state_ << 5;
+  // The top 24 bits, to [0, 2 pi).
+  return static_cast<float>(random_state_ >> 8) *
+         (SIMD_2_PI / static_cast<float>(1 << 24));
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RIGID_BODY_POOL_H_
+#define RIGID_BODY_POOL_H_
+
+#include <cstdint>
+#include <vector>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wextra-semi"
+#include "btBulletDynamicsCommon.h"
+#pragma GCC diagnostic pop
+
+#include "physics_arena.h"
+
+/*
+ * Pool of the dynamic boxes of the demo, all sharing one box shape from the
+ * ShapeCache.
+ *
+ * Changing the box count does not rebuild the scene: bodies are added to or
+ * removed from the world incrementally, at most `max_changes` per Update(),
+ * so a large change is spread over several simulation ticks. Removed bodies
+ * are parked rather than freed, and are reused when the count goes up again.
+ *
+ * Active bodies keep their index while the count changes, so per-box data
+ * indexed by it (e.g. the colors) stays stable.
+ *
+ * When sleeping is enabled, bodies that came to rest are deactivated and the
+ * island manager skips them until something wakes them up.
+ *
+ * Bodies and motion states are allocated from an arena, interleaved in
+ * creation order, so walking the bodies walks memory linearly, and
+ * destroying the pool frees a handful of blocks.
+ *
+ * Respawn() works on blocks of kRespawnBlockSize consecutive bodies: the
+ * spawn transforms of a block are computed into a local array first, then
+ * applied, and the broadphase proxy of each body is moved right away. As the
+ * index walks the spawn grid row by row, the bodies of a block are
+ * neighbours in space and the broadphase tree updates stay local.
+ */
+class RigidBodyPool {
+ public:
+  // Default # of bodies added or parked per Update().
+  static constexpr int32_t kMaxChangesPerUpdate = 64;
+  // # of bodies whose spawn transforms are computed together in Respawn().
+  static constexpr int32_t kRespawnBlockSize = 64;
+
+  // `shape` is the shared shape of the boxes, it must outlive the pool.
+  RigidBodyPool(btDiscreteDynamicsWorld* world, btBoxShape* shape);
+
+  // Removes the active bodies from the world and frees all bodies, but not
+  // the shape.
+  ~RigidBodyPool();
+
+  // Set the # of bodies to converge to. New bodies are spawned on the grid of
+  // an `array_size`^3 cube.
+  void SetTargetCount(int32_t count, int32_t array_size);
+
+  // Add or park up to `max_changes` bodies. Returns the # of bodies added or
+  // parked.
+  int32_t Update(int32_t max_changes);
+
+  // Put up to `count` active bodies from index `first` back to their spawn
+  // point, updating their broadphase proxies. Returns the # of bodies
+  // respawned.
+  int32_t Respawn(int32_t first, int32_t count);
+
+  // Seed of the spawn rotations, for reproducible runs.
+  void SetRandomSeed(uint32_t seed) { random_state_ = seed != 0 ? seed : 1; }
+
+  // Let resting bodies deactivate, or keep all bodies simulated.
+  void SetSleepingEnabled(bool enabled);
+  bool IsSleepingEnabled() const { return sleeping_enabled_; }
+
+  // # of bodies in the world, and how many of them are awake.
+  int32_t GetActiveCount() const { return num_active_; }
+  int32_t GetAwakeCount() const;
+  // FNV-1a hash of the transforms and velocities of the active bodies, to
+  // check that two runs simulated the same.
+  uint32_t GetStateHash() const;
+  btRigidBody* GetBody(int32_t index) const { return bodies_[index]; }
+  const btBoxShape* GetShape() const { return shape_; }
+  const btVector3& GetHalfExtents() const { return half_extents_; }
+
+ private:
+  btRigidBody* CreateBody();
+  void Spawn(btRigidBody* body, int32_t index);
+  void GetSpawnTransform(int32_t index, btTransform* transform);
+  void Place(btRigidBody* body, const btTransform& transform);
+  // Xorshift, random() is much slower and takes a lock.
+  float NextRandomAngle();
+
+  btDiscreteDynamicsWorld* world_;
+  PhysicsArena arena_;
+  btBoxShape* shape_;
+  btVector3 local_inertia_;
+  btVector3 half_extents_;
+  float half_size_;
+
+  // All bodies. The first num_active_ are in the world, the rest are parked.
+  std::vector<btRigidBody*> bodies_;
+  int32_t num_active_;
+
+  int32_t target_count_;
+  int32_t array_size_;
+  bool sleeping_enabled_;
+  uint32_t random_state_;
+};
+
+#endif  // RIGID_BODY_POOL_H_
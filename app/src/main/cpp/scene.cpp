@@ -16,6 +16,8 @@
 
 #include "scene.h"
 
+#include <chrono>
+
 // These are all stubs. Subclasses should override to implement their
 // specific functionality.
 
@@ -41,4 +43,25 @@ void Scene::OnPause() {}
 
 void Scene::OnResume() {}
 
+void Scene::OnTrimMemory(MemoryPressureLevel /* level */) {}
+
+bool Scene::AreAssetsLoaded() const {
+  for (const auto &asset : pending_assets_) {
+    if (asset.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Scene::WaitForAssets() const {
+  for (const auto &asset : pending_assets_) {
+    asset.wait();
+  }
+}
+
+void Scene::AddPendingAsset(const AssetFuture &asset) {
+  pending_assets_.push_back(asset);
+}
+
 Scene::~Scene() {}
@@ -17,6 +17,11 @@
 #ifndef SCENE_H_
 #define SCENE_H_
 
+#include <vector>
+
+#include "asset_loader.h"
+#include "memory_tracker.h"
+
 struct PointerCoords;
 
 /* Represents a scene. A scene is an object that knows how to render itself to
@@ -60,8 +65,26 @@ class Scene {
   // Called when game is resumed (e.g. onResumed())
   virtual void OnResume();
 
+  // Called on memory pressure, with the GL context current. At
+  // MEMORY_PRESSURE_RELEASE_GRAPHICS, OnKillGraphics() follows.
+  virtual void OnTrimMemory(MemoryPressureLevel level);
+
+  // Returns true once the assets the scene waits for are loaded. Until then
+  // the SceneManager keeps the current scene running.
+  bool AreAssetsLoaded() const;
+
+  // Block until the assets the scene waits for are loaded.
+  void WaitForAssets() const;
+
   // Destructor
   virtual ~Scene();
+
+ protected:
+  // Delay the installation of the scene until `asset` is loaded.
+  void AddPendingAsset(const AssetFuture &asset);
+
+ private:
+  std::vector<AssetFuture> pending_assets_;
 };
 
 #endif  // SCENE_H_
@@ -16,7 +16,16 @@
 
 #include "scene_manager.h"
 
+#include <android/native_window.h>
+
+#include <chrono>
+
+#include "adpf_manager.h"
 #include "common.h"
+#include "imgui_manager.h"
+#include "input_queue.h"
+#include "native_engine.h"
+#include "render_thread.h"
 #include "scene.h"
 #include "swappy/swappyGL.h"
 #include "swappy/swappyGL_extra.h"
@@ -32,6 +41,7 @@ SceneManager::SceneManager() {
   mPreferredSwapInterval = SWAPPY_SWAP_60FPS;
 
   mSceneToInstall = NULL;
+  mInstallPreloadedScene = false;
 
   mHasGraphics = false;
 }
@@ -41,42 +51,124 @@ void SceneManager::RequestNewScene(Scene *newScene) {
   mSceneToInstall = newScene;
 }
 
+void SceneManager::PreloadScene(std::function<Scene *()> factory) {
+  if (mPreloadedScene.valid()) {
+    ALOGW("SceneManager: dropping the previous preloaded scene");
+    delete mPreloadedScene.get();
+  }
+  mInstallPreloadedScene = false;
+  mPreloadedScene = std::async(std::launch::async, [factory]() {
+    Scene *scene = factory();
+    // Don't leave the thread attached to the VM, e.g. by a JNI call made
+    // while building the scene.
+    JavaVM *vm = NativeEngine::GetInstance()->GetAndroidApp()->activity->vm;
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) ==
+        JNI_OK) {
+      vm->DetachCurrentThread();
+    }
+    return scene;
+  });
+  ALOGI("SceneManager: preloading a scene");
+}
+
+void SceneManager::RequestPreloadedScene() {
+  if (!mPreloadedScene.valid()) {
+    ALOGW("SceneManager: no preloaded scene to install");
+    return;
+  }
+  mInstallPreloadedScene = true;
+}
+
 void SceneManager::InstallScene(Scene *newScene) {
   ALOGI("SceneManager: installing scene %p.", newScene);
 
-  // kill graphics, if we have them.
-  bool hadGraphics = mHasGraphics;
-  if (mHasGraphics) {
-    KillGraphics();
+  // Normally a no-op: DoFrame() only installs a scene once it is loaded.
+  if (newScene) {
+    newScene->WaitForAssets();
   }
 
-  // If we have an existing scene, uninstall it.
-  if (mCurScene) {
-    mCurScene->OnUninstall();
-    delete mCurScene;
-    mCurScene = NULL;
-  }
+  // The scenes create and delete their GL objects on the render thread,
+  // once it drew the frames that use the old ones.
+  RenderThread::GetInstance()->Run([this, newScene]() {
+    // kill graphics, if we have them.
+    bool hadGraphics = mHasGraphics;
+    if (mHasGraphics) {
+      KillGraphics();
+    }
 
-  // install the new scene
-  mCurScene = newScene;
-  if (mCurScene) {
-    mCurScene->OnInstall();
-  }
+    // If we have an existing scene, uninstall it.
+    if (mCurScene) {
+      mCurScene->OnUninstall();
+      delete mCurScene;
+      mCurScene = NULL;
+    }
+
+    // install the new scene
+    mCurScene = newScene;
+    if (mCurScene) {
+      mCurScene->OnInstall();
+    }
+
+    // if we had graphics before, start them again.
+    if (hadGraphics) {
+      StartGraphics();
+    }
+  });
 
-  // if we had graphics before, start them again.
-  if (hadGraphics) {
-    StartGraphics();
+  // The previous scene's UI must not be drawn again.
+  ImGuiManager *imguiManager = NativeEngine::GetInstance()->GetImGuiManager();
+  if (imguiManager) {
+    imguiManager->RequestUpdate();
   }
 }
 
 Scene *SceneManager::GetScene() { return mCurScene; }
 
+static bool _dispatch_cooked_event(struct CookedEvent *event) {
+  SceneManager *mgr = SceneManager::GetInstance();
+  PointerCoords coords;
+  memset(&coords, 0, sizeof(coords));
+  coords.x_ = event->motion_x_;
+  coords.y_ = event->motion_y_;
+  coords.min_x_ = event->motion_min_x_;
+  coords.max_x_ = event->motion_max_x_;
+  coords.min_y_ = event->motion_min_y_;
+  coords.max_y_ = event->motion_max_y_;
+  coords.is_screen_ = event->motion_is_on_screen_;
+
+  switch (event->type_) {
+    case COOKED_EVENT_TYPE_POINTER_DOWN:
+      mgr->OnPointerDown(event->motion_pointer_id_, &coords);
+      return true;
+    case COOKED_EVENT_TYPE_POINTER_UP:
+      mgr->OnPointerUp(event->motion_pointer_id_, &coords);
+      return true;
+    case COOKED_EVENT_TYPE_POINTER_MOVE:
+      mgr->OnPointerMove(event->motion_pointer_id_, &coords);
+      return true;
+    default:
+      return false;
+  }
+}
+
 void SceneManager::DoFrame() {
-  if (mSceneToInstall) {
+  // The current scene keeps running while the new one loads.
+  if (mInstallPreloadedScene &&
+      mPreloadedScene.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready) {
+    RequestNewScene(mPreloadedScene.get());
+    mInstallPreloadedScene = false;
+  }
+  if (mSceneToInstall && mSceneToInstall->AreAssetsLoaded()) {
     InstallScene(mSceneToInstall);
     mSceneToInstall = NULL;
   }
 
+  // The only point where the scene sees input, so it never changes in the
+  // middle of a frame.
+  InputQueue::GetInstance()->Drain(_dispatch_cooked_event);
+
   if (mHasGraphics && mCurScene) {
     mCurScene->DoFrame();
   }
@@ -127,6 +219,17 @@ void SceneManager::SetPreferredSwapInterval(int32_t preferred_interval) {
     if (SwappyGL_isEnabled()) {
       SwappyGL_setSwapIntervalNS(preferred_interval);
     }
+    // Keep the performance hint target in sync with the frame cadence.
+    ADPFManager::GetInstance()->SetTargetWorkDuration(preferred_interval);
+
+    // Let the display pick a refresh rate the new period divides, e.g. 90 Hz
+    // for 45 fps.
+    android_app *app = NativeEngine::GetInstance()->GetAndroidApp();
+    if (app != NULL && app->window != NULL && preferred_interval > 0) {
+      ANativeWindow_setFrameRate(
+          app->window, 1e9f / preferred_interval,
+          ANATIVEWINDOW_FRAME_RATE_COMPATIBILITY_DEFAULT);
+    }
   }
   mPreferredSwapInterval = preferred_interval;
 }
@@ -165,3 +268,9 @@ void SceneManager::OnResume() {
     mCurScene->OnResume();
   }
 }
+
+void SceneManager::TrimMemory(MemoryPressureLevel level) {
+  if (mHasGraphics && mCurScene) {
+    mCurScene->OnTrimMemory(level);
+  }
+}
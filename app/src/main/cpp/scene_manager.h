@@ -18,6 +18,10 @@
 #define SCENE_MANAGER_H_
 
 #include <cstdint>
+#include <functional>
+#include <future>
+
+#include "memory_tracker.h"
 
 class Scene;
 
@@ -44,6 +48,11 @@ class SceneManager {
   bool mHasGraphics;
   Scene *mSceneToInstall;
 
+  // Scene being built on a worker thread, and whether to install it when
+  // it's done.
+  std::future<Scene *> mPreloadedScene;
+  bool mInstallPreloadedScene;
+
   void InstallScene(Scene *newScene);
 
  public:
@@ -57,6 +66,9 @@ class SceneManager {
 
   void StartGraphics();
 
+  // Let the current scene free memory. The GL context must be current.
+  void TrimMemory(MemoryPressureLevel level);
+
   // Returns screen width in pixels, this is the actual screen width in pixels
   int GetScreenWidth() { return mScreenWidth; }
 
@@ -100,9 +112,20 @@ class SceneManager {
   void OnResume();
 
   // Requests that a new scene be installed, replacing the currently active
-  // scene. The new scene will be installed on the next DoFrame() call.
+  // scene. The new scene will be installed on the first DoFrame() call after
+  // its assets are loaded.
   void RequestNewScene(Scene *newScene);
 
+  // Construct a scene on a worker thread, typically the next scene while the
+  // current one is shown, so that installing it only has to create its GL
+  // objects. `factory` must not use the GL context. A scene preloaded
+  // earlier and not installed is deleted.
+  void PreloadScene(std::function<Scene *()> factory);
+
+  // Requests that the preloaded scene be installed, on the first DoFrame()
+  // call after it is constructed and its assets are loaded.
+  void RequestPreloadedScene();
+
   // Returns the (singleton) instance of SceneManager.
   static SceneManager *GetInstance();
 };
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "shape_cache.h"
+
+ShapeCache* ShapeCache::GetInstance() {
+  static ShapeCache instance;
+  return &instance;
+}
+
+ShapeCache::~ShapeCache() {
+  for (auto& entry : entries_) {
+    delete entry.shape_;
+  }
+}
+
+btBoxShape* ShapeCache::GetBox(const btVector3& half_extents) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  btCollisionShape* shape = Find(SHAPE_TYPE_BOX, half_extents);
+  if (shape == nullptr) {
+    shape = new btBoxShape(half_extents);
+    entries_.push_back({SHAPE_TYPE_BOX,
+                        {half_extents.x(), half_extents.y(), half_extents.z()},
+                        shape});
+  }
+  return static_cast<btBoxShape*>(shape);
+}
+
+int32_t ShapeCache::GetCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<int32_t>(entries_.size());
+}
+
+btCollisionShape* ShapeCache::Find(ShapeType type,
+                                   const btVector3& extents) const {
+  for (const auto& entry : entries_) {
+    if (entry.type_ == type && entry.extents_[0] == extents.x() &&
+        entry.extents_[1] == extents.y() && entry.extents_[2] == extents.z()) {
+      return entry.shape_;
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SHAPE_CACHE_H_
+#define SHAPE_CACHE_H_
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wextra-semi"
+#include "btBulletDynamicsCommon.h"
+#pragma GCC diagnostic pop
+
+// Collision shape types the cache can hold.
+enum ShapeType {
+  SHAPE_TYPE_BOX = 0,
+};
+
+/*
+ * Collision shapes shared by all bodies, scenes and world rebuilds.
+ *
+ * Shapes are keyed by type and extents, created on first use and kept until
+ * the cache goes away, so rebuilding the world or changing the box count
+ * never allocates a shape again. Bullet shapes carry no per-body state, so
+ * any number of bodies in any number of worlds can use the same one.
+ *
+ * Thread safe.
+ */
+class ShapeCache {
+ public:
+  static ShapeCache* GetInstance();
+
+  // Box of `half_extents`. Owned by the cache.
+  btBoxShape* GetBox(const btVector3& half_extents);
+
+  int32_t GetCount();
+
+ private:
+  struct Entry {
+    ShapeType type_;
+    btScalar extents_[3];
+    btCollisionShape* shape_;
+  };
+
+  ShapeCache() = default;
+  ~ShapeCache();
+  ShapeCache(const ShapeCache&) = delete;
+  ShapeCache& operator=(const ShapeCache&) = delete;
+
+  btCollisionShape* Find(ShapeType type, const btVector3& extents) const;
+
+  std::mutex mutex_;
+  // A handful of shapes, a linear search is the fastest lookup.
+  std::vector<Entry> entries_;
+};
+
+#endif  // SHAPE_CACHE_H_
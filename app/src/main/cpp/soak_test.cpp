@@ -0,0 +1,171 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "soak_test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+
+#include "common.h"
+#include "frame_telemetry.h"
+
+namespace {
+// Value at `percentile` (0..1) of the first `count` values; reorders them.
+float Percentile(float* values, int32_t count, float percentile) {
+  int32_t index = static_cast<int32_t>(percentile * (count - 1) + 0.5f);
+  std::nth_element(values, values + index, values + count);
+  return values[index];
+}
+}  // namespace
+
+SoakTest* SoakTest::GetInstance() {
+  static SoakTest instance;
+  return &instance;
+}
+
+SoakTest::SoakTest()
+    : duration_(0.f),
+      profile_length_(0.f),
+      file_(nullptr),
+      finished_(false),
+      start_time_(0.f),
+      last_record_time_(0.f),
+      last_frame_ns_(0),
+      num_frames_(0) {}
+
+SoakTest::~SoakTest() { Finish(); }
+
+bool SoakTest::Configure(float duration, const char* profile) {
+  std::vector<SoakSegment> segments;
+  float length = 0.f;
+  const char* cursor = profile != nullptr ? profile : "";
+  while (*cursor != '\0') {
+    SoakSegment segment;
+    int consumed = 0;
+    if (sscanf(cursor, "%f:%d:%d%n", &segment.duration_, &segment.array_size_,
+               &segment.physics_step_, &consumed) != 3 ||
+        segment.duration_ <= 0.f || segment.array_size_ <= 0 ||
+        segment.physics_step_ <= 0) {
+      ALOGW("SoakTest: invalid profile segment \"%s\"", cursor);
+      duration_ = 0.f;
+      segments_.clear();
+      profile_length_ = 0.f;
+      return false;
+    }
+    segments.push_back(segment);
+    length += segment.duration_;
+    cursor += consumed;
+    if (*cursor == ',') {
+      ++cursor;
+    }
+  }
+
+  duration_ = duration;
+  segments_ = segments;
+  profile_length_ = length;
+  ALOGI("SoakTest: %.0f sec, %s", duration_,
+        segments_.empty() ? "load driven by the governor" : profile);
+  return true;
+}
+
+bool SoakTest::Start(const std::string& directory, float now) {
+  char name[64];
+  time_t wall_time = time(nullptr);
+  strftime(name, sizeof(name), "/soak_%Y%m%d_%H%M%S.csv",
+           localtime(&wall_time));
+  path_ = directory + name;
+  file_ = fopen(path_.c_str(), "w");
+  if (file_ == nullptr) {
+    ALOGW("SoakTest: cannot create %s", path_.c_str());
+    finished_ = true;
+    return false;
+  }
+  fprintf(file_,
+          "time_s,thermal_status,thermal_headroom,frames,frame_p50_ms,"
+          "frame_p90_ms,frame_p99_ms,frame_max_ms,physics_step,array_size,"
+          "frame_period_ms,resolution_scale\n");
+  fflush(file_);
+  start_time_ = last_record_time_ = now;
+  last_frame_ns_ = FrameTelemetry::GetNanos();
+  num_frames_ = 0;
+  ALOGI("SoakTest: recording to %s", path_.c_str());
+  return true;
+}
+
+const SoakSegment& SoakTest::GetSegment(float now) const {
+  float time = fmodf(now - start_time_, profile_length_);
+  for (const auto& segment : segments_) {
+    if (time < segment.duration_) {
+      return segment;
+    }
+    time -= segment.duration_;
+  }
+  return segments_.back();
+}
+
+bool SoakTest::Update(const SoakSample& sample, float now) {
+  if (file_ == nullptr) {
+    return false;
+  }
+  // Clock() only has a millisecond resolution, too coarse for percentiles.
+  const int64_t now_ns = FrameTelemetry::GetNanos();
+  if (num_frames_ < kMaxFramesPerRecord) {
+    frame_times_[num_frames_++] = (now_ns - last_frame_ns_) / 1e6f;
+  }
+  last_frame_ns_ = now_ns;
+
+  if (now - last_record_time_ >= kRecordInterval) {
+    WriteRecord(sample, now);
+    last_record_time_ = now;
+    num_frames_ = 0;
+  }
+  if (now - start_time_ >= duration_) {
+    Finish();
+    return false;
+  }
+  return true;
+}
+
+void SoakTest::WriteRecord(const SoakSample& sample, float now) {
+  float p50 = 0.f;
+  float p90 = 0.f;
+  float p99 = 0.f;
+  float max = 0.f;
+  if (num_frames_ > 0) {
+    max = *std::max_element(frame_times_, frame_times_ + num_frames_);
+    p50 = Percentile(frame_times_, num_frames_, 0.5f);
+    p90 = Percentile(frame_times_, num_frames_, 0.9f);
+    p99 = Percentile(frame_times_, num_frames_, 0.99f);
+  }
+  fprintf(file_, "%.1f,%d,%.3f,%d,%.2f,%.2f,%.2f,%.2f,%d,%d,%.2f,%.2f\n",
+          now - start_time_, sample.thermal_status_, sample.thermal_headroom_,
+          num_frames_, p50, p90, p99, max,
+          sample.physics_step_, sample.array_size_,
+          sample.frame_period_ns_ / 1e6f, sample.resolution_scale_);
+  fflush(file_);
+}
+
+void SoakTest::Finish() {
+  if (file_ == nullptr) {
+    return;
+  }
+  fclose(file_);
+  file_ = nullptr;
+  finished_ = true;
+  ALOGI("SoakTest: done, recording in %s", path_.c_str());
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SOAK_TEST_H_
+#define SOAK_TEST_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// One step of a scripted load profile.
+struct SoakSegment {
+  float duration_;  // in seconds
+  int32_t array_size_;
+  int32_t physics_step_;
+};
+
+// State of the demo recorded with each row.
+struct SoakSample {
+  int32_t thermal_status_;
+  float thermal_headroom_;
+  int32_t physics_step_;
+  int32_t array_size_;
+  int64_t frame_period_ns_;
+  float resolution_scale_;
+};
+
+/*
+ * Unattended soak test of the demo scene, requested by the activity from the
+ * intent extras (see ADPFSampleActivity).
+ *
+ * The run lasts a configured duration. The load either follows a scripted
+ * profile, a list of segments played in a loop, or is left to the governor.
+ * Every kRecordInterval a CSV row is appended to the recording: thermal
+ * status and headroom, frame time percentiles over the interval, the physics
+ * step and box count, the frame period and the resolution scale. Each row is
+ * flushed, so a run cut short by the system still leaves its data.
+ *
+ * Game thread only, except Configure().
+ */
+class SoakTest {
+ public:
+  static constexpr float kRecordInterval = 1.f;
+  // Frames kept per row, enough for 1 sec at 240 Hz.
+  static constexpr int32_t kMaxFramesPerRecord = 256;
+
+  static SoakTest* GetInstance();
+
+  // Request a run of `duration` seconds. `profile` lists the segments as
+  // "<seconds>:<array size>:<physics steps>", separated by commas; when
+  // empty the governor drives the load. Returns false, and requests no run,
+  // when the profile does not parse. Call before the native activity starts.
+  bool Configure(float duration, const char* profile);
+
+  bool IsRequested() const { return duration_ > 0.f; }
+  bool IsRunning() const { return file_ != nullptr; }
+  bool IsFinished() const { return finished_; }
+  bool IsScripted() const { return !segments_.empty(); }
+
+  // Create the recording in `directory` and start the clock. `now` is in
+  // seconds (see Clock()).
+  bool Start(const std::string& directory, float now);
+
+  // Segment of the profile the run is in. Only valid when IsScripted().
+  const SoakSegment& GetSegment(float now) const;
+
+  // Account for a frame, and write a row when a record interval elapsed.
+  // Returns false once the run is over and the recording closed.
+  bool Update(const SoakSample& sample, float now);
+
+  const std::string& GetPath() const { return path_; }
+
+ private:
+  SoakTest();
+  ~SoakTest();
+  SoakTest(const SoakTest&) = delete;
+  SoakTest& operator=(const SoakTest&) = delete;
+
+  void WriteRecord(const SoakSample& sample, float now);
+  void Finish();
+
+  float duration_;
+  std::vector<SoakSegment> segments_;
+  float profile_length_;
+
+  FILE* file_;
+  std::string path_;
+  bool finished_;
+  float start_time_;
+  float last_record_time_;
+  // From FrameTelemetry::GetNanos().
+  int64_t last_frame_ns_;
+  // Frame times of the row, in milliseconds.
+  float frame_times_[kMaxFramesPerRecord];
+  int32_t num_frames_;
+};
+
+#endif  // SOAK_TEST_H_
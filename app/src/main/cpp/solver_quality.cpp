@@ -0,0 +1,51 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "solver_quality.h"
+
+namespace {
+const SolverSettings kTierSettings[SOLVER_TIER_COUNT] = {
+    // iterations, simd, warm starting, split impulse, max sub-steps
+    {10, true, true, true, 10},
+    {6, true, true, true, 4},
+    {4, true, true, false, 2},
+    {2, true, false, false, 1},
+};
+}  // namespace
+
+const char* const kSolverTierNames[SOLVER_TIER_COUNT] = {"High", "Medium",
+                                                         "Low", "Minimum"};
+
+SolverSettings GetSolverSettings(SolverTier tier) {
+  if (tier < SOLVER_TIER_HIGH || tier >= SOLVER_TIER_COUNT) {
+    tier = SOLVER_TIER_HIGH;
+  }
+  return kTierSettings[tier];
+}
+
+void ApplySolverSettings(const SolverSettings& settings,
+                         btDiscreteDynamicsWorld* world) {
+  btContactSolverInfo& info = world->getSolverInfo();
+  info.m_numIterations = settings.num_iterations_;
+  info.m_solverMode &= ~(SOLVER_SIMD | SOLVER_USE_WARMSTARTING);
+  if (settings.simd_) {
+    info.m_solverMode |= SOLVER_SIMD;
+  }
+  if (settings.warm_starting_) {
+    info.m_solverMode |= SOLVER_USE_WARMSTARTING;
+  }
+  info.m_splitImpulse = settings.split_impulse_;
+}
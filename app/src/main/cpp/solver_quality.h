@@ -0,0 +1,67 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SOLVER_QUALITY_H_
+#define SOLVER_QUALITY_H_
+
+#include <cstdint>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wextra-semi"
+#include "btBulletDynamicsCommon.h"
+#pragma GCC diagnostic pop
+
+// Quality tiers of the constraint solver, most accurate first.
+enum SolverTier {
+  // Bullet's defaults.
+  SOLVER_TIER_HIGH = 0,
+  // Fewer iterations: stacks settle a little slower.
+  SOLVER_TIER_MEDIUM,
+  // No split impulse: penetration is resolved by the velocity solve, which
+  // adds some energy, boxes in a stack jitter more.
+  SOLVER_TIER_LOW,
+  // Few iterations without warm starting: stacks sag and slide.
+  SOLVER_TIER_MINIMUM,
+  SOLVER_TIER_COUNT
+};
+
+// What a tier sets on the world.
+struct SolverSettings {
+  // btContactSolverInfo::m_numIterations.
+  int32_t num_iterations_;
+  // SOLVER_SIMD and SOLVER_USE_WARMSTARTING of m_solverMode.
+  bool simd_;
+  bool warm_starting_;
+  // btContactSolverInfo::m_splitImpulse.
+  bool split_impulse_;
+  // maxSubSteps of stepSimulation() when the timestep is variable: how many
+  // internal steps a long frame may catch up with.
+  int32_t max_sub_steps_;
+};
+
+// Settings of `tier`. Cutting iterations saves more CPU than halving the
+// sub-steps, and shows less, so it comes first. SIMD only changes how the
+// rows are solved, not the result: it stays on in every tier, the benchmark
+// can still turn it off to measure it.
+SolverSettings GetSolverSettings(SolverTier tier);
+
+void ApplySolverSettings(const SolverSettings& settings,
+                         btDiscreteDynamicsWorld* world);
+
+// Display names, indexed by SolverTier.
+extern const char* const kSolverTierNames[SOLVER_TIER_COUNT];
+
+#endif  // SOLVER_QUALITY_H_
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "surface_format.h"
+
+namespace {
+// Upper bound of the configs looked at for one format.
+const EGLint kMaxConfigs = 64;
+
+const SurfaceFormatSettings kFormatSettings[SURFACE_FORMAT_COUNT] = {
+    // red, green, blue, alpha, depth, samples, offscreen color and depth,
+    // offscreen bytes per pixel
+    {8, 8, 8, 8, 24, 4, GL_RGBA8, GL_DEPTH_COMPONENT24, 8},
+    {8, 8, 8, 8, 24, 0, GL_RGBA8, GL_DEPTH_COMPONENT24, 8},
+    {5, 6, 5, 0, 16, 0, GL_RGB565, GL_DEPTH_COMPONENT16, 4},
+};
+
+EGLint GetConfigAttrib(EGLDisplay display, EGLConfig config,
+                       EGLint attribute) {
+  EGLint value = 0;
+  eglGetConfigAttrib(display, config, attribute, &value);
+  return value;
+}
+}  // namespace
+
+const char* const kSurfaceFormatNames[SURFACE_FORMAT_COUNT] = {
+    "RGBA8 D24 MSAA 4x", "RGBA8 D24", "RGB565 D16"};
+
+SurfaceFormatSettings GetSurfaceFormatSettings(SurfaceFormat format) {
+  if (format < SURFACE_FORMAT_RGBA8_D24_MSAA ||
+      format >= SURFACE_FORMAT_COUNT) {
+    format = kDefaultSurfaceFormat;
+  }
+  return kFormatSettings[format];
+}
+
+bool ChooseSurfaceConfig(EGLDisplay display, SurfaceFormat format,
+                         EGLint renderable_type, EGLConfig* config) {
+  const SurfaceFormatSettings settings = GetSurfaceFormatSettings(format);
+  const EGLint attribs[] = {EGL_RENDERABLE_TYPE,
+                            renderable_type,
+                            EGL_SURFACE_TYPE,
+                            EGL_WINDOW_BIT,
+                            EGL_RED_SIZE,
+                            settings.red_size_,
+                            EGL_GREEN_SIZE,
+                            settings.green_size_,
+                            EGL_BLUE_SIZE,
+                            settings.blue_size_,
+                            EGL_ALPHA_SIZE,
+                            settings.alpha_size_,
+                            EGL_DEPTH_SIZE,
+                            settings.depth_size_,
+                            EGL_SAMPLE_BUFFERS,
+                            settings.samples_ > 0 ? 1 : 0,
+                            EGL_SAMPLES,
+                            settings.samples_,
+                            EGL_NONE};
+  EGLConfig configs[kMaxConfigs];
+  EGLint num_configs = 0;
+  if (!eglChooseConfig(display, attribs, configs, kMaxConfigs,
+                       &num_configs)) {
+    return false;
+  }
+
+  for (auto i = 0; i < num_configs; ++i) {
+    if (GetConfigAttrib(display, configs[i], EGL_RED_SIZE) ==
+            settings.red_size_ &&
+        GetConfigAttrib(display, configs[i], EGL_GREEN_SIZE) ==
+            settings.green_size_ &&
+        GetConfigAttrib(display, configs[i], EGL_BLUE_SIZE) ==
+            settings.blue_size_ &&
+        GetConfigAttrib(display, configs[i], EGL_ALPHA_SIZE) ==
+            settings.alpha_size_ &&
+        GetConfigAttrib(display, configs[i], EGL_SAMPLES) ==
+            settings.samples_) {
+      *config = configs[i];
+      return true;
+    }
+  }
+  return false;
+}
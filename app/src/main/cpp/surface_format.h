@@ -0,0 +1,69 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SURFACE_FORMAT_H_
+#define SURFACE_FORMAT_H_
+
+#include <cstdint>
+
+#include "common.h"
+
+// Framebuffer formats of the window surface, most expensive first.
+// Framebuffer bandwidth is a large part of the GPU power.
+enum SurfaceFormat {
+  // 4x MSAA. The samples are resolved on chip by tilers, but the blit of
+  // DynamicResolution can't target a multisampled surface, so the scale
+  // stays at 1.
+  SURFACE_FORMAT_RGBA8_D24_MSAA = 0,
+  SURFACE_FORMAT_RGBA8_D24,
+  // Half the bytes per pixel, with some banding on the gradients.
+  SURFACE_FORMAT_RGB565_D16,
+  SURFACE_FORMAT_COUNT
+};
+
+// The format the app starts with, MSAA is opt in.
+const SurfaceFormat kDefaultSurfaceFormat = SURFACE_FORMAT_RGBA8_D24;
+
+// What a format asks of the EGL config, and the matching formats of the
+// offscreen target of DynamicResolution.
+struct SurfaceFormatSettings {
+  EGLint red_size_;
+  EGLint green_size_;
+  EGLint blue_size_;
+  EGLint alpha_size_;
+  // Minimum, drivers may pad it.
+  EGLint depth_size_;
+  // 0 without MSAA.
+  EGLint samples_;
+  GLenum color_format_;
+  GLenum depth_format_;
+  // Of the offscreen target, drivers pad 24 bit depth to 32 bits.
+  int32_t bytes_per_pixel_;
+};
+
+SurfaceFormatSettings GetSurfaceFormatSettings(SurfaceFormat format);
+
+// Find a window config of `format` with `renderable_type`
+// (EGL_OPENGL_ES3_BIT or EGL_OPENGL_ES2_BIT). eglChooseConfig() sorts the
+// deepest colors first, so the configs are matched exactly here. Returns false
+// when the display has none.
+bool ChooseSurfaceConfig(EGLDisplay display, SurfaceFormat format,
+                         EGLint renderable_type, EGLConfig* config);
+
+// Display names, indexed by SurfaceFormat.
+extern const char* const kSurfaceFormatNames[SURFACE_FORMAT_COUNT];
+
+#endif  // SURFACE_FORMAT_H_
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "swap_interval_controller.h"
+
+#include <android/thermal.h>
+
+#include <cstdlib>
+
+#include "common.h"
+#include "swappy/swappyGL.h"
+
+namespace {
+// Frame rates we would like to run at, fastest first.
+const int32_t kCandidateRates[SwapIntervalController::kMaxLevels] = {
+    120, 90, 60, 45, 30};
+
+// Swap intervals tried against each refresh period.
+const int32_t kMaxSwapInterval = 4;
+
+// A refresh period multiple matches a candidate within this tolerance.
+const float kPeriodTolerance = 0.02f;
+
+const int32_t kMaxRefreshPeriods = 16;
+
+const int64_t kNanosPerSecond = 1000000000LL;
+
+const int32_t kDefaultMaxRate = 60;
+}  // namespace
+
+SwapIntervalController::SwapIntervalController()
+    : num_levels_(0),
+      current_level_(0),
+      min_rate_(0),
+      max_rate_(kDefaultMaxRate),
+      smoothed_frame_time_(0.f),
+      pending_level_(0),
+      pending_since_(0.f),
+      last_change_(0.f) {}
+
+//--------------------------------------------------------------------------------
+// Keep the candidates that are a whole number of refresh periods on one of the
+// display modes.
+//--------------------------------------------------------------------------------
+void SwapIntervalController::Initialize(int64_t preferred_period) {
+  uint64_t refresh_periods[kMaxRefreshPeriods];
+  int32_t num_periods = 0;
+  if (SwappyGL_isEnabled()) {
+    num_periods = SwappyGL_getSupportedRefreshPeriodsNS(refresh_periods,
+                                                        kMaxRefreshPeriods);
+    if (num_periods > kMaxRefreshPeriods) {
+      num_periods = kMaxRefreshPeriods;
+    }
+    if (num_periods <= 0) {
+      refresh_periods[0] = SwappyGL_getRefreshPeriodNanos();
+      num_periods = refresh_periods[0] > 0 ? 1 : 0;
+    }
+  }
+  if (num_periods == 0) {
+    // Without Swappy, assume a 60 Hz panel.
+    refresh_periods[0] = kNanosPerSecond / 60;
+    num_periods = 1;
+  }
+
+  int64_t previous_period =
+      preferred_period > 0 ? preferred_period : GetFramePeriod();
+  num_levels_ = 0;
+  for (auto rate : kCandidateRates) {
+    const int64_t period = kNanosPerSecond / rate;
+    for (auto i = 0; i < num_periods; ++i) {
+      int64_t interval = (period + refresh_periods[i] / 2) / refresh_periods[i];
+      if (interval < 1 || interval > kMaxSwapInterval) {
+        continue;
+      }
+      int64_t candidate = interval * refresh_periods[i];
+      if (std::abs(candidate - period) <= period * kPeriodTolerance) {
+        level_periods_[num_levels_] = candidate;
+        level_rates_[num_levels_] = rate;
+        ++num_levels_;
+        break;
+      }
+    }
+  }
+
+  // Stay as close as possible to the period we ran at before.
+  current_level_ = 0;
+  for (auto i = 0; i < num_levels_; ++i) {
+    if (level_periods_[i] >= previous_period * (1.f - kPeriodTolerance)) {
+      current_level_ = i;
+      break;
+    }
+  }
+  pending_level_ = current_level_;
+  for (auto i = 0; i < num_levels_; ++i) {
+    ALOGI("SwapIntervalController: %d Hz (%.2f ms)", level_rates_[i],
+          level_periods_[i] / 1e6f);
+  }
+}
+
+void SwapIntervalController::SetFrameRateRange(int32_t min_rate,
+                                               int32_t max_rate) {
+  min_rate_ = min_rate;
+  max_rate_ = max_rate;
+}
+
+bool SwapIntervalController::IsSelectable(int32_t level) const {
+  return level >= 0 && level < num_levels_ &&
+         level_rates_[level] >= min_rate_ && level_rates_[level] <= max_rate_;
+}
+
+int64_t SwapIntervalController::GetFramePeriod() const {
+  return num_levels_ > 0 ? level_periods_[current_level_]
+                         : kNanosPerSecond / kDefaultMaxRate;
+}
+
+int32_t SwapIntervalController::GetFrameRate() const {
+  return num_levels_ > 0 ? level_rates_[current_level_] : kDefaultMaxRate;
+}
+
+//--------------------------------------------------------------------------------
+// One level slower when we run hot or out of budget, one level faster when
+// the device is cool and the frame fits in the faster period.
+//--------------------------------------------------------------------------------
+int32_t SwapIntervalController::Evaluate(const GovernorInput& input) const {
+  const float period = level_periods_[current_level_] / 1e9f;
+
+  // Out of the allowed range (e.g. the range just changed): move back in.
+  if (!IsSelectable(current_level_)) {
+    if (level_rates_[current_level_] > max_rate_ &&
+        IsSelectable(current_level_ + 1)) {
+      return current_level_ + 1;
+    }
+    if (level_rates_[current_level_] < min_rate_ &&
+        IsSelectable(current_level_ - 1)) {
+      return current_level_ - 1;
+    }
+  }
+
+  if (input.thermal_status_ >= ATHERMAL_STATUS_MODERATE ||
+      input.thermal_headroom_ > kDecreaseHeadroom ||
+      input.frame_time_ > period * kDecreaseBudget) {
+    return IsSelectable(current_level_ + 1) ? current_level_ + 1
+                                            : current_level_;
+  }
+
+  if (IsSelectable(current_level_ - 1) &&
+      input.thermal_headroom_ < kIncreaseHeadroom &&
+      input.frame_time_ <
+          level_periods_[current_level_ - 1] / 1e9f * kIncreaseBudget) {
+    return current_level_ - 1;
+  }
+  return current_level_;
+}
+
+int64_t SwapIntervalController::Update(const GovernorInput& input, float now) {
+  if (num_levels_ == 0) {
+    return 0;
+  }
+
+  if (smoothed_frame_time_ <= 0.f) {
+    smoothed_frame_time_ = input.frame_time_;
+  } else {
+    smoothed_frame_time_ +=
+        (input.frame_time_ - smoothed_frame_time_) * kFrameTimeSmoothing;
+  }
+  GovernorInput smoothed = input;
+  smoothed.frame_time_ = smoothed_frame_time_;
+
+  int32_t level = Evaluate(smoothed);
+  if (level != pending_level_) {
+    pending_level_ = level;
+    pending_since_ = now;
+    return 0;
+  }
+  if (level == current_level_) {
+    return 0;
+  }
+
+  const bool slower = level > current_level_;
+  const float hold_time = slower ? kDecreaseHoldTime : kIncreaseHoldTime;
+  if (now - pending_since_ < hold_time ||
+      now - last_change_ < kChangeInterval) {
+    return 0;
+  }
+
+  ALOGI("SwapIntervalController: %d Hz -> %d Hz (headroom %.3f, frame %.2f ms)",
+        level_rates_[current_level_], level_rates_[level],
+        input.thermal_headroom_, smoothed_frame_time_ * 1000.f);
+  current_level_ = level;
+  pending_since_ = now;
+  last_change_ = now;
+  return level_periods_[level];
+}
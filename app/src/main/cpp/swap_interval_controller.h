@@ -0,0 +1,98 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SWAP_INTERVAL_CONTROLLER_H_
+#define SWAP_INTERVAL_CONTROLLER_H_
+
+#include <cstdint>
+
+#include "thermal_governor.h"
+
+/*
+ * Picks the frame period among the rates the display can present
+ * (120/90/60/45/30 Hz, each a multiple of a supported refresh period), based
+ * on the thermal headroom and on how much of the frame budget is used.
+ *
+ * Lowering the frame rate is the first response to thermal pressure, since
+ * it saves more power than reducing content: the controller slows down
+ * quickly and speeds up only after the device has been cool for a while.
+ */
+class SwapIntervalController {
+ public:
+  static constexpr int32_t kMaxLevels = 5;
+
+  // Change the rate when headroom is above / below these.
+  static constexpr float kDecreaseHeadroom = 0.8f;
+  static constexpr float kIncreaseHeadroom = 0.6f;
+
+  // Slow down when the frame takes more than this share of its period, speed
+  // up only if the frame would use less than this share of the faster period.
+  static constexpr float kDecreaseBudget = 0.9f;
+  static constexpr float kIncreaseBudget = 0.6f;
+
+  // How long a condition must persist, and the minimum time between changes,
+  // in seconds.
+  static constexpr float kDecreaseHoldTime = 2.f;
+  static constexpr float kIncreaseHoldTime = 10.f;
+  static constexpr float kChangeInterval = 3.f;
+
+  // Smoothing factor of the frame time exponential moving average.
+  static constexpr float kFrameTimeSmoothing = 0.1f;
+
+  SwapIntervalController();
+
+  // Build the list of frame rates from the display's refresh periods. Call
+  // once the window is set on Swappy. Starts at the rate closest to
+  // `preferred_period` in ns, or to the current one when it is 0.
+  void Initialize(int64_t preferred_period = 0);
+
+  // Restrict the selectable frame rates, in Hz.
+  void SetFrameRateRange(int32_t min_rate, int32_t max_rate);
+
+  // Feed a frame. `input.frame_time_` should be the CPU time of the frame.
+  // Returns the new frame period in ns, or 0 to keep the current one.
+  int64_t Update(const GovernorInput& input, float now);
+
+  int64_t GetFramePeriod() const;
+  int32_t GetFrameRate() const;
+  float GetSmoothedFrameTime() const { return smoothed_frame_time_; }
+
+  int32_t GetNumLevels() const { return num_levels_; }
+  int32_t GetLevelFrameRate(int32_t level) const {
+    return level_rates_[level];
+  }
+
+ private:
+  // Returns the level to move to, or the current level.
+  int32_t Evaluate(const GovernorInput& input) const;
+  bool IsSelectable(int32_t level) const;
+
+  // Selectable levels, fastest first.
+  int64_t level_periods_[kMaxLevels];
+  int32_t level_rates_[kMaxLevels];
+  int32_t num_levels_;
+  int32_t current_level_;
+
+  int32_t min_rate_;
+  int32_t max_rate_;
+
+  float smoothed_frame_time_;
+  int32_t pending_level_;
+  float pending_since_;
+  float last_change_;
+};
+
+#endif  // SWAP_INTERVAL_CONTROLLER_H_
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "swappy_stats_collector.h"
+
+#include "common.h"
+#include "frame_telemetry.h"
+
+SwappyStatsCollector* SwappyStatsCollector::GetInstance() {
+  static SwappyStatsCollector instance;
+  return &instance;
+}
+
+SwappyStatsCollector::SwappyStatsCollector()
+    : enabled_(false), has_stats_(false), last_collect_ns_(0), stats_() {}
+
+void SwappyStatsCollector::Initialize() {
+  if (!SwappyGL_isEnabled()) {
+    ALOGW("SwappyStatsCollector: Swappy is not enabled, no frame stats.");
+    return;
+  }
+  SwappyGL_enableStats(true);
+  SwappyGL_clearStats();
+  last_collect_ns_ = FrameTelemetry::GetNanos();
+  enabled_ = true;
+}
+
+void SwappyStatsCollector::RecordFrameStart(EGLDisplay display,
+                                            EGLSurface surface) {
+  if (enabled_) {
+    SwappyGL_recordFrameStart(display, surface);
+  }
+}
+
+//--------------------------------------------------------------------------------
+// Read and clear Swappy's histograms once per interval.
+//--------------------------------------------------------------------------------
+bool SwappyStatsCollector::Update() {
+  if (!enabled_) {
+    return false;
+  }
+  int64_t now = FrameTelemetry::GetNanos();
+  if (now - last_collect_ns_ < kCollectIntervalMs * 1000000LL) {
+    return false;
+  }
+  last_collect_ns_ = now;
+
+  SwappyStats swappy_stats;
+  SwappyGL_getStats(&swappy_stats);
+  SwappyGL_clearStats();
+  if (swappy_stats.totalFrames == 0) {
+    return false;
+  }
+
+  uint64_t late_frames = 0;
+  uint64_t latency_sum = 0;
+  stats_.total_frames_ = swappy_stats.totalFrames;
+  for (auto i = 0; i < MAX_FRAME_BUCKETS; ++i) {
+    stats_.idle_frames_[i] = swappy_stats.idleFrames[i];
+    stats_.late_frames_[i] = swappy_stats.lateFrames[i];
+    stats_.offset_from_previous_frame_[i] =
+        swappy_stats.offsetFromPreviousFrame[i];
+    stats_.latency_frames_[i] = swappy_stats.latencyFrames[i];
+    if (i > 0) {
+      late_frames += swappy_stats.lateFrames[i];
+    }
+    latency_sum += swappy_stats.latencyFrames[i] * i;
+  }
+  stats_.missed_frame_ratio_ =
+      static_cast<float>(late_frames) / swappy_stats.totalFrames;
+  stats_.average_latency_ =
+      static_cast<float>(latency_sum) / swappy_stats.totalFrames;
+  has_stats_ = true;
+  return true;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SWAPPY_STATS_COLLECTOR_H_
+#define SWAPPY_STATS_COLLECTOR_H_
+
+#include <EGL/egl.h>
+
+#include <cstdint>
+
+#include "swappy/swappyGL.h"
+#include "swappy/swappyGL_extra.h"
+
+// Swappy's histograms over one collection interval. Bucket i counts the
+// frames for which the value was i refresh periods (the last bucket is
+// "MAX_FRAME_BUCKETS - 1 or more").
+struct SwappyIntervalStats {
+  uint64_t total_frames_;
+  float idle_frames_[MAX_FRAME_BUCKETS];
+  float late_frames_[MAX_FRAME_BUCKETS];
+  float offset_from_previous_frame_[MAX_FRAME_BUCKETS];
+  float latency_frames_[MAX_FRAME_BUCKETS];
+
+  // Fraction of frames presented at least one refresh period late.
+  float missed_frame_ratio_;
+
+  // Average # of refresh periods between frame start and presentation.
+  float average_latency_;
+};
+
+/*
+ * Collects Swappy's frame statistics. Swappy accumulates the histograms since
+ * the last clear; the collector reads and clears them every
+ * kCollectIntervalMs, so each SwappyIntervalStats covers one interval.
+ *
+ * All calls are made on the game thread, but for RecordFrameStart(), which
+ * the render thread makes before drawing each frame.
+ */
+class SwappyStatsCollector {
+ public:
+  static constexpr int32_t kCollectIntervalMs = 1000;
+
+  static SwappyStatsCollector* GetInstance();
+
+  // Turn on Swappy's statistics. Call once after SwappyGL_init().
+  void Initialize();
+
+  // Mark the start of a frame for the latency histogram. Call before the
+  // frame's rendering starts.
+  void RecordFrameStart(EGLDisplay display, EGLSurface surface);
+
+  // Pull the statistics when the interval elapsed. Returns true when a new
+  // interval is available.
+  bool Update();
+
+  const SwappyIntervalStats& GetStats() const { return stats_; }
+  float GetMissedFrameRatio() const { return stats_.missed_frame_ratio_; }
+
+  // True once a full interval has been collected.
+  bool HasStats() const { return has_stats_; }
+
+ private:
+  SwappyStatsCollector();
+  SwappyStatsCollector(const SwappyStatsCollector&) = delete;
+  SwappyStatsCollector& operator=(const SwappyStatsCollector&) = delete;
+
+  bool enabled_;
+  bool has_stats_;
+  int64_t last_collect_ns_;
+  SwappyIntervalStats stats_;
+};
+
+#endif  // SWAPPY_STATS_COLLECTOR_H_
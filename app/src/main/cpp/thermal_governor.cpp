@@ -0,0 +1,261 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thermal_governor.h"
+
+#include <android/thermal.h>
+
+#include <algorithm>
+
+#include "common.h"
+
+//--------------------------------------------------------------------------------
+// HeadroomPolicy
+//--------------------------------------------------------------------------------
+HeadroomPolicy::Params HeadroomPolicy::DefaultParams() {
+  Params params;
+  params.decrease_headroom_ = 0.85f;
+  params.increase_headroom_ = 0.65f;
+  params.decrease_frame_ratio_ = 1.2f;
+  params.increase_frame_ratio_ = 1.05f;
+  params.decrease_missed_ratio_ = 0.1f;
+  params.increase_missed_ratio_ = 0.02f;
+  params.decrease_status_ = ATHERMAL_STATUS_SEVERE;
+  return params;
+}
+
+HeadroomPolicy::Params HeadroomPolicy::ConservativeParams() {
+  // For devices that throttle early: back off sooner, recover later.
+  Params params;
+  params.decrease_headroom_ = 0.7f;
+  params.increase_headroom_ = 0.5f;
+  params.decrease_frame_ratio_ = 1.1f;
+  params.increase_frame_ratio_ = 1.02f;
+  params.decrease_missed_ratio_ = 0.05f;
+  params.increase_missed_ratio_ = 0.01f;
+  params.decrease_status_ = ATHERMAL_STATUS_MODERATE;
+  return params;
+}
+
+HeadroomPolicy::HeadroomPolicy(const char* name, const Params& params)
+    : name_(name), params_(params) {}
+
+GovernorRequest HeadroomPolicy::Evaluate(const GovernorInput& input) {
+  if (input.thermal_status_ >= params_.decrease_status_) {
+    return GOVERNOR_REQUEST_DECREASE;
+  }
+
+  const float target = input.target_frame_time_;
+  if (input.thermal_headroom_ > params_.decrease_headroom_ ||
+      input.frame_time_ > target * params_.decrease_frame_ratio_ ||
+      input.missed_frame_ratio_ > params_.decrease_missed_ratio_) {
+    return GOVERNOR_REQUEST_DECREASE;
+  }
+
+  if (input.thermal_headroom_ < params_.increase_headroom_ &&
+      input.frame_time_ < target * params_.increase_frame_ratio_ &&
+      input.missed_frame_ratio_ < params_.increase_missed_ratio_) {
+    return GOVERNOR_REQUEST_INCREASE;
+  }
+  return GOVERNOR_REQUEST_HOLD;
+}
+
+//--------------------------------------------------------------------------------
+// PredictivePolicy
+//--------------------------------------------------------------------------------
+PredictivePolicy::Params PredictivePolicy::DefaultParams() {
+  Params params;
+  params.target_headroom_ = 0.75f;
+  params.increase_margin_ = 0.05f;
+  params.horizon_ = 20.f;
+  params.load_step_ = 0.25f;
+  params.limits_ = HeadroomPolicy::DefaultParams();
+  return params;
+}
+
+PredictivePolicy::PredictivePolicy(const char* name, const Params& params,
+                                   const ThermalModel* model)
+    : name_(name),
+      params_(params),
+      model_(model),
+      fallback_(name, params.limits_),
+      predicted_headroom_(0.f) {}
+
+GovernorRequest PredictivePolicy::Evaluate(const GovernorInput& input) {
+  predicted_headroom_ = input.thermal_headroom_;
+  if (!model_->IsTrained()) {
+    return fallback_.Evaluate(input);
+  }
+
+  const HeadroomPolicy::Params& limits = params_.limits_;
+  const float target = input.target_frame_time_;
+  predicted_headroom_ = model_->Predict(input.load_, input.thermal_headroom_,
+                                        params_.horizon_);
+  if (input.thermal_status_ >= limits.decrease_status_ ||
+      input.frame_time_ > target * limits.decrease_frame_ratio_ ||
+      input.missed_frame_ratio_ > limits.decrease_missed_ratio_ ||
+      predicted_headroom_ > params_.target_headroom_) {
+    return GOVERNOR_REQUEST_DECREASE;
+  }
+  if (input.frame_time_ >= target * limits.increase_frame_ratio_ ||
+      input.missed_frame_ratio_ >= limits.increase_missed_ratio_) {
+    return GOVERNOR_REQUEST_HOLD;
+  }
+
+  // The governor picks the knob, so assume the costliest one moves.
+  float next_headroom = predicted_headroom_;
+  ThermalLoad next = input.load_;
+  float* terms[] = {&next.physics_, &next.boxes_, &next.pixels_};
+  for (auto term : terms) {
+    const float value = *term;
+    *term = std::min(value + params_.load_step_, 1.f);
+    next_headroom = std::max(
+        next_headroom,
+        model_->Predict(next, input.thermal_headroom_, params_.horizon_));
+    *term = value;
+  }
+  if (next_headroom < params_.target_headroom_ - params_.increase_margin_) {
+    return GOVERNOR_REQUEST_INCREASE;
+  }
+  return GOVERNOR_REQUEST_HOLD;
+}
+
+//--------------------------------------------------------------------------------
+// ThermalGovernor
+//--------------------------------------------------------------------------------
+ThermalGovernor::ThermalGovernor()
+    : policy_(new HeadroomPolicy("Default", HeadroomPolicy::DefaultParams())),
+      enabled_(true),
+      smoothed_frame_time_(0.f),
+      bottleneck_(GOVERNOR_BOTTLENECK_UNKNOWN),
+      pending_request_(GOVERNOR_REQUEST_HOLD),
+      pending_since_(0.f),
+      last_change_(0.f),
+      last_knob_(-1),
+      last_action_(nullptr) {}
+
+void ThermalGovernor::SetPolicy(std::unique_ptr<GovernorPolicy> policy) {
+  policy_ = std::move(policy);
+  pending_request_ = GOVERNOR_REQUEST_HOLD;
+}
+
+void ThermalGovernor::AddKnob(const GovernorKnob& knob) {
+  knobs_.push_back(knob);
+}
+
+void ThermalGovernor::Reset(float now) {
+  pending_request_ = GOVERNOR_REQUEST_HOLD;
+  pending_since_ = now;
+  last_change_ = now;
+}
+
+const char* ThermalGovernor::Update(const GovernorInput& input, float now) {
+  // Smooth the frame time so a single hitch does not count as a trend.
+  if (smoothed_frame_time_ <= 0.f) {
+    smoothed_frame_time_ = input.frame_time_;
+  } else {
+    smoothed_frame_time_ +=
+        (input.frame_time_ - smoothed_frame_time_) * kFrameTimeSmoothing;
+  }
+
+  bottleneck_ = GetBottleneck(input);
+  if (!enabled_ || !policy_) {
+    return nullptr;
+  }
+
+  GovernorInput smoothed = input;
+  smoothed.frame_time_ = smoothed_frame_time_;
+  GovernorRequest request = policy_->Evaluate(smoothed);
+
+  // Hysteresis: the request must be stable for its hold time.
+  if (request != pending_request_) {
+    pending_request_ = request;
+    pending_since_ = now;
+    return nullptr;
+  }
+  if (request == GOVERNOR_REQUEST_HOLD) {
+    return nullptr;
+  }
+
+  const bool decrease = request == GOVERNOR_REQUEST_DECREASE;
+  const float hold_time = decrease ? kDecreaseHoldTime : kIncreaseHoldTime;
+  const float interval = decrease ? kDecreaseInterval : kIncreaseInterval;
+  if (now - pending_since_ < hold_time || now - last_change_ < interval) {
+    return nullptr;
+  }
+
+  if (!Apply(request, bottleneck_)) {
+    return nullptr;
+  }
+  last_change_ = now;
+  pending_since_ = now;
+  ALOGI("ThermalGovernor: %s %s (headroom %.3f, frame %.2f ms, missed %.1f%%)",
+        decrease ? "decreased" : "increased", last_action_,
+        input.thermal_headroom_, smoothed_frame_time_ * 1000.f,
+        input.missed_frame_ratio_ * 100.f);
+  return last_action_;
+}
+
+GovernorBottleneck ThermalGovernor::GetBottleneck(const GovernorInput& input) {
+  if (input.cpu_time_ <= 0.f || input.gpu_time_ <= 0.f) {
+    return GOVERNOR_BOTTLENECK_UNKNOWN;
+  }
+  return input.gpu_time_ > input.cpu_time_ ? GOVERNOR_BOTTLENECK_GPU
+                                           : GOVERNOR_BOTTLENECK_CPU;
+}
+
+bool ThermalGovernor::Apply(GovernorRequest request,
+                            GovernorBottleneck bottleneck) {
+  const int32_t num_knobs = static_cast<int32_t>(knobs_.size());
+  if (request == GOVERNOR_REQUEST_DECREASE) {
+    // Relieve the bottleneck first, e.g. scale the resolution when GPU bound
+    // rather than the physics.
+    if (bottleneck != GOVERNOR_BOTTLENECK_UNKNOWN) {
+      for (auto i = 0; i < num_knobs; ++i) {
+        if (knobs_[i].relieves_ == bottleneck && MoveKnob(i, true)) {
+          return true;
+        }
+      }
+    }
+    for (auto i = 0; i < num_knobs; ++i) {
+      if (MoveKnob(i, true)) {
+        return true;
+      }
+    }
+  } else if (request == GOVERNOR_REQUEST_INCREASE) {
+    for (auto i = num_knobs - 1; i >= 0; --i) {
+      if (MoveKnob(i, false)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool ThermalGovernor::MoveKnob(int32_t index, bool decrease) {
+  if (index < 0 || index >= static_cast<int32_t>(knobs_.size())) {
+    return false;
+  }
+  const GovernorKnob& knob = knobs_[index];
+  const std::function<bool()>& move =
+      decrease ? knob.decrease_ : knob.increase_;
+  if (!move || !move()) {
+    return false;
+  }
+  last_knob_ = index;
+  last_action_ = knob.name_;
+  return true;
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef THERMAL_GOVERNOR_H_
+#define THERMAL_GOVERNOR_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "thermal_model.h"
+
+// Inputs sampled once per frame and fed to the governor.
+struct GovernorInput {
+  // Forecasted thermal headroom (see ADPFManager::GetThermalHeadroom()).
+  float thermal_headroom_;
+
+  // Current AThermalStatus.
+  int32_t thermal_status_;
+
+  // Measured frame time and the frame time we are aiming for, in seconds.
+  float frame_time_;
+  float target_frame_time_;
+
+  // Fraction of frames Swappy presented late over the last stats interval.
+  float missed_frame_ratio_;
+
+  // CPU and GPU time of a frame, in seconds, 0 when unknown. They tell which
+  // of the two limits the frame rate.
+  float cpu_time_;
+  float gpu_time_;
+
+  // The content load the frame ran at.
+  ThermalLoad load_;
+};
+
+// What limits the frame rate.
+enum GovernorBottleneck {
+  GOVERNOR_BOTTLENECK_UNKNOWN = 0,
+  GOVERNOR_BOTTLENECK_CPU,
+  GOVERNOR_BOTTLENECK_GPU
+};
+
+// What a policy wants the governor to do with the content load.
+enum GovernorRequest {
+  GOVERNOR_REQUEST_HOLD = 0,
+  GOVERNOR_REQUEST_DECREASE,
+  GOVERNOR_REQUEST_INCREASE
+};
+
+/*
+ * A policy maps the (smoothed) governor inputs to a request. Policies only
+ * express the curve; hysteresis and rate limiting are handled by the governor,
+ * so a policy can be swapped at runtime, e.g. per device tier.
+ */
+class GovernorPolicy {
+ public:
+  virtual ~GovernorPolicy() {}
+
+  virtual GovernorRequest Evaluate(const GovernorInput& input) = 0;
+
+  virtual const char* GetName() const = 0;
+};
+
+// Threshold based policy on thermal headroom and frame time.
+class HeadroomPolicy : public GovernorPolicy {
+ public:
+  struct Params {
+    // Decrease the load above this headroom, increase it below.
+    float decrease_headroom_;
+    float increase_headroom_;
+
+    // Decrease the load when frame time exceeds target * this ratio, only
+    // increase it when frame time is below target * this ratio.
+    float decrease_frame_ratio_;
+    float increase_frame_ratio_;
+
+    // Decrease the load when more frames than this are presented late, only
+    // increase it when fewer are.
+    float decrease_missed_ratio_;
+    float increase_missed_ratio_;
+
+    // Always decrease at or above this thermal status.
+    int32_t decrease_status_;
+  };
+
+  // Presets for different device tiers.
+  static Params DefaultParams();
+  static Params ConservativeParams();
+
+  HeadroomPolicy(const char* name, const Params& params);
+
+  virtual GovernorRequest Evaluate(const GovernorInput& input);
+
+  virtual const char* GetName() const { return name_; }
+
+ private:
+  const char* name_;
+  Params params_;
+};
+
+/*
+ * Keeps the headroom a ThermalModel predicts below a target. The load is
+ * decreased as soon as the current one is predicted to cross the target
+ * within the horizon, and is only increased when the next level up is
+ * predicted to stay below it. The governor then settles on the highest level
+ * that is sustainable, instead of cycling between the thresholds of a
+ * HeadroomPolicy as the device heats up and cools down.
+ *
+ * The frame time and thermal status limits are the ones of a HeadroomPolicy,
+ * which also takes over until the model is trained.
+ */
+class PredictivePolicy : public GovernorPolicy {
+ public:
+  struct Params {
+    // The headroom to stay under, and how far below it the next level up
+    // must be predicted to increase the load.
+    float target_headroom_;
+    float increase_margin_;
+
+    // How far past the platform forecast the headroom is predicted, in
+    // seconds.
+    float horizon_;
+
+    // Load added to each term of ThermalLoad to predict the next level up.
+    float load_step_;
+
+    HeadroomPolicy::Params limits_;
+  };
+
+  static Params DefaultParams();
+
+  // `model` must outlive the policy.
+  PredictivePolicy(const char* name, const Params& params,
+                   const ThermalModel* model);
+
+  virtual GovernorRequest Evaluate(const GovernorInput& input);
+
+  virtual const char* GetName() const { return name_; }
+
+  // Predicted headroom at the current load, from the last Evaluate().
+  float GetPredictedHeadroom() const { return predicted_headroom_; }
+
+ private:
+  const char* name_;
+  Params params_;
+  const ThermalModel* model_;
+  HeadroomPolicy fallback_;
+  float predicted_headroom_;
+};
+
+/*
+ * A single quality knob the governor can move. Knobs return false when they
+ * cannot move any further in the requested direction.
+ */
+struct GovernorKnob {
+  const char* name_;
+  std::function<bool()> decrease_;
+  std::function<bool()> increase_;
+  // Bottleneck the knob mostly relieves, UNKNOWN when it relieves both.
+  GovernorBottleneck relieves_ = GOVERNOR_BOTTLENECK_UNKNOWN;
+};
+
+/*
+ * Closed-loop governor that moves the registered knobs based on the policy's
+ * requests. A request has to persist for a hold time before it is acted on
+ * (hysteresis), and consecutive changes are separated by a minimum interval
+ * (rate limit), so the load does not oscillate between two levels.
+ *
+ * Knobs are decreased in registration order and increased in reverse order.
+ * When the input tells the frame is CPU or GPU bound, the knobs relieving
+ * that bottleneck are decreased first.
+ */
+class ThermalGovernor {
+ public:
+  // How long a request must persist before it is acted on, in seconds.
+  static constexpr float kDecreaseHoldTime = 1.0f;
+  static constexpr float kIncreaseHoldTime = 5.0f;
+
+  // Minimum interval after any change before the next one, in seconds.
+  static constexpr float kDecreaseInterval = 3.0f;
+  static constexpr float kIncreaseInterval = 10.0f;
+
+  // Smoothing factor of the frame time exponential moving average.
+  static constexpr float kFrameTimeSmoothing = 0.1f;
+
+  ThermalGovernor();
+
+  void SetPolicy(std::unique_ptr<GovernorPolicy> policy);
+
+  const GovernorPolicy* GetPolicy() const { return policy_.get(); }
+
+  void AddKnob(const GovernorKnob& knob);
+
+  // Feed the inputs of a frame. `now` is in seconds (see Clock()).
+  // Returns the name of the knob that was moved, or nullptr.
+  const char* Update(const GovernorInput& input, float now);
+
+  // Forget the pending request and restart the rate limit window.
+  void Reset(float now);
+
+  void SetEnabled(bool enabled) { enabled_ = enabled; }
+  bool IsEnabled() const { return enabled_; }
+
+  float GetSmoothedFrameTime() const { return smoothed_frame_time_; }
+  GovernorRequest GetPendingRequest() const { return pending_request_; }
+  GovernorBottleneck GetBottleneck() const { return bottleneck_; }
+  const char* GetLastAction() const { return last_action_; }
+  // Index of the knob moved last, in registration order, -1 before the
+  // first change.
+  int32_t GetLastKnob() const { return last_knob_; }
+
+  // Move knob `index` right away, e.g. to play back recorded decisions while
+  // the governor is disabled. Returns false when it cannot move.
+  bool MoveKnob(int32_t index, bool decrease);
+
+ private:
+  static GovernorBottleneck GetBottleneck(const GovernorInput& input);
+  bool Apply(GovernorRequest request, GovernorBottleneck bottleneck);
+
+  std::unique_ptr<GovernorPolicy> policy_;
+  std::vector<GovernorKnob> knobs_;
+  bool enabled_;
+
+  float smoothed_frame_time_;
+  GovernorBottleneck bottleneck_;
+  GovernorRequest pending_request_;
+  float pending_since_;
+  float last_change_;
+  int32_t last_knob_;
+  const char* last_action_;
+};
+
+#endif  // THERMAL_GOVERNOR_H_
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thermal_model.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "common.h"
+#include "util.h"
+
+namespace {
+const uint32_t kModelMagic = 0x314d4854;  // "THM1"
+// Bump when the features or the file layout change.
+const uint32_t kModelVersion = 2;
+
+// Initial covariance: the weights start at 0 with no confidence.
+const float kInitialCovariance = 100.f;
+// Past this trace of the covariance, stop forgetting. Without new
+// information (a constant load), forgetting alone makes it grow unbounded.
+const float kMaxCovarianceTrace = 1e4f;
+// Integration step of Predict(), in seconds.
+const float kPredictStep = 1.f;
+
+struct ModelHeader {
+  uint32_t magic_;
+  uint32_t version_;
+  uint64_t device_hash_;
+  int32_t num_samples_;
+  float mean_square_error_;
+};
+}  // namespace
+
+ThermalModel::ThermalModel() { Reset(); }
+
+void ThermalModel::Reset() {
+  for (auto i = 0; i < kNumFeatures; ++i) {
+    weights_[i] = 0.f;
+    for (auto j = 0; j < kNumFeatures; ++j) {
+      covariance_[i][j] = i == j ? kInitialCovariance : 0.f;
+    }
+  }
+  num_samples_ = 0;
+  mean_square_error_ = 0.f;
+  has_sample_ = false;
+  sample_time_ = 0.f;
+  sample_headroom_ = 0.f;
+}
+
+void ThermalModel::GetFeatures(const ThermalLoad& load, float headroom,
+                               float* features) {
+  features[0] = 1.f;
+  features[1] = load.physics_;
+  features[2] = load.boxes_;
+  features[3] = load.pixels_;
+  features[4] = headroom;
+}
+
+float ThermalModel::PredictSlope(const float* features) const {
+  float slope = 0.f;
+  for (auto i = 0; i < kNumFeatures; ++i) {
+    slope += weights_[i] * features[i];
+  }
+  return slope;
+}
+
+//--------------------------------------------------------------------------------
+// The slope over the last interval is attributed to the load at its end and
+// to the mean headroom over it.
+//--------------------------------------------------------------------------------
+void ThermalModel::Observe(const ThermalLoad& load, float headroom,
+                           float now) {
+  // 0 until the first poll, NaN when the platform has no forecast.
+  if (!(headroom > 0.f)) {
+    return;
+  }
+  if (!has_sample_) {
+    has_sample_ = true;
+    sample_time_ = now;
+    sample_headroom_ = headroom;
+    return;
+  }
+  const float elapsed = now - sample_time_;
+  if (elapsed < kObserveInterval) {
+    return;
+  }
+
+  float features[kNumFeatures];
+  GetFeatures(load, (headroom + sample_headroom_) * 0.5f, features);
+  Update(features, (headroom - sample_headroom_) / elapsed);
+  sample_time_ = now;
+  sample_headroom_ = headroom;
+}
+
+//--------------------------------------------------------------------------------
+// Recursive least squares with forgetting:
+//   gain = P x / (lambda + x' P x)
+//   w += gain * (y - w' x)
+//   P = (P - gain x' P) / lambda
+//--------------------------------------------------------------------------------
+void ThermalModel::Update(const float* features, float slope) {
+  float px[kNumFeatures];
+  float denominator = 0.f;
+  float trace = 0.f;
+  for (auto i = 0; i < kNumFeatures; ++i) {
+    px[i] = 0.f;
+    for (auto j = 0; j < kNumFeatures; ++j) {
+      px[i] += covariance_[i][j] * features[j];
+    }
+    denominator += features[i] * px[i];
+    trace += covariance_[i][i];
+  }
+  const float forgetting = trace < kMaxCovarianceTrace ? kForgetting : 1.f;
+  denominator += forgetting;
+
+  const float error = slope - PredictSlope(features);
+  for (auto i = 0; i < kNumFeatures; ++i) {
+    weights_[i] += px[i] / denominator * error;
+  }
+  // P is symmetric, so x' P is px transposed.
+  for (auto i = 0; i < kNumFeatures; ++i) {
+    for (auto j = 0; j < kNumFeatures; ++j) {
+      covariance_[i][j] =
+          (covariance_[i][j] - px[i] * px[j] / denominator) / forgetting;
+    }
+  }
+
+  ++num_samples_;
+  mean_square_error_ +=
+      (error * error - mean_square_error_) * (1.f - kForgetting);
+}
+
+float ThermalModel::Predict(const ThermalLoad& load, float headroom,
+                            float seconds) const {
+  float features[kNumFeatures];
+  for (float t = 0.f; t < seconds; t += kPredictStep) {
+    GetFeatures(load, headroom, features);
+    const float step = std::min(kPredictStep, seconds - t);
+    headroom = std::max(headroom + PredictSlope(features) * step, 0.f);
+  }
+  return headroom;
+}
+
+//--------------------------------------------------------------------------------
+// Persistence, written next to the final path and renamed over it.
+//--------------------------------------------------------------------------------
+bool ThermalModel::Load(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  ModelHeader header;
+  float weights[kNumFeatures];
+  float covariance[kNumFeatures][kNumFeatures];
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+            header.magic_ == kModelMagic && header.version_ == kModelVersion &&
+            header.device_hash_ == GetDeviceHash() &&
+            fread(weights, sizeof(weights), 1, file) == 1 &&
+            fread(covariance, sizeof(covariance), 1, file) == 1;
+  fclose(file);
+  if (!ok) {
+    ALOGI("ThermalModel: ignoring stale %s", path.c_str());
+    return false;
+  }
+
+  memcpy(weights_, weights, sizeof(weights_));
+  memcpy(covariance_, covariance, sizeof(covariance_));
+  num_samples_ = header.num_samples_;
+  mean_square_error_ = header.mean_square_error_;
+  has_sample_ = false;
+  ALOGI("ThermalModel: loaded %d samples from %s", num_samples_, path.c_str());
+  return true;
+}
+
+bool ThermalModel::Save(const std::string& path) const {
+  ModelHeader header;
+  header.magic_ = kModelMagic;
+  header.version_ = kModelVersion;
+  header.device_hash_ = GetDeviceHash();
+  header.num_samples_ = num_samples_;
+  header.mean_square_error_ = mean_square_error_;
+
+  std::string temp_path = path + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "wb");
+  if (file == nullptr) {
+    ALOGW("ThermalModel: cannot open %s", temp_path.c_str());
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(weights_, sizeof(weights_), 1, file) == 1 &&
+            fwrite(covariance_, sizeof(covariance_), 1, file) == 1;
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+    ALOGW("ThermalModel: cannot write %s", path.c_str());
+    remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
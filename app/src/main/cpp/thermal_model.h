@@ -0,0 +1,103 @@
+/*
+ * Copyright 2022 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef THERMAL_MODEL_H_
+#define THERMAL_MODEL_H_
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+// The content load, each term normalized to [0, 1] of its maximum.
+struct ThermalLoad {
+  float physics_;  // physics steps per tick times solver iterations
+  float boxes_;    // # of boxes
+  float pixels_;   // square of the resolution scale
+};
+
+/*
+ * Online model of how the thermal headroom responds to the load, learned
+ * while the app runs:
+ *
+ *   d(headroom)/dt = w0 + w1 * physics + w2 * boxes + w3 * pixels
+ *                    + w4 * headroom
+ *
+ * The load terms heat the device up, the headroom term (negative once
+ * learned) is the cooling, which grows with the temperature. The weights are
+ * fitted by recursive least squares with exponential forgetting, so the fit
+ * follows slow changes like the ambient temperature or a case being put on.
+ *
+ * Observe() samples the slope of the headroom every kObserveInterval. The
+ * headroom itself is the platform forecast (AThermal_getThermalHeadroom()),
+ * Predict() extrapolates it further for a given load.
+ *
+ * The weights are saved per device (GetDeviceName()), so a run starts from
+ * what the previous ones learned.
+ */
+class ThermalModel {
+ public:
+  static constexpr int32_t kNumFeatures = 5;
+  // Interval between two slope samples, in seconds. The headroom is polled
+  // once per second, so shorter intervals mostly measure the polling.
+  static constexpr float kObserveInterval = 2.f;
+  // Forgetting factor per sample: the fit mostly reflects the last
+  // kObserveInterval / (1 - kForgetting) = 200 seconds.
+  static constexpr float kForgetting = 0.99f;
+  // # of samples before the predictions are trusted.
+  static constexpr int32_t kMinSamples = 30;
+
+  ThermalModel();
+
+  // Forget everything learned.
+  void Reset();
+
+  // Feed the headroom and the load of a frame. `now` is in seconds (see
+  // Clock()).
+  void Observe(const ThermalLoad& load, float headroom, float now);
+
+  // Headroom `seconds` from now when running at `load`, starting from
+  // `headroom`.
+  float Predict(const ThermalLoad& load, float headroom, float seconds) const;
+
+  bool IsTrained() const { return num_samples_ >= kMinSamples; }
+  int32_t GetSampleCount() const { return num_samples_; }
+  // Root mean square error of the slope predictions, per second.
+  float GetError() const { return sqrtf(mean_square_error_); }
+
+  // Read and write the weights. Load() fails when the file was written by
+  // another device or version, and leaves the model untouched.
+  bool Load(const std::string& path);
+  bool Save(const std::string& path) const;
+
+ private:
+  static void GetFeatures(const ThermalLoad& load, float headroom,
+                          float* features);
+  float PredictSlope(const float* features) const;
+  void Update(const float* features, float slope);
+
+  float weights_[kNumFeatures];
+  // Covariance of the weights.
+  float covariance_[kNumFeatures][kNumFeatures];
+  int32_t num_samples_;
+  float mean_square_error_;
+
+  // The previous sample, the slope is measured from it.
+  bool has_sample_;
+  float sample_time_;
+  float sample_headroom_;
+};
+
+#endif  // THERMAL_MODEL_H_
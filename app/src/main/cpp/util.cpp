@@ -16,9 +16,19 @@
 
 #include "util.h"
 
+#include <sys/system_properties.h>
+
 #include <cstdlib>
 #include <ctime>
 
+namespace {
+std::string GetSystemProperty(const char* name) {
+  char value[PROP_VALUE_MAX] = {};
+  __system_property_get(name, value);
+  return value;
+}
+}  // namespace
+
 int Random(int uboundExclusive) {
   int r = rand();
   return r % uboundExclusive;
@@ -46,6 +56,25 @@ float Clock() {
   return secDiff + 0.001f * msecDiff;
 }
 
+std::string GetDeviceName() {
+  // ro.soc.model only exists from Android 12 on.
+  std::string soc = GetSystemProperty("ro.soc.model");
+  if (soc.empty()) {
+    soc = GetSystemProperty("ro.board.platform");
+  }
+  return GetSystemProperty("ro.product.manufacturer") + " " +
+         GetSystemProperty("ro.product.model") + " " + soc;
+}
+
+uint64_t GetDeviceHash() {
+  const std::string name = GetDeviceName();
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (char c : name) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
 float SineWave(float min, float max, float period, float phase) {
   float ampl = max - min;
   return min + ampl * sin(((Clock() / period) + phase) * 2 * M_PI);
@@ -18,7 +18,9 @@
 #define UTIL_H_
 
 #include <cmath>
+#include <cstdint>
 #include <ctime>
+#include <string>
 
 // Clean up a resource (delete and set to null).
 template <typename T>
@@ -89,6 +91,12 @@ T Abs(T f) {
 // point in the past).
 float Clock();
 
+// "<manufacturer> <model> <soc>" from the system properties, what the data
+// learned on a device is keyed by.
+std::string GetDeviceName();
+// FNV-1a hash of GetDeviceName(), stored in the files of per device data.
+uint64_t GetDeviceHash();
+
 float SineWave(float min, float max, float period, float phase);
 
 bool BlinkFunc(float period);
@@ -26,6 +26,9 @@
 #include "imgui.h"
 #include "imgui_manager.h"
 #include "native_engine.h"
+#include "render_thread.h"
+#include "replay_log.h"
+#include "soak_test.h"
 
 extern "C" {
 #include <GLES2/gl2.h>
@@ -48,6 +51,15 @@ WelcomeScene::~WelcomeScene() {}
 //--------------------------------------------------------------------------------
 // Install => StartGraphics => KillGraphics => Uninstall
 void WelcomeScene::OnInstall() {
+  // Build the physics world of the demo while the welcome screen is shown.
+  SceneManager::GetInstance()->PreloadScene(
+      []() -> Scene* { return new DemoScene(); });
+  // A soak test runs unattended, don't wait for a tap. A recording starts
+  // right away too, so its replays start at the same point.
+  if (SoakTest::GetInstance()->IsRequested() ||
+      ReplayLog::GetInstance()->IsRequested()) {
+    SceneManager::GetInstance()->RequestPreloadedScene();
+  }
 }
 
 void WelcomeScene::OnStartGraphics() {
@@ -72,16 +84,14 @@ void WelcomeScene::OnScreenResized(int width, int height) {}
 //--------------------------------------------------------------------------------
 void WelcomeScene::DoFrame() {
   // clear screen
-  glClearColor(0.8588f, 0.2666f, 0.2156f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glDisable(GL_DEPTH_TEST);
+  RenderThread::GetInstance()->GetFrame()->Clear(0.8588f, 0.2666f, 0.2156f,
+                                                 1.0f);
 
   ImGuiManager* imguiManager = NativeEngine::GetInstance()->GetImGuiManager();
-  imguiManager->BeginImGuiFrame();
-  RenderUI();
+  if (imguiManager->BeginImGuiFrame()) {
+    RenderUI();
+  }
   imguiManager->EndImGuiFrame();
-
-  glEnable(GL_DEPTH_TEST);
 }
 
 //--------------------------------------------------------------------------------
@@ -90,7 +100,7 @@ void WelcomeScene::DoFrame() {
 void WelcomeScene::OnPointerDown(int pointerId,
                                  const struct PointerCoords* coords) {
   SceneManager* mgr = SceneManager::GetInstance();
-  mgr->RequestNewScene(new DemoScene());
+  mgr->RequestPreloadedScene();
 }
 
 void WelcomeScene::OnPointerMove(int pointerId,
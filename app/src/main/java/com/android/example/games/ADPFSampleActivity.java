@@ -15,6 +15,7 @@
  */
 package com.android.example.games;
 
+import android.content.Intent;
 import android.os.Build.VERSION;
 import android.os.Build.VERSION_CODES;
 import android.os.Bundle;
@@ -31,6 +32,22 @@ import com.google.androidgamesdk.GameActivity;
 // a workaround for loading the runtime shared library on old Android versions.
 public class ADPFSampleActivity extends GameActivity {
 
+    // Intent extras starting a soak test, e.g.
+    // adb shell am start -n <package>/com.android.example.games.ADPFSampleActivity \
+    //     --ei soak_duration 3600 --es soak_profile "600:8:8,600:12:16"
+    // The duration is in seconds. The profile lists <seconds>:<array size>:<physics steps>
+    // segments played in a loop; without it the thermal governor drives the load.
+    private static final String EXTRA_SOAK_DURATION = "soak_duration";
+    private static final String EXTRA_SOAK_PROFILE = "soak_profile";
+
+    // Intent extras recording a run for <seconds>, or replaying a recording, e.g.
+    //     --ei replay_record 120
+    //     --es replay_file replay_20221014_101500.bin
+    // The recording is written to the external files directory, where the file to replay
+    // is looked up unless its path is absolute.
+    private static final String EXTRA_REPLAY_RECORD = "replay_record";
+    private static final String EXTRA_REPLAY_FILE = "replay_file";
+
     // Load our native library:
     static {
         // Load the STL first to workaround issues on old Android versions:
@@ -70,6 +87,18 @@ public class ADPFSampleActivity extends GameActivity {
         WindowCompat.setDecorFitsSystemWindows(getWindow(), false);
         hideSystemUI();
 
+        // The native side reads the request when the demo scene starts.
+        Intent intent = getIntent();
+        int soakDuration = intent.getIntExtra(EXTRA_SOAK_DURATION, 0);
+        if (soakDuration > 0) {
+            nativeConfigureSoakTest(soakDuration, intent.getStringExtra(EXTRA_SOAK_PROFILE));
+        }
+        int replayRecord = intent.getIntExtra(EXTRA_REPLAY_RECORD, 0);
+        String replayFile = intent.getStringExtra(EXTRA_REPLAY_FILE);
+        if (replayRecord > 0 || replayFile != null) {
+            nativeConfigureReplay(replayRecord, replayFile);
+        }
+
         super.onCreate(savedInstanceState);
     }
 
@@ -84,4 +113,18 @@ public class ADPFSampleActivity extends GameActivity {
     protected void onPause() {
         super.onPause();
     }
+
+    // GameActivity forwards onTrimMemory() without its level: store the level for the native
+    // side first, it picks how much to free from it.
+    @Override
+    public void onTrimMemory(int level) {
+        nativeOnTrimMemory(level);
+        super.onTrimMemory(level);
+    }
+
+    private static native void nativeConfigureSoakTest(int durationSeconds, String profile);
+
+    private static native void nativeConfigureReplay(int recordSeconds, String replayFile);
+
+    private static native void nativeOnTrimMemory(int level);
 }